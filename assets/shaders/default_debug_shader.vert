@@ -14,6 +14,9 @@ layout(push_constant) uniform push_constants {
 
 layout(location = 0) out vec4 out_color;
 
+// Same position as default_depth_prepass, for the color pass after a depth prepass
+invariant gl_Position;
+
 void main()
 {
     out_color = in_color;
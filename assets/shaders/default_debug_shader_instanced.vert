@@ -0,0 +1,22 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec4 in_color;
+// Per instance, one column per location
+layout(location = 2) in mat4 in_model;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+    mat4 view;
+} global_ubo;
+
+layout(location = 0) out vec4 out_color;
+
+// Same position as default_depth_prepass_instanced, for the color pass after a depth prepass
+invariant gl_Position;
+
+void main()
+{
+    out_color = in_color;
+    gl_Position = global_ubo.projection * global_ubo.view * in_model * vec4(in_position, 1.0);
+}
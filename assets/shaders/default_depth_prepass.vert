@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+    mat4 view;
+} global_ubo;
+
+layout(push_constant) uniform push_constants {
+    mat4 model;
+} u_push_constants;
+
+// Must match the color pass bit for bit, which tests against this depth with EQUAL
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = global_ubo.projection * global_ubo.view * u_push_constants.model * vec4(in_position, 1.0);
+}
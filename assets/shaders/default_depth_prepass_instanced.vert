@@ -0,0 +1,18 @@
+#version 450
+
+layout(location = 0) in vec3 in_position;
+// Per instance, one column per location
+layout(location = 2) in mat4 in_model;
+
+layout(set = 0, binding = 0) uniform global_uniform_object {
+    mat4 projection;
+    mat4 view;
+} global_ubo;
+
+// Must match the color pass bit for bit, which tests against this depth with EQUAL
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = global_ubo.projection * global_ubo.view * in_model * vec4(in_position, 1.0);
+}
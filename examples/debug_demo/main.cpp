@@ -8,7 +8,9 @@
 int main()
 {
     flwfrg::init();
-    flwfrg::vk::Renderer renderer{600, 600, "Debug Demo", flwfrg::vk::shader::DebugShader::get_minimum_requirements()};
+    // Solid frames lay down depth first, so each pixel is only shaded once
+    flwfrg::vk::Renderer renderer{600, 600, "Debug Demo", flwfrg::vk::shader::DebugShader::get_minimum_requirements(), {},
+                                  {.depth_prepass = true}};
     auto &display_context = renderer.get_display_context();
     flwfrg::vk::shader::DebugShader debug_shader(&renderer.get_display_context());
 
@@ -52,16 +54,22 @@ int main()
     // flwfrg::vk::ColorModelManager::GeometryRenderData object_data{};
 
     flwfrg::vk::ColorModelManager manager{&renderer.get_display_context().get_device()};
-    manager.reserve_vertex_buffer_space(sizeof(flwfrg::vk::ColorVertex) * vertices.size() * 2);
+    manager.reserve_vertex_buffer_space((sizeof(flwfrg::vk::ColorVertex) + sizeof(flwfrg::vk::CompactColorVertex)) *
+                                        vertices.size());
     manager.reserve_index_buffer_space(sizeof(uint32_t) * indices.size() * 2);
-    
-    flwfrg::vk::ColorModelManager::object_id_t object_id_0 = manager.register_model(vertices, indices);
-    vertices[0].position.z = -1;
-    flwfrg::vk::ColorModelManager::object_id_t object_id_1 = manager.register_model(vertices, indices);
 
-    auto transform = manager.get_transform(object_id_1);
+    // The quad is uploaded once and both copies of it are drawn in a single instanced draw
+    flwfrg::vk::ColorModelManager::mesh_id_t quad = manager.register_mesh(vertices, indices);
+    manager.create_instance(quad);
+    flwfrg::Transform transform{};
     transform.translation.x += 4;
-    manager.set_transform(object_id_1, transform);
+    manager.create_instance(quad, transform);
+
+    // The same quad in the compact vertex format, drawn with the compact pipelines
+    flwfrg::vk::ColorModelManager::mesh_id_t compact_quad =
+            manager.register_mesh(vertices, indices, flwfrg::vk::VertexFormat::COMPACT);
+    transform.translation.x = -4;
+    manager.create_instance(compact_quad, transform);
 
     flwfrg::KeyboardController controller;
     flwfrg::Camera camera;
@@ -89,27 +97,29 @@ int main()
 
         controller.move_in_plane_XZ(display_context.get_window()->get_glfw_window_ptr(), camera_transform, 0.007);
         camera.set_viewYXZ(camera_transform.translation, camera_transform.rotation);
-        debug_shader.update_global_state(camera.get_projection(), camera.get_view());
+        debug_shader.prepare_global_state(camera.get_projection(), camera.get_view());
         // object_data.model = object_transform.mat4();
         // debug_shader.update_object(object_data);
 
-        // Draw object 0
-        auto render_info = manager.get_model_render_info(object_id_0);
-        debug_shader.update_object(render_info.render_data);
-
-        VkDeviceSize offsets[1] = {render_info.vertex_offset};
-        vkCmdBindVertexBuffers(frame_data.value()->get_handle(), 0, 1, &render_info.vertex_buffer, offsets);
-        vkCmdBindIndexBuffer(frame_data.value()->get_handle(), render_info.index_buffer, render_info.index_offset, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(frame_data.value()->get_handle(), indices.size(), 1, 0, 0, 0);
+        // Meshes with LODs are drawn at the coarsest one that stays within a pixel of the full detail mesh
+        flwfrg::vk::ColorModelManager::LodSelection lod_selection{
+                .camera = &camera,
+                .viewport_height = static_cast<float>(display_context.get_swapchain().get_extent().height),
+        };
+        const auto &instanced_draws = manager.update_instances(display_context.get_current_frame(), lod_selection);
 
-        // Draw object 1
-        render_info = manager.get_model_render_info(object_id_1);
-        debug_shader.update_object(render_info.render_data);
+        // Depth prepass
+        flwfrg::vk::CommandBuffer &command_buffer = *frame_data.value();
+        if (debug_shader.uses_depth_prepass())
+        {
+            debug_shader.bind_global_state(command_buffer);
+            debug_shader.draw_instances(command_buffer, instanced_draws, true);
+        }
+        renderer.next_subpass();
 
-        offsets[0] = render_info.vertex_offset;
-        vkCmdBindVertexBuffers(frame_data.value()->get_handle(), 0, 1, &render_info.vertex_buffer, offsets);
-        vkCmdBindIndexBuffer(frame_data.value()->get_handle(), render_info.index_buffer, render_info.index_offset, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(frame_data.value()->get_handle(), indices.size(), 1, 0, 0, 0);
+        // Color pass
+        debug_shader.bind_global_state(command_buffer);
+        debug_shader.draw_instances(command_buffer, instanced_draws);
 
 
 
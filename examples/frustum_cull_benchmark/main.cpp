@@ -0,0 +1,144 @@
+#include "math/bounds.hpp"
+#include "math/camera.hpp"
+#include "math/frustum.hpp"
+
+#include <array>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+constexpr size_t object_count = 100000;
+constexpr int repetitions = 200;
+
+// What culling looks like without the batch kernels, one object and one glm plane at a time
+void cull_spheres_glm(const std::array<glm::vec4, 6> &planes, const std::vector<glm::vec4> &spheres,
+                      std::vector<uint64_t> &visible)
+{
+    visible.assign((spheres.size() + 63) / 64, 0);
+    for (size_t i = 0; i < spheres.size(); i++)
+    {
+        bool inside = true;
+        for (const auto &plane: planes)
+        {
+            inside &= glm::dot(plane, glm::vec4{glm::vec3{spheres[i]}, 1.0f}) >= -spheres[i].w;
+        }
+        visible[i / 64] |= static_cast<uint64_t>(inside) << (i % 64);
+    }
+}
+
+void cull_aabbs_glm(const std::array<glm::vec4, 6> &planes, const std::vector<flwfrg::AABB> &boxes,
+                    std::vector<uint64_t> &visible)
+{
+    visible.assign((boxes.size() + 63) / 64, 0);
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        glm::vec3 center = boxes[i].center();
+        glm::vec3 extent = boxes[i].extent();
+        bool inside = true;
+        for (const auto &plane: planes)
+        {
+            inside &= glm::dot(glm::vec3{plane}, center) + plane.w + glm::dot(glm::abs(glm::vec3{plane}), extent) >=
+                      0.0f;
+        }
+        visible[i / 64] |= static_cast<uint64_t>(inside) << (i % 64);
+    }
+}
+
+template<typename Function>
+double time_per_object(Function &&function)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int repetition = 0; repetition < repetitions; repetition++)
+    {
+        function();
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (repetitions * object_count);
+}
+
+const char *get_name(flwfrg::Frustum::InstructionSet instruction_set)
+{
+    switch (instruction_set)
+    {
+        case flwfrg::Frustum::InstructionSet::SCALAR:
+            return "scalar";
+        case flwfrg::Frustum::InstructionSet::SSE:
+            return "SSE";
+        case flwfrg::Frustum::InstructionSet::AVX2:
+            return "AVX2";
+    }
+    return "unknown";
+}
+
+}// namespace
+
+int main()
+{
+    flwfrg::Camera camera;
+    camera.set_perspective_projection(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+    camera.set_view_direction({0.0f, 0.0f, -200.0f}, {0.0f, 0.0f, 1.0f});
+    flwfrg::Frustum frustum = camera.frustum();
+
+    std::array<glm::vec4, 6> planes{};
+    for (uint32_t plane = 0; plane < planes.size(); plane++)
+    {
+        planes[plane] = frustum.get_plane(plane);
+    }
+
+    // Objects spread around the camera, with some in view
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> position{-400.0f, 400.0f};
+    std::uniform_real_distribution<float> size{0.5f, 5.0f};
+
+    std::vector<glm::vec4> spheres(object_count);
+    std::vector<flwfrg::AABB> boxes(object_count);
+    for (size_t i = 0; i < object_count; i++)
+    {
+        glm::vec3 center{position(random), position(random), position(random)};
+        glm::vec3 extent{size(random), size(random), size(random)};
+        spheres[i] = glm::vec4{center, glm::length(extent)};
+        boxes[i] = flwfrg::AABB{center - extent, center + extent};
+    }
+
+    std::vector<uint64_t> reference_visible{};
+    std::vector<uint64_t> visible{};
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << object_count << " objects, best supported: " << get_name(flwfrg::Frustum::get_supported_instruction_set())
+              << "\n";
+
+    double sphere_baseline = time_per_object([&] { cull_spheres_glm(planes, spheres, reference_visible); });
+    std::cout << "spheres glm:    " << sphere_baseline << " ns per object\n";
+    for (auto instruction_set: {flwfrg::Frustum::InstructionSet::SCALAR, flwfrg::Frustum::InstructionSet::SSE,
+                                flwfrg::Frustum::InstructionSet::AVX2})
+    {
+        if (instruction_set > flwfrg::Frustum::get_supported_instruction_set())
+            continue;
+
+        double time = time_per_object([&] { frustum.cull_spheres(spheres, visible, instruction_set); });
+        std::cout << "spheres " << std::setw(6) << std::left << get_name(instruction_set) << ": " << time
+                  << " ns per object, " << sphere_baseline / time << "x"
+                  << (visible == reference_visible ? "" : ", results differ from glm") << "\n";
+    }
+
+    double box_baseline = time_per_object([&] { cull_aabbs_glm(planes, boxes, reference_visible); });
+    std::cout << "boxes glm:      " << box_baseline << " ns per object\n";
+    for (auto instruction_set: {flwfrg::Frustum::InstructionSet::SCALAR, flwfrg::Frustum::InstructionSet::SSE,
+                                flwfrg::Frustum::InstructionSet::AVX2})
+    {
+        if (instruction_set > flwfrg::Frustum::get_supported_instruction_set())
+            continue;
+
+        double time = time_per_object([&] { frustum.cull_aabbs(boxes, visible, instruction_set); });
+        std::cout << "boxes " << std::setw(8) << std::left << get_name(instruction_set) << ": " << time
+                  << " ns per object, " << box_baseline / time << "x"
+                  << (visible == reference_visible ? "" : ", results differ from glm") << "\n";
+    }
+
+    return 0;
+}
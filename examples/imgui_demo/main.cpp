@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <optional>
 
 #include "vulkan/resource/im_gui_texture.hpp"
 
@@ -18,6 +19,50 @@ void resize_texture(uint32_t width, uint32_t height,flwfrg::vk::ImGuiTexture& te
     new_data.resize(width * height * texture.get_channel_count());
 }
 
+// Returns a new config if the user changed anything
+std::optional<flwfrg::vk::PresentConfig> draw_presentation_window(const flwfrg::vk::Renderer &renderer)
+{
+    flwfrg::vk::PresentConfig config = renderer.get_present_config();
+    bool changed = false;
+
+    ImGui::Begin("Presentation");
+
+    const char *mode_names[] = {"Immediate", "Mailbox", "FIFO", "FIFO relaxed"};
+    int mode = static_cast<int>(config.present_mode);
+    if (ImGui::Combo("Present mode", &mode, mode_names, IM_ARRAYSIZE(mode_names)))
+    {
+        config.present_mode = static_cast<flwfrg::vk::PresentMode>(mode);
+        changed = true;
+    }
+
+    int frames_in_flight = config.frames_in_flight;
+    if (ImGui::SliderInt("Frames in flight", &frames_in_flight, 1, 4))
+    {
+        config.frames_in_flight = static_cast<uint8_t>(frames_in_flight);
+        changed = true;
+    }
+
+    changed |= ImGui::Checkbox("Latency limiter", &config.latency_limiter);
+    int max_queued_frames = config.max_queued_frames;
+    if (ImGui::SliderInt("Max queued frames", &max_queued_frames, 0, 3))
+    {
+        config.max_queued_frames = static_cast<uint8_t>(max_queued_frames);
+        changed = true;
+    }
+
+    const auto &stats = renderer.get_latency_stats();
+    ImGui::Separator();
+    ImGui::Text("Input to %s", stats.measured_to_display ? "display" : "present call");
+    ImGui::Text("Last %.2f ms, average %.2f ms", stats.last_ms, stats.average_ms);
+    ImGui::Text("Min %.2f ms, max %.2f ms", stats.min_ms, stats.max_ms);
+
+    ImGui::End();
+
+    if (!changed)
+        return std::nullopt;
+    return config;
+}
+
 int main()
 {
     flwfrg::init();
@@ -43,6 +88,7 @@ int main()
         im_gui_shader.begin_frame();
 
         ImGui::ShowDemoWindow();
+        auto new_present_config = draw_presentation_window(renderer);
 
 
         ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0.0f, 0.0f));
@@ -63,6 +109,13 @@ int main()
 
         renderer.end_frame();
 
+        // Recreates the swapchain, so only between frames
+        if (new_present_config.has_value())
+        {
+            renderer.set_present_config(new_present_config.value());
+            renderer.reset_latency_stats();
+        }
+
         resize_texture(viewport_width, viewport_height, texture, new_data);
 
         std::ranges::fill(new_data, static_cast<uint8_t>((std::sin(value) + 1) * 127.5f));
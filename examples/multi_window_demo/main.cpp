@@ -0,0 +1,90 @@
+#include "default_shaders.hpp"
+#include "math/camera.hpp"
+#include "math/transform.hpp"
+#include "vulkan/shader/vertex.hpp"
+
+#include <array>
+
+int main()
+{
+    flwfrg::init();
+
+    // The first renderer creates the device, the second opens its window on the same one. Declared first, so it is
+    // destroyed last.
+    flwfrg::vk::Renderer main_renderer{600, 600, "Multi Window Demo (Front)",
+                                       flwfrg::vk::shader::DebugShader::get_minimum_requirements()};
+    flwfrg::vk::Renderer side_renderer{main_renderer.get_graphics_context(), 600, 600, "Multi Window Demo (Side)"};
+
+    // Pipelines are made for a window's render pass, the geometry is shared
+    flwfrg::vk::shader::DebugShader main_shader(&main_renderer.get_display_context());
+    flwfrg::vk::shader::DebugShader side_shader(&side_renderer.get_display_context());
+
+    std::vector<flwfrg::vk::ColorVertex> vertices{};
+    vertices.resize(4);
+    vertices[0].position = {-0.5, 0.5, 0};
+    vertices[0].color = {1.0, 0.0, 0.0, 1.0};
+    vertices[1].position = {0.5, -0.5, 0};
+    vertices[1].color = {0.0, 1.0, 0.0, 1.0};
+    vertices[2].position = {-0.5, -0.5, 0};
+    vertices[2].color = {0.0, 0.0, 1.0, 1.0};
+    vertices[3].position = {0.5, 0.5, 0};
+    vertices[3].color = {1.0, 1.0, 1.0, 1.0};
+
+    std::vector<uint32_t> indices{0, 1, 2, 0, 3, 1};
+
+    flwfrg::vk::ColorModelManager manager{&main_renderer.get_display_context().get_device()};
+    manager.reserve_vertex_buffer_space(sizeof(flwfrg::vk::ColorVertex) * vertices.size());
+    manager.reserve_index_buffer_space(sizeof(uint32_t) * indices.size());
+    auto object_id = manager.register_model(vertices, indices);
+
+    flwfrg::Camera camera;
+    camera.set_perspective_projection(glm::radians(50.0f), 1.0f, 0.1f, 1000.0f);
+
+    // One camera looking at the quad from the front, one from the side
+    std::array<flwfrg::Transform, 2> camera_transforms{};
+    camera_transforms[0].translation.z = -3;
+    camera_transforms[1].translation.x = -3;
+    camera_transforms[1].rotation.y = glm::half_pi<float>();
+
+    std::array<flwfrg::vk::Renderer *, 2> renderers{&main_renderer, &side_renderer};
+    std::array<flwfrg::vk::shader::DebugShader *, 2> shaders{&main_shader, &side_shader};
+
+    float rotation = 0;
+    while (!main_renderer.should_close() && !side_renderer.should_close())
+    {
+        auto transform = manager.get_transform(object_id);
+        transform.rotation.z = rotation;
+        manager.set_transform(object_id, transform);
+        rotation += 0.01f;
+
+        std::vector<flwfrg::vk::Renderer *> submitted{};
+        for (size_t i = 0; i < renderers.size(); i++)
+        {
+            auto frame_data = renderers[i]->begin_frame();
+            if (!frame_data.has_value())
+                continue;
+
+            camera.set_viewYXZ(camera_transforms[i].translation, camera_transforms[i].rotation);
+            shaders[i]->update_global_state(camera.get_projection(), camera.get_view());
+
+            auto render_info = manager.get_model_render_info(object_id);
+            shaders[i]->update_object(render_info.render_data);
+
+            VkDeviceSize offsets[1] = {render_info.vertex_offset};
+            vkCmdBindVertexBuffers(frame_data.value()->get_handle(), 0, 1, &render_info.vertex_buffer, offsets);
+            vkCmdBindIndexBuffer(frame_data.value()->get_handle(), render_info.index_buffer, render_info.index_offset,
+                                 render_info.index_type);
+            vkCmdDrawIndexed(frame_data.value()->get_handle(), static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+
+            renderers[i]->submit_frame();
+            submitted.push_back(renderers[i]);
+        }
+
+        // Both windows in a single present call
+        flwfrg::vk::Renderer::present_frames(submitted);
+    }
+
+    main_renderer.get_display_context().get_device().wait_idle();
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "default_shaders.hpp"
+#include "input/keyboard_controller.hpp"
+#include "math/camera.hpp"
+#include "math/transform.hpp"
+#include "threading/thread_pool.hpp"
+#include "vulkan/parallel_recorder.hpp"
+#include "vulkan/shader/vertex.hpp"
+
+int main()
+{
+    flwfrg::init();
+    flwfrg::vk::Renderer renderer{800, 800, "Parallel Demo", flwfrg::vk::shader::DebugShader::get_minimum_requirements()};
+    auto &display_context = renderer.get_display_context();
+    flwfrg::vk::shader::DebugShader debug_shader(&renderer.get_display_context());
+    debug_shader.use_wire_frame(false);
+
+    std::vector<flwfrg::vk::ColorVertex> vertices{};
+    vertices.resize(4);
+    vertices[0].position = {-0.5, 0.5, 0};
+    vertices[0].color = {1.0, 0.0, 0.0, 1.0};
+    vertices[1].position = {0.5, -0.5, 0};
+    vertices[1].color = {0.0, 1.0, 0.0, 1.0};
+    vertices[2].position = {-0.5, -0.5, 0};
+    vertices[2].color = {0.0, 0.0, 1.0, 1.0};
+    vertices[3].position = {0.5, 0.5, 0};
+    vertices[3].color = {1.0, 1.0, 1.0, 1.0};
+
+    std::vector<uint32_t> indices{0, 1, 2, 0, 3, 1};
+
+    // A grid of quads, each its own draw
+    constexpr int32_t grid_size = 100;
+
+    flwfrg::vk::ColorModelManager manager{&display_context.get_device()};
+    manager.reserve_vertex_buffer_space(sizeof(flwfrg::vk::ColorVertex) * vertices.size() * grid_size * grid_size);
+    manager.reserve_index_buffer_space(sizeof(uint32_t) * indices.size() * grid_size * grid_size);
+
+    std::vector<flwfrg::vk::ColorModelManager::object_id_t> objects{};
+    for (int32_t x = 0; x < grid_size; x++)
+    {
+        for (int32_t y = 0; y < grid_size; y++)
+        {
+            auto id = manager.register_model(vertices, indices);
+            auto transform = manager.get_transform(id);
+            transform.translation = {static_cast<float>(x - grid_size / 2), static_cast<float>(y - grid_size / 2), 0};
+            manager.set_transform(id, transform);
+            objects.push_back(id);
+        }
+    }
+
+    flwfrg::ThreadPool thread_pool{};
+    flwfrg::vk::ParallelRecorder recorder{&display_context, &thread_pool};
+
+    // Only the models in view are recorded
+    std::vector<flwfrg::vk::ColorModelManager::object_id_t> visible_objects{};
+
+    flwfrg::KeyboardController controller;
+    flwfrg::Camera camera;
+    flwfrg::Transform camera_transform;
+    camera.set_perspective_projection(glm::radians(50.0f), 1.0f, 0.1f, 1000.0f);
+    camera_transform.translation.z = -80;
+
+    while (!renderer.should_close())
+    {
+        auto frame_data = renderer.begin_frame(VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        if (!frame_data.has_value())
+            continue;
+
+        controller.move_in_plane_XZ(display_context.get_window()->get_glfw_window_ptr(), camera_transform, 0.05);
+        camera.set_viewYXZ(camera_transform.translation, camera_transform.rotation);
+        debug_shader.prepare_global_state(camera.get_projection(), camera.get_view());
+
+        visible_objects.clear();
+        manager.query_visible_models(camera, visible_objects);
+
+        recorder.record(visible_objects.size(), [&](flwfrg::vk::CommandBuffer &command_buffer, size_t first, size_t count) {
+            debug_shader.use(command_buffer);
+            debug_shader.bind_global_state(command_buffer);
+
+            for (size_t i = first; i < first + count; i++)
+            {
+                auto render_info = manager.get_model_render_info(visible_objects[i]);
+                debug_shader.update_object(command_buffer, render_info.render_data);
+
+                VkDeviceSize offsets[1] = {render_info.vertex_offset};
+                vkCmdBindVertexBuffers(command_buffer.get_handle(), 0, 1, &render_info.vertex_buffer, offsets);
+                vkCmdBindIndexBuffer(command_buffer.get_handle(), render_info.index_buffer, render_info.index_offset,
+                                     render_info.index_type);
+                vkCmdDrawIndexed(command_buffer.get_handle(), static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+            }
+        });
+
+        renderer.end_frame();
+    }
+
+    vkDeviceWaitIdle(display_context.get_device().get_logical_device());
+
+    return 0;
+}
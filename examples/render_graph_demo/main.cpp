@@ -0,0 +1,178 @@
+#include "default_shaders.hpp"
+#include "math/camera.hpp"
+#include "vulkan/shader/vertex.hpp"
+
+#include <iostream>
+
+struct Scene
+{
+    flwfrg::vk::shader::DebugShader *shader;
+    flwfrg::vk::shader::ClusterCullShader *cluster_cull_shader;
+    flwfrg::vk::ColorModelManager *manager;
+    flwfrg::vk::ColorModelManager::object_id_t object_id;
+    const flwfrg::Camera *camera;
+
+    // Written by the culling pass, drawn by the passes after it
+    flwfrg::vk::shader::ClusterCullShader::CulledDraw culled_draw{};
+
+    void cull(flwfrg::vk::CommandBuffer &command_buffer)
+    {
+        cluster_cull_shader->begin_frame();
+        culled_draw = cluster_cull_shader->cull(command_buffer, manager->get_cluster_render_info(object_id),
+                                                camera->get_projection(), camera->get_view());
+    }
+
+    void draw(flwfrg::vk::CommandBuffer &command_buffer) const
+    {
+        shader->bind_global_state(command_buffer);
+        shader->update_object(command_buffer, culled_draw.render_data);
+        flwfrg::vk::shader::ClusterCullShader::draw(command_buffer, culled_draw);
+    }
+};
+
+struct GraphHandles
+{
+    flwfrg::vk::RenderGraph::ImageHandle swapchain_image{};
+    flwfrg::vk::RenderGraph::BufferHandle culled_indices{};
+    flwfrg::vk::RenderGraph::BufferHandle culled_draws{};
+};
+
+// Declared again whenever the swapchain changes size
+GraphHandles declare_graph(flwfrg::vk::RenderGraph &graph, flwfrg::vk::Renderer &renderer, Scene &scene)
+{
+    using flwfrg::vk::RenderGraph;
+
+    graph.reset();
+
+    auto swapchain_image = renderer.import_swapchain_image(graph);
+
+    // Every frame culls into its own part of these, so they start out unused
+    auto culled_indices = graph.import_buffer("culled_indices", {}, {});
+    auto culled_draws = graph.import_buffer("culled_draws", {}, {});
+
+    graph.add_pass("cluster_cull", RenderGraph::PassType::COMPUTE,
+                   [&scene](flwfrg::vk::CommandBuffer &command_buffer) { scene.cull(command_buffer); })
+            .write(culled_indices, RenderGraph::Access::STORAGE_WRITE)
+            .write(culled_draws, RenderGraph::Access::STORAGE_WRITE);
+    VkExtent2D extent = graph.get_image_description(swapchain_image).extent;
+
+    auto depth = graph.create_image("depth", {renderer.get_display_context().get_device().get_depth_format(), extent});
+
+    graph.add_pass("depth_prepass", RenderGraph::PassType::GRAPHICS,
+                   [&scene](flwfrg::vk::CommandBuffer &command_buffer) {
+                       scene.shader->use_depth_prepass(command_buffer);
+                       scene.draw(command_buffer);
+                   })
+            .read(culled_indices, RenderGraph::Access::INDEX_BUFFER)
+            .read(culled_draws, RenderGraph::Access::INDIRECT_BUFFER)
+            .depth_attachment(depth, 1.0f);
+
+    // Tests against the prepass depth without writing it
+    graph.add_pass("scene", RenderGraph::PassType::GRAPHICS,
+                   [&scene](flwfrg::vk::CommandBuffer &command_buffer) {
+                       scene.shader->use(command_buffer);
+                       scene.draw(command_buffer);
+                   })
+            .read(culled_indices, RenderGraph::Access::INDEX_BUFFER)
+            .read(culled_draws, RenderGraph::Access::INDIRECT_BUFFER)
+            .color_attachment(swapchain_image, VkClearColorValue{{0.1f, 0.1f, 0.1f, 1.0f}})
+            .depth_attachment(depth, std::nullopt, false);
+
+    // Nothing reads what this pass renders, so compiling culls it and never allocates its image
+    auto unused = graph.create_image("unused", {VK_FORMAT_R8G8B8A8_UNORM, extent});
+    graph.add_pass("unused", RenderGraph::PassType::GRAPHICS, nullptr)
+            .color_attachment(unused, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}});
+
+    graph.compile();
+
+    const auto &stats = graph.get_compile_stats();
+    std::cout << "Render graph: " << stats.pass_count << " passes, " << stats.culled_pass_count << " culled, "
+              << stats.barrier_batch_count << " barrier batches, " << stats.transient_memory_size / 1024
+              << " KiB transient memory" << std::endl;
+
+    return GraphHandles{swapchain_image, culled_indices, culled_draws};
+}
+
+int main()
+{
+    flwfrg::init();
+
+    auto requirements = flwfrg::vk::shader::DebugShader::get_minimum_requirements();
+    requirements.compute = true;
+    flwfrg::vk::Renderer renderer{800, 600, "Render Graph Demo", requirements};
+    flwfrg::vk::Device &device = renderer.get_display_context().get_device();
+
+    flwfrg::vk::shader::DebugShader shader(
+            &renderer.get_display_context(),
+            flwfrg::vk::shader::DebugShader::RenderTarget{
+                    .color_formats = {renderer.get_display_context().get_swapchain().get_image_format()},
+                    .depth_format = device.get_depth_format(),
+                    .depth_prepass = true,
+            });
+    shader.use_wire_frame(false);
+
+    flwfrg::vk::shader::ClusterCullShader cluster_cull_shader(&renderer.get_display_context());
+
+    std::vector<flwfrg::vk::ColorVertex> vertices{};
+    vertices.resize(4);
+    vertices[0].position = {-0.5, 0.5, 0};
+    vertices[0].color = {1.0, 0.0, 0.0, 1.0};
+    vertices[1].position = {0.5, -0.5, 0};
+    vertices[1].color = {0.0, 1.0, 0.0, 1.0};
+    vertices[2].position = {-0.5, -0.5, 0};
+    vertices[2].color = {0.0, 0.0, 1.0, 1.0};
+    vertices[3].position = {0.5, 0.5, 0};
+    vertices[3].color = {1.0, 1.0, 1.0, 1.0};
+
+    std::vector<uint32_t> indices{0, 1, 2, 0, 3, 1};
+
+    flwfrg::vk::ColorModelManager manager{&device};
+    manager.reserve_vertex_buffer_space(sizeof(flwfrg::vk::ColorVertex) * vertices.size());
+    manager.reserve_index_buffer_space(sizeof(uint32_t) * indices.size());
+    // Split into meshlets, so the culling pass can drop the clusters out of view
+    auto object_id = manager.register_model(vertices, indices, flwfrg::vk::VertexFormat::FULL, true);
+    cluster_cull_shader.reserve(static_cast<uint32_t>(indices.size()), 1);
+
+    flwfrg::Camera camera;
+    Scene scene{&shader, &cluster_cull_shader, &manager, object_id, &camera};
+
+    flwfrg::vk::RenderGraph graph{&device};
+    GraphHandles graph_handles{};
+    VkExtent2D graph_extent{};
+
+    float rotation = 0;
+    while (!renderer.should_close())
+    {
+        auto frame_data = renderer.begin_frame_commands();
+        if (!frame_data.has_value())
+            continue;
+
+        VkExtent2D extent = renderer.get_display_context().get_swapchain().get_extent();
+        if (!graph.is_compiled() || extent.width != graph_extent.width || extent.height != graph_extent.height)
+        {
+            graph_handles = declare_graph(graph, renderer, scene);
+            graph_extent = extent;
+        }
+
+        auto transform = manager.get_transform(object_id);
+        transform.rotation.z = rotation;
+        manager.set_transform(object_id, transform);
+        rotation += 0.01f;
+
+        camera.set_perspective_projection(glm::radians(50.0f),
+                                          static_cast<float>(extent.width) / static_cast<float>(extent.height), 0.1f,
+                                          1000.0f);
+        camera.set_viewYXZ({0, 0, -3}, {0, 0, 0});
+        shader.prepare_global_state(camera.get_projection(), camera.get_view());
+
+        graph.set_imported_buffer(graph_handles.culled_indices, cluster_cull_shader.get_index_buffer());
+        graph.set_imported_buffer(graph_handles.culled_draws, cluster_cull_shader.get_indirect_buffer());
+        renderer.execute_graph(graph, graph_handles.swapchain_image);
+
+        renderer.end_frame();
+    }
+
+    device.wait_idle();
+
+    return 0;
+}
@@ -5,4 +5,5 @@
 #include "vulkan/shader/default/imgui_shader.hpp"
 #include "vulkan/shader/default/material_shader.hpp"
 #include "vulkan/shader/default/simple_shader.hpp"
-#include "vulkan/shader/default/debug_shader.hpp"
\ No newline at end of file
+#include "vulkan/shader/default/debug_shader.hpp"
+#include "vulkan/shader/default/cluster_cull_shader.hpp"
\ No newline at end of file
@@ -4,7 +4,9 @@
 #include "logging/logger.hpp"
 #include "vulkan/device.hpp"
 #include "vulkan/display_context.hpp"
+#include "vulkan/graphics_context.hpp"
 #include "vulkan/instance.hpp"
+#include "vulkan/render_graph.hpp"
 #include "vulkan/renderer.hpp"
 #include "vulkan/surface.hpp"
 #include "vulkan/window.hpp"
@@ -12,10 +12,14 @@ namespace flwfrg
 
 GLFWContext::GLFWContext()
 {
+	if (reference_count_++ > 0)
+		return;
+
 	glfwSetErrorCallback(glfw_error_callback);
 	if (!glfwInit())
 	{
 		FLOWFORGE_FATAL("GLFW Failed to initialize");
+		reference_count_--;
 		throw std::runtime_error("GLFW Failed to initialize");
 	}
 	FLOWFORGE_INFO("GLFW Initialised successfully");
@@ -23,6 +27,9 @@ GLFWContext::GLFWContext()
 
 GLFWContext::~GLFWContext()
 {
+	if (--reference_count_ > 0)
+		return;
+
 	glfwTerminate();
 	FLOWFORGE_INFO("GLFW terminated successfully");
 }
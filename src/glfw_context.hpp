@@ -4,16 +4,24 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <cstdint>
+
 namespace flwfrg
 {
 
+// Reference counted, so every window owner can hold one and GLFW is only terminated once the last one is gone
 class GLFWContext
 {
 public:
 	GLFWContext();
 	~GLFWContext();
-	
+
+	// Copy
+	GLFWContext(const GLFWContext &) = delete;
+	GLFWContext &operator=(const GLFWContext &) = delete;
+
 private:
+	static inline uint32_t reference_count_ = 0;
 };
 
 }
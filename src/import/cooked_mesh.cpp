@@ -0,0 +1,331 @@
+#include "pch.hpp"
+
+#include "cooked_mesh.hpp"
+
+#include "math/bounds.hpp"
+#include "math/transform.hpp"
+#include "threading/thread_pool.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+// A primitive as it goes into the file
+struct CookedPrimitive
+{
+    CookedMeshEntry entry{};
+    std::vector<std::byte> vertex_data{};
+    std::vector<std::byte> index_data{};
+};
+
+template<typename T>
+void append_bytes(std::vector<std::byte> &bytes, const std::vector<T> &values)
+{
+    auto source = std::as_bytes(std::span{values});
+    bytes.insert(bytes.end(), source.begin(), source.end());
+}
+
+CookedPrimitive cook_primitive(const ImportedPrimitive &primitive, const CookConfig &config)
+{
+    std::vector<vk::ColorVertex> vertices = primitive.get_color_vertices();
+    std::vector<uint32_t> indices = primitive.indices;
+    optimize_mesh(vertices, indices, config.optimization);
+
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+    {
+        positions[vertex] = vertices[vertex].position;
+    }
+    std::vector<LodLevel> lods = generate_lod_chain(indices, positions, config.lod);
+
+    CookedPrimitive cooked{};
+    CookedMeshEntry &entry = cooked.entry;
+    AABB bounds = AABB::from_vertices(vertices);
+    BoundingSphere sphere = BoundingSphere::from_vertices(vertices, bounds);
+    entry.vertex_format = config.vertex_format;
+    entry.vertex_count = static_cast<uint32_t>(vertices.size());
+    entry.quantization = vk::QuantizationBounds::from_vertices(vertices);
+    entry.bounds_min = bounds.min;
+    entry.bounds_max = bounds.max;
+    entry.sphere_center = sphere.center;
+    entry.sphere_radius = sphere.radius;
+
+    if (config.vertex_format == vk::VertexFormat::COMPACT)
+    {
+        std::vector<vk::CompactColorVertex> compact_vertices{};
+        compact_vertices.reserve(vertices.size());
+        for (const auto &vertex: vertices)
+        {
+            compact_vertices.emplace_back(vk::CompactColorVertex::from(vertex, entry.quantization));
+        }
+        append_bytes(cooked.vertex_data, compact_vertices);
+    }
+    else
+    {
+        append_bytes(cooked.vertex_data, vertices);
+    }
+
+    // Every LOD goes into the same index range, one after the other, as the model manager stores them
+    std::vector<uint32_t> lod_indices{};
+    entry.lod_count = static_cast<uint32_t>(lods.size());
+    for (uint32_t lod = 0; lod < entry.lod_count; lod++)
+    {
+        entry.lods[lod] = vk::ColorModelManager::LodRange{
+                .first_index = static_cast<uint32_t>(lod_indices.size()),
+                .index_count = static_cast<uint32_t>(lods[lod].indices.size()),
+                .error = lods[lod].error,
+        };
+        lod_indices.insert(lod_indices.end(), lods[lod].indices.begin(), lods[lod].indices.end());
+    }
+
+    if (vertices.size() <= std::numeric_limits<uint16_t>::max())
+    {
+        entry.index_size = sizeof(uint16_t);
+        append_bytes(cooked.index_data, std::vector<uint16_t>(lod_indices.begin(), lod_indices.end()));
+    }
+    else
+    {
+        entry.index_size = sizeof(uint32_t);
+        append_bytes(cooked.index_data, lod_indices);
+    }
+
+    entry.vertex_data_size = cooked.vertex_data.size();
+    entry.index_data_size = cooked.index_data.size();
+    return cooked;
+}
+
+inline uint64_t align_blob(uint64_t offset)
+{
+    return (offset + cooked_mesh_blob_alignment - 1) & ~(cooked_mesh_blob_alignment - 1);
+}
+
+uint64_t get_vertex_size(vk::VertexFormat vertex_format)
+{
+    switch (vertex_format)
+    {
+        case vk::VertexFormat::FULL:
+            return sizeof(vk::ColorVertex);
+        case vk::VertexFormat::COMPACT:
+            return sizeof(vk::CompactColorVertex);
+    }
+    return 0;
+}
+
+bool is_in_file(uint64_t offset, uint64_t size, uint64_t file_size)
+{
+    return offset <= file_size && size <= file_size - offset;
+}
+
+} // namespace
+
+void cook_scene(const ImportedScene &scene, const std::filesystem::path &path, ThreadPool &thread_pool,
+                const CookConfig &config)
+{
+    // Primitives of every mesh one after the other
+    std::vector<const ImportedPrimitive *> primitives{};
+    std::vector<size_t> first_primitives(scene.meshes.size());
+    for (size_t mesh = 0; mesh < scene.meshes.size(); mesh++)
+    {
+        first_primitives[mesh] = primitives.size();
+        for (const auto &primitive: scene.meshes[mesh].primitives)
+        {
+            primitives.push_back(&primitive);
+        }
+    }
+
+    std::vector<CookedPrimitive> cooked(primitives.size());
+    thread_pool.parallel_for(primitives.size(), [&](size_t primitive) {
+        if (!primitives[primitive]->positions.empty() && !primitives[primitive]->indices.empty())
+            cooked[primitive] = cook_primitive(*primitives[primitive], config);
+    });
+
+    // Empty primitives get no mesh, and their instances are left out
+    std::vector<CookedMeshEntry> meshes{};
+    std::vector<const CookedPrimitive *> mesh_primitives{};
+    std::vector<int64_t> primitive_meshes(primitives.size(), -1);
+    for (size_t primitive = 0; primitive < primitives.size(); primitive++)
+    {
+        if (cooked[primitive].entry.lod_count == 0)
+            continue;
+        primitive_meshes[primitive] = static_cast<int64_t>(meshes.size());
+        meshes.push_back(cooked[primitive].entry);
+        mesh_primitives.push_back(&cooked[primitive]);
+    }
+
+    std::vector<CookedInstance> instances{};
+    for (const auto &node: scene.nodes)
+    {
+        if (node.mesh < 0)
+            continue;
+
+        const size_t first_primitive = first_primitives[node.mesh];
+        for (size_t primitive = first_primitive;
+             primitive < first_primitive + scene.meshes[node.mesh].primitives.size(); primitive++)
+        {
+            if (primitive_meshes[primitive] >= 0)
+            {
+                instances.push_back(CookedInstance{
+                        .mesh = static_cast<uint32_t>(primitive_meshes[primitive]),
+                        .transform = node.world_matrix,
+                });
+            }
+        }
+    }
+
+    CookedMeshHeader header{
+            .mesh_count = static_cast<uint32_t>(meshes.size()),
+            .instance_count = static_cast<uint32_t>(instances.size()),
+            .mesh_table_offset = sizeof(CookedMeshHeader),
+    };
+    header.instance_table_offset = header.mesh_table_offset + sizeof(CookedMeshEntry) * meshes.size();
+
+    uint64_t offset = header.instance_table_offset + sizeof(CookedInstance) * instances.size();
+    for (auto &entry: meshes)
+    {
+        entry.vertex_data_offset = align_blob(offset);
+        entry.index_data_offset = align_blob(entry.vertex_data_offset + entry.vertex_data_size);
+        offset = entry.index_data_offset + entry.index_data_size;
+    }
+    header.file_size = offset;
+
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Failed to open file for writing: " + path.string());
+    }
+
+    uint64_t written = 0;
+    auto write = [&](const void *data, uint64_t size) {
+        file.write(static_cast<const char *>(data), static_cast<std::streamsize>(size));
+        written += size;
+    };
+    // Zeroes up to the given offset, rather than seeking past the end, which not every file system handles well
+    auto pad_to = [&](uint64_t target) {
+        static constexpr std::byte zeroes[cooked_mesh_blob_alignment]{};
+        write(zeroes, target - written);
+    };
+
+    write(&header, sizeof(header));
+    write(meshes.data(), sizeof(CookedMeshEntry) * meshes.size());
+    write(instances.data(), sizeof(CookedInstance) * instances.size());
+    for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+    {
+        pad_to(meshes[mesh].vertex_data_offset);
+        write(mesh_primitives[mesh]->vertex_data.data(), meshes[mesh].vertex_data_size);
+        pad_to(meshes[mesh].index_data_offset);
+        write(mesh_primitives[mesh]->index_data.data(), meshes[mesh].index_data_size);
+    }
+
+    file.close();
+    if (file.fail())
+    {
+        throw std::runtime_error("Failed to write file: " + path.string());
+    }
+}
+
+CookedMeshFile::CookedMeshFile(const std::filesystem::path &path) : file_{path}
+{
+    auto bytes = file_.get_bytes();
+    auto fail = [&](const char *reason) {
+        return std::runtime_error("Failed to load cooked mesh file " + path.string() + ", " + reason);
+    };
+
+    if (bytes.size() < sizeof(CookedMeshHeader))
+        throw fail("the file is too small");
+
+    // The mapping is page aligned, and the tables are at offsets aligned for their types
+    const auto &header = *reinterpret_cast<const CookedMeshHeader *>(bytes.data());
+    if (header.magic != cooked_mesh_magic)
+        throw fail("the file is not a cooked mesh file");
+    if (header.version != cooked_mesh_version)
+        throw fail("the file was cooked for another version, and has to be cooked again");
+    if (header.file_size != bytes.size())
+        throw fail("the file is truncated");
+    if (header.mesh_table_offset % alignof(CookedMeshEntry) != 0 ||
+        header.instance_table_offset % alignof(CookedInstance) != 0 ||
+        !is_in_file(header.mesh_table_offset, sizeof(CookedMeshEntry) * uint64_t{header.mesh_count}, bytes.size()) ||
+        !is_in_file(header.instance_table_offset, sizeof(CookedInstance) * uint64_t{header.instance_count},
+                    bytes.size()))
+        throw fail("the tables are out of bounds");
+
+    meshes_ = {reinterpret_cast<const CookedMeshEntry *>(bytes.data() + header.mesh_table_offset), header.mesh_count};
+    instances_ = {reinterpret_cast<const CookedInstance *>(bytes.data() + header.instance_table_offset),
+                  header.instance_count};
+
+    for (const auto &entry: meshes_)
+    {
+        const uint64_t vertex_size = get_vertex_size(entry.vertex_format);
+        if (vertex_size == 0 || entry.vertex_data_size != vertex_size * entry.vertex_count)
+            throw fail("a mesh has an unknown vertex format");
+        if ((entry.index_size != sizeof(uint16_t) && entry.index_size != sizeof(uint32_t)) ||
+            entry.index_data_size % entry.index_size != 0)
+            throw fail("a mesh has an unknown index size");
+        if (!is_in_file(entry.vertex_data_offset, entry.vertex_data_size, bytes.size()) ||
+            !is_in_file(entry.index_data_offset, entry.index_data_size, bytes.size()))
+            throw fail("the data of a mesh is out of bounds");
+        if (entry.lod_count == 0 || entry.lod_count > max_lod_count)
+            throw fail("a mesh has an invalid LOD count");
+
+        const uint64_t index_count = entry.index_data_size / entry.index_size;
+        for (uint32_t lod = 0; lod < entry.lod_count; lod++)
+        {
+            if (uint64_t{entry.lods[lod].first_index} + entry.lods[lod].index_count > index_count)
+                throw fail("a LOD of a mesh is out of bounds");
+        }
+    }
+
+    for (const auto &instance: instances_)
+    {
+        if (instance.mesh >= header.mesh_count)
+            throw fail("an instance has an invalid mesh");
+    }
+}
+
+vk::ColorModelManager::PackedMesh CookedMeshFile::get_packed_mesh(uint32_t mesh) const
+{
+    assert(mesh < meshes_.size());
+    const CookedMeshEntry &entry = meshes_[mesh];
+    auto bytes = file_.get_bytes();
+
+    AABB bounds{entry.bounds_min, entry.bounds_max};
+    return vk::ColorModelManager::PackedMesh{
+            .vertex_data = bytes.subspan(entry.vertex_data_offset, entry.vertex_data_size),
+            .index_data = bytes.subspan(entry.index_data_offset, entry.index_data_size),
+            .vertex_format = entry.vertex_format,
+            .index_type = entry.index_size == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32,
+            .lods = std::span{entry.lods, entry.lod_count},
+            .quantization = entry.quantization,
+            .bounds = bounds,
+            .bounding_sphere = BoundingSphere{entry.sphere_center, entry.sphere_radius},
+    };
+}
+
+std::vector<vk::ColorModelManager::instance_id_t> add_to_model_manager(const CookedMeshFile &file,
+                                                                      vk::ColorModelManager &model_manager)
+{
+    std::vector<vk::ColorModelManager::mesh_id_t> mesh_ids(file.get_meshes().size());
+    for (uint32_t mesh = 0; mesh < mesh_ids.size(); mesh++)
+    {
+        mesh_ids[mesh] = model_manager.register_packed_mesh(file.get_packed_mesh(mesh));
+    }
+
+    std::vector<vk::ColorModelManager::instance_id_t> instances{};
+    instances.reserve(file.get_instances().size());
+    for (const auto &instance: file.get_instances())
+    {
+        instances.push_back(
+                model_manager.create_instance(mesh_ids[instance.mesh], Transform::from_mat4(instance.transform)));
+    }
+
+    model_manager.flush_uploads();
+    return instances;
+}
+
+}// namespace flwfrg
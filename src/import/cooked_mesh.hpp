@@ -0,0 +1,117 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "import/imported_scene.hpp"
+#include "import/mapped_file.hpp"
+#include "mesh/mesh_optimizer.hpp"
+#include "mesh/mesh_simplifier.hpp"
+#include "vulkan/resource/model_manager.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace flwfrg
+{
+class ThreadPool;
+
+// A cooked mesh file (.ffmesh) is the header, the mesh table and the instance table, followed by the vertex and index
+// data of every mesh exactly as the GPU buffers take it. The tables are used in place from the mapped file, so
+// loading one takes no parsing at all. Each blob starts on a 4096 byte boundary, which keeps blobs on pages of their
+// own and lets them be read with direct I/O as well.
+constexpr uint32_t cooked_mesh_magic = 0x48534d46;// "FMSH"
+constexpr uint32_t cooked_mesh_version = 1;
+constexpr uint64_t cooked_mesh_blob_alignment = 4096;
+
+struct CookedMeshHeader
+{
+    uint32_t magic = cooked_mesh_magic;
+    uint32_t version = cooked_mesh_version;
+    uint32_t mesh_count = 0;
+    uint32_t instance_count = 0;
+    uint64_t mesh_table_offset = 0;
+    uint64_t instance_table_offset = 0;
+    uint64_t file_size = 0;
+};
+
+struct CookedMeshEntry
+{
+    vk::VertexFormat vertex_format = vk::VertexFormat::FULL;
+    // 2 or 4
+    uint32_t index_size = 0;
+    uint32_t vertex_count = 0;
+    uint32_t lod_count = 0;
+    uint64_t vertex_data_offset = 0;
+    uint64_t vertex_data_size = 0;
+    uint64_t index_data_offset = 0;
+    uint64_t index_data_size = 0;
+    vk::QuantizationBounds quantization{};
+    glm::vec3 bounds_min{0.0f};
+    glm::vec3 bounds_max{0.0f};
+    glm::vec3 sphere_center{0.0f};
+    float sphere_radius = 0.0f;
+    vk::ColorModelManager::LodRange lods[max_lod_count]{};
+};
+
+// An instance of a mesh at a node of the cooked scene
+struct CookedInstance
+{
+    uint32_t mesh = 0;
+    uint32_t padding = 0;
+    glm::mat4 transform{1.0f};
+};
+
+// The tables are read straight out of the file, so their layout is the file format
+static_assert(sizeof(vk::VertexFormat) == 4);
+static_assert(sizeof(CookedMeshHeader) == 40 && std::is_trivially_copyable_v<CookedMeshHeader>);
+static_assert(sizeof(CookedMeshEntry) == 184 && std::is_trivially_copyable_v<CookedMeshEntry>);
+static_assert(sizeof(CookedInstance) == 72 && std::is_trivially_copyable_v<CookedInstance>);
+
+struct CookConfig
+{
+    vk::VertexFormat vertex_format = vk::VertexFormat::COMPACT;
+    MeshOptimizationConfig optimization{};
+    LodConfig lod{.level_count = 4};
+};
+
+/// Cooks every primitive of the scene into a mesh of its own, with one instance of it for every node using it.
+/// Primitives are optimized, given LODs and quantized on the thread pool, the same as
+/// ColorModelManager::register_mesh_async would at runtime, and use 16 bit indices when their vertex count allows.
+/// @throws std::runtime_error When the file cannot be written
+void cook_scene(const ImportedScene &scene, const std::filesystem::path &path, ThreadPool &thread_pool,
+                const CookConfig &config = {});
+
+/// A cooked mesh file, mapped into memory. The tables are checked against the size of the file when it is opened,
+/// the vertex and index data is not looked at, so only cooked files from trusted sources should be loaded.
+class CookedMeshFile
+{
+public:
+    /// @throws std::runtime_error When the file cannot be mapped, or is not a cooked mesh file of this version
+    explicit CookedMeshFile(const std::filesystem::path &path);
+
+    // Methods
+
+    [[nodiscard]] inline std::span<const CookedMeshEntry> get_meshes() const { return meshes_; };
+    [[nodiscard]] inline std::span<const CookedInstance> get_instances() const { return instances_; };
+
+    /// The mesh as ColorModelManager::register_packed_mesh takes it, pointing into the mapped file
+    [[nodiscard]] vk::ColorModelManager::PackedMesh get_packed_mesh(uint32_t mesh) const;
+
+private:
+    MappedFile file_;
+    std::span<const CookedMeshEntry> meshes_{};
+    std::span<const CookedInstance> instances_{};
+};
+
+/// Registers every mesh of the file, and creates its instances. The vertex and index data is copied from the mapping
+/// straight into the manager's staging ring when it has one, and flushed at the end in a single submission.
+/// @return The instances created, in file order
+std::vector<vk::ColorModelManager::instance_id_t> add_to_model_manager(const CookedMeshFile &file,
+                                                                      vk::ColorModelManager &model_manager);
+
+}// namespace flwfrg
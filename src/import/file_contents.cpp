@@ -0,0 +1,20 @@
+#include "pch.hpp"
+
+#include "file_contents.hpp"
+
+#include "io/file_reader.hpp"
+
+namespace flwfrg
+{
+
+FileContents FileContents::read(const std::filesystem::path &path)
+{
+    return io::read_file(path);
+}
+
+FileContents FileContents::allocate(size_t size)
+{
+    return FileContents{.data = std::make_unique_for_overwrite<std::byte[]>(size), .size = size};
+}
+
+}// namespace flwfrg
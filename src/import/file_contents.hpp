@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string_view>
+
+namespace flwfrg
+{
+
+/// The whole of a file in memory. The memory is not zeroed before the read, which would cost as much as touching
+/// it twice for large files.
+struct FileContents
+{
+    std::unique_ptr<std::byte[]> data{};
+    size_t size = 0;
+
+    /// Reads with the calling thread's io::FileReader, see io::read_files to read many files at once
+    /// @throws std::runtime_error When the file cannot be opened or read
+    [[nodiscard]] static FileContents read(const std::filesystem::path &path);
+    /// Uninitialized memory of the given size, e.g. to decode into
+    [[nodiscard]] static FileContents allocate(size_t size);
+
+    [[nodiscard]] inline std::span<const std::byte> get_bytes() const { return {data.get(), size}; };
+    [[nodiscard]] inline std::string_view get_text() const
+    {
+        return {reinterpret_cast<const char *>(data.get()), size};
+    }
+};
+
+}// namespace flwfrg
@@ -0,0 +1,573 @@
+#include "pch.hpp"
+
+#include "gltf_importer.hpp"
+
+#include "import/file_contents.hpp"
+#include "import/json.hpp"
+#include "import/vertex_conversion.hpp"
+#include "threading/thread_pool.hpp"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+constexpr uint32_t glb_magic = 0x46546C67;       // "glTF"
+constexpr uint32_t glb_json_chunk = 0x4E4F534A;  // "JSON"
+constexpr uint32_t glb_binary_chunk = 0x004E4942;// "BIN"
+constexpr uint32_t triangle_list_mode = 4;
+
+[[noreturn]] void fail(const std::filesystem::path &path, const std::string &reason)
+{
+    throw std::runtime_error("Failed to import glTF " + path.string() + ": " + reason);
+}
+
+uint32_t read_uint32(std::span<const std::byte> bytes, size_t offset)
+{
+    uint32_t value;
+    std::memcpy(&value, bytes.data() + offset, sizeof(value));
+    return value;
+}
+
+FileContents decode_base64(std::string_view text)
+{
+    constexpr std::array<uint8_t, 256> values = [] {
+        std::array<uint8_t, 256> table{};
+        table.fill(0xFF);
+        constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (size_t index = 0; index < alphabet.size(); index++)
+        {
+            table[static_cast<uint8_t>(alphabet[index])] = static_cast<uint8_t>(index);
+        }
+        return table;
+    }();
+
+    while (!text.empty() && text.back() == '=')
+    {
+        text.remove_suffix(1);
+    }
+
+    FileContents contents = FileContents::allocate(text.size() * 3 / 4);
+    uint32_t bits = 0;
+    uint32_t bit_count = 0;
+    size_t size = 0;
+    for (char character: text)
+    {
+        uint8_t value = values[static_cast<uint8_t>(character)];
+        if (value == 0xFF)
+            throw std::runtime_error("Failed to decode base64, invalid character");
+
+        bits = (bits << 6) | value;
+        bit_count += 6;
+        if (bit_count >= 8)
+        {
+            bit_count -= 8;
+            contents.data[size++] = static_cast<std::byte>((bits >> bit_count) & 0xFF);
+        }
+    }
+    contents.size = size;
+    return contents;
+}
+
+// URIs of files may escape characters, spaces as %20 in particular
+std::string decode_uri(const std::filesystem::path &path, std::string_view uri)
+{
+    auto hex_value = [](char digit) {
+        if (digit >= '0' && digit <= '9')
+            return digit - '0';
+        return std::tolower(static_cast<unsigned char>(digit)) - 'a' + 10;
+    };
+
+    std::string decoded{};
+    decoded.reserve(uri.size());
+    for (size_t position = 0; position < uri.size(); position++)
+    {
+        if (uri[position] != '%')
+        {
+            decoded += uri[position];
+            continue;
+        }
+
+        if (position + 2 >= uri.size() || !std::isxdigit(static_cast<unsigned char>(uri[position + 1])) ||
+            !std::isxdigit(static_cast<unsigned char>(uri[position + 2])))
+            fail(path, "malformed escape in uri " + std::string{uri});
+        decoded += static_cast<char>(hex_value(uri[position + 1]) * 16 + hex_value(uri[position + 2]));
+        position += 2;
+    }
+    return decoded;
+}
+
+struct BufferView
+{
+    uint32_t buffer = 0;
+    size_t offset = 0;
+    size_t length = 0;
+    // 0 for tightly packed
+    size_t stride = 0;
+};
+
+struct Accessor
+{
+    int32_t buffer_view = -1;
+    size_t offset = 0;
+    ComponentType component_type = ComponentType::FLOAT;
+    uint32_t component_count = 0;
+    size_t count = 0;
+    bool normalized = false;
+};
+
+uint32_t get_component_count(std::string_view type)
+{
+    if (type == "SCALAR")
+        return 1;
+    if (type == "VEC2")
+        return 2;
+    if (type == "VEC3")
+        return 3;
+    if (type == "VEC4")
+        return 4;
+    // Matrices are not vertex attributes this importer reads
+    return 0;
+}
+
+std::vector<JsonDocument::Value> get_elements(JsonDocument::Value array)
+{
+    std::vector<JsonDocument::Value> elements{};
+    elements.reserve(array.size());
+    for (JsonDocument::Value element: array)
+    {
+        elements.push_back(element);
+    }
+    return elements;
+}
+
+glm::mat4 get_local_matrix(JsonDocument::Value node)
+{
+    JsonDocument::Value matrix = node["matrix"];
+    if (matrix.size() == 16)
+    {
+        // Column major, as glm
+        glm::mat4 result{};
+        uint32_t element = 0;
+        for (JsonDocument::Value value: matrix)
+        {
+            result[element / 4][element % 4] = value.as_float();
+            element++;
+        }
+        return result;
+    }
+
+    JsonDocument::Value translation = node["translation"];
+    JsonDocument::Value rotation = node["rotation"];
+    JsonDocument::Value scale = node["scale"];
+
+    glm::mat4 result{1.0f};
+    if (rotation.size() == 4)
+    {
+        // Stored as x, y, z, w
+        result = glm::mat4_cast(glm::quat{rotation[3u].as_float(1.0f), rotation[0u].as_float(), rotation[1u].as_float(),
+                                          rotation[2u].as_float()});
+    }
+    if (scale.size() == 3)
+    {
+        for (uint32_t axis = 0; axis < 3; axis++)
+        {
+            result[axis] *= scale[axis].as_float(1.0f);
+        }
+    }
+    if (translation.size() == 3)
+    {
+        result[3] = glm::vec4{translation[0u].as_float(), translation[1u].as_float(), translation[2u].as_float(), 1.0f};
+    }
+    return result;
+}
+
+class GltfImporter
+{
+public:
+    GltfImporter(const std::filesystem::path &path, ThreadPool &thread_pool)
+        : path_{path}, thread_pool_{thread_pool}, file_{FileContents::read(path)}
+    {}
+
+    ImportedScene import()
+    {
+        std::string_view json_text = split_binary();
+        JsonDocument document{json_text};
+        JsonDocument::Value root = document.get_root();
+
+        if (!root["asset"]["version"].as_string().starts_with("2"))
+            fail(path_, "only glTF 2.0 is supported");
+
+        load_buffers(root["buffers"]);
+        read_buffer_views(root["bufferViews"]);
+        read_accessors(root["accessors"]);
+
+        for (JsonDocument::Value material: root["materials"])
+        {
+            JsonDocument::Value factor = material["pbrMetallicRoughness"]["baseColorFactor"];
+            base_colors_.emplace_back(factor[0u].as_float(1.0f), factor[1u].as_float(1.0f), factor[2u].as_float(1.0f),
+                                      factor[3u].as_float(1.0f));
+        }
+
+        ImportedScene scene{};
+        read_meshes(root["meshes"], scene);
+        read_nodes(root, scene);
+        return scene;
+    }
+
+private:
+    const std::filesystem::path &path_;
+    ThreadPool &thread_pool_;
+    FileContents file_;
+
+    // The BIN chunk of a .glb, which is the buffer without a uri
+    std::span<const std::byte> binary_chunk_{};
+    // Buffers that are not part of file_
+    std::vector<FileContents> buffer_storage_{};
+    std::vector<std::span<const std::byte>> buffers_{};
+    std::vector<BufferView> buffer_views_{};
+    std::vector<Accessor> accessors_{};
+    std::vector<glm::vec4> base_colors_{};
+
+    // Returns the JSON, which is the whole file unless it is a .glb
+    std::string_view split_binary()
+    {
+        std::span<const std::byte> bytes = file_.get_bytes();
+        if (bytes.size() < 12 || read_uint32(bytes, 0) != glb_magic)
+            return file_.get_text();
+
+        // Header of magic, version and length, followed by chunks of length, type and data
+        std::string_view json_text{};
+        size_t offset = 12;
+        while (offset + 8 <= bytes.size())
+        {
+            uint32_t chunk_length = read_uint32(bytes, offset);
+            uint32_t chunk_type = read_uint32(bytes, offset + 4);
+            offset += 8;
+            if (chunk_length > bytes.size() - offset)
+                fail(path_, "chunk exceeds the file");
+
+            if (chunk_type == glb_json_chunk)
+                json_text = {reinterpret_cast<const char *>(bytes.data() + offset), chunk_length};
+            else if (chunk_type == glb_binary_chunk && binary_chunk_.empty())
+                binary_chunk_ = bytes.subspan(offset, chunk_length);
+            offset += chunk_length;
+        }
+
+        if (json_text.empty())
+            fail(path_, "no JSON chunk");
+        return json_text;
+    }
+
+    // A byte size or count, which a negative value would wrap around to a huge one
+    size_t get_size(JsonDocument::Value value, const char *name) const
+    {
+        int64_t size = value.as_int();
+        if (size < 0)
+            fail(path_, std::string{name} + " is negative");
+        return static_cast<size_t>(size);
+    }
+
+    // An index into one of the arrays, checked so narrowing cannot wrap a huge one around to a valid index
+    int32_t get_index(JsonDocument::Value value, int32_t fallback = -1) const
+    {
+        int64_t index = value.as_int(fallback);
+        if (index < -1 || index > std::numeric_limits<int32_t>::max())
+            fail(path_, "index " + std::to_string(index) + " is out of range");
+        return static_cast<int32_t>(index);
+    }
+
+    void load_buffers(JsonDocument::Value buffers)
+    {
+        std::vector<JsonDocument::Value> elements = get_elements(buffers);
+        buffer_storage_.resize(elements.size());
+        buffers_.resize(elements.size());
+
+        // Every buffer is a read or a decode of its own
+        thread_pool_.parallel_for(elements.size(), [&](size_t buffer) {
+            std::string_view uri = elements[buffer]["uri"].as_string();
+            if (uri.empty())
+            {
+                buffers_[buffer] = binary_chunk_;
+            }
+            else if (uri.starts_with("data:"))
+            {
+                size_t data_start = uri.find(";base64,");
+                if (data_start == std::string_view::npos)
+                    fail(path_, "data URIs have to be base64");
+                buffer_storage_[buffer] = decode_base64(uri.substr(data_start + 8));
+                buffers_[buffer] = buffer_storage_[buffer].get_bytes();
+            }
+            else
+            {
+                buffer_storage_[buffer] = FileContents::read(path_.parent_path() / decode_uri(path_, uri));
+                buffers_[buffer] = buffer_storage_[buffer].get_bytes();
+            }
+
+            size_t byte_length = get_size(elements[buffer]["byteLength"], "byteLength");
+            if (byte_length > buffers_[buffer].size())
+                fail(path_, "buffer " + std::to_string(buffer) + " is shorter than its byteLength");
+        });
+    }
+
+    void read_buffer_views(JsonDocument::Value buffer_views)
+    {
+        buffer_views_.reserve(buffer_views.size());
+        for (JsonDocument::Value view: buffer_views)
+        {
+            BufferView &buffer_view = buffer_views_.emplace_back(BufferView{
+                    .buffer = static_cast<uint32_t>(get_index(view["buffer"])),
+                    .offset = get_size(view["byteOffset"], "byteOffset"),
+                    .length = get_size(view["byteLength"], "byteLength"),
+                    .stride = get_size(view["byteStride"], "byteStride"),
+            });
+
+            // Checked without adding the offset and length, which could overflow
+            if (buffer_view.buffer >= buffers_.size() || buffer_view.offset > buffers_[buffer_view.buffer].size() ||
+                buffer_view.length > buffers_[buffer_view.buffer].size() - buffer_view.offset)
+                fail(path_, "buffer view " + std::to_string(buffer_views_.size() - 1) + " is out of bounds");
+        }
+    }
+
+    void read_accessors(JsonDocument::Value accessors)
+    {
+        accessors_.reserve(accessors.size());
+        for (JsonDocument::Value accessor: accessors)
+        {
+            // Unknown types are rejected once the accessor is used, but only if they survive the narrowing intact
+            int64_t component_type = accessor["componentType"].as_int();
+            if (component_type < 0 || component_type > std::numeric_limits<uint32_t>::max())
+                fail(path_, "accessor " + std::to_string(accessors_.size()) + " has an invalid componentType");
+
+            accessors_.push_back(Accessor{
+                    .buffer_view = get_index(accessor["bufferView"]),
+                    .offset = get_size(accessor["byteOffset"], "byteOffset"),
+                    .component_type = static_cast<ComponentType>(component_type),
+                    .component_count = get_component_count(accessor["type"].as_string()),
+                    .count = get_size(accessor["count"], "count"),
+                    .normalized = accessor["normalized"].as_bool(),
+            });
+        }
+    }
+
+    // Where the accessor's elements are, checked against the bounds of its buffer view
+    AttributeSource get_source(int64_t accessor_index) const
+    {
+        if (accessor_index < 0 || accessor_index >= static_cast<int64_t>(accessors_.size()))
+            fail(path_, "accessor " + std::to_string(accessor_index) + " does not exist");
+
+        const Accessor &accessor = accessors_[accessor_index];
+        size_t component_size = get_component_size(accessor.component_type);
+        if (accessor.buffer_view < 0 || accessor.buffer_view >= static_cast<int32_t>(buffer_views_.size()) ||
+            accessor.component_count == 0 || component_size == 0)
+            fail(path_, "accessor " + std::to_string(accessor_index) + " is not supported");
+
+        const BufferView &view = buffer_views_[accessor.buffer_view];
+        size_t element_size = component_size * accessor.component_count;
+        // The SIMD conversion reads past the end of an element into the next one, so elements must not overlap
+        if (view.stride != 0 && (view.stride < 4 || view.stride > 252 || view.stride % 4 != 0 ||
+                                 view.stride < element_size))
+            fail(path_, "accessor " + std::to_string(accessor_index) + " has an invalid byteStride");
+        size_t stride = view.stride != 0 ? view.stride : element_size;
+        // offset + stride * (count - 1) + element_size <= length, rearranged so nothing can overflow
+        if (accessor.count > 0 &&
+            (accessor.offset > view.length || element_size > view.length - accessor.offset ||
+             accessor.count - 1 > (view.length - accessor.offset - element_size) / stride))
+            fail(path_, "accessor " + std::to_string(accessor_index) + " is out of bounds");
+
+        return AttributeSource{
+                .data = buffers_[view.buffer].data() + view.offset + accessor.offset,
+                .stride = stride,
+                .component_type = accessor.component_type,
+                .component_count = accessor.component_count,
+                .normalized = accessor.normalized,
+        };
+    }
+
+    void read_meshes(JsonDocument::Value meshes, ImportedScene &scene) const
+    {
+        struct PrimitiveTask
+        {
+            ImportedPrimitive *primitive;
+            JsonDocument::Value value;
+        };
+
+        // Sized up front, so the tasks can fill in their primitive without synchronizing
+        std::vector<PrimitiveTask> tasks{};
+        scene.meshes.resize(meshes.size());
+        uint32_t mesh_index = 0;
+        for (JsonDocument::Value mesh: meshes)
+        {
+            ImportedMesh &imported_mesh = scene.meshes[mesh_index++];
+            imported_mesh.name = mesh["name"].as_string();
+            imported_mesh.primitives.resize(mesh["primitives"].size());
+
+            uint32_t primitive_index = 0;
+            for (JsonDocument::Value primitive: mesh["primitives"])
+            {
+                tasks.push_back({&imported_mesh.primitives[primitive_index++], primitive});
+            }
+        }
+
+        thread_pool_.parallel_for(tasks.size(),
+                                  [&](size_t task) { read_primitive(tasks[task].value, *tasks[task].primitive); });
+    }
+
+    void read_primitive(JsonDocument::Value value, ImportedPrimitive &primitive) const
+    {
+        if (value["mode"].as_int(triangle_list_mode) != triangle_list_mode)
+        {
+            FLOWFORGE_WARN("Skipping glTF primitive of {}, only triangle lists are supported", path_.string());
+            return;
+        }
+
+        JsonDocument::Value attributes = value["attributes"];
+        if (!attributes["POSITION"].is_valid())
+            return;
+
+        AttributeSource position_source = get_source(attributes["POSITION"].as_int(-1));
+        size_t vertex_count = accessors_[attributes["POSITION"].as_int()].count;
+        if (vertex_count == 0)
+            return;
+        primitive.positions.resize(vertex_count);
+        convert_attribute(position_source, {&primitive.positions[0].x, sizeof(glm::vec3), 3}, vertex_count);
+
+        auto read_attribute = [&](std::string_view name, auto &destination, uint32_t component_count, float fill) {
+            JsonDocument::Value accessor = attributes[name];
+            if (!accessor.is_valid())
+                return;
+            AttributeSource source = get_source(accessor.as_int(-1));
+            if (accessors_[accessor.as_int()].count != vertex_count)
+                fail(path_, std::string{name} + " has a different count than POSITION");
+
+            destination.resize(vertex_count);
+            convert_attribute(source, {&destination[0].x, sizeof(destination[0]), component_count}, vertex_count,
+                              fill);
+        };
+        // RGB colors get an alpha of 1
+        read_attribute("COLOR_0", primitive.colors, 4, 1.0f);
+        read_attribute("TEXCOORD_0", primitive.texture_coordinates, 2, 0.0f);
+
+        JsonDocument::Value indices = value["indices"];
+        if (indices.is_valid())
+        {
+            AttributeSource index_source = get_source(indices.as_int(-1));
+            size_t index_count = accessors_[indices.as_int()].count;
+            primitive.indices.resize(index_count);
+            convert_indices(index_source.data, index_source.stride, index_source.component_type, index_count,
+                            primitive.indices.data());
+
+            for (uint32_t index: primitive.indices)
+            {
+                if (index >= vertex_count)
+                    fail(path_, "index out of range of the vertices");
+            }
+        }
+        else
+        {
+            primitive.indices.resize(vertex_count);
+            std::iota(primitive.indices.begin(), primitive.indices.end(), 0u);
+        }
+        primitive.indices.resize(primitive.indices.size() / 3 * 3);
+
+        int64_t material = value["material"].as_int(-1);
+        if (material >= 0 && material < static_cast<int64_t>(base_colors_.size()))
+            primitive.base_color = base_colors_[material];
+    }
+
+    void read_nodes(JsonDocument::Value root, ImportedScene &scene) const
+    {
+        std::vector<JsonDocument::Value> nodes = get_elements(root["nodes"]);
+
+        // The roots of the default scene, or of every node when there are no scenes
+        std::vector<uint32_t> roots{};
+        JsonDocument::Value scenes = root["scenes"];
+        if (scenes.size() > 0)
+        {
+            for (JsonDocument::Value node: scenes[static_cast<uint32_t>(get_index(root["scene"], 0))]["nodes"])
+            {
+                roots.push_back(static_cast<uint32_t>(get_index(node)));
+            }
+        }
+        else
+        {
+            std::vector<bool> is_child(nodes.size(), false);
+            for (JsonDocument::Value node: nodes)
+            {
+                for (JsonDocument::Value child: node["children"])
+                {
+                    if (child.as_int() >= 0 && child.as_int() < static_cast<int64_t>(nodes.size()))
+                        is_child[child.as_int()] = true;
+                }
+            }
+            for (uint32_t node = 0; node < nodes.size(); node++)
+            {
+                if (!is_child[node])
+                    roots.push_back(node);
+            }
+        }
+
+        // Depth first, which puts parents before their children
+        struct Visit
+        {
+            uint32_t node;
+            int32_t parent;
+        };
+        std::vector<Visit> stack{};
+        for (auto root_node = roots.rbegin(); root_node != roots.rend(); ++root_node)
+        {
+            stack.push_back({*root_node, -1});
+        }
+
+        std::vector<bool> visited(nodes.size(), false);
+        scene.nodes.reserve(nodes.size());
+        while (!stack.empty())
+        {
+            Visit visit = stack.back();
+            stack.pop_back();
+            if (visit.node >= nodes.size() || visited[visit.node])
+                fail(path_, "node " + std::to_string(visit.node) + " does not exist or has several parents");
+            visited[visit.node] = true;
+
+            JsonDocument::Value node = nodes[visit.node];
+            ImportedNode imported{
+                    .name = std::string{node["name"].as_string()},
+                    .mesh = get_index(node["mesh"]),
+                    .parent = visit.parent,
+                    .local_matrix = get_local_matrix(node),
+            };
+            if (imported.mesh >= static_cast<int32_t>(scene.meshes.size()))
+                fail(path_, "node " + std::to_string(visit.node) + " uses a mesh that does not exist");
+            imported.world_matrix = visit.parent >= 0 ? scene.nodes[visit.parent].world_matrix * imported.local_matrix
+                                                      : imported.local_matrix;
+
+            auto index = static_cast<int32_t>(scene.nodes.size());
+            scene.nodes.push_back(std::move(imported));
+
+            std::vector<JsonDocument::Value> children = get_elements(node["children"]);
+            for (auto child = children.rbegin(); child != children.rend(); ++child)
+            {
+                stack.push_back({static_cast<uint32_t>(get_index(*child)), index});
+            }
+        }
+    }
+};
+
+} // namespace
+
+ImportedScene import_gltf(const std::filesystem::path &path, ThreadPool &thread_pool)
+{
+    return GltfImporter{path, thread_pool}.import();
+}
+
+}// namespace flwfrg
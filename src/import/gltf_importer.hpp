@@ -0,0 +1,21 @@
+#pragma once
+
+#include "import/imported_scene.hpp"
+
+#include <filesystem>
+
+namespace flwfrg
+{
+class ThreadPool;
+
+/// Imports a glTF 2.0 file, either JSON (.gltf) with its buffers in files next to it or in data URIs, or binary
+/// (.glb). Buffers are read on the thread pool, one task each, and the accessors of every primitive are then decoded
+/// in parallel, one primitive per task, straight from the buffers with the SIMD kernels of convert_attribute.
+///
+/// Triangle list primitives are imported with their POSITION, COLOR_0 and TEXCOORD_0 attributes, their indices and
+/// their material's baseColorFactor, along with the node hierarchy of the default scene. Sparse accessors, morph
+/// targets and skins are not.
+/// @throws std::runtime_error When the file cannot be read or is malformed
+[[nodiscard]] ImportedScene import_gltf(const std::filesystem::path &path, ThreadPool &thread_pool);
+
+}// namespace flwfrg
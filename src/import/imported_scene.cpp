@@ -0,0 +1,156 @@
+#include "pch.hpp"
+
+#include "imported_scene.hpp"
+
+#include "import/gltf_importer.hpp"
+#include "import/obj_importer.hpp"
+#include "import/vertex_conversion.hpp"
+#include "threading/thread_pool.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+template<typename T>
+AttributeSource get_float_source(const std::vector<T> &attribute)
+{
+    return AttributeSource{
+            .data = reinterpret_cast<const std::byte *>(attribute.data()),
+            .stride = sizeof(T),
+            .component_type = ComponentType::FLOAT,
+            .component_count = static_cast<uint32_t>(T::length()),
+    };
+}
+
+} // namespace
+
+std::vector<vk::ColorVertex> ImportedPrimitive::get_color_vertices() const
+{
+    std::vector<vk::ColorVertex> vertices(positions.size());
+    if (vertices.empty())
+        return vertices;
+
+    convert_attribute(get_float_source(positions), {&vertices[0].position.x, sizeof(vk::ColorVertex), 3},
+                      vertices.size());
+
+    if (colors.size() == vertices.size())
+    {
+        convert_attribute(get_float_source(colors), {&vertices[0].color.x, sizeof(vk::ColorVertex), 4},
+                          vertices.size());
+        if (base_color != glm::vec4{1.0f})
+        {
+            for (auto &vertex: vertices)
+            {
+                vertex.color *= base_color;
+            }
+        }
+    }
+    else
+    {
+        for (auto &vertex: vertices)
+        {
+            vertex.color = base_color;
+        }
+    }
+
+    return vertices;
+}
+
+std::vector<vk::shader::MaterialShader::Vertex> ImportedPrimitive::get_material_vertices() const
+{
+    using Vertex = vk::shader::MaterialShader::Vertex;
+
+    std::vector<Vertex> vertices(positions.size());
+    if (vertices.empty())
+        return vertices;
+
+    convert_attribute(get_float_source(positions), {&vertices[0].position.x, sizeof(Vertex), 3}, vertices.size());
+    if (texture_coordinates.size() == vertices.size())
+    {
+        convert_attribute(get_float_source(texture_coordinates),
+                          {&vertices[0].texture_coordinate.x, sizeof(Vertex), 2}, vertices.size());
+    }
+    else
+    {
+        for (auto &vertex: vertices)
+        {
+            vertex.texture_coordinate = glm::vec2{0.0f};
+        }
+    }
+
+    return vertices;
+}
+
+ImportedScene import_scene(const std::filesystem::path &path, ThreadPool &thread_pool)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char character) { return static_cast<char>(std::tolower(character)); });
+
+    if (extension == ".gltf" || extension == ".glb")
+        return import_gltf(path, thread_pool);
+    if (extension == ".obj")
+        return import_obj(path, thread_pool);
+
+    throw std::runtime_error("Failed to import " + path.string() + ", unknown file type");
+}
+
+std::vector<vk::ColorModelManager::instance_id_t> add_to_model_manager(const ImportedScene &scene,
+                                                                      vk::ColorModelManager &model_manager,
+                                                                      ThreadPool &thread_pool,
+                                                                      vk::VertexFormat vertex_format)
+{
+    // Primitives of every mesh one after the other
+    std::vector<const ImportedPrimitive *> primitives{};
+    std::vector<size_t> first_primitives(scene.meshes.size());
+    for (size_t mesh = 0; mesh < scene.meshes.size(); mesh++)
+    {
+        first_primitives[mesh] = primitives.size();
+        for (const auto &primitive: scene.meshes[mesh].primitives)
+        {
+            primitives.push_back(&primitive);
+        }
+    }
+
+    std::vector<std::vector<vk::ColorVertex>> vertices(primitives.size());
+    thread_pool.parallel_for(primitives.size(), [&](size_t primitive) {
+        vertices[primitive] = primitives[primitive]->get_color_vertices();
+    });
+
+    // Registered here, since uploads use the graphics queue
+    std::vector<vk::ColorModelManager::mesh_id_t> mesh_ids(primitives.size(), -1);
+    for (size_t primitive = 0; primitive < primitives.size(); primitive++)
+    {
+        if (vertices[primitive].empty() || primitives[primitive]->indices.empty())
+            continue;
+        mesh_ids[primitive] = model_manager.register_mesh(std::move(vertices[primitive]),
+                                                          primitives[primitive]->indices, vertex_format);
+    }
+
+    std::vector<vk::ColorModelManager::instance_id_t> instances{};
+    for (const auto &node: scene.nodes)
+    {
+        if (node.mesh < 0)
+            continue;
+
+        Transform transform = Transform::from_mat4(node.world_matrix);
+        const size_t first_primitive = first_primitives[node.mesh];
+        for (size_t primitive = first_primitive;
+             primitive < first_primitive + scene.meshes[node.mesh].primitives.size(); primitive++)
+        {
+            if (mesh_ids[primitive] >= 0)
+                instances.push_back(model_manager.create_instance(mesh_ids[primitive], transform));
+        }
+    }
+
+    model_manager.flush_uploads();
+    return instances;
+}
+
+}// namespace flwfrg
@@ -0,0 +1,77 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "vulkan/resource/model_manager.hpp"
+#include "vulkan/shader/default/material_shader.hpp"
+#include "vulkan/shader/vertex.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace flwfrg
+{
+class ThreadPool;
+
+/// The geometry of one draw as read from a file, with each attribute in an array of its own so it converts into any
+/// vertex layout.
+struct ImportedPrimitive
+{
+    std::vector<glm::vec3> positions{};
+    // Empty when the file has none, base_color is the color of every vertex then
+    std::vector<glm::vec4> colors{};
+    // Empty when the file has none
+    std::vector<glm::vec2> texture_coordinates{};
+    // Triangle list
+    std::vector<uint32_t> indices{};
+    // Multiplied into the vertex colors, as glTF does with baseColorFactor
+    glm::vec4 base_color{1.0f};
+
+    [[nodiscard]] std::vector<vk::ColorVertex> get_color_vertices() const;
+    [[nodiscard]] std::vector<vk::shader::MaterialShader::Vertex> get_material_vertices() const;
+};
+
+struct ImportedMesh
+{
+    std::string name{};
+    std::vector<ImportedPrimitive> primitives{};
+};
+
+struct ImportedNode
+{
+    std::string name{};
+    // Into ImportedScene::meshes, -1 for nodes without a mesh
+    int32_t mesh = -1;
+    // Into ImportedScene::nodes, -1 for root nodes
+    int32_t parent = -1;
+    glm::mat4 local_matrix{1.0f};
+    // The local matrix under every parent's
+    glm::mat4 world_matrix{1.0f};
+};
+
+struct ImportedScene
+{
+    std::vector<ImportedMesh> meshes{};
+    // Parents come before their children
+    std::vector<ImportedNode> nodes{};
+};
+
+/// Imports a glTF 2.0 (.gltf or .glb) or Wavefront OBJ (.obj) file, told apart by the extension. Parsing and
+/// conversion are spread over the thread pool, see import_gltf and import_obj.
+/// @throws std::runtime_error When the file cannot be read or is malformed
+[[nodiscard]] ImportedScene import_scene(const std::filesystem::path &path, ThreadPool &thread_pool);
+
+/// Registers every primitive of the scene as a mesh, and creates an instance of it for every node using it, at the
+/// node's world transform. Vertices are converted on the thread pool, and the uploads are staged in the manager's
+/// staging ring when it has one and flushed at the end, so a whole scene takes a single submission.
+/// @return The instances created, in node order
+std::vector<vk::ColorModelManager::instance_id_t> add_to_model_manager(const ImportedScene &scene,
+                                                                      vk::ColorModelManager &model_manager,
+                                                                      ThreadPool &thread_pool,
+                                                                      vk::VertexFormat vertex_format =
+                                                                              vk::VertexFormat::FULL);
+
+}// namespace flwfrg
@@ -0,0 +1,386 @@
+#include "pch.hpp"
+
+#include "json.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+// Deeper documents are rejected rather than risking the stack
+constexpr uint32_t max_depth = 512;
+
+void append_utf8(std::string &string, uint32_t code_point)
+{
+    if (code_point < 0x80)
+    {
+        string += static_cast<char>(code_point);
+    }
+    else if (code_point < 0x800)
+    {
+        string += static_cast<char>(0xC0 | (code_point >> 6));
+        string += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
+    {
+        string += static_cast<char>(0xE0 | (code_point >> 12));
+        string += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        string += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        string += static_cast<char>(0xF0 | (code_point >> 18));
+        string += static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+        string += static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+        string += static_cast<char>(0x80 | (code_point & 0x3F));
+    }
+}
+
+} // namespace
+
+class JsonDocument::Parser
+{
+public:
+    Parser(JsonDocument &document, std::string_view source) : document_{document}, source_{source} {}
+
+    void parse()
+    {
+        // Values take a few bytes of source at the least, which bounds the nodes without counting them first
+        document_.nodes_.reserve(source_.size() / 8 + 1);
+
+        parse_value({}, 0);
+        skip_whitespace();
+        if (position_ != source_.size())
+            fail("unexpected data after the document");
+    }
+
+private:
+    JsonDocument &document_;
+    std::string_view source_;
+    size_t position_ = 0;
+
+    [[noreturn]] void fail(const char *reason) const
+    {
+        throw std::runtime_error("Failed to parse JSON at offset " + std::to_string(position_) + ": " + reason);
+    }
+
+    void skip_whitespace()
+    {
+        while (position_ < source_.size())
+        {
+            char character = source_[position_];
+            if (character != ' ' && character != '\n' && character != '\r' && character != '\t')
+                return;
+            position_++;
+        }
+    }
+
+    char peek()
+    {
+        skip_whitespace();
+        if (position_ >= source_.size())
+            fail("unexpected end of the document");
+        return source_[position_];
+    }
+
+    void expect(char character)
+    {
+        if (peek() != character)
+            fail("unexpected character");
+        position_++;
+    }
+
+    void parse_value(std::string_view key, uint32_t depth)
+    {
+        if (depth > max_depth)
+            fail("nested too deep");
+
+        auto index = static_cast<uint32_t>(document_.nodes_.size());
+        document_.nodes_.push_back(Node{.key = key});
+
+        char character = peek();
+        switch (character)
+        {
+            case '{':
+                parse_object(index, depth);
+                break;
+            case '[':
+                parse_array(index, depth);
+                break;
+            case '"':
+                document_.nodes_[index].type = Type::STRING;
+                document_.nodes_[index].string = parse_string();
+                break;
+            case 't':
+                parse_literal("true");
+                document_.nodes_[index].type = Type::BOOLEAN;
+                document_.nodes_[index].number = 1.0;
+                break;
+            case 'f':
+                parse_literal("false");
+                document_.nodes_[index].type = Type::BOOLEAN;
+                break;
+            case 'n':
+                parse_literal("null");
+                break;
+            default:
+                document_.nodes_[index].type = Type::NUMBER;
+                document_.nodes_[index].number = parse_number();
+                break;
+        }
+
+        document_.nodes_[index].end = static_cast<uint32_t>(document_.nodes_.size());
+    }
+
+    void parse_object(uint32_t index, uint32_t depth)
+    {
+        document_.nodes_[index].type = Type::OBJECT;
+        position_++;
+
+        uint32_t member_count = 0;
+        if (peek() != '}')
+        {
+            while (true)
+            {
+                if (peek() != '"')
+                    fail("expected a key");
+                std::string_view key = parse_string();
+                expect(':');
+                parse_value(key, depth + 1);
+                member_count++;
+
+                if (peek() != ',')
+                    break;
+                position_++;
+            }
+        }
+        expect('}');
+
+        // The vector may have grown, so the node is looked up again
+        document_.nodes_[index].child_count = member_count;
+    }
+
+    void parse_array(uint32_t index, uint32_t depth)
+    {
+        document_.nodes_[index].type = Type::ARRAY;
+        position_++;
+
+        uint32_t element_count = 0;
+        if (peek() != ']')
+        {
+            while (true)
+            {
+                parse_value({}, depth + 1);
+                element_count++;
+
+                if (peek() != ',')
+                    break;
+                position_++;
+            }
+        }
+        expect(']');
+
+        document_.nodes_[index].child_count = element_count;
+    }
+
+    void parse_literal(std::string_view literal)
+    {
+        if (source_.substr(position_, literal.size()) != literal)
+            fail("unknown literal");
+        position_ += literal.size();
+    }
+
+    double parse_number()
+    {
+        size_t start = position_;
+        while (position_ < source_.size())
+        {
+            char character = source_[position_];
+            if ((character < '0' || character > '9') && character != '-' && character != '+' && character != '.' &&
+                character != 'e' && character != 'E')
+                break;
+            position_++;
+        }
+
+        double number = 0.0;
+        auto [end, error] = std::from_chars(source_.data() + start, source_.data() + position_, number);
+        if (error != std::errc{} || end != source_.data() + position_)
+        {
+            position_ = start;
+            fail("invalid number");
+        }
+        return number;
+    }
+
+    uint32_t parse_hex4()
+    {
+        if (position_ + 4 > source_.size())
+            fail("unexpected end of the document");
+
+        uint32_t value = 0;
+        auto [end, error] = std::from_chars(source_.data() + position_, source_.data() + position_ + 4, value, 16);
+        if (error != std::errc{} || end != source_.data() + position_ + 4)
+            fail("invalid unicode escape");
+        position_ += 4;
+        return value;
+    }
+
+    std::string_view parse_string()
+    {
+        // Opening quote
+        position_++;
+        size_t start = position_;
+
+        // Strings without escapes, which is nearly all of them, are used in place
+        while (position_ < source_.size() && source_[position_] != '"' && source_[position_] != '\\')
+        {
+            position_++;
+        }
+        if (position_ >= source_.size())
+            fail("unterminated string");
+        if (source_[position_] == '"')
+        {
+            return source_.substr(start, position_++ - start);
+        }
+
+        std::string &decoded = document_.decoded_strings_.emplace_back(source_.substr(start, position_ - start));
+        while (true)
+        {
+            if (position_ >= source_.size())
+                fail("unterminated string");
+
+            char character = source_[position_++];
+            if (character == '"')
+                break;
+            if (character != '\\')
+            {
+                decoded += character;
+                continue;
+            }
+
+            if (position_ >= source_.size())
+                fail("unterminated string");
+            switch (source_[position_++])
+            {
+                case '"':
+                    decoded += '"';
+                    break;
+                case '\\':
+                    decoded += '\\';
+                    break;
+                case '/':
+                    decoded += '/';
+                    break;
+                case 'b':
+                    decoded += '\b';
+                    break;
+                case 'f':
+                    decoded += '\f';
+                    break;
+                case 'n':
+                    decoded += '\n';
+                    break;
+                case 'r':
+                    decoded += '\r';
+                    break;
+                case 't':
+                    decoded += '\t';
+                    break;
+                case 'u':
+                {
+                    uint32_t code_point = parse_hex4();
+                    // Characters outside the basic plane come as a surrogate pair
+                    if (code_point >= 0xD800 && code_point < 0xDC00 && source_.substr(position_, 2) == "\\u")
+                    {
+                        position_ += 2;
+                        uint32_t low_surrogate = parse_hex4();
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low_surrogate - 0xDC00);
+                    }
+                    append_utf8(decoded, code_point);
+                    break;
+                }
+                default:
+                    fail("invalid escape");
+            }
+        }
+        return decoded;
+    }
+};
+
+JsonDocument::JsonDocument(std::string_view source)
+{
+    Parser{*this, source}.parse();
+}
+
+JsonDocument::Value JsonDocument::Value::operator[](std::string_view key) const
+{
+    if (!is_object())
+        return {};
+
+    for (Value member: *this)
+    {
+        if (member.get_key() == key)
+            return member;
+    }
+    return {};
+}
+
+JsonDocument::Value JsonDocument::Value::operator[](uint32_t index) const
+{
+    if (!is_array() || index >= size())
+        return {};
+
+    Iterator element = begin();
+    for (uint32_t skipped = 0; skipped < index; skipped++)
+    {
+        ++element;
+    }
+    return *element;
+}
+
+double JsonDocument::Value::as_number(double fallback) const
+{
+    return get_type() == Type::NUMBER ? get_node().number : fallback;
+}
+
+int64_t JsonDocument::Value::as_int(int64_t fallback) const
+{
+    if (get_type() != Type::NUMBER)
+        return fallback;
+
+    // Converting a double that is out of range of the integer is undefined, so it is checked first
+    double number = get_node().number;
+    if (!(number >= -0x1p63 && number < 0x1p63) || std::trunc(number) != number)
+        throw std::runtime_error("Failed to read a JSON number as an integer, it is fractional or out of range");
+    return static_cast<int64_t>(number);
+}
+
+bool JsonDocument::Value::as_bool(bool fallback) const
+{
+    return get_type() == Type::BOOLEAN ? get_node().number != 0.0 : fallback;
+}
+
+std::string_view JsonDocument::Value::as_string(std::string_view fallback) const
+{
+    return get_type() == Type::STRING ? get_node().string : fallback;
+}
+
+JsonDocument::Value::Iterator JsonDocument::Value::begin() const
+{
+    // Children follow their container directly
+    if (!is_array() && !is_object())
+        return end();
+    return Iterator{document_, index_ + 1};
+}
+
+JsonDocument::Value::Iterator JsonDocument::Value::end() const
+{
+    return Iterator{document_, is_valid() ? get_node().end : 0};
+}
+
+}// namespace flwfrg
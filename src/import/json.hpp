@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flwfrg
+{
+
+/// A parsed JSON document, read only, for the JSON parts of asset formats. Values are kept in one flat array in
+/// document order, and strings point into the source text unless they had escapes, so parsing allocates little more
+/// than that array. The source text has to outlive the document, and values have to be dropped with it.
+class JsonDocument
+{
+    struct Node;
+
+public:
+    enum class Type : uint8_t
+    {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT,
+    };
+
+    /// A value in the document. Looking up a key or index that does not exist gives an invalid value, and reading an
+    /// invalid value or one of another type gives the fallback, so optional fields need no checks of their own.
+    class Value
+    {
+    public:
+        Value() = default;
+
+        class Iterator
+        {
+        public:
+            inline Value operator*() const { return Value{document_, index_}; };
+            inline Iterator &operator++()
+            {
+                index_ = document_->nodes_[index_].end;
+                return *this;
+            }
+            inline bool operator!=(const Iterator &other) const { return index_ != other.index_; };
+
+        private:
+            friend class Value;
+            Iterator(const JsonDocument *document, uint32_t index) : document_{document}, index_{index} {}
+
+            const JsonDocument *document_;
+            uint32_t index_;
+        };
+
+        [[nodiscard]] inline bool is_valid() const { return document_ != nullptr; };
+        [[nodiscard]] inline Type get_type() const { return is_valid() ? get_node().type : Type::NUL; };
+        [[nodiscard]] inline bool is_array() const { return get_type() == Type::ARRAY; };
+        [[nodiscard]] inline bool is_object() const { return get_type() == Type::OBJECT; };
+        /// Elements of an array or members of an object, 0 for anything else
+        [[nodiscard]] inline uint32_t size() const { return is_valid() ? get_node().child_count : 0; };
+        /// The key of an object member, empty for anything else
+        [[nodiscard]] inline std::string_view get_key() const
+        {
+            return is_valid() ? get_node().key : std::string_view{};
+        }
+
+        /// Linear in the number of members
+        [[nodiscard]] Value operator[](std::string_view key) const;
+        /// Linear in the index, iterate instead to visit every element
+        [[nodiscard]] Value operator[](uint32_t index) const;
+
+        [[nodiscard]] double as_number(double fallback = 0.0) const;
+        [[nodiscard]] inline float as_float(float fallback = 0.0f) const
+        {
+            return static_cast<float>(as_number(fallback));
+        }
+        /// Throws for a number that is not an integer or does not fit in an int64_t
+        [[nodiscard]] int64_t as_int(int64_t fallback = 0) const;
+        [[nodiscard]] bool as_bool(bool fallback = false) const;
+        [[nodiscard]] std::string_view as_string(std::string_view fallback = {}) const;
+
+        /// Elements of an array or members of an object, in document order
+        [[nodiscard]] Iterator begin() const;
+        [[nodiscard]] Iterator end() const;
+
+    private:
+        friend class JsonDocument;
+        Value(const JsonDocument *document, uint32_t index) : document_{document}, index_{index} {}
+
+        const JsonDocument *document_ = nullptr;
+        uint32_t index_ = 0;
+
+        [[nodiscard]] inline const Node &get_node() const { return document_->nodes_[index_]; };
+    };
+
+public:
+    /// @throws std::runtime_error On malformed JSON, with the offset of the error
+    explicit JsonDocument(std::string_view source);
+    ~JsonDocument() = default;
+
+    // Copy
+    JsonDocument(const JsonDocument &) = delete;
+    JsonDocument &operator=(const JsonDocument &) = delete;
+    // Move
+    JsonDocument(JsonDocument &&other) noexcept = default;
+    JsonDocument &operator=(JsonDocument &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] inline Value get_root() const { return Value{this, 0}; };
+
+private:
+    struct Node
+    {
+        Type type = Type::NUL;
+        uint32_t child_count = 0;
+        // Index after the value and everything in it, which is the next sibling
+        uint32_t end = 0;
+        double number = 0.0;
+        std::string_view string{};
+        std::string_view key{};
+    };
+
+    std::vector<Node> nodes_{};
+    // Strings with escapes, decoded. A deque, so the views into it stay valid as it grows.
+    std::deque<std::string> decoded_strings_{};
+
+    class Parser;
+};
+
+}// namespace flwfrg
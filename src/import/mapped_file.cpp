@@ -0,0 +1,156 @@
+#include "pch.hpp"
+
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace flwfrg
+{
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path &path)
+{
+    file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                        FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+    {
+        file_ = nullptr;
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+
+    LARGE_INTEGER size{};
+    GetFileSizeEx(file_, &size);
+    size_ = static_cast<size_t>(size.QuadPart);
+    // Empty files cannot be mapped, and have nothing to map either
+    if (size_ == 0)
+        return;
+
+    mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ != nullptr)
+        data_ = static_cast<const std::byte *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr)
+    {
+        unmap();
+        throw std::runtime_error("Failed to map file: " + path.string());
+    }
+}
+
+void MappedFile::unmap()
+{
+    if (data_ != nullptr)
+        UnmapViewOfFile(data_);
+    if (mapping_ != nullptr)
+        CloseHandle(mapping_);
+    if (file_ != nullptr)
+        CloseHandle(file_);
+    data_ = nullptr;
+    mapping_ = nullptr;
+    file_ = nullptr;
+    size_ = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_{std::exchange(other.data_, nullptr)},
+      size_{std::exchange(other.size_, 0)},
+      file_{std::exchange(other.file_, nullptr)},
+      mapping_{std::exchange(other.mapping_, nullptr)}
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        file_ = std::exchange(other.file_, nullptr);
+        mapping_ = std::exchange(other.mapping_, nullptr);
+    }
+    return *this;
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path &path)
+{
+    int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        throw std::runtime_error("Failed to open file: " + path.string());
+    }
+
+    struct stat status{};
+    if (fstat(file, &status) != 0)
+    {
+        close(file);
+        throw std::runtime_error("Failed to read the size of file: " + path.string());
+    }
+    size_ = static_cast<size_t>(status.st_size);
+
+    // Empty files cannot be mapped, and have nothing to map either
+    if (size_ > 0)
+    {
+        void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED)
+        {
+            close(file);
+            throw std::runtime_error("Failed to map file: " + path.string());
+        }
+        data_ = static_cast<const std::byte *>(data);
+
+        // The file is read front to back once, so the kernel can read far ahead and drop pages behind
+        madvise(data, size_, MADV_SEQUENTIAL);
+        madvise(data, size_, MADV_WILLNEED);
+    }
+
+    // The mapping keeps the file alive on its own
+    close(file);
+}
+
+void MappedFile::unmap()
+{
+    if (data_ != nullptr)
+        munmap(const_cast<std::byte *>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : data_{std::exchange(other.data_, nullptr)}, size_{std::exchange(other.size_, 0)}
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+    unmap();
+}
+
+}// namespace flwfrg
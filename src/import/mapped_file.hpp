@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+namespace flwfrg
+{
+
+/// A file mapped read only into memory. Pages are read in by the OS as they are touched, so copying out of the
+/// mapping reads the file with no buffer of its own in between, and files already in the page cache are not read at
+/// all.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    /// @throws std::runtime_error When the file cannot be opened or mapped
+    explicit MappedFile(const std::filesystem::path &path);
+    ~MappedFile();
+
+    // Copy
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    // Move
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+
+    // Methods
+
+    [[nodiscard]] inline std::span<const std::byte> get_bytes() const { return {data_, size_}; };
+    [[nodiscard]] inline size_t get_size() const { return size_; };
+
+private:
+    const std::byte *data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void *file_ = nullptr;
+    void *mapping_ = nullptr;
+#endif
+
+    void unmap();
+};
+
+}// namespace flwfrg
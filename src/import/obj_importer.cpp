@@ -0,0 +1,480 @@
+#include "pch.hpp"
+
+#include "obj_importer.hpp"
+
+#include "import/file_contents.hpp"
+#include "threading/thread_pool.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+// Big enough that the per chunk work outweighs handing it out, small enough to keep every worker busy
+constexpr size_t target_chunk_size = 256 * 1024;
+constexpr uint32_t no_texture_coordinate = std::numeric_limits<uint32_t>::max();
+
+[[noreturn]] void fail(const std::filesystem::path &path, const std::string &reason)
+{
+    throw std::runtime_error("Failed to import OBJ " + path.string() + ": " + reason);
+}
+
+struct Corner
+{
+    uint32_t position;
+    uint32_t texture_coordinate;
+
+    [[nodiscard]] inline uint64_t get_key() const
+    {
+        return static_cast<uint64_t>(position) << 32 | texture_coordinate;
+    }
+};
+
+struct Chunk
+{
+    std::string_view text{};
+
+    // Counted by the first pass
+    size_t position_count = 0;
+    size_t texture_coordinate_count = 0;
+    size_t corner_count = 0;
+    // Where the chunk's positions and texture coordinates are in the whole file's
+    size_t first_position = 0;
+    size_t first_texture_coordinate = 0;
+
+    // Three per triangle
+    std::vector<Corner> corners{};
+    // Corners after deduplication, and the triangle list into them
+    std::vector<Corner> vertices{};
+    std::vector<uint32_t> indices{};
+    size_t first_vertex = 0;
+};
+
+// Reads the values of one line
+class LineReader
+{
+public:
+    LineReader(const char *begin, const char *end) : current_{begin}, end_{end} {}
+
+    // Skips the keyword, or whatever the next value is
+    void skip()
+    {
+        skip_space();
+        while (current_ < end_ && *current_ != ' ' && *current_ != '\t')
+        {
+            current_++;
+        }
+    }
+
+    bool read_float(float &value)
+    {
+        skip_space();
+        // from_chars takes no plus sign
+        if (current_ < end_ && *current_ == '+')
+            current_++;
+        auto [end, error] = std::from_chars(current_, end_, value);
+        if (error != std::errc{})
+            return false;
+        current_ = end;
+        return true;
+    }
+
+    // A face corner of position/texture/normal, with the texture coordinate and normal optional. Returns false after
+    // the last corner.
+    bool read_corner(int64_t &position, int64_t &texture_coordinate)
+    {
+        skip_space();
+        if (current_ >= end_)
+            return false;
+
+        texture_coordinate = 0;
+        if (!read_int(position))
+            return false;
+        if (current_ < end_ && *current_ == '/')
+        {
+            current_++;
+            if (current_ < end_ && *current_ != '/')
+                read_int(texture_coordinate);
+            if (current_ < end_ && *current_ == '/')
+            {
+                int64_t normal;
+                current_++;
+                read_int(normal);
+            }
+        }
+        return true;
+    }
+
+    // Values left on the line
+    size_t count_values()
+    {
+        size_t count = 0;
+        while (true)
+        {
+            skip_space();
+            if (current_ >= end_)
+                return count;
+            skip();
+            count++;
+        }
+    }
+
+private:
+    const char *current_;
+    const char *end_;
+
+    void skip_space()
+    {
+        while (current_ < end_ && (*current_ == ' ' || *current_ == '\t' || *current_ == '\r'))
+        {
+            current_++;
+        }
+    }
+
+    bool read_int(int64_t &value)
+    {
+        auto [end, error] = std::from_chars(current_, end_, value);
+        if (error != std::errc{})
+            return false;
+        current_ = end;
+        return true;
+    }
+};
+
+enum class LineType
+{
+    OTHER,
+    POSITION,
+    TEXTURE_COORDINATE,
+    FACE,
+};
+
+LineType get_line_type(std::string_view line)
+{
+    size_t start = line.find_first_not_of(" \t");
+    if (start == std::string_view::npos || start + 1 >= line.size())
+        return LineType::OTHER;
+
+    char first = line[start];
+    char second = line[start + 1];
+    bool second_is_space = second == ' ' || second == '\t';
+    if (first == 'v' && second_is_space)
+        return LineType::POSITION;
+    if (first == 'f' && second_is_space)
+        return LineType::FACE;
+    if (first == 'v' && second == 't' && start + 2 < line.size() && (line[start + 2] == ' ' || line[start + 2] == '\t'))
+        return LineType::TEXTURE_COORDINATE;
+    return LineType::OTHER;
+}
+
+template<typename Function>
+void for_each_line(std::string_view text, Function &&function)
+{
+    const char *current = text.data();
+    const char *end = text.data() + text.size();
+    while (current < end)
+    {
+        const auto *line_end = static_cast<const char *>(std::memchr(current, '\n', end - current));
+        if (line_end == nullptr)
+            line_end = end;
+        function(std::string_view{current, static_cast<size_t>(line_end - current)});
+        current = line_end + 1;
+    }
+}
+
+// Splits the text into chunks of whole lines
+std::vector<Chunk> split_chunks(std::string_view text, size_t max_chunk_count)
+{
+    size_t chunk_count = std::clamp<size_t>(text.size() / target_chunk_size, 1, max_chunk_count);
+    size_t chunk_size = text.size() / chunk_count + 1;
+
+    std::vector<Chunk> chunks{};
+    chunks.reserve(chunk_count);
+    size_t start = 0;
+    while (start < text.size())
+    {
+        size_t end = std::min(start + chunk_size, text.size());
+        size_t line_end = text.find('\n', end);
+        end = line_end == std::string_view::npos ? text.size() : line_end + 1;
+
+        chunks.push_back(Chunk{.text = text.substr(start, end - start)});
+        start = end;
+    }
+    return chunks;
+}
+
+// Open addressing, with room for every corner of the chunk so it never grows
+class CornerTable
+{
+public:
+    explicit CornerTable(size_t max_size)
+        : keys_(std::bit_ceil(std::max<size_t>(max_size * 2, 16)), empty_key), values_(keys_.size())
+    {}
+
+    // The index of the corner, and whether it was added by this call
+    std::pair<uint32_t, bool> insert(uint64_t key, uint32_t value)
+    {
+        const size_t mask = keys_.size() - 1;
+        // Fibonacci hashing spreads keys differing only in the low bits of the position
+        size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+        while (true)
+        {
+            if (keys_[slot] == empty_key)
+            {
+                keys_[slot] = key;
+                values_[slot] = value;
+                return {value, true};
+            }
+            if (keys_[slot] == key)
+                return {values_[slot], false};
+            slot = (slot + 1) & mask;
+        }
+    }
+
+private:
+    static constexpr uint64_t empty_key = std::numeric_limits<uint64_t>::max();
+
+    std::vector<uint64_t> keys_;
+    std::vector<uint32_t> values_;
+};
+
+} // namespace
+
+ImportedScene import_obj(const std::filesystem::path &path, ThreadPool &thread_pool)
+{
+    FileContents file = FileContents::read(path);
+    std::vector<Chunk> chunks = split_chunks(file.get_text(), (thread_pool.get_thread_count() + 1) * 8);
+
+    // Counting first tells every chunk where its positions go, which relative indices need
+    thread_pool.parallel_for(chunks.size(), [&](size_t chunk_index) {
+        Chunk &chunk = chunks[chunk_index];
+        for_each_line(chunk.text, [&](std::string_view line) {
+            switch (get_line_type(line))
+            {
+                case LineType::POSITION:
+                    chunk.position_count++;
+                    break;
+                case LineType::TEXTURE_COORDINATE:
+                    chunk.texture_coordinate_count++;
+                    break;
+                case LineType::FACE:
+                {
+                    LineReader reader{line.data(), line.data() + line.size()};
+                    reader.skip();
+                    size_t corner_count = reader.count_values();
+                    chunk.corner_count += corner_count >= 3 ? (corner_count - 2) * 3 : 0;
+                    break;
+                }
+                case LineType::OTHER:
+                    break;
+            }
+        });
+    });
+
+    size_t position_count = 0;
+    size_t texture_coordinate_count = 0;
+    for (Chunk &chunk: chunks)
+    {
+        chunk.first_position = position_count;
+        chunk.first_texture_coordinate = texture_coordinate_count;
+        position_count += chunk.position_count;
+        texture_coordinate_count += chunk.texture_coordinate_count;
+    }
+    if (position_count >= std::numeric_limits<uint32_t>::max())
+        fail(path, "too many positions");
+
+    // Vertex colors are all or nothing, so the first position tells whether the file has them
+    bool has_colors = false;
+    for (const Chunk &chunk: chunks)
+    {
+        if (chunk.position_count == 0)
+            continue;
+        for_each_line(chunk.text, [&](std::string_view line) {
+            if (!has_colors && get_line_type(line) == LineType::POSITION)
+            {
+                LineReader reader{line.data(), line.data() + line.size()};
+                reader.skip();
+                has_colors = reader.count_values() >= 6;
+            }
+        });
+        break;
+    }
+
+    // Every chunk writes its positions and texture coordinates into its own range of these
+    std::vector<glm::vec3> positions(position_count);
+    std::vector<glm::vec4> colors(has_colors ? position_count : 0);
+    std::vector<glm::vec2> texture_coordinates(texture_coordinate_count);
+
+    thread_pool.parallel_for(chunks.size(), [&](size_t chunk_index) {
+        Chunk &chunk = chunks[chunk_index];
+        chunk.corners.reserve(chunk.corner_count);
+        size_t next_position = chunk.first_position;
+        size_t next_texture_coordinate = chunk.first_texture_coordinate;
+        // A face's corners before triangulating, kept across faces
+        std::vector<Corner> face{};
+
+        for_each_line(chunk.text, [&](std::string_view line) {
+            LineType type = get_line_type(line);
+            if (type == LineType::OTHER)
+                return;
+
+            LineReader reader{line.data(), line.data() + line.size()};
+            reader.skip();
+            switch (type)
+            {
+                case LineType::POSITION:
+                {
+                    glm::vec3 &position = positions[next_position];
+                    if (!reader.read_float(position.x) || !reader.read_float(position.y) ||
+                        !reader.read_float(position.z))
+                        fail(path, "invalid position");
+                    if (has_colors)
+                    {
+                        glm::vec4 &color = colors[next_position];
+                        color.a = 1.0f;
+                        if (!reader.read_float(color.r) || !reader.read_float(color.g) || !reader.read_float(color.b))
+                            color = glm::vec4{1.0f};
+                    }
+                    next_position++;
+                    break;
+                }
+                case LineType::TEXTURE_COORDINATE:
+                {
+                    glm::vec2 &texture_coordinate = texture_coordinates[next_texture_coordinate++];
+                    if (!reader.read_float(texture_coordinate.x))
+                        fail(path, "invalid texture coordinate");
+                    // The v coordinate is optional, and OBJ has it point up where Vulkan has it point down
+                    texture_coordinate.y = 0.0f;
+                    reader.read_float(texture_coordinate.y);
+                    texture_coordinate.y = 1.0f - texture_coordinate.y;
+                    break;
+                }
+                case LineType::FACE:
+                {
+                    face.clear();
+                    int64_t position;
+                    int64_t texture_coordinate;
+                    while (reader.read_corner(position, texture_coordinate))
+                    {
+                        // 1 based, or relative to the end when negative
+                        position = position < 0 ? static_cast<int64_t>(next_position) + position : position - 1;
+                        texture_coordinate =
+                                texture_coordinate < 0
+                                        ? static_cast<int64_t>(next_texture_coordinate) + texture_coordinate
+                                        : texture_coordinate - 1;
+                        if (position < 0 || position >= static_cast<int64_t>(position_count) ||
+                            texture_coordinate >= static_cast<int64_t>(texture_coordinate_count))
+                            fail(path, "face index out of range");
+
+                        face.push_back(Corner{
+                                .position = static_cast<uint32_t>(position),
+                                .texture_coordinate = texture_coordinate < 0
+                                                              ? no_texture_coordinate
+                                                              : static_cast<uint32_t>(texture_coordinate),
+                        });
+                    }
+
+                    for (size_t corner = 2; corner < face.size(); corner++)
+                    {
+                        chunk.corners.push_back(face[0]);
+                        chunk.corners.push_back(face[corner - 1]);
+                        chunk.corners.push_back(face[corner]);
+                    }
+                    break;
+                }
+                case LineType::OTHER:
+                    break;
+            }
+        });
+    });
+
+    ImportedScene scene{};
+    ImportedPrimitive &primitive = scene.meshes.emplace_back().primitives.emplace_back();
+    scene.meshes[0].name = path.stem().string();
+    scene.nodes.push_back(ImportedNode{.name = scene.meshes[0].name, .mesh = 0});
+
+    size_t index_count = 0;
+    for (const Chunk &chunk: chunks)
+    {
+        index_count += chunk.corners.size();
+    }
+    primitive.indices.reserve(index_count);
+
+    // Without texture coordinates every position is a vertex of its own, so the positions are the vertices already
+    if (texture_coordinate_count == 0)
+    {
+        for (const Chunk &chunk: chunks)
+        {
+            for (const Corner &corner: chunk.corners)
+            {
+                primitive.indices.push_back(corner.position);
+            }
+        }
+        primitive.positions = std::move(positions);
+        primitive.colors = std::move(colors);
+        return scene;
+    }
+
+    // Deduplicated per chunk, which leaves a few duplicates at chunk borders but needs no shared table
+    thread_pool.parallel_for(chunks.size(), [&](size_t chunk_index) {
+        Chunk &chunk = chunks[chunk_index];
+        CornerTable table{chunk.corners.size()};
+        chunk.indices.reserve(chunk.corners.size());
+        for (const Corner &corner: chunk.corners)
+        {
+            auto [index, added] = table.insert(corner.get_key(), static_cast<uint32_t>(chunk.vertices.size()));
+            if (added)
+                chunk.vertices.push_back(corner);
+            chunk.indices.push_back(index);
+        }
+        chunk.corners = {};
+    });
+
+    size_t vertex_count = 0;
+    for (Chunk &chunk: chunks)
+    {
+        chunk.first_vertex = vertex_count;
+        vertex_count += chunk.vertices.size();
+    }
+    primitive.positions.resize(vertex_count);
+    primitive.colors.resize(has_colors ? vertex_count : 0);
+    primitive.texture_coordinates.resize(vertex_count);
+    primitive.indices.resize(index_count);
+
+    // Every chunk writes its vertices and indices at its own offset
+    std::vector<size_t> first_indices(chunks.size());
+    for (size_t chunk = 1; chunk < chunks.size(); chunk++)
+    {
+        first_indices[chunk] = first_indices[chunk - 1] + chunks[chunk - 1].indices.size();
+    }
+    thread_pool.parallel_for(chunks.size(), [&](size_t chunk_index) {
+        const Chunk &chunk = chunks[chunk_index];
+        for (size_t vertex = 0; vertex < chunk.vertices.size(); vertex++)
+        {
+            const Corner &corner = chunk.vertices[vertex];
+            size_t destination = chunk.first_vertex + vertex;
+            primitive.positions[destination] = positions[corner.position];
+            if (has_colors)
+                primitive.colors[destination] = colors[corner.position];
+            primitive.texture_coordinates[destination] = corner.texture_coordinate == no_texture_coordinate
+                                                                 ? glm::vec2{0.0f}
+                                                                 : texture_coordinates[corner.texture_coordinate];
+        }
+        for (size_t index = 0; index < chunk.indices.size(); index++)
+        {
+            primitive.indices[first_indices[chunk_index] + index] =
+                    static_cast<uint32_t>(chunk.first_vertex) + chunk.indices[index];
+        }
+    });
+
+    return scene;
+}
+
+}// namespace flwfrg
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "import/imported_scene.hpp"
+
+#include <filesystem>
+
+namespace flwfrg
+{
+class ThreadPool;
+
+/// Imports a Wavefront OBJ file as a single mesh under a single node. The file is split into chunks at line breaks,
+/// which are counted and then parsed in parallel with every chunk knowing where its positions go, so relative
+/// indices resolve without a pass of their own. The vertices of each chunk are deduplicated by their position and
+/// texture coordinate, and written straight into the mesh at the chunk's offset.
+///
+/// Positions, vertex colors (the r g b after a position), texture coordinates and faces are read, with polygons
+/// triangulated as fans. Normals, groups and materials are not.
+/// @throws std::runtime_error When the file cannot be read or an index is out of range
+[[nodiscard]] ImportedScene import_obj(const std::filesystem::path &path, ThreadPool &thread_pool);
+
+}// namespace flwfrg
@@ -0,0 +1,204 @@
+#include "pch.hpp"
+
+#include "vertex_conversion.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FLOWFORGE_VERTEX_CONVERSION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace flwfrg
+{
+
+namespace
+{
+
+template<typename T>
+T load(const std::byte *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+float read_component(const std::byte *data, ComponentType component_type, bool normalized)
+{
+    switch (component_type)
+    {
+        case ComponentType::BYTE:
+        {
+            auto value = static_cast<float>(load<int8_t>(data));
+            return normalized ? std::max(value / 127.0f, -1.0f) : value;
+        }
+        case ComponentType::UNSIGNED_BYTE:
+        {
+            auto value = static_cast<float>(load<uint8_t>(data));
+            return normalized ? value / 255.0f : value;
+        }
+        case ComponentType::SHORT:
+        {
+            auto value = static_cast<float>(load<int16_t>(data));
+            return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+        }
+        case ComponentType::UNSIGNED_SHORT:
+        {
+            auto value = static_cast<float>(load<uint16_t>(data));
+            return normalized ? value / 65535.0f : value;
+        }
+        case ComponentType::UNSIGNED_INT:
+            return static_cast<float>(load<uint32_t>(data));
+        case ComponentType::FLOAT:
+            return load<float>(data);
+    }
+    return 0.0f;
+}
+
+#ifdef FLOWFORGE_VERTEX_CONVERSION_SSE2
+
+// Loads four components of an element, whatever the source has of them
+template<typename LoadElement>
+void convert_elements_sse2(const AttributeSource &source, const AttributeDestination &destination, size_t count,
+                           float fill, LoadElement load_element)
+{
+    alignas(16) uint32_t keep_lanes[4];
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+        keep_lanes[lane] = lane < source.component_count ? ~0u : 0u;
+    }
+    const __m128 keep_mask = _mm_load_ps(reinterpret_cast<const float *>(keep_lanes));
+    const __m128 fill_value = _mm_andnot_ps(keep_mask, _mm_set1_ps(fill));
+
+    for (size_t element = 0; element < count; element++)
+    {
+        __m128 value = load_element(source.data + element * source.stride);
+        value = _mm_or_ps(_mm_and_ps(value, keep_mask), fill_value);
+
+        auto *output = reinterpret_cast<float *>(reinterpret_cast<std::byte *>(destination.data) +
+                                                 element * destination.stride);
+        switch (destination.component_count)
+        {
+            case 4:
+                _mm_storeu_ps(output, value);
+                break;
+            case 3:
+                _mm_storel_pi(reinterpret_cast<__m64 *>(output), value);
+                _mm_store_ss(output + 2, _mm_movehl_ps(value, value));
+                break;
+            case 2:
+                _mm_storel_pi(reinterpret_cast<__m64 *>(output), value);
+                break;
+            default:
+                _mm_store_ss(output, value);
+                break;
+        }
+    }
+}
+
+// Returns how many elements were converted, leaving the rest to the scalar loop
+size_t convert_attribute_sse2(const AttributeSource &source, const AttributeDestination &destination, size_t count,
+                              float fill)
+{
+    // Four components are loaded at once, which reads past the end of an element. With at least two components the
+    // bytes read past one element are still inside the next one, so only the last element is left out.
+    if (source.component_count < 2 || count < 2)
+        return 0;
+    size_t simd_count = count - 1;
+
+    const __m128i zero = _mm_setzero_si128();
+    switch (source.component_type)
+    {
+        case ComponentType::FLOAT:
+            convert_elements_sse2(source, destination, simd_count, fill, [](const std::byte *data) {
+                return _mm_loadu_ps(reinterpret_cast<const float *>(data));
+            });
+            return simd_count;
+        case ComponentType::UNSIGNED_BYTE:
+        {
+            const __m128 scale = _mm_set1_ps(source.normalized ? 1.0f / 255.0f : 1.0f);
+            convert_elements_sse2(source, destination, simd_count, fill, [zero, scale](const std::byte *data) {
+                __m128i bytes = _mm_cvtsi32_si128(load<int32_t>(data));
+                __m128i integers = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+                return _mm_mul_ps(_mm_cvtepi32_ps(integers), scale);
+            });
+            return simd_count;
+        }
+        case ComponentType::UNSIGNED_SHORT:
+        {
+            const __m128 scale = _mm_set1_ps(source.normalized ? 1.0f / 65535.0f : 1.0f);
+            convert_elements_sse2(source, destination, simd_count, fill, [zero, scale](const std::byte *data) {
+                __m128i shorts = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(data));
+                __m128i integers = _mm_unpacklo_epi16(shorts, zero);
+                return _mm_mul_ps(_mm_cvtepi32_ps(integers), scale);
+            });
+            return simd_count;
+        }
+        default:
+            return 0;
+    }
+}
+
+#endif
+
+} // namespace
+
+void convert_attribute(const AttributeSource &source, const AttributeDestination &destination, size_t count,
+                       float fill)
+{
+    assert(source.component_count >= 1 && source.component_count <= 4);
+    assert(destination.component_count >= 1 && destination.component_count <= 4);
+
+    size_t converted = 0;
+#ifdef FLOWFORGE_VERTEX_CONVERSION_SSE2
+    converted = convert_attribute_sse2(source, destination, count, fill);
+#endif
+
+    const size_t component_size = get_component_size(source.component_type);
+    for (size_t element = converted; element < count; element++)
+    {
+        const std::byte *input = source.data + element * source.stride;
+        auto *output = reinterpret_cast<float *>(reinterpret_cast<std::byte *>(destination.data) +
+                                                 element * destination.stride);
+        for (uint32_t component = 0; component < destination.component_count; component++)
+        {
+            output[component] = component < source.component_count
+                                        ? read_component(input + component * component_size, source.component_type,
+                                                         source.normalized)
+                                        : fill;
+        }
+    }
+}
+
+void convert_indices(const std::byte *data, size_t stride, ComponentType component_type, size_t count,
+                     uint32_t *destination)
+{
+    // Separate loops per type, which compilers vectorize for packed indices
+    switch (component_type)
+    {
+        case ComponentType::UNSIGNED_BYTE:
+            for (size_t index = 0; index < count; index++)
+            {
+                destination[index] = load<uint8_t>(data + index * stride);
+            }
+            break;
+        case ComponentType::UNSIGNED_SHORT:
+            for (size_t index = 0; index < count; index++)
+            {
+                destination[index] = load<uint16_t>(data + index * stride);
+            }
+            break;
+        case ComponentType::UNSIGNED_INT:
+            for (size_t index = 0; index < count; index++)
+            {
+                destination[index] = load<uint32_t>(data + index * stride);
+            }
+            break;
+        default:
+            throw std::runtime_error("Failed to convert indices, they have to be unsigned integers");
+    }
+}
+
+}// namespace flwfrg
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace flwfrg
+{
+
+/// How the components of an attribute are stored, with the values glTF uses for them
+enum class ComponentType : uint32_t
+{
+    BYTE = 5120,
+    UNSIGNED_BYTE = 5121,
+    SHORT = 5122,
+    UNSIGNED_SHORT = 5123,
+    UNSIGNED_INT = 5125,
+    FLOAT = 5126,
+};
+
+[[nodiscard]] constexpr size_t get_component_size(ComponentType component_type)
+{
+    switch (component_type)
+    {
+        case ComponentType::BYTE:
+        case ComponentType::UNSIGNED_BYTE:
+            return 1;
+        case ComponentType::SHORT:
+        case ComponentType::UNSIGNED_SHORT:
+            return 2;
+        case ComponentType::UNSIGNED_INT:
+        case ComponentType::FLOAT:
+            return 4;
+    }
+    return 0;
+}
+
+/// Interleaved or packed attribute data, one element every stride bytes
+struct AttributeSource
+{
+    const std::byte *data = nullptr;
+    size_t stride = 0;
+    ComponentType component_type = ComponentType::FLOAT;
+    uint32_t component_count = 0;
+    // Integers map to 0 to 1, or -1 to 1 when signed
+    bool normalized = false;
+};
+
+/// Floats, one element every stride bytes, such as a member of a vertex struct
+struct AttributeDestination
+{
+    float *data = nullptr;
+    size_t stride = 0;
+    uint32_t component_count = 0;
+};
+
+/// Converts count elements of an attribute to floats, e.g. from a glTF buffer into vertices, or from one vertex
+/// layout into another. Components the source lacks are set to fill, such as the alpha of RGB colors, and components
+/// the destination lacks are dropped. Floats and 8 and 16 bit unsigned integers with at least two components, which
+/// covers positions, colors and texture coordinates, are converted four components at a time with SSE2.
+void convert_attribute(const AttributeSource &source, const AttributeDestination &destination, size_t count,
+                       float fill = 0.0f);
+
+/// Widens 8, 16 or 32 bit unsigned indices, one every stride bytes
+void convert_indices(const std::byte *data, size_t stride, ComponentType component_type, size_t count,
+                     uint32_t *destination);
+
+}// namespace flwfrg
@@ -0,0 +1,630 @@
+#include "pch.hpp"
+
+#include "file_reader.hpp"
+
+#include "threading/thread_pool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define FLOWFORGE_IO_URING
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace flwfrg::io
+{
+
+namespace
+{
+
+// The kernel reads at most a little under 2 GiB at once, larger reads are split
+constexpr uint64_t max_read_size = 1ull << 30;
+
+std::string describe_error(int error)
+{
+    return std::generic_category().message(error);
+}
+
+std::string open_error(const ReadRequest &request, int error)
+{
+    return "Failed to open file: " + request.path.string() + ", " + describe_error(error);
+}
+
+std::string read_error(const ReadRequest &request, int error)
+{
+    return "Failed to read file: " + request.path.string() + ", " + describe_error(error);
+}
+
+// Where a request is read to, allocated when it did not bring memory of its own. Ranges reaching past the end of the
+// file are cut short, so the memory allocated is never more than the file holds.
+std::byte *prepare_destination(const ReadRequest &request, uint64_t file_size, ReadResult &result, uint64_t &size)
+{
+    uint64_t available = request.offset < file_size ? file_size - request.offset : 0;
+    size = std::min(request.size, available);
+    if (request.destination != nullptr)
+        return request.destination;
+
+    result.contents = FileContents::allocate(static_cast<size_t>(size));
+    return result.contents.data.get();
+}
+
+ReadResult read_with_pread(const ReadRequest &request)
+{
+    ReadResult result{};
+    uint64_t size = 0;
+
+#ifdef _WIN32
+    std::ifstream file(request.path, std::ios::ate | std::ios::binary);
+    if (!file.is_open())
+    {
+        result.error = "Failed to open file: " + request.path.string();
+        return result;
+    }
+
+    std::byte *destination = prepare_destination(request, static_cast<uint64_t>(file.tellg()), result, size);
+    file.seekg(static_cast<std::streamoff>(request.offset));
+    file.read(reinterpret_cast<char *>(destination), static_cast<std::streamsize>(size));
+    result.size = static_cast<uint64_t>(file.gcount());
+    if (file.bad())
+    {
+        result.error = "Failed to read file: " + request.path.string();
+    }
+#else
+    int file = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0)
+    {
+        result.error = open_error(request, errno);
+        return result;
+    }
+
+    struct stat status{};
+    if (fstat(file, &status) != 0)
+    {
+        result.error = open_error(request, errno);
+        close(file);
+        return result;
+    }
+
+    std::byte *destination = prepare_destination(request, static_cast<uint64_t>(status.st_size), result, size);
+    while (result.size < size)
+    {
+        ssize_t read_size = pread(file, destination + result.size, std::min(size - result.size, max_read_size),
+                                  static_cast<off_t>(request.offset + result.size));
+        if (read_size < 0 && errno == EINTR)
+            continue;
+        if (read_size < 0)
+        {
+            result.error = read_error(request, errno);
+            break;
+        }
+        // The file got shorter since it was opened
+        if (read_size == 0)
+            break;
+        result.size += static_cast<uint64_t>(read_size);
+    }
+    close(file);
+#endif
+
+    if (!result.succeeded())
+        result.contents = FileContents{};
+    return result;
+}
+
+} // namespace
+
+#ifdef FLOWFORGE_IO_URING
+
+/// An io_uring instance, set up and driven with the raw system calls
+struct FileReader::Ring
+{
+    int fd = -1;
+
+    void *sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void *cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+
+    // Queued in the submission ring, but not taken by the kernel yet
+    unsigned unsubmitted = 0;
+
+    /// @throws std::runtime_error When the kernel has no io_uring, or it is not allowed
+    explicit Ring(uint32_t entries)
+    {
+        io_uring_params params{};
+        fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+        {
+            throw std::runtime_error("Failed to set up io_uring, " + describe_error(errno));
+        }
+
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        // Both rings share one mapping on kernels since 5.4
+        bool single_mapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mapping)
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+        sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                       IORING_OFF_SQ_RING);
+        if (sq_ring == MAP_FAILED)
+        {
+            sq_ring = nullptr;
+            release();
+            throw std::runtime_error("Failed to map the io_uring submission ring");
+        }
+        if (single_mapping)
+        {
+            cq_ring = sq_ring;
+        }
+        else
+        {
+            cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                           IORING_OFF_CQ_RING);
+            if (cq_ring == MAP_FAILED)
+            {
+                cq_ring = nullptr;
+                release();
+                throw std::runtime_error("Failed to map the io_uring completion ring");
+            }
+        }
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqe_memory = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                                IORING_OFF_SQES);
+        if (sqe_memory == MAP_FAILED)
+        {
+            release();
+            throw std::runtime_error("Failed to map the io_uring submission entries");
+        }
+        sqes = static_cast<io_uring_sqe *>(sqe_memory);
+
+        auto *sq = static_cast<std::byte *>(sq_ring);
+        sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_entries = params.sq_entries;
+        auto *cq = static_cast<std::byte *>(cq_ring);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    }
+
+    ~Ring() { release(); }
+
+    Ring(const Ring &) = delete;
+    Ring &operator=(const Ring &) = delete;
+
+    void release()
+    {
+        if (sqes != nullptr)
+            munmap(sqes, sqes_size);
+        if (cq_ring != nullptr && cq_ring != sq_ring)
+            munmap(cq_ring, cq_ring_size);
+        if (sq_ring != nullptr)
+            munmap(sq_ring, sq_ring_size);
+        if (fd >= 0)
+            close(fd);
+        sqes = nullptr;
+        cq_ring = nullptr;
+        sq_ring = nullptr;
+        fd = -1;
+    }
+
+    /// Whether the kernel supports every operation the reader submits, which is the case since 5.6
+    [[nodiscard]] bool supports_operations() const
+    {
+        constexpr unsigned probe_op_count = 256;
+        std::vector<uint64_t> storage((sizeof(io_uring_probe) + probe_op_count * sizeof(io_uring_probe_op)) /
+                                              sizeof(uint64_t) + 1,
+                                      0);
+        auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+        // Probing came with 5.6 as well, so it failing means the operations are missing too
+        if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, probe_op_count) < 0)
+            return false;
+
+        for (unsigned operation: {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE})
+        {
+            if (operation > probe->last_op || (probe->ops[operation].flags & IO_URING_OP_SUPPORTED) == 0)
+                return false;
+        }
+        return true;
+    }
+
+    /// Submits operations 0 to count - 1, keeping as many in flight as the ring holds, and blocks until all of them
+    /// are complete. prepare fills in the entry of an operation, and complete gets its result and returns whether to
+    /// submit it again, e.g. for the rest of a short read. Neither may throw, the kernel still writes to what the
+    /// operations in flight point at.
+    /// @throws std::runtime_error When io_uring_enter fails, once the operations in flight are complete. The ring
+    /// is left with entries it never took and should not be used again.
+    void run(size_t count, const std::function<void(size_t, io_uring_sqe &)> &prepare,
+             const std::function<bool(size_t, int32_t)> &complete)
+    {
+        std::vector<size_t> resubmissions{};
+        size_t next = 0;
+        unsigned in_flight = 0;
+        while (next < count || !resubmissions.empty() || in_flight > 0 || unsubmitted > 0)
+        {
+            // The completion ring holds twice the submission ring, so it cannot overflow with this many in flight
+            unsigned tail = *sq_tail;
+            while (in_flight + unsubmitted < sq_entries && (next < count || !resubmissions.empty()))
+            {
+                size_t operation = next;
+                if (!resubmissions.empty())
+                {
+                    operation = resubmissions.back();
+                    resubmissions.pop_back();
+                }
+                else
+                {
+                    next++;
+                }
+
+                unsigned slot = tail & sq_mask;
+                io_uring_sqe &sqe = sqes[slot];
+                std::memset(&sqe, 0, sizeof(sqe));
+                prepare(operation, sqe);
+                sqe.user_data = operation;
+                sq_array[slot] = slot;
+                tail++;
+                unsubmitted++;
+            }
+            std::atomic_ref<unsigned>(*sq_tail).store(tail, std::memory_order_release);
+
+            unsigned submitted = 0;
+            try
+            {
+                submitted = enter(unsubmitted, in_flight + unsubmitted > 0 ? 1 : 0);
+            } catch (const std::runtime_error &)
+            {
+                wait_for_in_flight(in_flight, complete);
+                throw;
+            }
+            unsubmitted -= submitted;
+            in_flight += submitted;
+
+            unsigned head = *cq_head;
+            unsigned completed_tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+            for (; head != completed_tail; head++)
+            {
+                const io_uring_cqe &cqe = cqes[head & cq_mask];
+                in_flight--;
+                if (complete(static_cast<size_t>(cqe.user_data), cqe.res))
+                    resubmissions.push_back(static_cast<size_t>(cqe.user_data));
+            }
+            std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+        }
+    }
+
+    // Completes operations without submitting any again until none is in flight anymore, so the caller can free
+    // what they point at
+    void wait_for_in_flight(unsigned in_flight, const std::function<bool(size_t, int32_t)> &complete) const
+    {
+        while (true)
+        {
+            unsigned head = *cq_head;
+            unsigned completed_tail = std::atomic_ref<unsigned>(*cq_tail).load(std::memory_order_acquire);
+            for (; head != completed_tail && in_flight > 0; head++)
+            {
+                const io_uring_cqe &cqe = cqes[head & cq_mask];
+                in_flight--;
+                complete(static_cast<size_t>(cqe.user_data), cqe.res);
+            }
+            std::atomic_ref<unsigned>(*cq_head).store(head, std::memory_order_release);
+            if (in_flight == 0)
+                return;
+
+            // Nothing is left to wait with if waiting fails as well
+            if (syscall(__NR_io_uring_enter, fd, 0, in_flight, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+                errno != EINTR)
+            {
+                FLOWFORGE_ERROR("Failed to wait for {} io_uring operations, {}", in_flight, describe_error(errno));
+                return;
+            }
+        }
+    }
+
+    unsigned enter(unsigned submit_count, unsigned wait_count) const
+    {
+        while (true)
+        {
+            long submitted = syscall(__NR_io_uring_enter, fd, submit_count, wait_count, IORING_ENTER_GETEVENTS,
+                                     nullptr, 0);
+            if (submitted >= 0)
+                return static_cast<unsigned>(submitted);
+            // Interrupted before anything was submitted
+            if (errno != EINTR)
+            {
+                throw std::runtime_error("Failed to submit to io_uring, " + describe_error(errno));
+            }
+        }
+    }
+};
+
+#else
+
+struct FileReader::Ring
+{
+};
+
+#endif
+
+FileReader::FileReader(Config config)
+    : config_{config}
+{
+#ifdef FLOWFORGE_IO_URING
+    if (config_.backend != Backend::THREAD_POOL)
+    {
+        try
+        {
+            ring_ = std::make_unique<Ring>(config_.queue_depth);
+            if (!ring_->supports_operations())
+            {
+                throw std::runtime_error("Failed to set up io_uring, the kernel is older than 5.6");
+            }
+            backend_ = Backend::IO_URING;
+        } catch (const std::runtime_error &e)
+        {
+            ring_.reset();
+            if (config_.backend == Backend::IO_URING)
+                throw;
+            FLOWFORGE_TRACE("{}, reading files on a thread pool instead", e.what());
+        }
+    }
+#else
+    if (config_.backend == Backend::IO_URING)
+    {
+        throw std::runtime_error("Failed to set up io_uring, it is only available on Linux");
+    }
+#endif
+}
+
+FileReader::~FileReader() = default;
+
+FileReader::FileReader(FileReader &&other) noexcept = default;
+
+FileReader &FileReader::operator=(FileReader &&other) noexcept = default;
+
+std::vector<ReadResult> FileReader::read(std::span<const ReadRequest> requests)
+{
+    if (requests.empty())
+        return {};
+
+#ifdef FLOWFORGE_IO_URING
+    if (backend_ == Backend::IO_URING)
+    {
+        try
+        {
+            return read_with_ring(requests);
+        } catch (const std::runtime_error &e)
+        {
+            // The ring is stale after a failed submission, so the whole batch is read again without it
+            FLOWFORGE_WARN("{}, reading files on a thread pool from now on", e.what());
+            ring_.reset();
+            backend_ = Backend::THREAD_POOL;
+        }
+    }
+#endif
+    return read_with_threads(requests);
+}
+
+#ifdef FLOWFORGE_IO_URING
+
+std::vector<ReadResult> FileReader::read_with_ring(std::span<const ReadRequest> requests)
+{
+    // Every file of a chunk is open until its reads are done, so chunks keep the open files to the queue depth
+    // instead of running into the open file limit with thousands of files
+    std::vector<ReadResult> results(requests.size());
+    size_t chunk_size = std::max<size_t>(config_.queue_depth, 1);
+    for (size_t first = 0; first < requests.size(); first += chunk_size)
+    {
+        size_t count = std::min(chunk_size, requests.size() - first);
+        read_chunk_with_ring(requests.subspan(first, count), std::span{results}.subspan(first, count));
+    }
+    return results;
+}
+
+void FileReader::read_chunk_with_ring(std::span<const ReadRequest> requests, std::span<ReadResult> results)
+{
+    struct PendingRead
+    {
+        int file = -1;
+        std::byte *destination = nullptr;
+        uint64_t size = 0;
+    };
+
+    std::vector<PendingRead> reads(requests.size());
+    std::vector<struct statx> statuses(requests.size());
+    // Closes the files the ring did not get to, when a submission fails
+    struct OpenFiles
+    {
+        std::vector<PendingRead> &reads;
+        ~OpenFiles()
+        {
+            for (const PendingRead &read: reads)
+            {
+                if (read.file >= 0)
+                    close(read.file);
+            }
+        }
+    } open_files{reads};
+
+    // Every file is opened and has its size looked up in one submission, two operations per file
+    ring_->run(
+            requests.size() * 2,
+            [&](size_t operation, io_uring_sqe &sqe) {
+                size_t request = operation / 2;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uintptr_t>(requests[request].path.c_str());
+                if (operation % 2 == 0)
+                {
+                    sqe.opcode = IORING_OP_OPENAT;
+                    sqe.open_flags = O_RDONLY | O_CLOEXEC;
+                }
+                else
+                {
+                    sqe.opcode = IORING_OP_STATX;
+                    sqe.len = STATX_SIZE;
+                    sqe.off = reinterpret_cast<uintptr_t>(&statuses[request]);
+                }
+            },
+            [&](size_t operation, int32_t result) {
+                size_t request = operation / 2;
+                if (result == -EINTR || result == -EAGAIN)
+                    return true;
+                if (result < 0 && results[request].succeeded())
+                    results[request].error = open_error(requests[request], -result);
+                else if (result >= 0 && operation % 2 == 0)
+                    reads[request].file = result;
+                return false;
+            });
+
+    std::vector<size_t> pending{};
+    for (size_t request = 0; request < requests.size(); request++)
+    {
+        if (!results[request].succeeded())
+            continue;
+
+        PendingRead &read = reads[request];
+        read.destination = prepare_destination(requests[request], statuses[request].stx_size, results[request],
+                                               read.size);
+        if (read.size > 0)
+            pending.push_back(request);
+    }
+
+    // Then every read in one submission
+    ring_->run(
+            pending.size(),
+            [&](size_t operation, io_uring_sqe &sqe) {
+                size_t request = pending[operation];
+                const PendingRead &read = reads[request];
+                uint64_t done = results[request].size;
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = read.file;
+                sqe.off = requests[request].offset + done;
+                sqe.addr = reinterpret_cast<uintptr_t>(read.destination + done);
+                sqe.len = static_cast<uint32_t>(std::min(read.size - done, max_read_size));
+            },
+            [&](size_t operation, int32_t result) {
+                size_t request = pending[operation];
+                if (result == -EINTR || result == -EAGAIN)
+                    return true;
+                if (result < 0)
+                {
+                    results[request].error = read_error(requests[request], -result);
+                    return false;
+                }
+                // Nothing read means the file got shorter since it was opened
+                results[request].size += static_cast<uint64_t>(result);
+                return result > 0 && results[request].size < reads[request].size;
+            });
+
+    // And every close in one submission
+    std::vector<size_t> open_requests{};
+    for (size_t request = 0; request < requests.size(); request++)
+    {
+        if (reads[request].file >= 0)
+            open_requests.push_back(request);
+    }
+    ring_->run(
+            open_requests.size(),
+            [&](size_t operation, io_uring_sqe &sqe) {
+                sqe.opcode = IORING_OP_CLOSE;
+                sqe.fd = reads[open_requests[operation]].file;
+            },
+            [&](size_t operation, int32_t) {
+                reads[open_requests[operation]].file = -1;
+                return false;
+            });
+
+    for (ReadResult &result: results)
+    {
+        if (!result.succeeded())
+            result.contents = FileContents{};
+    }
+}
+
+#endif
+
+std::vector<ReadResult> FileReader::read_with_threads(std::span<const ReadRequest> requests)
+{
+    std::vector<ReadResult> results(requests.size());
+    if (requests.size() == 1)
+    {
+        results[0] = read_with_pread(requests[0]);
+        return results;
+    }
+
+    if (threads_ == nullptr)
+        threads_ = std::make_unique<ThreadPool>(config_.thread_count);
+    threads_->parallel_for(requests.size(), [&](size_t request) {
+        results[request] = read_with_pread(requests[request]);
+    });
+    return results;
+}
+
+namespace
+{
+
+FileReader &get_thread_reader()
+{
+    // A reader is used by one thread at a time, so every thread gets one of its own
+    thread_local FileReader reader{};
+    return reader;
+}
+
+} // namespace
+
+FileContents read_file(const std::filesystem::path &path)
+{
+    ReadRequest request{.path = path};
+    ReadResult result = std::move(get_thread_reader().read({&request, 1}).front());
+    if (!result.succeeded())
+    {
+        throw std::runtime_error(result.error);
+    }
+
+    // The file may have gotten shorter while it was read
+    result.contents.size = static_cast<size_t>(result.size);
+    return std::move(result.contents);
+}
+
+std::vector<ReadResult> read_files(std::span<const std::filesystem::path> paths)
+{
+    std::vector<ReadRequest> requests{};
+    requests.reserve(paths.size());
+    for (const auto &path: paths)
+    {
+        requests.push_back(ReadRequest{.path = path});
+    }
+    return get_thread_reader().read(requests);
+}
+
+}// namespace flwfrg::io
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "import/file_contents.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace flwfrg
+{
+class ThreadPool;
+}
+
+namespace flwfrg::io
+{
+
+constexpr uint64_t whole_file = std::numeric_limits<uint64_t>::max();
+
+/// A file, or a range of one, to read
+struct ReadRequest
+{
+    std::filesystem::path path;
+    uint64_t offset = 0;
+    // Bytes to read from offset on, whole_file for everything up to the end of the file
+    uint64_t size = whole_file;
+    // Memory to read into, at least size bytes. When nullptr the reader allocates memory of the right size for the
+    // read.
+    std::byte *destination = nullptr;
+};
+
+struct ReadResult
+{
+    // The memory the reader allocated, empty when the request had a destination
+    FileContents contents{};
+    // Bytes read, fewer than requested only when the file ends first
+    uint64_t size = 0;
+    // Why the read failed, empty when it succeeded
+    std::string error{};
+
+    [[nodiscard]] inline bool succeeded() const { return error.empty(); };
+};
+
+enum class Backend
+{
+    // io_uring when the kernel supports every operation used, the thread pool otherwise
+    AUTOMATIC,
+    IO_URING,
+    THREAD_POOL
+};
+
+/// Reads many files at once. With io_uring the opens, reads and closes of up to queue depth files are each queued in
+/// one submission, so reading thousands of small files takes a few system calls instead of several per file. Elsewhere,
+/// or on kernels without io_uring, the files are read with pread spread over a pool of threads.
+///
+/// A reader is used by one thread at a time. read_file uses a reader of the calling thread's own.
+class FileReader
+{
+public:
+    struct Config
+    {
+        Backend backend = Backend::AUTOMATIC;
+        // Operations in flight at once with io_uring, the rest are queued as earlier ones complete. Also the most
+        // files open at once, so it should stay well below the open file limit.
+        uint32_t queue_depth = 256;
+        // Threads reading at once without io_uring, created on the first batch of more than one file
+        size_t thread_count = 4;
+    };
+
+public:
+    FileReader() : FileReader(Config{}) {}
+    /// @throws std::runtime_error When io_uring is asked for and cannot be used
+    explicit FileReader(Config config);
+    ~FileReader();
+
+    // Copy
+    FileReader(const FileReader &) = delete;
+    FileReader &operator=(const FileReader &) = delete;
+    // Move
+    FileReader(FileReader &&other) noexcept;
+    FileReader &operator=(FileReader &&other) noexcept;
+
+    // Methods
+
+    /// Reads every request and blocks until all of them are done. A request failing does not stop the others. When
+    /// io_uring itself fails, the batch and every later one are read on the thread pool instead.
+    /// @return One result per request, in request order
+    [[nodiscard]] std::vector<ReadResult> read(std::span<const ReadRequest> requests);
+
+    [[nodiscard]] inline Backend get_backend() const { return backend_; };
+
+private:
+    struct Ring;
+
+    Backend backend_ = Backend::THREAD_POOL;
+    Config config_{};
+    std::unique_ptr<Ring> ring_{};
+    // Created on the first batch of more than one file, without io_uring
+    std::unique_ptr<ThreadPool> threads_{};
+
+    std::vector<ReadResult> read_with_ring(std::span<const ReadRequest> requests);
+    void read_chunk_with_ring(std::span<const ReadRequest> requests, std::span<ReadResult> results);
+    std::vector<ReadResult> read_with_threads(std::span<const ReadRequest> requests);
+};
+
+/// Reads a whole file with the calling thread's reader
+/// @throws std::runtime_error When the file cannot be opened or read
+[[nodiscard]] FileContents read_file(const std::filesystem::path &path);
+
+/// Reads whole files in one batch with the calling thread's reader
+/// @return One result per path, in path order
+[[nodiscard]] std::vector<ReadResult> read_files(std::span<const std::filesystem::path> paths);
+
+}// namespace flwfrg::io
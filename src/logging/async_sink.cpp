@@ -0,0 +1,191 @@
+#include "pch.hpp"
+
+#include "async_sink.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <string>
+#include <utility>
+
+namespace flwfrg
+{
+
+AsyncSink::AsyncSink(std::vector<spdlog::sink_ptr> sinks, size_t capacity, std::chrono::milliseconds flush_interval)
+    : sinks_{std::move(sinks)},
+      capacity_{std::bit_ceil(std::max<uint64_t>(capacity, 2))},
+      flush_interval_{flush_interval}
+{
+    slots_ = std::make_unique<Slot[]>(capacity_);
+    for (uint64_t slot = 0; slot < capacity_; slot++)
+    {
+        slots_[slot].sequence.store(slot, std::memory_order_relaxed);
+    }
+
+    worker_ = std::thread([this]() { worker_loop(); });
+}
+
+AsyncSink::~AsyncSink()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    worker_.join();
+}
+
+void AsyncSink::log(const spdlog::details::log_msg &message)
+{
+    uint64_t position = tail_.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    while (true)
+    {
+        slot = &slots_[position & (capacity_ - 1)];
+        auto difference = static_cast<int64_t>(slot->sequence.load(std::memory_order_acquire) - position);
+        if (difference == 0)
+        {
+            if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0)
+        {
+            // Full, the background thread has not caught up with the slot a whole lap ago. Critical messages are the
+            // last words before a crash, so they wait for room instead of being dropped.
+            if (message.level >= spdlog::level::critical)
+            {
+                condition_.notify_all();
+                std::this_thread::yield();
+                position = tail_.load(std::memory_order_relaxed);
+                continue;
+            }
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            // Another producer took the slot first
+            position = tail_.load(std::memory_order_relaxed);
+        }
+    }
+
+    // The message only points at the caller's memory, so it is copied into the slot
+    slot->message = spdlog::details::log_msg_buffer{message};
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+void AsyncSink::flush()
+{
+    // Everything claimed so far is written before the flush completes, also slots producers are still filling in
+    uint64_t position = tail_.load(std::memory_order_acquire);
+
+    std::unique_lock lock{mutex_};
+    flush_position_ = std::max(flush_position_, position);
+    uint64_t flush = ++flushes_requested_;
+    condition_.notify_all();
+    condition_.wait(lock, [&]() { return flushes_completed_ >= flush; });
+}
+
+void AsyncSink::set_pattern(const std::string &pattern)
+{
+    for (auto &sink: sinks_)
+    {
+        sink->set_pattern(pattern);
+    }
+}
+
+void AsyncSink::set_formatter(std::unique_ptr<spdlog::formatter> formatter)
+{
+    for (auto &sink: sinks_)
+    {
+        sink->set_formatter(formatter->clone());
+    }
+}
+
+void AsyncSink::worker_loop()
+{
+    std::unique_lock lock{mutex_};
+    while (true)
+    {
+        uint64_t flushes_requested = flushes_requested_;
+        uint64_t flush_position = flush_position_;
+        bool stopping = stopping_;
+        lock.unlock();
+
+        // Nothing logs anymore once the sink is being destroyed, so everything claimed is written before stopping
+        if (stopping)
+            flush_position = tail_.load(std::memory_order_acquire);
+
+        // drain stops in front of a slot that is claimed but not filled in yet, which the flush still has to wait for
+        bool written = drain();
+        bool caught_up = head_ >= flush_position;
+        bool flushing = flushes_requested != flushes_completed_;
+        if (written || (caught_up && (flushing || stopping)))
+        {
+            for (auto &sink: sinks_)
+            {
+                sink->flush();
+            }
+        }
+
+        lock.lock();
+        if (caught_up && flushing)
+        {
+            flushes_completed_ = flushes_requested;
+            condition_.notify_all();
+        }
+        if (caught_up && stopping)
+            break;
+
+        // The producer is in the middle of copying its message, so it is done in a moment
+        if (!caught_up)
+        {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+            continue;
+        }
+
+        condition_.wait_for(lock, flush_interval_,
+                            [&]() { return stopping_ || flushes_requested_ != flushes_requested; });
+    }
+}
+
+bool AsyncSink::drain()
+{
+    bool written = false;
+    while (true)
+    {
+        Slot &slot = slots_[head_ & (capacity_ - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != head_ + 1)
+            break;
+
+        for (auto &sink: sinks_)
+        {
+            if (sink->should_log(slot.message.level))
+                sink->log(slot.message);
+        }
+        // Free for the producers again, one lap later
+        slot.sequence.store(head_ + capacity_, std::memory_order_release);
+        head_++;
+        written = true;
+    }
+
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped_)
+    {
+        std::string text = "Dropped " + std::to_string(dropped - reported_dropped_) +
+                           " log messages, the log queue was full";
+        spdlog::details::log_msg message{spdlog::string_view_t{}, spdlog::level::warn, text};
+        for (auto &sink: sinks_)
+        {
+            if (sink->should_log(message.level))
+                sink->log(message);
+        }
+        reported_dropped_ = dropped;
+        written = true;
+    }
+
+    return written;
+}
+
+}// namespace flwfrg
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/sinks/sink.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flwfrg
+{
+
+/// A sink handing messages to a background thread, which formats them and writes them to the sinks it wraps.
+///
+/// Logging costs the calling thread a copy of the message into a bounded lock-free queue, without taking a lock or
+/// touching I/O, and without allocating for messages up to 250 bytes. When the queue is full the message is dropped
+/// and counted instead of waiting for room, and the count is logged once there is room again. Only critical messages
+/// wait for room. The background thread writes what is queued every flush interval.
+class AsyncSink final : public spdlog::sinks::sink
+{
+public:
+    /// @param capacity Messages queued at most, rounded up to a power of two
+    AsyncSink(std::vector<spdlog::sink_ptr> sinks, size_t capacity, std::chrono::milliseconds flush_interval);
+    /// Writes everything still queued
+    ~AsyncSink() override;
+
+    // Not copyable or movable, the background thread holds a pointer to the sink
+    AsyncSink(const AsyncSink &) = delete;
+    AsyncSink &operator=(const AsyncSink &) = delete;
+    AsyncSink(AsyncSink &&) = delete;
+    AsyncSink &operator=(AsyncSink &&) = delete;
+
+    // Methods
+
+    void log(const spdlog::details::log_msg &message) override;
+    /// Blocks until everything logged before the call is written, and the wrapped sinks are flushed
+    void flush() override;
+    void set_pattern(const std::string &pattern) override;
+    void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+    [[nodiscard]] inline uint64_t get_dropped_count() const { return dropped_.load(std::memory_order_relaxed); };
+
+private:
+    // A slot is free for the producer at position p when its sequence is p, and holds a message for the consumer at
+    // position p when its sequence is p + 1
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        spdlog::details::log_msg_buffer message{};
+    };
+
+    std::vector<spdlog::sink_ptr> sinks_{};
+    std::unique_ptr<Slot[]> slots_{};
+    uint64_t capacity_ = 0;
+
+    // On lines of their own, the producers contend on tail_ while only the background thread touches head_
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    alignas(64) uint64_t head_ = 0;
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t reported_dropped_ = 0;
+
+    std::chrono::milliseconds flush_interval_{};
+    // Only for waking the background thread early and waiting on it, never taken by log
+    std::mutex mutex_{};
+    std::condition_variable condition_{};
+    uint64_t flushes_requested_ = 0;
+    uint64_t flushes_completed_ = 0;
+    // The queue position the latest flush waits for the background thread to reach
+    uint64_t flush_position_ = 0;
+    bool stopping_ = false;
+
+    // Last, so it starts once everything it uses is initialized
+    std::thread worker_{};
+
+    void worker_loop();
+    /// Writes every queued message, on the background thread
+    /// @return Whether anything was written
+    bool drain();
+};
+
+}// namespace flwfrg
@@ -1,19 +1,35 @@
 #include "logger.hpp"
 
+#include "async_sink.hpp"
+
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 namespace flwfrg
 {
 std::shared_ptr<spdlog::logger> Logger::core_logger_s;
 
-void Logger::init()
+void Logger::init(Config config)
 {
 	// TODO: Make better custom pattern
 	spdlog::set_pattern("%^[%T](%s:%#) %n[%l]: %v%$");
-	core_logger_s = spdlog::stdout_color_mt("FLOWFORGE");
+
+	spdlog::sink_ptr console_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+	if (config.async)
+	{
+		auto async_sink = std::make_shared<AsyncSink>(std::vector<spdlog::sink_ptr>{console_sink}, config.queue_capacity,
+													  config.flush_interval);
+		core_logger_s = std::make_shared<spdlog::logger>("FLOWFORGE", std::move(async_sink));
+	} else
+	{
+		core_logger_s = std::make_shared<spdlog::logger>("FLOWFORGE", std::move(console_sink));
+	}
+	// Registers the logger and gives it the pattern
+	spdlog::initialize_logger(core_logger_s);
 	core_logger_s->set_level(spdlog::level::trace);
+	// Written before the call returns, as it may be the last thing the program does
+	core_logger_s->flush_on(spdlog::level::critical);
 
-	FLOWFORGE_INFO("Logger initialized successfully");
+	FLOWFORGE_INFO("Logger initialized successfully{}", config.async ? ", logging asynchronously" : "");
 }
 
-}// namespace flwfrg
\ No newline at end of file
+}// namespace flwfrg
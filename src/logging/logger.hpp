@@ -1,8 +1,15 @@
 #pragma once
-// Set the logger to log all, so flwfrg can decide what to log itself.
+// The lowest level compiled in, set with the FLOWFORGE_LOG_LEVEL CMake option. Without it everything is compiled in,
+// so flwfrg can decide what to log itself.
+#ifndef SPDLOG_ACTIVE_LEVEL
 #define SPDLOG_ACTIVE_LEVEL 0
+#endif
 
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
 #include <memory>
 
 #include <spdlog/spdlog.h>
@@ -19,11 +26,53 @@ private:
 	static std::shared_ptr<spdlog::logger> core_logger_s;
 
 public:
-	static void init();
+	struct Config
+	{
+		// Messages are written by a background thread (see AsyncSink), so logging costs the caller a copy into a
+		// queue instead of formatting and console output. Critical messages are still written before the call returns.
+		bool async = true;
+		// Messages queued at most in async mode, more are dropped and counted
+		size_t queue_capacity = 8192;
+		// How often the background thread writes what is queued
+		std::chrono::milliseconds flush_interval{10};
+	};
+
+public:
+	static void init() { init(Config{}); };
+	static void init(Config config);
 
 	inline static std::shared_ptr<spdlog::logger> &get_core_logger() { return core_logger_s; };
 };
 
+/// Lets one message through per interval, for messages that would otherwise repeat every frame. Lock-free, so it can
+/// be shared by threads.
+class LogRateLimiter
+{
+public:
+	explicit LogRateLimiter(std::chrono::steady_clock::duration interval = std::chrono::seconds(1))
+		: interval_{interval.count()}
+	{}
+
+	/// Whether to log now. The calls turned down are counted, and the count is handed to the next call let through.
+	inline bool try_acquire(uint64_t &suppressed_count)
+	{
+		int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+		int64_t next = next_allowed_.load(std::memory_order_relaxed);
+		if (now < next || !next_allowed_.compare_exchange_strong(next, now + interval_, std::memory_order_relaxed))
+		{
+			suppressed_count_.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		suppressed_count = suppressed_count_.exchange(0, std::memory_order_relaxed);
+		return true;
+	}
+
+private:
+	int64_t interval_;
+	std::atomic<int64_t> next_allowed_{std::numeric_limits<int64_t>::min()};
+	std::atomic<uint64_t> suppressed_count_{0};
+};
+
 }// namespace flwfrg
 
 #define FLOWFORGE_TRACE(...) SPDLOG_LOGGER_TRACE(flwfrg::Logger::get_core_logger(), __VA_ARGS__)
@@ -31,3 +80,29 @@ public:
 #define FLOWFORGE_WARN(...) SPDLOG_LOGGER_WARN(flwfrg::Logger::get_core_logger(), __VA_ARGS__)
 #define FLOWFORGE_ERROR(...) SPDLOG_LOGGER_ERROR(flwfrg::Logger::get_core_logger(), __VA_ARGS__)
 #define FLOWFORGE_FATAL(...) SPDLOG_LOGGER_CRITICAL(flwfrg::Logger::get_core_logger(), __VA_ARGS__)
+
+// Log at most once per second from the call site, with the number of messages suppressed since the last one
+#define FLOWFORGE_LOG_RATE_LIMITED_IMPL(LOG_MACRO, ...) \
+	do \
+	{ \
+		static flwfrg::LogRateLimiter flowforge_rate_limiter{}; \
+		uint64_t flowforge_suppressed_count = 0; \
+		if (flowforge_rate_limiter.try_acquire(flowforge_suppressed_count)) \
+		{ \
+			if (flowforge_suppressed_count == 0) \
+				LOG_MACRO(__VA_ARGS__); \
+			else \
+				LOG_MACRO("{} ({} more suppressed)", fmt::format(__VA_ARGS__), flowforge_suppressed_count); \
+		} \
+	} while (false)
+
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_WARN
+#define FLOWFORGE_WARN_RATE_LIMITED(...) FLOWFORGE_LOG_RATE_LIMITED_IMPL(FLOWFORGE_WARN, __VA_ARGS__)
+#else
+#define FLOWFORGE_WARN_RATE_LIMITED(...) (void) 0
+#endif
+#if SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_ERROR
+#define FLOWFORGE_ERROR_RATE_LIMITED(...) FLOWFORGE_LOG_RATE_LIMITED_IMPL(FLOWFORGE_ERROR, __VA_ARGS__)
+#else
+#define FLOWFORGE_ERROR_RATE_LIMITED(...) (void) 0
+#endif
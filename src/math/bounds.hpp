@@ -0,0 +1,123 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace flwfrg
+{
+
+// Axis aligned bounding box. Default constructed it is empty, and expanding it by anything gives that thing's bounds.
+struct AABB
+{
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+
+    template<typename VertexType>
+    [[nodiscard]] static AABB from_vertices(const std::vector<VertexType> &vertices)
+    {
+        AABB bounds{};
+        for (const auto &vertex: vertices)
+        {
+            bounds.expand(vertex.position);
+        }
+        return bounds;
+    }
+
+    inline void expand(const glm::vec3 &point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+    inline void expand(const AABB &other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    [[nodiscard]] inline bool is_empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+    [[nodiscard]] inline glm::vec3 center() const { return (min + max) * 0.5f; }
+    // Half the size along each axis
+    [[nodiscard]] inline glm::vec3 extent() const { return (max - min) * 0.5f; }
+    [[nodiscard]] inline float surface_area() const
+    {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    [[nodiscard]] inline bool contains(const AABB &other) const
+    {
+        return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+    }
+    [[nodiscard]] inline bool intersects(const AABB &other) const
+    {
+        return glm::all(glm::lessThanEqual(min, other.max)) && glm::all(glm::greaterThanEqual(max, other.min));
+    }
+
+    [[nodiscard]] inline AABB enlarged(float margin) const { return AABB{min - glm::vec3{margin}, max + glm::vec3{margin}}; }
+
+    /// Bounds of the box after an affine transform (Arvo 1990), which are looser than the bounds of the transformed
+    /// contents once rotated
+    [[nodiscard]] inline AABB transformed(const glm::mat4 &transform) const
+    {
+        glm::vec3 new_center = glm::vec3{transform * glm::vec4{center(), 1.0f}};
+        glm::mat3 absolute{glm::abs(glm::vec3{transform[0]}), glm::abs(glm::vec3{transform[1]}),
+                           glm::abs(glm::vec3{transform[2]})};
+        glm::vec3 new_extent = absolute * extent();
+        return AABB{new_center - new_extent, new_center + new_extent};
+    }
+};
+
+struct BoundingSphere
+{
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+
+    /// Centered on the box, not minimal but close for most meshes
+    template<typename VertexType>
+    [[nodiscard]] static BoundingSphere from_vertices(const std::vector<VertexType> &vertices, const AABB &bounds)
+    {
+        BoundingSphere sphere{bounds.center(), 0.0f};
+        for (const auto &vertex: vertices)
+        {
+            sphere.radius = std::max(sphere.radius, glm::length(vertex.position - sphere.center));
+        }
+        return sphere;
+    }
+
+    /// Scales the radius by the largest scale of the transform, so the sphere still covers its contents
+    [[nodiscard]] inline BoundingSphere transformed(const glm::mat4 &transform) const
+    {
+        float max_scale = std::max({glm::length(glm::vec3{transform[0]}), glm::length(glm::vec3{transform[1]}),
+                                    glm::length(glm::vec3{transform[2]})});
+        return BoundingSphere{glm::vec3{transform * glm::vec4{center, 1.0f}}, radius * max_scale};
+    }
+};
+
+struct Ray
+{
+    glm::vec3 origin{0.0f};
+    // Does not have to be normalized, distances along the ray are then in multiples of its length
+    glm::vec3 direction{0.0f, 0.0f, 1.0f};
+
+    /// Distance along the ray where it enters the box (slab test), negative when it does not hit the box. Starting
+    /// inside the box counts as entering it at 0.
+    [[nodiscard]] inline float intersect(const AABB &bounds, float max_distance) const
+    {
+        glm::vec3 inverse_direction = 1.0f / direction;
+        glm::vec3 t0 = (bounds.min - origin) * inverse_direction;
+        glm::vec3 t1 = (bounds.max - origin) * inverse_direction;
+        glm::vec3 t_near = glm::min(t0, t1);
+        glm::vec3 t_far = glm::max(t0, t1);
+
+        float enter = std::max({t_near.x, t_near.y, t_near.z, 0.0f});
+        float exit = std::min({t_far.x, t_far.y, t_far.z, max_distance});
+        return enter <= exit ? enter : -1.0f;
+    }
+};
+
+}// namespace flwfrg
@@ -0,0 +1,380 @@
+#include "pch.hpp"
+
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+inline AABB merge(const AABB &first, const AABB &second)
+{
+    AABB merged = first;
+    merged.expand(second);
+    return merged;
+}
+
+}// namespace
+
+Bvh::Bvh(float margin) : margin_{margin}
+{
+    assert(margin_ >= 0.0f);
+}
+
+Bvh::proxy_id_t Bvh::insert(const AABB &bounds, int32_t user_data)
+{
+    assert(!bounds.is_empty());
+
+    int32_t leaf = allocate_node();
+    nodes_[leaf].bounds = bounds.enlarged(margin_);
+    nodes_[leaf].tight_bounds = bounds;
+    nodes_[leaf].user_data = user_data;
+    nodes_[leaf].height = 0;
+    insert_leaf(leaf);
+
+    proxy_count_++;
+    return leaf;
+}
+
+void Bvh::remove(proxy_id_t proxy)
+{
+    assert(is_leaf(proxy));
+
+    remove_leaf(proxy);
+    free_node(proxy);
+    proxy_count_--;
+}
+
+bool Bvh::update(proxy_id_t proxy, const AABB &bounds)
+{
+    assert(is_leaf(proxy));
+    assert(!bounds.is_empty());
+
+    nodes_[proxy].tight_bounds = bounds;
+
+    // Still inside its leaf, and the leaf is not much larger than needed anymore
+    const AABB &leaf_bounds = nodes_[proxy].bounds;
+    if (leaf_bounds.contains(bounds) && bounds.enlarged(margin_ * 4.0f).contains(leaf_bounds))
+        return false;
+
+    remove_leaf(proxy);
+    nodes_[proxy].bounds = bounds.enlarged(margin_);
+    insert_leaf(proxy);
+    return true;
+}
+
+void Bvh::query(const Frustum &frustum, std::vector<int32_t> &results) const
+{
+    if (root_ == null_node)
+        return;
+
+    std::vector<int32_t> stack{};
+    stack.reserve(64);
+    // Subtrees entirely in the frustum are gathered without testing them any further
+    std::vector<int32_t> inside_stack{};
+
+    stack.push_back(root_);
+    while (!stack.empty())
+    {
+        const Node &node = nodes_[stack.back()];
+        stack.pop_back();
+
+        if (node.is_leaf())
+        {
+            if (frustum.intersects(node.tight_bounds))
+                results.push_back(node.user_data);
+            continue;
+        }
+
+        Frustum::Intersection intersection = frustum.test(node.bounds);
+        if (intersection == Frustum::Intersection::INTERSECTING)
+        {
+            stack.push_back(node.children[0]);
+            stack.push_back(node.children[1]);
+        }
+        else if (intersection == Frustum::Intersection::INSIDE)
+        {
+            inside_stack.push_back(node.children[0]);
+            inside_stack.push_back(node.children[1]);
+            while (!inside_stack.empty())
+            {
+                const Node &inside_node = nodes_[inside_stack.back()];
+                inside_stack.pop_back();
+
+                if (inside_node.is_leaf())
+                {
+                    results.push_back(inside_node.user_data);
+                    continue;
+                }
+                inside_stack.push_back(inside_node.children[0]);
+                inside_stack.push_back(inside_node.children[1]);
+            }
+        }
+    }
+}
+
+void Bvh::query(const AABB &bounds, std::vector<int32_t> &results) const
+{
+    if (root_ == null_node)
+        return;
+
+    std::vector<int32_t> stack{};
+    stack.reserve(64);
+
+    stack.push_back(root_);
+    while (!stack.empty())
+    {
+        const Node &node = nodes_[stack.back()];
+        stack.pop_back();
+
+        if (node.is_leaf())
+        {
+            if (node.tight_bounds.intersects(bounds))
+                results.push_back(node.user_data);
+        }
+        else if (node.bounds.intersects(bounds))
+        {
+            stack.push_back(node.children[0]);
+            stack.push_back(node.children[1]);
+        }
+    }
+}
+
+std::optional<Bvh::RayHit> Bvh::raycast(const Ray &ray, float max_distance) const
+{
+    if (root_ == null_node)
+        return std::nullopt;
+
+    std::optional<RayHit> closest_hit{};
+    float closest_distance = max_distance;
+
+    std::vector<int32_t> stack{};
+    stack.reserve(64);
+
+    if (ray.intersect(nodes_[root_].bounds, closest_distance) >= 0.0f)
+        stack.push_back(root_);
+    while (!stack.empty())
+    {
+        const Node &node = nodes_[stack.back()];
+        stack.pop_back();
+
+        if (node.is_leaf())
+        {
+            float distance = ray.intersect(node.tight_bounds, closest_distance);
+            if (distance >= 0.0f)
+            {
+                closest_distance = distance;
+                closest_hit = RayHit{node.user_data, distance};
+            }
+            continue;
+        }
+
+        // Visits the nearer child first, so hits in it cut the search of the farther one short
+        float first_distance = ray.intersect(nodes_[node.children[0]].bounds, closest_distance);
+        float second_distance = ray.intersect(nodes_[node.children[1]].bounds, closest_distance);
+        int32_t first_child = node.children[0];
+        int32_t second_child = node.children[1];
+        if (second_distance >= 0.0f && (first_distance < 0.0f || second_distance < first_distance))
+        {
+            std::swap(first_distance, second_distance);
+            std::swap(first_child, second_child);
+        }
+
+        if (second_distance >= 0.0f)
+            stack.push_back(second_child);
+        if (first_distance >= 0.0f)
+            stack.push_back(first_child);
+    }
+
+    return closest_hit;
+}
+
+int32_t Bvh::allocate_node()
+{
+    if (free_list_ == null_node)
+    {
+        nodes_.emplace_back();
+        return static_cast<int32_t>(nodes_.size() - 1);
+    }
+
+    int32_t node = free_list_;
+    free_list_ = nodes_[node].parent;
+    nodes_[node] = Node{};
+    return node;
+}
+
+void Bvh::free_node(int32_t node)
+{
+    nodes_[node].parent = free_list_;
+    nodes_[node].height = -1;
+    free_list_ = node;
+}
+
+void Bvh::insert_leaf(int32_t leaf)
+{
+    if (root_ == null_node)
+    {
+        root_ = leaf;
+        nodes_[leaf].parent = null_node;
+        return;
+    }
+
+    // Walks down to the sibling that grows the total surface area of the tree the least
+    AABB leaf_bounds = nodes_[leaf].bounds;
+    int32_t sibling = root_;
+    while (!nodes_[sibling].is_leaf())
+    {
+        const Node &node = nodes_[sibling];
+        float area = node.bounds.surface_area();
+        float combined_area = merge(node.bounds, leaf_bounds).surface_area();
+
+        // Making a new parent of this node and the leaf
+        float cost = 2.0f * combined_area;
+        // Every ancestor below here grows by this much when the leaf goes further down
+        float inherited_cost = 2.0f * (combined_area - area);
+
+        auto descend_cost = [&](int32_t child) {
+            const AABB &child_bounds = nodes_[child].bounds;
+            float merged_area = merge(child_bounds, leaf_bounds).surface_area();
+            if (nodes_[child].is_leaf())
+                return merged_area + inherited_cost;
+            return merged_area - child_bounds.surface_area() + inherited_cost;
+        };
+        float first_cost = descend_cost(node.children[0]);
+        float second_cost = descend_cost(node.children[1]);
+
+        if (cost < first_cost && cost < second_cost)
+            break;
+        sibling = first_cost < second_cost ? node.children[0] : node.children[1];
+    }
+
+    int32_t old_parent = nodes_[sibling].parent;
+    int32_t new_parent = allocate_node();
+    nodes_[new_parent].parent = old_parent;
+    nodes_[new_parent].bounds = merge(leaf_bounds, nodes_[sibling].bounds);
+    nodes_[new_parent].height = nodes_[sibling].height + 1;
+    nodes_[new_parent].children[0] = sibling;
+    nodes_[new_parent].children[1] = leaf;
+    nodes_[sibling].parent = new_parent;
+    nodes_[leaf].parent = new_parent;
+
+    if (old_parent == null_node)
+    {
+        root_ = new_parent;
+    }
+    else
+    {
+        int32_t child = nodes_[old_parent].children[0] == sibling ? 0 : 1;
+        nodes_[old_parent].children[child] = new_parent;
+    }
+
+    refit_ancestors(nodes_[leaf].parent);
+}
+
+void Bvh::remove_leaf(int32_t leaf)
+{
+    if (leaf == root_)
+    {
+        root_ = null_node;
+        return;
+    }
+
+    int32_t parent = nodes_[leaf].parent;
+    int32_t grandparent = nodes_[parent].parent;
+    int32_t sibling = nodes_[parent].children[0] == leaf ? nodes_[parent].children[1] : nodes_[parent].children[0];
+
+    // The sibling takes the parent's place
+    nodes_[sibling].parent = grandparent;
+    free_node(parent);
+    if (grandparent == null_node)
+    {
+        root_ = sibling;
+        return;
+    }
+
+    int32_t child = nodes_[grandparent].children[0] == parent ? 0 : 1;
+    nodes_[grandparent].children[child] = sibling;
+    refit_ancestors(grandparent);
+}
+
+int32_t Bvh::balance(int32_t node)
+{
+    Node &a = nodes_[node];
+    if (a.is_leaf() || a.height < 2)
+        return node;
+
+    int32_t b_index = a.children[0];
+    int32_t c_index = a.children[1];
+    Node &b = nodes_[b_index];
+    Node &c = nodes_[c_index];
+    int32_t height_difference = c.height - b.height;
+
+    // Rotates the higher child up, the lower of its children taking its place below this node
+    auto rotate_up = [&](int32_t up_index, Node &up, int32_t side, const Node &other) {
+        int32_t f_index = up.children[0];
+        int32_t g_index = up.children[1];
+        Node &f = nodes_[f_index];
+        Node &g = nodes_[g_index];
+
+        up.children[0] = node;
+        up.parent = a.parent;
+        a.parent = up_index;
+
+        if (up.parent == null_node)
+        {
+            root_ = up_index;
+        }
+        else
+        {
+            Node &parent = nodes_[up.parent];
+            parent.children[parent.children[0] == node ? 0 : 1] = up_index;
+        }
+
+        int32_t kept_index = f.height > g.height ? f_index : g_index;
+        int32_t moved_index = f.height > g.height ? g_index : f_index;
+        Node &kept = nodes_[kept_index];
+        Node &moved = nodes_[moved_index];
+
+        up.children[1] = kept_index;
+        a.children[side] = moved_index;
+        moved.parent = node;
+        a.bounds = merge(other.bounds, moved.bounds);
+        a.height = 1 + std::max(other.height, moved.height);
+        up.bounds = merge(a.bounds, kept.bounds);
+        up.height = 1 + std::max(a.height, kept.height);
+    };
+
+    if (height_difference > 1)
+    {
+        rotate_up(c_index, c, 1, b);
+        return c_index;
+    }
+    if (height_difference < -1)
+    {
+        rotate_up(b_index, b, 0, c);
+        return b_index;
+    }
+    return node;
+}
+
+void Bvh::refit_ancestors(int32_t node)
+{
+    while (node != null_node)
+    {
+        node = balance(node);
+
+        Node &current = nodes_[node];
+        const Node &first = nodes_[current.children[0]];
+        const Node &second = nodes_[current.children[1]];
+        current.height = 1 + std::max(first.height, second.height);
+        current.bounds = merge(first.bounds, second.bounds);
+
+        node = current.parent;
+    }
+}
+
+}// namespace flwfrg
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "math/bounds.hpp"
+#include "math/frustum.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace flwfrg
+{
+
+/// Dynamic bounding volume hierarchy over boxes, for culling and picking on the CPU.
+///
+/// A binary tree of boxes kept balanced with tree rotations, like the dynamic trees of physics engines. New leaves
+/// go where they grow the surface area of the tree the least. Leaves store their bounds enlarged by a margin, so
+/// objects moving around a little only refit their leaf instead of changing the tree.
+class Bvh
+{
+public:
+    typedef int32_t proxy_id_t;
+
+    static constexpr proxy_id_t invalid_proxy = -1;
+
+    struct RayHit
+    {
+        int32_t user_data;
+        // Along the ray, in multiples of its direction's length
+        float distance;
+    };
+
+public:
+    Bvh() = default;
+    /// @param margin How much the bounds of leaves are enlarged
+    explicit Bvh(float margin);
+    ~Bvh() = default;
+
+    // Copy
+    Bvh(const Bvh &) = default;
+    Bvh &operator=(const Bvh &) = default;
+    // Move
+    Bvh(Bvh &&other) noexcept = default;
+    Bvh &operator=(Bvh &&other) noexcept = default;
+
+    // Methods
+
+    /// @param user_data Returned by the queries for this proxy, e.g. the id of an object
+    proxy_id_t insert(const AABB &bounds, int32_t user_data);
+    void remove(proxy_id_t proxy);
+    /// Sets the bounds of a proxy. The tree only changes when they leave the enlarged bounds of its leaf.
+    /// @return Whether the proxy was moved in the tree
+    bool update(proxy_id_t proxy, const AABB &bounds);
+
+    /// Appends the user data of every proxy whose bounds intersect the frustum
+    void query(const Frustum &frustum, std::vector<int32_t> &results) const;
+    /// Appends the user data of every proxy whose bounds intersect the box
+    void query(const AABB &bounds, std::vector<int32_t> &results) const;
+    /// Finds the closest proxy whose bounds the ray hits
+    [[nodiscard]] std::optional<RayHit> raycast(const Ray &ray,
+                                                float max_distance = std::numeric_limits<float>::max()) const;
+
+    [[nodiscard]] inline const AABB &get_bounds(proxy_id_t proxy) const
+    {
+        assert(is_leaf(proxy));
+        return nodes_[proxy].tight_bounds;
+    }
+    [[nodiscard]] inline int32_t get_user_data(proxy_id_t proxy) const
+    {
+        assert(is_leaf(proxy));
+        return nodes_[proxy].user_data;
+    }
+    [[nodiscard]] inline uint32_t get_proxy_count() const { return proxy_count_; };
+    [[nodiscard]] inline int32_t get_height() const { return root_ == null_node ? 0 : nodes_[root_].height; };
+
+private:
+    static constexpr int32_t null_node = -1;
+
+    struct Node
+    {
+        // Enlarged by the margin for leaves
+        AABB bounds{};
+        // Leaves only
+        AABB tight_bounds{};
+        // The next free node while on the free list
+        int32_t parent = null_node;
+        int32_t children[2]{null_node, null_node};
+        // Leaves are at 0, free nodes at -1
+        int32_t height = -1;
+        int32_t user_data = 0;
+
+        [[nodiscard]] inline bool is_leaf() const { return children[0] == null_node; };
+    };
+
+    float margin_ = 0.1f;
+
+    std::vector<Node> nodes_{};
+    int32_t root_ = null_node;
+    int32_t free_list_ = null_node;
+    uint32_t proxy_count_ = 0;
+
+    [[nodiscard]] inline bool is_leaf(int32_t node) const
+    {
+        return node >= 0 && node < static_cast<int32_t>(nodes_.size()) && nodes_[node].height == 0;
+    }
+
+    int32_t allocate_node();
+    void free_node(int32_t node);
+
+    void insert_leaf(int32_t leaf);
+    void remove_leaf(int32_t leaf);
+    /// Rotates the tree at the node if it is unbalanced
+    /// @return The node now at its place
+    int32_t balance(int32_t node);
+    /// Recomputes the bounds and heights from the node up to the root, balancing on the way
+    void refit_ancestors(int32_t node);
+};
+
+}// namespace flwfrg
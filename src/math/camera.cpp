@@ -120,4 +120,9 @@ void Camera::set_viewYXZ(glm::vec3 position, glm::vec3 rotation)
 	inverse_view_matrix_[3][2] = position.z;
 }
 
+Frustum Camera::frustum() const
+{
+	return Frustum::from_matrix(projection_matrix_ * view_matrix_);
+}
+
 }// namespace flwfrg
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include "math/frustum.hpp"
+
 namespace flwfrg
 {
 
@@ -23,6 +25,9 @@ public:
 	[[nodiscard]] inline const glm::mat4& get_view() const { return view_matrix_; };
 	[[nodiscard]] inline const glm::mat4& get_inverseView() const { return inverse_view_matrix_; };
 
+	/// World space planes of the view, from the current projection and view
+	[[nodiscard]] Frustum frustum() const;
+
 private:
 	glm::mat4 projection_matrix_{ 1.0f };
 	glm::mat4 view_matrix_{ 1.0f };
@@ -0,0 +1,402 @@
+#include "pch.hpp"
+
+#include "frustum.hpp"
+
+#include "math/frustum_kernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FLOWFORGE_FRUSTUM_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(FLOWFORGE_AVX2) && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace flwfrg
+{
+
+static_assert(sizeof(glm::vec4) == 4 * sizeof(float), "The batch culls read spheres as plain floats");
+static_assert(sizeof(AABB) == 6 * sizeof(float), "The batch culls read boxes as plain floats");
+
+namespace
+{
+
+inline void set_visible(uint64_t *visible, size_t index)
+{
+    visible[index / 64] |= uint64_t{1} << (index % 64);
+}
+
+void cull_spheres_scalar(const Frustum &frustum, std::span<const glm::vec4> spheres, size_t first,
+                         uint64_t *visible)
+{
+    for (size_t index = first; index < spheres.size(); index++)
+    {
+        const glm::vec4 &sphere = spheres[index];
+        bool inside = true;
+        for (uint32_t plane = 0; plane < Frustum::plane_count; plane++)
+        {
+            float distance = frustum.normal_x[plane] * sphere.x + frustum.normal_y[plane] * sphere.y +
+                             frustum.normal_z[plane] * sphere.z + frustum.distance[plane];
+            inside &= distance >= -sphere.w;
+        }
+        if (inside)
+            set_visible(visible, index);
+    }
+}
+
+void cull_aabbs_scalar(const Frustum &frustum, std::span<const AABB> boxes, size_t first, uint64_t *visible)
+{
+    for (size_t index = first; index < boxes.size(); index++)
+    {
+        glm::vec3 center = boxes[index].center();
+        glm::vec3 extent = boxes[index].extent();
+        bool inside = true;
+        for (uint32_t plane = 0; plane < Frustum::plane_count; plane++)
+        {
+            float center_distance = frustum.normal_x[plane] * center.x + frustum.normal_y[plane] * center.y +
+                                    frustum.normal_z[plane] * center.z + frustum.distance[plane];
+            float reach = std::abs(frustum.normal_x[plane]) * extent.x + std::abs(frustum.normal_y[plane]) * extent.y +
+                          std::abs(frustum.normal_z[plane]) * extent.z;
+            inside &= center_distance + reach >= 0.0f;
+        }
+        if (inside)
+            set_visible(visible, index);
+    }
+}
+
+#ifdef FLOWFORGE_FRUSTUM_SSE
+
+// Signed distance of the box's center to four planes, and how far the box reaches towards them
+inline void box_plane_distances(const Frustum &frustum, uint32_t first_plane, const AABB &bounds,
+                                __m128 &center_distance, __m128 &reach)
+{
+    glm::vec3 center = bounds.center();
+    glm::vec3 extent = bounds.extent();
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+
+    __m128 nx = _mm_load_ps(&frustum.normal_x[first_plane]);
+    __m128 ny = _mm_load_ps(&frustum.normal_y[first_plane]);
+    __m128 nz = _mm_load_ps(&frustum.normal_z[first_plane]);
+    __m128 d = _mm_load_ps(&frustum.distance[first_plane]);
+
+    center_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_set1_ps(center.x)), _mm_mul_ps(ny, _mm_set1_ps(center.y))),
+                                 _mm_add_ps(_mm_mul_ps(nz, _mm_set1_ps(center.z)), d));
+    reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(sign_mask, nx), _mm_set1_ps(extent.x)),
+                                  _mm_mul_ps(_mm_andnot_ps(sign_mask, ny), _mm_set1_ps(extent.y))),
+                       _mm_mul_ps(_mm_andnot_ps(sign_mask, nz), _mm_set1_ps(extent.z)));
+}
+
+// Four spheres at a time, the rest are left to the scalar cull
+size_t cull_spheres_sse(const Frustum &frustum, std::span<const glm::vec4> spheres, uint64_t *visible)
+{
+    size_t count = spheres.size() & ~size_t{3};
+    const float *data = reinterpret_cast<const float *>(spheres.data());
+    for (size_t first = 0; first < count; first += 4)
+    {
+        __m128 x = _mm_loadu_ps(data + first * 4 + 0);
+        __m128 y = _mm_loadu_ps(data + first * 4 + 4);
+        __m128 z = _mm_loadu_ps(data + first * 4 + 8);
+        __m128 radius = _mm_loadu_ps(data + first * 4 + 12);
+        _MM_TRANSPOSE4_PS(x, y, z, radius);
+        __m128 negative_radius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+        __m128 outside = _mm_setzero_ps();
+        for (uint32_t plane = 0; plane < Frustum::plane_count; plane++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.normal_x[plane]), x),
+                                                    _mm_mul_ps(_mm_set1_ps(frustum.normal_y[plane]), y)),
+                                         _mm_add_ps(_mm_mul_ps(_mm_set1_ps(frustum.normal_z[plane]), z),
+                                                    _mm_set1_ps(frustum.distance[plane])));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negative_radius));
+        }
+
+        auto visible_bits = static_cast<uint64_t>(~_mm_movemask_ps(outside) & 0xf);
+        visible[first / 64] |= visible_bits << (first % 64);
+    }
+    return count;
+}
+
+size_t cull_aabbs_sse(const Frustum &frustum, std::span<const AABB> boxes, uint64_t *visible)
+{
+    size_t count = boxes.size() & ~size_t{3};
+    const float *data = reinterpret_cast<const float *>(boxes.data());
+    const __m128 half = _mm_set1_ps(0.5f);
+    for (size_t first = 0; first < count; first += 4)
+    {
+        const float *box = data + first * 6;
+        auto gather = [box](int component) {
+            return _mm_setr_ps(box[component], box[6 + component], box[12 + component], box[18 + component]);
+        };
+        __m128 min_x = gather(0);
+        __m128 min_y = gather(1);
+        __m128 min_z = gather(2);
+        __m128 max_x = gather(3);
+        __m128 max_y = gather(4);
+        __m128 max_z = gather(5);
+
+        __m128 center_x = _mm_mul_ps(_mm_add_ps(min_x, max_x), half);
+        __m128 center_y = _mm_mul_ps(_mm_add_ps(min_y, max_y), half);
+        __m128 center_z = _mm_mul_ps(_mm_add_ps(min_z, max_z), half);
+        __m128 extent_x = _mm_mul_ps(_mm_sub_ps(max_x, min_x), half);
+        __m128 extent_y = _mm_mul_ps(_mm_sub_ps(max_y, min_y), half);
+        __m128 extent_z = _mm_mul_ps(_mm_sub_ps(max_z, min_z), half);
+
+        __m128 outside = _mm_setzero_ps();
+        for (uint32_t plane = 0; plane < Frustum::plane_count; plane++)
+        {
+            float nx = frustum.normal_x[plane];
+            float ny = frustum.normal_y[plane];
+            float nz = frustum.normal_z[plane];
+
+            __m128 center_distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(nx), center_x),
+                                                           _mm_mul_ps(_mm_set1_ps(ny), center_y)),
+                                                _mm_add_ps(_mm_mul_ps(_mm_set1_ps(nz), center_z),
+                                                           _mm_set1_ps(frustum.distance[plane])));
+            __m128 reach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(std::abs(nx)), extent_x),
+                                                 _mm_mul_ps(_mm_set1_ps(std::abs(ny)), extent_y)),
+                                      _mm_mul_ps(_mm_set1_ps(std::abs(nz)), extent_z));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(center_distance, reach), _mm_setzero_ps()));
+        }
+
+        auto visible_bits = static_cast<uint64_t>(~_mm_movemask_ps(outside) & 0xf);
+        visible[first / 64] |= visible_bits << (first % 64);
+    }
+    return count;
+}
+
+#endif
+
+#ifdef FLOWFORGE_AVX2
+
+detail::FrustumPlanes get_planes(const Frustum &frustum)
+{
+    return detail::FrustumPlanes{
+            .normal_x = frustum.normal_x.data(),
+            .normal_y = frustum.normal_y.data(),
+            .normal_z = frustum.normal_z.data(),
+            .distance = frustum.distance.data(),
+            .plane_count = Frustum::plane_count,
+    };
+}
+
+#endif
+
+}// namespace
+
+Frustum Frustum::from_matrix(const glm::mat4 &view_projection)
+{
+    auto row = [&view_projection](int i) {
+        return glm::vec4{view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]};
+    };
+    std::array<glm::vec4, plane_count> planes{
+            row(3) + row(0),
+            row(3) - row(0),
+            row(3) + row(1),
+            row(3) - row(1),
+            row(2),
+            row(3) - row(2),
+    };
+
+    Frustum frustum{};
+    for (uint32_t plane = 0; plane < plane_count; plane++)
+    {
+        float length = glm::length(glm::vec3{planes[plane]});
+        glm::vec4 normalized = length > 0.0f ? planes[plane] / length : planes[plane];
+        frustum.normal_x[plane] = normalized.x;
+        frustum.normal_y[plane] = normalized.y;
+        frustum.normal_z[plane] = normalized.z;
+        frustum.distance[plane] = normalized.w;
+    }
+    // Nothing is ever behind the padding planes
+    for (uint32_t plane = plane_count; plane < padded_plane_count; plane++)
+    {
+        frustum.distance[plane] = std::numeric_limits<float>::max();
+    }
+    return frustum;
+}
+
+#ifdef FLOWFORGE_FRUSTUM_SSE
+
+Frustum::Intersection Frustum::test(const AABB &bounds) const
+{
+    int outside = 0;
+    int inside = 0;
+    for (uint32_t first_plane = 0; first_plane < padded_plane_count; first_plane += 4)
+    {
+        __m128 center_distance;
+        __m128 reach;
+        box_plane_distances(*this, first_plane, bounds, center_distance, reach);
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(center_distance, _mm_sub_ps(_mm_setzero_ps(), reach)));
+        inside |= _mm_movemask_ps(_mm_cmplt_ps(center_distance, reach));
+    }
+
+    if (outside != 0)
+        return Intersection::OUTSIDE;
+    return inside != 0 ? Intersection::INTERSECTING : Intersection::INSIDE;
+}
+
+bool Frustum::intersects(const AABB &bounds) const
+{
+    int outside = 0;
+    for (uint32_t first_plane = 0; first_plane < padded_plane_count; first_plane += 4)
+    {
+        __m128 center_distance;
+        __m128 reach;
+        box_plane_distances(*this, first_plane, bounds, center_distance, reach);
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(center_distance, _mm_sub_ps(_mm_setzero_ps(), reach)));
+    }
+    return outside == 0;
+}
+
+bool Frustum::intersects(const BoundingSphere &sphere) const
+{
+    int outside = 0;
+    __m128 negative_radius = _mm_set1_ps(-sphere.radius);
+    for (uint32_t first_plane = 0; first_plane < padded_plane_count; first_plane += 4)
+    {
+        __m128 distance_to_plane = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_load_ps(&normal_x[first_plane]), _mm_set1_ps(sphere.center.x)),
+                           _mm_mul_ps(_mm_load_ps(&normal_y[first_plane]), _mm_set1_ps(sphere.center.y))),
+                _mm_add_ps(_mm_mul_ps(_mm_load_ps(&normal_z[first_plane]), _mm_set1_ps(sphere.center.z)),
+                           _mm_load_ps(&distance[first_plane])));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(distance_to_plane, negative_radius));
+    }
+    return outside == 0;
+}
+
+#else
+
+Frustum::Intersection Frustum::test(const AABB &bounds) const
+{
+    glm::vec3 center = bounds.center();
+    glm::vec3 extent = bounds.extent();
+
+    bool intersecting = false;
+    for (uint32_t plane = 0; plane < plane_count; plane++)
+    {
+        float center_distance = normal_x[plane] * center.x + normal_y[plane] * center.y +
+                                normal_z[plane] * center.z + distance[plane];
+        float reach = std::abs(normal_x[plane]) * extent.x + std::abs(normal_y[plane]) * extent.y +
+                      std::abs(normal_z[plane]) * extent.z;
+        if (center_distance < -reach)
+            return Intersection::OUTSIDE;
+        intersecting |= center_distance < reach;
+    }
+    return intersecting ? Intersection::INTERSECTING : Intersection::INSIDE;
+}
+
+bool Frustum::intersects(const AABB &bounds) const
+{
+    return test(bounds) != Intersection::OUTSIDE;
+}
+
+bool Frustum::intersects(const BoundingSphere &sphere) const
+{
+    for (uint32_t plane = 0; plane < plane_count; plane++)
+    {
+        float distance_to_plane = normal_x[plane] * sphere.center.x + normal_y[plane] * sphere.center.y +
+                                  normal_z[plane] * sphere.center.z + distance[plane];
+        if (distance_to_plane < -sphere.radius)
+            return false;
+    }
+    return true;
+}
+
+#endif
+
+void Frustum::cull_spheres(std::span<const glm::vec4> spheres, std::vector<uint64_t> &visible) const
+{
+    cull_spheres(spheres, visible, get_supported_instruction_set());
+}
+
+void Frustum::cull_spheres(std::span<const glm::vec4> spheres, std::vector<uint64_t> &visible,
+                           InstructionSet instruction_set) const
+{
+    visible.assign((spheres.size() + 63) / 64, 0);
+    instruction_set = std::min(instruction_set, get_supported_instruction_set());
+
+    size_t culled = 0;
+#ifdef FLOWFORGE_AVX2
+    if (instruction_set == InstructionSet::AVX2)
+    {
+        culled = spheres.size() & ~size_t{7};
+        detail::cull_spheres_avx2(get_planes(*this), reinterpret_cast<const float *>(spheres.data()), culled,
+                                  visible.data());
+    }
+#endif
+#ifdef FLOWFORGE_FRUSTUM_SSE
+    if (instruction_set == InstructionSet::SSE)
+    {
+        culled = cull_spheres_sse(*this, spheres, visible.data());
+    }
+#endif
+    cull_spheres_scalar(*this, spheres, culled, visible.data());
+}
+
+void Frustum::cull_aabbs(std::span<const AABB> boxes, std::vector<uint64_t> &visible) const
+{
+    cull_aabbs(boxes, visible, get_supported_instruction_set());
+}
+
+void Frustum::cull_aabbs(std::span<const AABB> boxes, std::vector<uint64_t> &visible,
+                         InstructionSet instruction_set) const
+{
+    visible.assign((boxes.size() + 63) / 64, 0);
+    instruction_set = std::min(instruction_set, get_supported_instruction_set());
+
+    size_t culled = 0;
+#ifdef FLOWFORGE_AVX2
+    if (instruction_set == InstructionSet::AVX2)
+    {
+        culled = boxes.size() & ~size_t{7};
+        detail::cull_aabbs_avx2(get_planes(*this), reinterpret_cast<const float *>(boxes.data()), culled,
+                                visible.data());
+    }
+#endif
+#ifdef FLOWFORGE_FRUSTUM_SSE
+    if (instruction_set == InstructionSet::SSE)
+    {
+        culled = cull_aabbs_sse(*this, boxes, visible.data());
+    }
+#endif
+    cull_aabbs_scalar(*this, boxes, culled, visible.data());
+}
+
+Frustum::InstructionSet Frustum::get_supported_instruction_set()
+{
+    static const InstructionSet supported = [] {
+#ifdef FLOWFORGE_AVX2
+#ifdef _MSC_VER
+        // AVX2 on the CPU, and the OS saving the upper halves of the registers
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7)
+        {
+            __cpuid(info, 1);
+            bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 &&
+                                (_xgetbv(0) & 0x6) == 0x6;
+            __cpuidex(info, 7, 0);
+            if (os_saves_avx && (info[1] & (1 << 5)) != 0)
+                return InstructionSet::AVX2;
+        }
+#else
+        if (__builtin_cpu_supports("avx2"))
+            return InstructionSet::AVX2;
+#endif
+#endif
+#ifdef FLOWFORGE_FRUSTUM_SSE
+        return InstructionSet::SSE;
+#else
+        return InstructionSet::SCALAR;
+#endif
+    }();
+    return supported;
+}
+
+}// namespace flwfrg
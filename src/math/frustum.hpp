@@ -0,0 +1,75 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "math/bounds.hpp"
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace flwfrg
+{
+
+/// The six planes of a view frustum, normalized and facing inwards.
+///
+/// Stored as one array per plane component, padded to eight planes that contain everything, so the box and sphere
+/// tests check four planes per SSE instruction. The batch culls go the other way, testing four (SSE) or eight (AVX2)
+/// objects per instruction against one plane at a time.
+struct Frustum
+{
+    enum class Intersection
+    {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE,
+    };
+
+    enum class InstructionSet
+    {
+        SCALAR,
+        SSE,
+        AVX2,
+    };
+
+    static constexpr uint32_t plane_count = 6;
+    static constexpr uint32_t padded_plane_count = 8;
+
+    alignas(16) std::array<float, padded_plane_count> normal_x{};
+    alignas(16) std::array<float, padded_plane_count> normal_y{};
+    alignas(16) std::array<float, padded_plane_count> normal_z{};
+    alignas(16) std::array<float, padded_plane_count> distance{};
+
+    /// Extracts the planes of the clip volume (Gribb and Hartmann) with depth from 0 to 1. Passing the projection
+    /// times the view gives them in world space, and including a model matrix gives them in that model's space.
+    [[nodiscard]] static Frustum from_matrix(const glm::mat4 &view_projection);
+
+    [[nodiscard]] Intersection test(const AABB &bounds) const;
+    [[nodiscard]] bool intersects(const AABB &bounds) const;
+    [[nodiscard]] bool intersects(const BoundingSphere &sphere) const;
+
+    /// Tests many spheres at once, with the best instruction set the CPU supports.
+    /// @param spheres Center in xyz and radius in w
+    /// @param visible Replaced by one bit per sphere, bit i % 64 of word i / 64 being set when sphere i is visible
+    void cull_spheres(std::span<const glm::vec4> spheres, std::vector<uint64_t> &visible) const;
+    /// @param instruction_set Instructions to use, at most get_supported_instruction_set, e.g. to compare them
+    void cull_spheres(std::span<const glm::vec4> spheres, std::vector<uint64_t> &visible,
+                      InstructionSet instruction_set) const;
+    /// Tests many boxes at once, see cull_spheres
+    void cull_aabbs(std::span<const AABB> boxes, std::vector<uint64_t> &visible) const;
+    void cull_aabbs(std::span<const AABB> boxes, std::vector<uint64_t> &visible, InstructionSet instruction_set) const;
+
+    /// The widest instruction set the batch culls can use on this CPU. AVX2 also needs the library to be built for
+    /// x86, which compiles those kernels on their own with AVX2 enabled.
+    [[nodiscard]] static InstructionSet get_supported_instruction_set();
+
+    [[nodiscard]] inline glm::vec4 get_plane(uint32_t plane) const
+    {
+        return glm::vec4{normal_x[plane], normal_y[plane], normal_z[plane], distance[plane]};
+    }
+};
+
+}// namespace flwfrg
@@ -0,0 +1,93 @@
+// Compiled with AVX2 enabled and without the precompiled header, see frustum_kernels.hpp
+#include "frustum_kernels.hpp"
+
+#include <immintrin.h>
+
+namespace flwfrg::detail
+{
+
+void cull_spheres_avx2(const FrustumPlanes &planes, const float *spheres, size_t count, uint64_t *visible)
+{
+    for (size_t first = 0; first < count; first += 8)
+    {
+        // Two spheres per register, i and i + 4, so the transpose within each half gives spheres 0 to 7 in order
+        const float *sphere = spheres + first * 4;
+        __m256 r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(sphere + 0)), _mm_loadu_ps(sphere + 16), 1);
+        __m256 r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(sphere + 4)), _mm_loadu_ps(sphere + 20), 1);
+        __m256 r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(sphere + 8)), _mm_loadu_ps(sphere + 24), 1);
+        __m256 r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(sphere + 12)), _mm_loadu_ps(sphere + 28), 1);
+
+        __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+        __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+        __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+        __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+        __m256 x = _mm256_shuffle_ps(t0, t2, 0x44);
+        __m256 y = _mm256_shuffle_ps(t0, t2, 0xee);
+        __m256 z = _mm256_shuffle_ps(t1, t3, 0x44);
+        __m256 negative_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_shuffle_ps(t1, t3, 0xee));
+
+        __m256 outside = _mm256_setzero_ps();
+        for (uint32_t plane = 0; plane < planes.plane_count; plane++)
+        {
+            __m256 distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.normal_x[plane]), x),
+                                  _mm256_mul_ps(_mm256_set1_ps(planes.normal_y[plane]), y)),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(planes.normal_z[plane]), z),
+                                  _mm256_set1_ps(planes.distance[plane])));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negative_radius, _CMP_LT_OQ));
+        }
+
+        auto visible_bits = static_cast<uint64_t>(~_mm256_movemask_ps(outside) & 0xff);
+        visible[first / 64] |= visible_bits << (first % 64);
+    }
+}
+
+void cull_aabbs_avx2(const FrustumPlanes &planes, const float *boxes, size_t count, uint64_t *visible)
+{
+    const __m256i box_offsets = _mm256_setr_epi32(0, 6, 12, 18, 24, 30, 36, 42);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    for (size_t first = 0; first < count; first += 8)
+    {
+        const float *box = boxes + first * 6;
+        __m256 min_x = _mm256_i32gather_ps(box + 0, box_offsets, 4);
+        __m256 min_y = _mm256_i32gather_ps(box + 1, box_offsets, 4);
+        __m256 min_z = _mm256_i32gather_ps(box + 2, box_offsets, 4);
+        __m256 max_x = _mm256_i32gather_ps(box + 3, box_offsets, 4);
+        __m256 max_y = _mm256_i32gather_ps(box + 4, box_offsets, 4);
+        __m256 max_z = _mm256_i32gather_ps(box + 5, box_offsets, 4);
+
+        __m256 center_x = _mm256_mul_ps(_mm256_add_ps(min_x, max_x), half);
+        __m256 center_y = _mm256_mul_ps(_mm256_add_ps(min_y, max_y), half);
+        __m256 center_z = _mm256_mul_ps(_mm256_add_ps(min_z, max_z), half);
+        __m256 extent_x = _mm256_mul_ps(_mm256_sub_ps(max_x, min_x), half);
+        __m256 extent_y = _mm256_mul_ps(_mm256_sub_ps(max_y, min_y), half);
+        __m256 extent_z = _mm256_mul_ps(_mm256_sub_ps(max_z, min_z), half);
+
+        __m256 outside = _mm256_setzero_ps();
+        for (uint32_t plane = 0; plane < planes.plane_count; plane++)
+        {
+            float nx = planes.normal_x[plane];
+            float ny = planes.normal_y[plane];
+            float nz = planes.normal_z[plane];
+
+            __m256 center_distance = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(nx), center_x),
+                                  _mm256_mul_ps(_mm256_set1_ps(ny), center_y)),
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(nz), center_z),
+                                  _mm256_set1_ps(planes.distance[plane])));
+            // How far the box reaches towards the plane
+            __m256 reach = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(nx < 0.0f ? -nx : nx), extent_x),
+                                  _mm256_mul_ps(_mm256_set1_ps(ny < 0.0f ? -ny : ny), extent_y)),
+                    _mm256_mul_ps(_mm256_set1_ps(nz < 0.0f ? -nz : nz), extent_z));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(center_distance, reach), _mm256_setzero_ps(),
+                                                          _CMP_LT_OQ));
+        }
+
+        auto visible_bits = static_cast<uint64_t>(~_mm256_movemask_ps(outside) & 0xff);
+        visible[first / 64] |= visible_bits << (first % 64);
+    }
+}
+
+}// namespace flwfrg::detail
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Kernels compiled in their own translation unit with wider instructions enabled, used by Frustum once it has made
+// sure the CPU supports them. Nothing here or in those translation units may be inline code shared with the rest of
+// the library, since the linker could pick the copy using the wider instructions for everyone.
+
+namespace flwfrg::detail
+{
+
+struct FrustumPlanes
+{
+    const float *normal_x;
+    const float *normal_y;
+    const float *normal_z;
+    const float *distance;
+    uint32_t plane_count;
+};
+
+// Spheres are four floats each, center and radius. Boxes are six, min then max. The counts are multiples of eight,
+// and the visibility bits are ored into visible.
+
+void cull_spheres_avx2(const FrustumPlanes &planes, const float *spheres, size_t count, uint64_t *visible);
+void cull_aabbs_avx2(const FrustumPlanes &planes, const float *boxes, size_t count, uint64_t *visible);
+
+}// namespace flwfrg::detail
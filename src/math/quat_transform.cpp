@@ -0,0 +1,98 @@
+#include "pch.hpp"
+
+#include "quat_transform.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FLOWFORGE_QUAT_TRANSFORM_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace flwfrg
+{
+
+QuatTransform::QuatTransform(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale)
+    : translation_{translation}, rotation_{glm::normalize(rotation)}, scale_{scale}, rotation_scale_dirty_{true}
+{
+}
+
+QuatTransform::QuatTransform(const Transform &transform)
+    : translation_{transform.translation},
+      // Transform::mat4 rotates around z, then x, then y
+      rotation_{glm::angleAxis(transform.rotation.y, glm::vec3{0.0f, 1.0f, 0.0f}) *
+                glm::angleAxis(transform.rotation.x, glm::vec3{1.0f, 0.0f, 0.0f}) *
+                glm::angleAxis(transform.rotation.z, glm::vec3{0.0f, 0.0f, 1.0f})},
+      scale_{transform.scale},
+      rotation_scale_dirty_{true}
+{
+}
+
+glm::mat4 QuatTransform::mat4() const
+{
+    const glm::mat3 &rotation_scale = get_rotation_scale();
+    return glm::mat4{
+            glm::vec4{rotation_scale[0], 0.0f},
+            glm::vec4{rotation_scale[1], 0.0f},
+            glm::vec4{rotation_scale[2], 0.0f},
+            glm::vec4{translation_, 1.0f},
+    };
+}
+
+glm::mat3 QuatTransform::normal_matrix() const
+{
+    // The inverse transpose of rotation times scale is the rotation divided by the scale, which is the cached block
+    // divided by the scale twice
+    const glm::mat3 &rotation_scale = get_rotation_scale();
+    return glm::mat3{
+            rotation_scale[0] / (scale_.x * scale_.x),
+            rotation_scale[1] / (scale_.y * scale_.y),
+            rotation_scale[2] / (scale_.z * scale_.z),
+    };
+}
+
+glm::mat4 QuatTransform::compose(const glm::mat4 &parent) const
+{
+    const glm::mat3 &rotation_scale = get_rotation_scale();
+    glm::mat4 result;
+
+#ifdef FLOWFORGE_QUAT_TRANSFORM_SSE
+    __m128 parent_x = _mm_loadu_ps(&parent[0][0]);
+    __m128 parent_y = _mm_loadu_ps(&parent[1][0]);
+    __m128 parent_z = _mm_loadu_ps(&parent[2][0]);
+    __m128 parent_w = _mm_loadu_ps(&parent[3][0]);
+
+    for (int column = 0; column < 3; column++)
+    {
+        __m128 combined = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(parent_x, _mm_set1_ps(rotation_scale[column].x)),
+                           _mm_mul_ps(parent_y, _mm_set1_ps(rotation_scale[column].y))),
+                _mm_mul_ps(parent_z, _mm_set1_ps(rotation_scale[column].z)));
+        _mm_storeu_ps(&result[column][0], combined);
+    }
+    __m128 translated = _mm_add_ps(_mm_add_ps(_mm_mul_ps(parent_x, _mm_set1_ps(translation_.x)),
+                                              _mm_mul_ps(parent_y, _mm_set1_ps(translation_.y))),
+                                   _mm_add_ps(_mm_mul_ps(parent_z, _mm_set1_ps(translation_.z)), parent_w));
+    _mm_storeu_ps(&result[3][0], translated);
+#else
+    for (int column = 0; column < 3; column++)
+    {
+        result[column] = parent[0] * rotation_scale[column].x + parent[1] * rotation_scale[column].y +
+                         parent[2] * rotation_scale[column].z;
+    }
+    result[3] = parent[0] * translation_.x + parent[1] * translation_.y + parent[2] * translation_.z + parent[3];
+#endif
+
+    return result;
+}
+
+const glm::mat3 &QuatTransform::get_rotation_scale() const
+{
+    if (rotation_scale_dirty_)
+    {
+        glm::mat3 rotation = glm::mat3_cast(rotation_);
+        rotation_scale_ = glm::mat3{rotation[0] * scale_.x, rotation[1] * scale_.y, rotation[2] * scale_.z};
+        rotation_scale_dirty_ = false;
+    }
+    return rotation_scale_;
+}
+
+}// namespace flwfrg
@@ -0,0 +1,77 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "math/transform.hpp"
+
+namespace flwfrg
+{
+
+/// A transform with its rotation stored as a quaternion, for transforms that are updated and turned into matrices
+/// often.
+///
+/// The rotation and scale part of the matrix is cached, and only recomputed after the rotation or scale changed.
+/// Building the matrices after moving the transform does no trig and no quaternion math, and the normal matrix is
+/// derived from the cached part without any trig either. The cache is refreshed by the const methods, so build a
+/// matrix once after changes before reading the transform from several threads.
+class QuatTransform
+{
+public:
+    QuatTransform() = default;
+    QuatTransform(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale = glm::vec3{1.0f});
+    /// Gives the same matrix as the Euler angle transform
+    explicit QuatTransform(const Transform &transform);
+    ~QuatTransform() = default;
+
+    // Copy
+    QuatTransform(const QuatTransform &) = default;
+    QuatTransform &operator=(const QuatTransform &) = default;
+    // Move
+    QuatTransform(QuatTransform &&other) noexcept = default;
+    QuatTransform &operator=(QuatTransform &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] glm::mat4 mat4() const;
+    /// Inverse transpose of the rotation and scale, for transforming normals
+    [[nodiscard]] glm::mat3 normal_matrix() const;
+    /// parent * mat4(), e.g. for the world matrix of a node in a hierarchy. Done as four SIMD column combinations
+    /// rather than a full matrix product, since the bottom row of mat4() is always 0, 0, 0, 1.
+    [[nodiscard]] glm::mat4 compose(const glm::mat4 &parent) const;
+
+    [[nodiscard]] inline const glm::vec3 &get_translation() const { return translation_; };
+    inline void set_translation(const glm::vec3 &translation) { translation_ = translation; };
+
+    [[nodiscard]] inline const glm::quat &get_rotation() const { return rotation_; };
+    /// @param rotation Normalized, so rotations can be built up without drifting
+    inline void set_rotation(const glm::quat &rotation)
+    {
+        rotation_ = glm::normalize(rotation);
+        rotation_scale_dirty_ = true;
+    }
+    /// Rotates by delta after the current rotation
+    inline void rotate(const glm::quat &delta) { set_rotation(delta * rotation_); };
+
+    [[nodiscard]] inline const glm::vec3 &get_scale() const { return scale_; };
+    inline void set_scale(const glm::vec3 &scale)
+    {
+        scale_ = scale;
+        rotation_scale_dirty_ = true;
+    }
+
+private:
+    glm::vec3 translation_{0.0f};
+    glm::quat rotation_{1.0f, 0.0f, 0.0f, 0.0f};
+    glm::vec3 scale_{1.0f};
+
+    // Columns of the rotation scaled by scale_
+    mutable glm::mat3 rotation_scale_{1.0f};
+    mutable bool rotation_scale_dirty_ = false;
+
+    [[nodiscard]] const glm::mat3 &get_rotation_scale() const;
+};
+
+}// namespace flwfrg
@@ -65,4 +65,28 @@ glm::mat3 Transform::normal_matrix() const
 	};
 }
 
+Transform Transform::from_mat4(const glm::mat4 &matrix)
+{
+	Transform transform{};
+	transform.translation = glm::vec3{matrix[3]};
+
+	glm::vec3 columns[3] = {glm::vec3{matrix[0]}, glm::vec3{matrix[1]}, glm::vec3{matrix[2]}};
+	transform.scale = {glm::length(columns[0]), glm::length(columns[1]), glm::length(columns[2])};
+	// A mirroring matrix has a negative scale, put on x
+	if (glm::dot(glm::cross(columns[0], columns[1]), columns[2]) < 0.0f)
+		transform.scale.x = -transform.scale.x;
+
+	for (int column = 0; column < 3; column++)
+	{
+		if (transform.scale[column] != 0.0f)
+			columns[column] /= transform.scale[column];
+	}
+
+	// The rotation of mat4, read back from the entries that hold a single sine or cosine of an angle
+	transform.rotation.x = glm::asin(glm::clamp(-columns[2].y, -1.0f, 1.0f));
+	transform.rotation.y = glm::atan(columns[2].x, columns[2].z);
+	transform.rotation.z = glm::atan(columns[0].y, columns[1].y);
+	return transform;
+}
+
 }// namespace flwfrg
\ No newline at end of file
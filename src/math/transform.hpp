@@ -16,6 +16,10 @@ struct Transform
 	[[nodiscard]] glm::mat4 mat4() const;
 	[[nodiscard]] glm::mat3 normal_matrix() const;
 
+	/// The transform giving matrix, for matrices made of a translation, a rotation and a scale. Shear, as from a
+	/// parent scaled unevenly, cannot be expressed and is lost.
+	[[nodiscard]] static Transform from_mat4(const glm::mat4 &matrix);
+
 	glm::vec3 rotation{};
 };
 
@@ -0,0 +1,279 @@
+#include "pch.hpp"
+
+#include "mesh_optimizer.hpp"
+
+#include <numeric>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+// Triangles using each vertex, as offsets into one flat list
+struct TriangleAdjacency
+{
+    std::vector<uint32_t> offsets{};
+    std::vector<uint32_t> triangles{};
+
+    TriangleAdjacency(const std::vector<uint32_t> &indices, size_t vertex_count)
+    {
+        offsets.assign(vertex_count + 1, 0);
+        for (uint32_t index: indices)
+        {
+            offsets[index + 1]++;
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+        triangles.resize(indices.size());
+        std::vector<uint32_t> fill = offsets;
+        for (size_t corner = 0; corner < indices.size(); corner++)
+        {
+            triangles[fill[indices[corner]]++] = static_cast<uint32_t>(corner / 3);
+        }
+    }
+};
+
+}// namespace
+
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count, uint32_t cache_size)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    TriangleAdjacency adjacency{indices, vertex_count};
+
+    // Triangles using the vertex that are not emitted yet
+    std::vector<uint32_t> live_triangles(vertex_count);
+    for (size_t vertex = 0; vertex < vertex_count; vertex++)
+    {
+        live_triangles[vertex] = adjacency.offsets[vertex + 1] - adjacency.offsets[vertex];
+    }
+
+    // Time stamp of the vertex entering the simulated FIFO cache, it is in the cache while time - stamp < cache_size
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_end_stack{};
+    std::vector<uint32_t> candidates{};
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+
+    // Scans for the next vertex with live triangles when everything near the fan is done
+    uint32_t cursor = 0;
+
+    int64_t fanning_vertex = indices[0];
+    while (fanning_vertex >= 0)
+    {
+        // Emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (uint32_t i = adjacency.offsets[fanning_vertex]; i < adjacency.offsets[fanning_vertex + 1]; i++)
+        {
+            uint32_t triangle = adjacency.triangles[i];
+            if (emitted[triangle])
+                continue;
+
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                result.push_back(vertex);
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+
+                if (time - cache_time[vertex] > cache_size)
+                    cache_time[vertex] = time++;
+            }
+            emitted[triangle] = true;
+        }
+
+        // Continue with the candidate that stays in the cache longest while its remaining triangles are emitted
+        fanning_vertex = -1;
+        int64_t best_priority = -1;
+        for (uint32_t vertex: candidates)
+        {
+            if (live_triangles[vertex] == 0)
+                continue;
+
+            int64_t priority = 0;
+            if (time - cache_time[vertex] + 2 * live_triangles[vertex] <= cache_size)
+                priority = time - cache_time[vertex];
+
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                fanning_vertex = vertex;
+            }
+        }
+
+        if (fanning_vertex >= 0)
+            continue;
+
+        // Dead end, go back to a recently used vertex or else any vertex with triangles left
+        while (!dead_end_stack.empty())
+        {
+            uint32_t vertex = dead_end_stack.back();
+            dead_end_stack.pop_back();
+            if (live_triangles[vertex] > 0)
+            {
+                fanning_vertex = vertex;
+                break;
+            }
+        }
+        while (fanning_vertex < 0 && cursor < vertex_count)
+        {
+            if (live_triangles[cursor] > 0)
+                fanning_vertex = cursor;
+            cursor++;
+        }
+    }
+
+    indices = std::move(result);
+}
+
+void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions, float threshold)
+{
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0)
+        return;
+
+    // Split where the cache order already starts over, a triangle missing the cache on all of its vertices. Moving
+    // these clusters around costs little cache efficiency.
+    std::vector<uint32_t> cluster_starts{};
+    {
+        std::vector<uint32_t> cache_time(positions.size(), 0);
+        uint32_t time = vertex_cache_size + 1;
+        for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+        {
+            uint32_t misses = 0;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = indices[triangle * 3 + corner];
+                if (time - cache_time[vertex] > vertex_cache_size)
+                {
+                    cache_time[vertex] = time++;
+                    misses++;
+                }
+            }
+            if (misses == 3 || triangle == 0)
+                cluster_starts.push_back(triangle);
+        }
+    }
+    if (cluster_starts.size() < 2)
+        return;
+
+    glm::vec3 mesh_centroid{0.0f};
+    for (uint32_t index: indices)
+    {
+        mesh_centroid += positions[index];
+    }
+    mesh_centroid /= static_cast<float>(indices.size());
+
+    // Clusters facing away from the center of the mesh are likely on the outside and in front, so they go first
+    std::vector<float> cluster_sort_keys(cluster_starts.size());
+    for (size_t cluster = 0; cluster < cluster_starts.size(); cluster++)
+    {
+        uint32_t begin = cluster_starts[cluster];
+        uint32_t end = cluster + 1 < cluster_starts.size() ? cluster_starts[cluster + 1]
+                                                           : static_cast<uint32_t>(triangle_count);
+
+        glm::vec3 centroid{0.0f};
+        glm::vec3 normal{0.0f};
+        float area = 0.0f;
+        for (uint32_t triangle = begin; triangle < end; triangle++)
+        {
+            const glm::vec3 &a = positions[indices[triangle * 3 + 0]];
+            const glm::vec3 &b = positions[indices[triangle * 3 + 1]];
+            const glm::vec3 &c = positions[indices[triangle * 3 + 2]];
+
+            // Area weighted, twice the area to be exact
+            glm::vec3 triangle_normal = glm::cross(b - a, c - a);
+            float triangle_area = glm::length(triangle_normal);
+            centroid += (a + b + c) * (triangle_area / 3.0f);
+            normal += triangle_normal;
+            area += triangle_area;
+        }
+
+        if (area > 0.0f)
+            centroid /= area;
+        float normal_length = glm::length(normal);
+        if (normal_length > 0.0f)
+            normal /= normal_length;
+
+        cluster_sort_keys[cluster] = glm::dot(centroid - mesh_centroid, normal);
+    }
+
+    std::vector<uint32_t> cluster_order(cluster_starts.size());
+    std::iota(cluster_order.begin(), cluster_order.end(), 0);
+    std::stable_sort(cluster_order.begin(), cluster_order.end(), [&cluster_sort_keys](uint32_t a, uint32_t b) {
+        return cluster_sort_keys[a] > cluster_sort_keys[b];
+    });
+
+    std::vector<uint32_t> result{};
+    result.reserve(indices.size());
+    for (uint32_t cluster: cluster_order)
+    {
+        uint32_t begin = cluster_starts[cluster];
+        uint32_t end = cluster + 1 < cluster_starts.size() ? cluster_starts[cluster + 1]
+                                                           : static_cast<uint32_t>(triangle_count);
+        result.insert(result.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+    }
+
+    float acmr_before = analyze_vertex_cache(indices, positions.size()).acmr;
+    float acmr_after = analyze_vertex_cache(result, positions.size()).acmr;
+    if (acmr_after <= acmr_before * threshold)
+        indices = std::move(result);
+}
+
+std::vector<uint32_t> optimize_vertex_fetch_remap(std::vector<uint32_t> &indices, size_t vertex_count)
+{
+    std::vector<uint32_t> remap(vertex_count, invalid_vertex);
+    uint32_t next_vertex = 0;
+    for (uint32_t &index: indices)
+    {
+        if (remap[index] == invalid_vertex)
+            remap[index] = next_vertex++;
+        index = remap[index];
+    }
+
+    return remap;
+}
+
+VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                           uint32_t cache_size)
+{
+    if (indices.empty() || vertex_count == 0)
+        return {};
+
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    uint32_t misses = 0;
+    for (uint32_t index: indices)
+    {
+        if (time - cache_time[index] > cache_size)
+        {
+            cache_time[index] = time++;
+            misses++;
+        }
+    }
+
+    std::vector<bool> used(vertex_count, false);
+    size_t used_count = 0;
+    for (uint32_t index: indices)
+    {
+        if (!used[index])
+        {
+            used[index] = true;
+            used_count++;
+        }
+    }
+
+    return VertexCacheStatistics{
+            .acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3),
+            .atvr = static_cast<float>(misses) / static_cast<float>(used_count),
+    };
+}
+
+}// namespace flwfrg
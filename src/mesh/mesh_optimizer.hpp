@@ -0,0 +1,158 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+namespace flwfrg
+{
+
+struct MeshOptimizationConfig
+{
+    // Merges vertices that are exactly equal, e.g. duplicated per face by an exporter
+    bool deduplicate_vertices = true;
+    // Orders triangles so vertices are reused while they are still in the post-transform cache
+    bool optimize_vertex_cache = true;
+    // Then orders clusters of triangles outside in, so fewer hidden fragments are shaded
+    bool optimize_overdraw = true;
+    // How much worse the cache hit rate may get for the sake of overdraw, 1.05 allows 5%
+    float overdraw_threshold = 1.05f;
+    // Orders vertices by first use, so vertex fetches walk memory linearly
+    bool optimize_vertex_fetch = true;
+};
+
+// Statistics of an index buffer on a simulated FIFO post-transform cache
+struct VertexCacheStatistics
+{
+    // Average cache misses per triangle, 0.5 is close to optimal and 3 means no reuse at all
+    float acmr = 0.0f;
+    // Cache misses per vertex, 1 is optimal
+    float atvr = 0.0f;
+};
+
+constexpr uint32_t vertex_cache_size = 16;
+constexpr uint32_t invalid_vertex = std::numeric_limits<uint32_t>::max();
+
+/// Maps every vertex to the first vertex equal to it.
+/// @return The remap table, with remap[i] <= i
+template<typename VertexType>
+std::vector<uint32_t> generate_duplicate_remap(const std::vector<VertexType> &vertices)
+{
+    // Positions are cheap to hash and tell most vertices apart, equality compares the rest
+    auto hash_position = [](const glm::vec3 &position) {
+        uint32_t bits[3];
+        std::memcpy(bits, &position, sizeof(bits));
+        return std::hash<uint64_t>{}((static_cast<uint64_t>(bits[0]) << 32 | bits[1]) ^
+                                     (static_cast<uint64_t>(bits[2]) * 0x9e3779b97f4a7c15ull));
+    };
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::unordered_multimap<size_t, uint32_t> unique_vertices{};
+    unique_vertices.reserve(vertices.size());
+    for (uint32_t vertex = 0; vertex < vertices.size(); vertex++)
+    {
+        size_t hash = hash_position(vertices[vertex].position);
+        remap[vertex] = vertex;
+
+        auto [begin, end] = unique_vertices.equal_range(hash);
+        for (auto it = begin; it != end; ++it)
+        {
+            if (vertices[it->second] == vertices[vertex])
+            {
+                remap[vertex] = it->second;
+                break;
+            }
+        }
+        if (remap[vertex] == vertex)
+            unique_vertices.emplace(hash, vertex);
+    }
+
+    return remap;
+}
+
+/// Reorders triangles for post-transform cache locality, using Tipsify (Sander et al. 2007).
+void optimize_vertex_cache(std::vector<uint32_t> &indices, size_t vertex_count,
+                           uint32_t cache_size = vertex_cache_size);
+
+/// Reorders clusters of a cache optimized index buffer, outward facing clusters on the outside of the mesh first.
+/// Falls back to the input order when it would make the cache hit rate more than threshold times worse.
+void optimize_overdraw(std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                       float threshold = 1.05f);
+
+/// Numbers the vertices in order of first use by the index buffer, and rewrites the indices to match.
+/// @return The remap table from old to new vertex indices, unused vertices map to invalid_vertex
+std::vector<uint32_t> optimize_vertex_fetch_remap(std::vector<uint32_t> &indices, size_t vertex_count);
+
+[[nodiscard]] VertexCacheStatistics analyze_vertex_cache(const std::vector<uint32_t> &indices, size_t vertex_count,
+                                                         uint32_t cache_size = vertex_cache_size);
+
+/// Applies a remap table to vertices. Several vertices mapping to the same index keep the first.
+template<typename VertexType>
+std::vector<VertexType> remap_vertices(const std::vector<VertexType> &vertices, const std::vector<uint32_t> &remap,
+                                       size_t new_vertex_count)
+{
+    std::vector<VertexType> remapped(new_vertex_count);
+    std::vector<bool> written(new_vertex_count, false);
+    for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+    {
+        uint32_t target = remap[vertex];
+        if (target != invalid_vertex && !written[target])
+        {
+            remapped[target] = vertices[vertex];
+            written[target] = true;
+        }
+    }
+    return remapped;
+}
+
+/// Runs the steps enabled in config on an indexed triangle list, in place. Takes a while on large meshes, so
+/// ColorModelManager::register_mesh_async runs it on a worker thread.
+template<typename VertexType>
+void optimize_mesh(std::vector<VertexType> &vertices, std::vector<uint32_t> &indices,
+                   const MeshOptimizationConfig &config = {})
+{
+    if (config.deduplicate_vertices)
+    {
+        auto remap = generate_duplicate_remap(vertices);
+        for (uint32_t &index: indices)
+        {
+            index = remap[index];
+        }
+    }
+
+    if (config.optimize_vertex_cache)
+        optimize_vertex_cache(indices, vertices.size());
+
+    if (config.optimize_overdraw)
+    {
+        std::vector<glm::vec3> positions(vertices.size());
+        for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+        {
+            positions[vertex] = vertices[vertex].position;
+        }
+        optimize_overdraw(indices, positions, config.overdraw_threshold);
+    }
+
+    // Also drops the duplicates, which nothing references anymore
+    if (config.optimize_vertex_fetch || config.deduplicate_vertices)
+    {
+        auto remap = optimize_vertex_fetch_remap(indices, vertices.size());
+        size_t vertex_count = 0;
+        for (uint32_t target: remap)
+        {
+            if (target != invalid_vertex)
+                vertex_count = std::max<size_t>(vertex_count, target + 1);
+        }
+        vertices = remap_vertices(vertices, remap, vertex_count);
+    }
+}
+
+}// namespace flwfrg
@@ -0,0 +1,330 @@
+#include "pch.hpp"
+
+#include "mesh_simplifier.hpp"
+
+#include "mesh_optimizer.hpp"
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <queue>
+#include <unordered_map>
+
+namespace flwfrg
+{
+
+namespace
+{
+
+// Sum of squared distances to a set of planes, as the symmetric matrix [A b; b^T c]
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    // Total area of the planes, dividing by it turns the error into a squared distance
+    double weight = 0;
+
+    static Quadric from_plane(glm::dvec3 normal, double distance, double weight)
+    {
+        return Quadric{
+                .a00 = weight * normal.x * normal.x,
+                .a01 = weight * normal.x * normal.y,
+                .a02 = weight * normal.x * normal.z,
+                .a11 = weight * normal.y * normal.y,
+                .a12 = weight * normal.y * normal.z,
+                .a22 = weight * normal.z * normal.z,
+                .b0 = weight * normal.x * distance,
+                .b1 = weight * normal.y * distance,
+                .b2 = weight * normal.z * distance,
+                .c = weight * distance * distance,
+                .weight = weight,
+        };
+    }
+
+    Quadric &operator+=(const Quadric &other)
+    {
+        a00 += other.a00;
+        a01 += other.a01;
+        a02 += other.a02;
+        a11 += other.a11;
+        a12 += other.a12;
+        a22 += other.a22;
+        b0 += other.b0;
+        b1 += other.b1;
+        b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+        return *this;
+    }
+
+    [[nodiscard]] double evaluate(glm::dvec3 p) const
+    {
+        double result = a00 * p.x * p.x + 2 * a01 * p.x * p.y + 2 * a02 * p.x * p.z + a11 * p.y * p.y +
+                        2 * a12 * p.y * p.z + a22 * p.z * p.z + 2 * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+        // Rounding can take it slightly below zero
+        return weight > 0 ? std::max(result, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    uint32_t from;
+    uint32_t to;
+    // Versions of both vertices when the cost was computed, collapses of vertices changed since are stale
+    uint32_t from_version;
+    uint32_t to_version;
+
+    bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+}// namespace
+
+std::vector<uint32_t> simplify_mesh(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                                    size_t target_index_count, float target_error, float *result_error)
+{
+    size_t vertex_count = positions.size();
+    size_t triangle_count = indices.size() / 3;
+
+    std::vector<uint32_t> result = indices;
+    std::vector<bool> triangle_alive(triangle_count, true);
+    size_t alive_index_count = indices.size();
+
+    std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+    for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            vertex_triangles[indices[triangle * 3 + corner]].push_back(triangle);
+        }
+    }
+
+    // Quadrics of the planes of the triangles around each vertex, weighted by area
+    std::vector<Quadric> quadrics(vertex_count);
+    for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+    {
+        glm::dvec3 a = positions[indices[triangle * 3 + 0]];
+        glm::dvec3 b = positions[indices[triangle * 3 + 1]];
+        glm::dvec3 c = positions[indices[triangle * 3 + 2]];
+
+        glm::dvec3 normal = glm::cross(b - a, c - a);
+        double double_area = glm::length(normal);
+        if (double_area <= 0.0)
+            continue;
+        normal /= double_area;
+
+        Quadric quadric = Quadric::from_plane(normal, -glm::dot(normal, a), double_area * 0.5);
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            quadrics[indices[triangle * 3 + corner]] += quadric;
+        }
+    }
+
+    // Border edges are used by one triangle only, and moving their vertices would open holes
+    std::vector<bool> locked(vertex_count, false);
+    {
+        std::map<std::pair<uint32_t, uint32_t>, uint32_t> edge_use_counts{};
+        for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t a = indices[triangle * 3 + corner];
+                uint32_t b = indices[triangle * 3 + (corner + 1) % 3];
+                edge_use_counts[{std::min(a, b), std::max(a, b)}]++;
+            }
+        }
+        for (const auto &[edge, use_count]: edge_use_counts)
+        {
+            if (use_count == 1)
+            {
+                locked[edge.first] = true;
+                locked[edge.second] = true;
+            }
+        }
+
+        // Seams, moving one vertex of a seam would tear it apart
+        std::unordered_map<size_t, uint32_t> first_at_position{};
+        auto hash_position = [](const glm::vec3 &position) {
+            return std::hash<float>{}(position.x) ^ (std::hash<float>{}(position.y) << 1) ^
+                   (std::hash<float>{}(position.z) << 2);
+        };
+        for (uint32_t vertex = 0; vertex < vertex_count; vertex++)
+        {
+            if (vertex_triangles[vertex].empty())
+                continue;
+
+            auto [it, inserted] = first_at_position.try_emplace(hash_position(positions[vertex]), vertex);
+            if (!inserted && positions[it->second] == positions[vertex])
+            {
+                locked[vertex] = true;
+                locked[it->second] = true;
+            }
+        }
+    }
+
+    std::vector<uint32_t> versions(vertex_count, 0);
+    std::vector<bool> removed(vertex_count, false);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> collapses{};
+
+    auto push_collapse = [&](uint32_t from, uint32_t to) {
+        if (from == to || locked[from])
+            return;
+
+        Quadric quadric = quadrics[from];
+        quadric += quadrics[to];
+        collapses.push(Collapse{
+                .cost = quadric.evaluate(positions[to]),
+                .from = from,
+                .to = to,
+                .from_version = versions[from],
+                .to_version = versions[to],
+        });
+    };
+    auto push_collapses_around = [&](uint32_t vertex) {
+        for (uint32_t triangle: vertex_triangles[vertex])
+        {
+            if (!triangle_alive[triangle])
+                continue;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t other = result[triangle * 3 + corner];
+                push_collapse(vertex, other);
+                push_collapse(other, vertex);
+            }
+        }
+    };
+
+    for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+    {
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            push_collapse(indices[triangle * 3 + corner], indices[triangle * 3 + (corner + 1) % 3]);
+            push_collapse(indices[triangle * 3 + (corner + 1) % 3], indices[triangle * 3 + corner]);
+        }
+    }
+
+    double max_cost = static_cast<double>(target_error) * static_cast<double>(target_error);
+    double largest_cost = 0.0;
+    while (alive_index_count > target_index_count && !collapses.empty())
+    {
+        Collapse collapse = collapses.top();
+        collapses.pop();
+
+        if (collapse.cost > max_cost)
+            break;
+        if (removed[collapse.from] || removed[collapse.to] || versions[collapse.from] != collapse.from_version ||
+            versions[collapse.to] != collapse.to_version)
+            continue;
+
+        // Collapses that would flip a remaining triangle over fold the surface onto itself
+        bool flips = false;
+        for (uint32_t triangle: vertex_triangles[collapse.from])
+        {
+            if (!triangle_alive[triangle])
+                continue;
+
+            glm::vec3 corners[3];
+            glm::vec3 moved[3];
+            bool has_target = false;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                uint32_t vertex = result[triangle * 3 + corner];
+                has_target |= vertex == collapse.to;
+                corners[corner] = positions[vertex];
+                moved[corner] = vertex == collapse.from ? positions[collapse.to] : positions[vertex];
+            }
+            if (has_target)
+                continue;
+
+            glm::vec3 normal_before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+            glm::vec3 normal_after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+            if (glm::dot(normal_before, normal_after) <= 0.0f)
+            {
+                flips = true;
+                break;
+            }
+        }
+        if (flips)
+            continue;
+
+        // Triangles on the collapsed edge disappear, the others move onto the remaining vertex
+        for (uint32_t triangle: vertex_triangles[collapse.from])
+        {
+            if (!triangle_alive[triangle])
+                continue;
+
+            bool has_target = false;
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                has_target |= result[triangle * 3 + corner] == collapse.to;
+            }
+
+            if (has_target)
+            {
+                triangle_alive[triangle] = false;
+                alive_index_count -= 3;
+                continue;
+            }
+
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                if (result[triangle * 3 + corner] == collapse.from)
+                    result[triangle * 3 + corner] = collapse.to;
+            }
+            vertex_triangles[collapse.to].push_back(triangle);
+        }
+
+        quadrics[collapse.to] += quadrics[collapse.from];
+        removed[collapse.from] = true;
+        versions[collapse.to]++;
+        largest_cost = std::max(largest_cost, collapse.cost);
+
+        push_collapses_around(collapse.to);
+    }
+
+    std::vector<uint32_t> simplified{};
+    simplified.reserve(alive_index_count);
+    for (uint32_t triangle = 0; triangle < triangle_count; triangle++)
+    {
+        if (triangle_alive[triangle])
+            simplified.insert(simplified.end(), result.begin() + triangle * 3, result.begin() + triangle * 3 + 3);
+    }
+
+    if (result_error != nullptr)
+        *result_error = static_cast<float>(std::sqrt(largest_cost));
+
+    return simplified;
+}
+
+std::vector<LodLevel> generate_lod_chain(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                                         const LodConfig &config)
+{
+    std::vector<LodLevel> levels{};
+    levels.push_back(LodLevel{.indices = indices, .error = 0.0f});
+
+    uint32_t level_count = std::min(config.level_count, max_lod_count);
+    while (levels.size() < level_count)
+    {
+        const LodLevel &previous = levels.back();
+        size_t target_index_count =
+                static_cast<size_t>(static_cast<float>(previous.indices.size() / 3) * config.reduction) * 3;
+
+        // Always from the full detail mesh, so the error is measured against it
+        float error = 0.0f;
+        auto simplified =
+                simplify_mesh(indices, positions, target_index_count, std::numeric_limits<float>::max(), &error);
+
+        // Nothing left to take away without opening holes
+        if (simplified.empty() || static_cast<float>(simplified.size()) >
+                                          static_cast<float>(previous.indices.size()) * (1.0f - config.min_reduction))
+            break;
+
+        optimize_vertex_cache(simplified, positions.size());
+        levels.push_back(LodLevel{.indices = std::move(simplified), .error = std::max(previous.error, error)});
+    }
+
+    return levels;
+}
+
+}// namespace flwfrg
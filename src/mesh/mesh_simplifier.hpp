@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace flwfrg
+{
+
+constexpr uint32_t max_lod_count = 6;
+
+struct LodConfig
+{
+    // Including the full detail mesh, at most max_lod_count. 1 generates no LODs.
+    uint32_t level_count = 1;
+    // Each level keeps this fraction of the triangles of the one before it
+    float reduction = 0.5f;
+    // Levels simplifying less than this fraction of the triangles end the chain early
+    float min_reduction = 0.05f;
+};
+
+struct LodLevel
+{
+    std::vector<uint32_t> indices{};
+    // How far the surface may be off from the full detail mesh, in the units of the vertex positions
+    float error = 0.0f;
+};
+
+/// Simplifies an indexed triangle list by collapsing edges, cheapest first by quadric error (Garland and Heckbert
+/// 1997). Vertices only ever collapse onto other vertices, so the result indexes the same vertex buffer. Vertices on
+/// borders or on seams (several vertices at one position, e.g. with different colors) are never moved.
+/// @param target_index_count Stops once the result has no more indices than this
+/// @param target_error Stops before a collapse would move the surface further than this
+/// @param result_error Set to the largest error of a collapse that was done
+/// @return The simplified indices
+std::vector<uint32_t> simplify_mesh(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                                    size_t target_index_count, float target_error, float *result_error = nullptr);
+
+/// Generates a LOD chain, the first level being the given indices. Every level has config.reduction times the
+/// triangles of the one before it, and is ordered for the vertex cache.
+std::vector<LodLevel> generate_lod_chain(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                                         const LodConfig &config);
+
+}// namespace flwfrg
@@ -0,0 +1,169 @@
+#include "pch.hpp"
+
+#include "meshlet_builder.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+namespace flwfrg
+{
+
+MeshletData build_meshlets(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                           uint32_t max_vertices, uint32_t max_triangles)
+{
+    // 0xff marks vertices outside the meshlet
+    assert(max_vertices >= 3 && max_vertices < 256);
+    assert(max_triangles >= 1);
+
+    MeshletData data{};
+    data.vertices.reserve(indices.size() / 3 + max_vertices);
+    data.triangles.reserve(indices.size() / 3);
+
+    // Index of each vertex in the current meshlet, or none
+    constexpr uint8_t not_in_meshlet = 0xff;
+    std::vector<uint8_t> local_indices(positions.size(), not_in_meshlet);
+    Meshlet meshlet{};
+
+    auto finish_meshlet = [&]() {
+        if (meshlet.triangle_count == 0)
+            return;
+
+        for (uint32_t vertex = 0; vertex < meshlet.vertex_count; vertex++)
+        {
+            local_indices[data.vertices[meshlet.vertex_offset + vertex]] = not_in_meshlet;
+        }
+        data.meshlets.push_back(meshlet);
+        meshlet = Meshlet{
+                .vertex_offset = static_cast<uint32_t>(data.vertices.size()),
+                .triangle_offset = static_cast<uint32_t>(data.triangles.size()),
+        };
+    };
+
+    for (size_t triangle = 0; triangle < indices.size() / 3; triangle++)
+    {
+        const uint32_t *corners = &indices[triangle * 3];
+
+        uint32_t new_vertex_count = 0;
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            // Degenerate triangles name a vertex twice, counting it once is enough
+            bool repeated = (corner > 0 && corners[corner] == corners[0]) ||
+                            (corner > 1 && corners[corner] == corners[1]);
+            if (local_indices[corners[corner]] == not_in_meshlet && !repeated)
+                new_vertex_count++;
+        }
+
+        if (meshlet.vertex_count + new_vertex_count > max_vertices || meshlet.triangle_count + 1 > max_triangles)
+            finish_meshlet();
+
+        uint32_t packed = 0;
+        for (uint32_t corner = 0; corner < 3; corner++)
+        {
+            uint8_t &local_index = local_indices[corners[corner]];
+            if (local_index == not_in_meshlet)
+            {
+                local_index = static_cast<uint8_t>(meshlet.vertex_count++);
+                data.vertices.push_back(corners[corner]);
+            }
+            packed |= static_cast<uint32_t>(local_index) << (corner * 8);
+        }
+        data.triangles.push_back(packed);
+        meshlet.triangle_count++;
+    }
+    finish_meshlet();
+
+    data.bounds.reserve(data.meshlets.size());
+    for (const Meshlet &built: data.meshlets)
+    {
+        data.bounds.push_back(compute_meshlet_bounds(data, built, positions));
+    }
+
+    return data;
+}
+
+MeshletBounds compute_meshlet_bounds(const MeshletData &data, const Meshlet &meshlet,
+                                     const std::vector<glm::vec3> &positions)
+{
+    MeshletBounds bounds{};
+    if (meshlet.vertex_count == 0)
+        return bounds;
+
+    // Sphere around the center of the bounding box, not minimal but close for the compact clusters built here
+    glm::vec3 min = positions[data.vertices[meshlet.vertex_offset]];
+    glm::vec3 max = min;
+    for (uint32_t vertex = 1; vertex < meshlet.vertex_count; vertex++)
+    {
+        const glm::vec3 &position = positions[data.vertices[meshlet.vertex_offset + vertex]];
+        min = glm::min(min, position);
+        max = glm::max(max, position);
+    }
+    bounds.center = (min + max) * 0.5f;
+    for (uint32_t vertex = 0; vertex < meshlet.vertex_count; vertex++)
+    {
+        const glm::vec3 &position = positions[data.vertices[meshlet.vertex_offset + vertex]];
+        bounds.radius = std::max(bounds.radius, glm::length(position - bounds.center));
+    }
+
+    auto triangle_corner = [&](uint32_t triangle, uint32_t corner) -> const glm::vec3 & {
+        uint32_t local_index = (data.triangles[meshlet.triangle_offset + triangle] >> (corner * 8)) & 0xff;
+        return positions[data.vertices[meshlet.vertex_offset + local_index]];
+    };
+
+    // Normal cone, around the average of the triangle normals
+    std::vector<glm::vec3> normals{};
+    normals.reserve(meshlet.triangle_count);
+    glm::vec3 normal_sum{0.0f};
+    for (uint32_t triangle = 0; triangle < meshlet.triangle_count; triangle++)
+    {
+        const glm::vec3 &a = triangle_corner(triangle, 0);
+        glm::vec3 normal = glm::cross(triangle_corner(triangle, 1) - a, triangle_corner(triangle, 2) - a);
+        float length = glm::length(normal);
+        if (length <= 0.0f)
+        {
+            normals.emplace_back(0.0f);
+            continue;
+        }
+        normals.push_back(normal / length);
+        normal_sum += normals.back();
+    }
+
+    float axis_length = glm::length(normal_sum);
+    if (axis_length <= 0.0f)
+        return bounds;
+    glm::vec3 axis = normal_sum / axis_length;
+
+    float min_dot = 1.0f;
+    for (const glm::vec3 &normal: normals)
+    {
+        if (normal != glm::vec3{0.0f})
+            min_dot = std::min(min_dot, glm::dot(axis, normal));
+    }
+
+    // Normals spread over close to a half sphere or more, no view direction sees only back faces
+    if (min_dot <= 0.1f)
+        return bounds;
+
+    // Move the apex back along the axis until it is behind every triangle's plane, so the test holds for cameras
+    // close to the cluster as well as far away
+    float max_t = std::numeric_limits<float>::lowest();
+    for (uint32_t triangle = 0; triangle < meshlet.triangle_count; triangle++)
+    {
+        const glm::vec3 &normal = normals[triangle];
+        if (normal == glm::vec3{0.0f})
+            continue;
+        max_t = std::max(max_t, glm::dot(bounds.center - triangle_corner(triangle, 0), normal) /
+                                        glm::dot(axis, normal));
+    }
+
+    bounds.cone_apex = bounds.center - axis * max_t;
+    bounds.cone_axis = axis;
+    // The cone's half angle is acos(min_dot), and every triangle faces away when the view direction is within
+    // 90 degrees minus that of the axis
+    bounds.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+
+    return bounds;
+}
+
+}// namespace flwfrg
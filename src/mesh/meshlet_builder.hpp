@@ -0,0 +1,63 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace flwfrg
+{
+
+// Sized so a cluster's triangles fit one 128 thread workgroup, and its local indices fit 8 bits
+constexpr uint32_t meshlet_max_vertices = 64;
+constexpr uint32_t meshlet_max_triangles = 124;
+
+// A cluster of triangles using at most meshlet_max_vertices vertices
+struct Meshlet
+{
+    // Into MeshletData::vertices
+    uint32_t vertex_offset = 0;
+    // Into MeshletData::triangles, in triangles
+    uint32_t triangle_offset = 0;
+    uint32_t vertex_count = 0;
+    uint32_t triangle_count = 0;
+};
+
+struct MeshletBounds
+{
+    // Bounding sphere
+    glm::vec3 center{0.0f};
+    float radius = 0.0f;
+
+    // Normal cone. Every triangle faces away from a camera at position when
+    // dot(normalize(cone_apex - position), cone_axis) >= cone_cutoff. Clusters too curved to ever be culled this way
+    // have a cutoff above 1.
+    glm::vec3 cone_apex{0.0f};
+    glm::vec3 cone_axis{0.0f};
+    float cone_cutoff = 2.0f;
+};
+
+struct MeshletData
+{
+    std::vector<Meshlet> meshlets{};
+    std::vector<MeshletBounds> bounds{};
+    // Vertex indices of the mesh, meshlet_max_vertices at most per meshlet
+    std::vector<uint32_t> vertices{};
+    // Triangles as indices into their meshlet's vertices, 8 bits each and packed into one word per triangle
+    std::vector<uint32_t> triangles{};
+};
+
+/// Splits an indexed triangle list into meshlets, keeping triangles in the order they are given. Best run on
+/// indices already ordered for the vertex cache (see optimize_vertex_cache), whose neighbouring triangles share
+/// vertices and sit close together, which keeps the clusters small and their bounds tight.
+/// @param positions Positions of the vertices, the bounds are in their space
+MeshletData build_meshlets(const std::vector<uint32_t> &indices, const std::vector<glm::vec3> &positions,
+                           uint32_t max_vertices = meshlet_max_vertices,
+                           uint32_t max_triangles = meshlet_max_triangles);
+
+[[nodiscard]] MeshletBounds compute_meshlet_bounds(const MeshletData &data, const Meshlet &meshlet,
+                                                   const std::vector<glm::vec3> &positions);
+
+}// namespace flwfrg
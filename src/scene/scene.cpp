@@ -0,0 +1,188 @@
+#include "pch.hpp"
+
+#include "scene.hpp"
+
+#include <type_traits>
+
+namespace flwfrg
+{
+
+Scene::node_id_t Scene::create_node(node_id_t parent, const Transform &local_transform)
+{
+    assert(parent == invalid_node || is_valid(parent));
+
+    node_id_t id;
+    if (free_ids_.empty())
+    {
+        id = static_cast<node_id_t>(indices_.size());
+        indices_.push_back(invalid_index);
+    }
+    else
+    {
+        id = free_ids_.back();
+        free_ids_.pop_back();
+    }
+
+    // Appended, which is after its parent
+    auto index = static_cast<uint32_t>(ids_.size());
+    indices_[id] = index;
+    parents_.push_back(parent == invalid_node ? no_parent : static_cast<int32_t>(indices_[parent]));
+    local_transforms_.push_back(local_transform);
+    world_matrices_.emplace_back(1.0f);
+    dirty_.push_back(false);
+    world_changed_.push_back(false);
+    ids_.push_back(id);
+    mark_dirty(index);
+
+    return id;
+}
+
+void Scene::destroy_node(node_id_t id)
+{
+    assert(is_valid(id));
+
+    uint32_t index = indices_[id];
+    auto in_subtree = find_subtree(index);
+
+    std::vector<uint32_t> new_order{};
+    new_order.reserve(ids_.size());
+    for (uint32_t node = 0; node < ids_.size(); node++)
+    {
+        if (node >= index && in_subtree[node - index])
+        {
+            indices_[ids_[node]] = invalid_index;
+            free_ids_.push_back(ids_[node]);
+        }
+        else
+        {
+            new_order.push_back(node);
+        }
+    }
+    reorder(new_order);
+}
+
+void Scene::set_parent(node_id_t id, node_id_t parent)
+{
+    assert(is_valid(id));
+    assert(parent == invalid_node || (is_valid(parent) && parent != id));
+
+    uint32_t index = indices_[id];
+    int32_t parent_index = parent == invalid_node ? no_parent : static_cast<int32_t>(indices_[parent]);
+
+    // Parents before children still holds
+    if (parent_index < static_cast<int32_t>(index))
+    {
+        parents_[index] = parent_index;
+        mark_dirty(index);
+        return;
+    }
+
+    // Otherwise the subtree moves behind everything else from index on, the new parent included. Nothing outside
+    // the subtree has a parent in it, so the order stays valid.
+    auto in_subtree = find_subtree(index);
+    assert(!in_subtree[parent_index - index] && "A node can not be moved below itself");
+
+    std::vector<uint32_t> new_order(index);
+    for (uint32_t node = 0; node < index; node++)
+    {
+        new_order[node] = node;
+    }
+    for (uint32_t node = index; node < ids_.size(); node++)
+    {
+        if (!in_subtree[node - index])
+            new_order.push_back(node);
+    }
+    for (uint32_t node = index; node < ids_.size(); node++)
+    {
+        if (in_subtree[node - index])
+            new_order.push_back(node);
+    }
+    reorder(new_order);
+
+    index = indices_[id];
+    parents_[index] = static_cast<int32_t>(indices_[parent]);
+    mark_dirty(index);
+}
+
+void Scene::update()
+{
+    changed_nodes_.clear();
+
+    auto node_count = static_cast<uint32_t>(ids_.size());
+    if (first_dirty_ >= node_count)
+    {
+        first_dirty_ = invalid_index;
+        return;
+    }
+
+    for (uint32_t index = first_dirty_; index < node_count; index++)
+    {
+        int32_t parent = parents_[index];
+        // Nodes before first_dirty_ have not changed, and their world_changed_ is left over from earlier updates
+        bool parent_changed = parent >= static_cast<int32_t>(first_dirty_) && world_changed_[parent];
+
+        bool changed = dirty_[index] || parent_changed;
+        world_changed_[index] = changed;
+        if (!changed)
+            continue;
+
+        glm::mat4 local_matrix = local_transforms_[index].mat4();
+        world_matrices_[index] = parent == no_parent ? local_matrix : world_matrices_[parent] * local_matrix;
+        dirty_[index] = false;
+        changed_nodes_.push_back(ids_[index]);
+    }
+
+    first_dirty_ = invalid_index;
+}
+
+std::vector<uint8_t> Scene::find_subtree(uint32_t index) const
+{
+    std::vector<uint8_t> in_subtree(ids_.size() - index, false);
+    in_subtree[0] = true;
+    for (uint32_t node = index + 1; node < ids_.size(); node++)
+    {
+        int32_t parent = parents_[node];
+        in_subtree[node - index] = parent >= static_cast<int32_t>(index) && in_subtree[parent - index];
+    }
+    return in_subtree;
+}
+
+void Scene::reorder(const std::vector<uint32_t> &new_order)
+{
+    std::vector<int32_t> new_indices(ids_.size(), no_parent);
+    for (uint32_t node = 0; node < new_order.size(); node++)
+    {
+        new_indices[new_order[node]] = static_cast<int32_t>(node);
+    }
+
+    auto permute = [&new_order](auto &values) {
+        std::remove_reference_t<decltype(values)> reordered{};
+        reordered.reserve(new_order.size());
+        for (uint32_t old_index: new_order)
+        {
+            reordered.push_back(values[old_index]);
+        }
+        values = std::move(reordered);
+    };
+
+    permute(parents_);
+    permute(local_transforms_);
+    permute(world_matrices_);
+    permute(dirty_);
+    permute(world_changed_);
+    permute(ids_);
+
+    // Parents left out of the new order were destroyed along with their children
+    uint32_t first_dirty = invalid_index;
+    for (uint32_t node = 0; node < ids_.size(); node++)
+    {
+        if (parents_[node] != no_parent)
+            parents_[node] = new_indices[parents_[node]];
+        indices_[ids_[node]] = node;
+        if (dirty_[node])
+            first_dirty = std::min(first_dirty, node);
+    }
+    first_dirty_ = first_dirty;
+}
+
+}// namespace flwfrg
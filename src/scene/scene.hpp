@@ -0,0 +1,130 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "math/transform.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace flwfrg
+{
+
+/// A hierarchy of transforms, each node's world matrix being its parent's times its own local transform.
+///
+/// Nodes live in flat arrays sorted so parents come before their children, which lets update propagate world
+/// matrices in a single forward pass. Only nodes whose local transform changed, and their descendants, have their
+/// world matrices recomputed. New nodes are appended, and the pass starts at the first changed node, so content
+/// that never moves is neither recomputed nor visited when it was created before the nodes being animated.
+///
+/// Node ids stay the same while reparenting and destroying other nodes moves nodes around in the arrays.
+class Scene
+{
+public:
+    typedef int32_t node_id_t;
+
+    static constexpr node_id_t invalid_node = -1;
+
+public:
+    Scene() = default;
+    ~Scene() = default;
+
+    // Copy
+    Scene(const Scene &) = default;
+    Scene &operator=(const Scene &) = default;
+    // Move
+    Scene(Scene &&other) noexcept = default;
+    Scene &operator=(Scene &&other) noexcept = default;
+
+    // Methods
+
+    node_id_t create_node(node_id_t parent = invalid_node, const Transform &local_transform = {});
+    /// Destroys the node and every node below it
+    void destroy_node(node_id_t id);
+    /// Moves the node, with everything below it, under another parent. The parent must not be below the node.
+    void set_parent(node_id_t id, node_id_t parent);
+
+    /// Recomputes the world matrices of the nodes that changed since the last update, and of everything below them
+    void update();
+
+    [[nodiscard]] inline bool is_valid(node_id_t id) const
+    {
+        return id >= 0 && id < static_cast<node_id_t>(indices_.size()) && indices_[id] != invalid_index;
+    }
+
+    [[nodiscard]] inline node_id_t get_parent(node_id_t id) const
+    {
+        assert(is_valid(id));
+        int32_t parent_index = parents_[indices_[id]];
+        return parent_index == no_parent ? invalid_node : ids_[parent_index];
+    }
+
+    [[nodiscard]] inline const Transform &get_local_transform(node_id_t id) const
+    {
+        assert(is_valid(id));
+        return local_transforms_[indices_[id]];
+    }
+
+    inline void set_local_transform(node_id_t id, const Transform &local_transform)
+    {
+        assert(is_valid(id));
+        uint32_t index = indices_[id];
+        local_transforms_[index] = local_transform;
+        mark_dirty(index);
+    }
+
+    /// As of the last update
+    [[nodiscard]] inline const glm::mat4 &get_world_matrix(node_id_t id) const
+    {
+        assert(is_valid(id));
+        return world_matrices_[indices_[id]];
+    }
+
+    /// Nodes whose world matrix the last update changed, e.g. to upload only those (see vk::SceneBuffer)
+    [[nodiscard]] inline const std::vector<node_id_t> &get_changed_nodes() const { return changed_nodes_; };
+
+    [[nodiscard]] inline size_t get_node_count() const { return ids_.size(); };
+    /// Every node id is below this
+    [[nodiscard]] inline node_id_t get_id_capacity() const { return static_cast<node_id_t>(indices_.size()); };
+
+private:
+    static constexpr int32_t no_parent = -1;
+    static constexpr uint32_t invalid_index = std::numeric_limits<uint32_t>::max();
+
+    // Indexed by position in the hierarchy, parents before children
+    std::vector<int32_t> parents_{};
+    std::vector<Transform> local_transforms_{};
+    std::vector<glm::mat4> world_matrices_{};
+    // Local transform changed since the last update
+    std::vector<uint8_t> dirty_{};
+    std::vector<node_id_t> ids_{};
+
+    // Position in the hierarchy of every node id
+    std::vector<uint32_t> indices_{};
+    std::vector<node_id_t> free_ids_{};
+
+    // Nothing before this is dirty, so update starts here
+    uint32_t first_dirty_ = invalid_index;
+    // Scratch space for update, set for the nodes it recomputes
+    std::vector<uint8_t> world_changed_{};
+    std::vector<node_id_t> changed_nodes_{};
+
+    inline void mark_dirty(uint32_t index)
+    {
+        dirty_[index] = true;
+        first_dirty_ = std::min(first_dirty_, index);
+    }
+
+    /// Marks the nodes in the subtree of the node at index, which can only be after it
+    /// @return Whether each node from index on is in the subtree
+    [[nodiscard]] std::vector<uint8_t> find_subtree(uint32_t index) const;
+    /// Reorders the hierarchy, new_order listing the old index of every node in its new place
+    void reorder(const std::vector<uint32_t> &new_order);
+};
+
+}// namespace flwfrg
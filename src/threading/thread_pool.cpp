@@ -0,0 +1,130 @@
+#include "pch.hpp"
+
+#include "thread_pool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <latch>
+
+namespace flwfrg
+{
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    assert(thread_count > 0);
+
+    workers_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        workers_.emplace_back([this]() { worker_loop(); });
+    }
+
+    FLOWFORGE_TRACE("Thread pool created with {} workers", thread_count);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{mutex_};
+        stopping_ = true;
+    }
+    condition_.notify_all();
+
+    for (auto &worker: workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard lock{mutex_};
+        tasks_.emplace_back(std::move(task));
+    }
+    condition_.notify_one();
+}
+
+void ThreadPool::parallel_for(size_t task_count, const std::function<void(size_t)> &function)
+{
+    if (task_count == 0)
+        return;
+
+    // Helpers can be dequeued after every task is done and this call has returned, so the state they touch
+    // past the last task has to outlive this stack frame.
+    struct SharedState
+    {
+        explicit SharedState(size_t count, const std::function<void(size_t)> *task_function)
+            : remaining{static_cast<std::ptrdiff_t>(count)}, task_count{count}, function{task_function}
+        {}
+
+        std::atomic<size_t> next_index{0};
+        std::latch remaining;
+        size_t task_count;
+        const std::function<void(size_t)> *function;
+
+        std::mutex exception_mutex{};
+        std::exception_ptr exception{};
+    };
+    auto state = std::make_shared<SharedState>(task_count, &function);
+
+    auto run_tasks = [state]() {
+        for (size_t i = state->next_index.fetch_add(1); i < state->task_count; i = state->next_index.fetch_add(1))
+        {
+            try
+            {
+                (*state->function)(i);
+            }
+            catch (...)
+            {
+                // Kept for the calling thread, a worker has no one to throw to
+                std::lock_guard lock{state->exception_mutex};
+                if (!state->exception)
+                    state->exception = std::current_exception();
+            }
+            state->remaining.count_down();
+        }
+    };
+
+    // No need to wake more workers than there are tasks left after the calling thread takes one
+    size_t helper_count = std::min(workers_.size(), task_count - 1);
+    for (size_t i = 0; i < helper_count; i++)
+    {
+        enqueue(run_tasks);
+    }
+
+    run_tasks();
+    state->remaining.wait();
+
+    if (state->exception)
+        std::rethrow_exception(state->exception);
+}
+
+size_t ThreadPool::default_thread_count()
+{
+    // Leave a core for the thread owning the pool
+    size_t hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 1;
+}
+
+void ThreadPool::worker_loop()
+{
+    while (true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{mutex_};
+            condition_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+
+            if (stopping_ && tasks_.empty())
+                return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
+
+}// namespace flwfrg
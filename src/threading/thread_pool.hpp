@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace flwfrg
+{
+
+/// Fixed size pool of worker threads consuming a shared FIFO queue of tasks.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(size_t thread_count = default_thread_count());
+    ~ThreadPool();
+
+    // Not copyable or movable, the workers hold a pointer to the pool
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    // Methods
+
+    [[nodiscard]] inline size_t get_thread_count() const { return workers_.size(); }
+
+    void enqueue(std::function<void()> task);
+
+    template<typename FUNCTION_T>
+    auto submit(FUNCTION_T &&function) -> std::future<decltype(function())>
+    {
+        using result_t = decltype(function());
+        auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<FUNCTION_T>(function));
+        std::future<result_t> future = task->get_future();
+        enqueue([task]() { (*task)(); });
+        return future;
+    }
+
+    /// Calls function(task_index) for every index in [0, task_count) spread over the workers, and blocks until all
+    /// of them have returned. The calling thread runs tasks as well instead of idling. The first exception a task
+    /// throws is rethrown here once every task is done, the other tasks still run.
+    void parallel_for(size_t task_count, const std::function<void(size_t)> &function);
+
+    static size_t default_thread_count();
+
+private:
+    std::vector<std::thread> workers_{};
+
+    std::mutex mutex_{};
+    std::condition_variable condition_{};
+    std::deque<std::function<void()>> tasks_{};
+    bool stopping_ = false;
+
+    void worker_loop();
+};
+
+}// namespace flwfrg
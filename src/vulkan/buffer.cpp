@@ -5,6 +5,8 @@
 #include "command_buffer.hpp"
 #include "device.hpp"
 
+#include <algorithm>
+
 namespace flwfrg::vk
 {
 
@@ -56,17 +58,20 @@ Buffer::Buffer(Device* device, uint64_t size, VkBufferUsageFlagBits usage, uint3
 
 Buffer::~Buffer()
 {
-	if (handle_.not_null())
+	if (handle_.not_null() || memory_.not_null())
 	{
-		vkDestroyBuffer(device_->get_logical_device(), handle_, nullptr);
-	    handle_ = {};
+		// The GPU may still be reading from or writing to the buffer
+		device_->defer_destruction([device = device_->get_logical_device(), buffer = static_cast<VkBuffer>(handle_),
+		                            memory = static_cast<VkDeviceMemory>(memory_)]() {
+			if (buffer != VK_NULL_HANDLE)
+				vkDestroyBuffer(device, buffer, nullptr);
+			if (memory != VK_NULL_HANDLE)
+				vkFreeMemory(device, memory, nullptr);
+		});
+		handle_ = {};
+		memory_ = {};
 		FLOWFORGE_TRACE("Vulkan Buffer destroyed");
 	}
-	if (memory_.not_null())
-	{
-		vkFreeMemory(device_->get_logical_device(), memory_, nullptr);
-	    memory_ = {};
-	}
 }
 
 void Buffer::resize(uint64_t new_size, VkQueue queue, VkCommandPool pool)
@@ -75,21 +80,10 @@ void Buffer::resize(uint64_t new_size, VkQueue queue, VkCommandPool pool)
 	Buffer new_buffer{device_, new_size, usage_, memory_property_flags_, true};
 
 	// Copy the data
-	copy_to(new_buffer, 0, new_size, 0, pool, VK_NULL_HANDLE, queue);
-
-	// Wait for device to be idle
-	vkDeviceWaitIdle(device_->get_logical_device());
-
-	if (handle_.not_null())
-	{
-		vkDestroyBuffer(device_->get_logical_device(), handle_, nullptr);
-	}
-	if (memory_.not_null())
-	{
-		vkFreeMemory(device_->get_logical_device(), memory_, nullptr);
-	}
+	copy_to(new_buffer, 0, std::min(total_size_, new_size), 0, pool, VK_NULL_HANDLE, queue);
 
-	// Move the new buffer to this
+	// The old buffer is released once the copy (and any frame still using it) has completed
+	Buffer old_buffer = std::move(*this);
 	*this = std::move(new_buffer);
 }
 
@@ -135,11 +129,25 @@ void Buffer::upload_data(const void *data, uint64_t offset, uint64_t size, VkCom
 
 void Buffer::copy_to(Buffer &dst, uint64_t dst_offset, uint64_t dst_size, uint64_t src_offset, VkCommandPool pool, VkFence fence, VkQueue queue)
 {
-	vkQueueWaitIdle(queue);
-
 	// Create a one time use command buffer
 	CommandBuffer command_buffer = CommandBuffer::begin_single_time_commands(device_, pool);
 
+	// Earlier work on the queue may still be reading the destination range, which the copy must not overwrite early
+	VkBufferMemoryBarrier read_barrier{};
+	read_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	read_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+	                             VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+	                             VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	read_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	read_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	read_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	read_barrier.buffer = dst.handle_;
+	read_barrier.offset = dst_offset;
+	read_barrier.size = dst_size;
+
+	vkCmdPipelineBarrier(command_buffer.get_handle(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+	                     0, 0, nullptr, 1, &read_barrier, 0, nullptr);
+
 	// Copy the buffer
 	VkBufferCopy copy_region{};
 	copy_region.srcOffset = src_offset;
@@ -148,6 +156,20 @@ void Buffer::copy_to(Buffer &dst, uint64_t dst_offset, uint64_t dst_size, uint64
 
 	vkCmdCopyBuffer(command_buffer.get_handle(), handle_, dst.handle_, 1, &copy_region);
 
+	// Make the copy visible to any later work on the queue, instead of waiting for the queue to drain
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = dst.handle_;
+	barrier.offset = dst_offset;
+	barrier.size = dst_size;
+
+	vkCmdPipelineBarrier(command_buffer.get_handle(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+	                     0, 0, nullptr, 1, &barrier, 0, nullptr);
+
 	// End the command buffer
 	CommandBuffer::end_single_time_commands(device_, command_buffer, queue);
 }
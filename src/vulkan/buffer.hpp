@@ -52,6 +52,7 @@ public:
 	/// @param size The amount of data to upload (in bytes)
 	void upload_data(const void* data, uint64_t offset, uint64_t size, VkCommandPool pool, VkFence fence, VkQueue queue);
 
+	/// Copies into dst on queue, ordered after any earlier work on the queue that reads dst, and visible to any later.
 	void copy_to(Buffer &dst,
 				 uint64_t dst_offset,
 				 uint64_t dst_size,
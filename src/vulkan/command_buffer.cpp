@@ -3,6 +3,8 @@
 #include "command_buffer.hpp"
 #include "device.hpp"
 
+#include <array>
+
 namespace flwfrg::vk
 {
 
@@ -32,12 +34,17 @@ CommandBuffer::~CommandBuffer()
 {
 	if (state_ != State::NOT_ALLOCATED)
 	{
-		vkFreeCommandBuffers(device_->get_logical_device(), pool_handle_, 1, handle_.ptr());
+		// The command buffer may still be pending execution
+		device_->defer_destruction([device = device_->get_logical_device(), pool = pool_handle_,
+		                            command_buffer = static_cast<VkCommandBuffer>(handle_)]() {
+			vkFreeCommandBuffers(device, pool, 1, &command_buffer);
+		});
 	}
 }
 
 
-void CommandBuffer::begin(bool is_single_use, bool is_renderpass_continue, bool is_simultaneous_use)
+void CommandBuffer::begin(bool is_single_use, bool is_renderpass_continue, bool is_simultaneous_use,
+                          const VkCommandBufferInheritanceInfo *inheritance_info)
 {
 	if (state_ != State::READY)
 	{
@@ -50,6 +57,7 @@ void CommandBuffer::begin(bool is_single_use, bool is_renderpass_continue, bool
 	begin_info.flags |= is_single_use ? VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT : 0;
 	begin_info.flags |= is_renderpass_continue ? VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT : 0;
 	begin_info.flags |= is_simultaneous_use ? VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT : 0;
+	begin_info.pInheritanceInfo = inheritance_info;
 
 	if (vkBeginCommandBuffer(handle_, &begin_info) != VK_SUCCESS)
 	{
@@ -73,28 +81,72 @@ void CommandBuffer::end()
 	state_ = State::RECORDING_ENDED;
 }
 
-void CommandBuffer::submit(VkQueue queue, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore, VkFence fence, VkPipelineStageFlags *flags)
+void CommandBuffer::submit(VkQueue queue, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore, VkFence fence, VkPipelineStageFlags *flags,
+                           uint64_t timeline_wait_value)
 {
 	if (state_ != State::RECORDING_ENDED)
 	{
 		throw std::runtime_error("Command buffer not ready to submit");
 	}
 
+	// Binary semaphores ignore their value, but the arrays have to line up with the semaphores
+	std::array<VkSemaphore, 2> wait_semaphores{};
+	std::array<uint64_t, 2> wait_values{};
+	std::array<VkPipelineStageFlags, 2> wait_stages{};
+	uint32_t wait_count = 0;
+	if (wait_semaphore != VK_NULL_HANDLE)
+	{
+		wait_semaphores[wait_count] = wait_semaphore;
+		wait_stages[wait_count] = flags != nullptr ? *flags : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		wait_count++;
+	}
+	if (timeline_wait_value != 0)
+	{
+		wait_semaphores[wait_count] = device_->get_timeline_semaphore();
+		wait_values[wait_count] = timeline_wait_value;
+		wait_stages[wait_count] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		wait_count++;
+	}
+
+	uint64_t signal_value = device_->get_next_submit_value();
+
+	std::array<VkSemaphore, 2> signal_semaphores{};
+	std::array<uint64_t, 2> signal_values{};
+	uint32_t signal_count = 0;
+	signal_semaphores[signal_count] = device_->get_timeline_semaphore();
+	signal_values[signal_count] = signal_value;
+	signal_count++;
+	if (signal_semaphore != VK_NULL_HANDLE)
+	{
+		signal_semaphores[signal_count] = signal_semaphore;
+		signal_count++;
+	}
+
+	VkTimelineSemaphoreSubmitInfo timeline_info{};
+	timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timeline_info.waitSemaphoreValueCount = wait_count;
+	timeline_info.pWaitSemaphoreValues = wait_values.data();
+	timeline_info.signalSemaphoreValueCount = signal_count;
+	timeline_info.pSignalSemaphoreValues = signal_values.data();
+
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit_info.waitSemaphoreCount = wait_semaphore != VK_NULL_HANDLE ? 1 : 0;
-	submit_info.pWaitSemaphores = &wait_semaphore;
-	submit_info.pWaitDstStageMask = flags;
+	submit_info.pNext = &timeline_info;
+	submit_info.waitSemaphoreCount = wait_count;
+	submit_info.pWaitSemaphores = wait_semaphores.data();
+	submit_info.pWaitDstStageMask = wait_stages.data();
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = handle_.ptr();
-	submit_info.signalSemaphoreCount = signal_semaphore != VK_NULL_HANDLE ? 1 : 0;
-	submit_info.pSignalSemaphores = &signal_semaphore;
+	submit_info.signalSemaphoreCount = signal_count;
+	submit_info.pSignalSemaphores = signal_semaphores.data();
 
 	if (vkQueueSubmit(queue, 1, &submit_info, fence) != VK_SUCCESS)
 	{
 		throw std::runtime_error("Failed to submit command buffer");
 	}
 
+	device_->mark_submitted(signal_value);
+	submitted_value_ = signal_value;
 	state_ = State::SUBMITTED;
 }
 
@@ -115,7 +167,7 @@ void CommandBuffer::reset()
 
 CommandBuffer CommandBuffer::begin_single_time_commands(Device *device, VkCommandPool pool)
 {
-	CommandBuffer command_buffer{device, pool, true};
+	CommandBuffer command_buffer = device->acquire_single_time_command_buffer(pool);
 	command_buffer.begin(true, false, false);
 	return command_buffer;
 }
@@ -123,13 +175,8 @@ CommandBuffer CommandBuffer::begin_single_time_commands(Device *device, VkComman
 void CommandBuffer::end_single_time_commands(Device *device, CommandBuffer &command_buffer, VkQueue queue)
 {
 	command_buffer.end();
-	command_buffer.submit(queue, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE);
-	// Wait for it to finish and check result
-	if (vkQueueWaitIdle(queue) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to wait for queue to finish");
-	}
-	command_buffer.reset();
+	// Tracked on the device timeline, and recycled once it has executed
+	device->submit_single_time_command_buffer(std::move(command_buffer), queue);
 }
 
 }// namespace flwfrg::vk
\ No newline at end of file
@@ -32,7 +32,8 @@ public:
 		: device_{std::move(other.device_)},
 		  handle_{std::move(other.handle_)},
 		  pool_handle_{std::move(other.pool_handle_)},
-		  state_{std::move(other.state_)}
+		  state_{std::move(other.state_)},
+		  submitted_value_{other.submitted_value_}
 	{
 		other.state_ = State::NOT_ALLOCATED;
 		other.handle_ = Handle<VkCommandBuffer>{};
@@ -48,6 +49,7 @@ public:
 			handle_ = std::move(other.handle_);
 			pool_handle_ = std::move(other.pool_handle_);
 			state_ = std::move(other.state_);
+			submitted_value_ = other.submitted_value_;
 
 			other.state_ = State::NOT_ALLOCATED;
 			other.handle_ = Handle<VkCommandBuffer>{};
@@ -59,11 +61,23 @@ public:
 
 	// Methods
 	[[nodiscard]] inline VkCommandBuffer get_handle() noexcept { return handle_; };
+	[[nodiscard]] inline VkCommandPool get_pool_handle() const noexcept { return pool_handle_; };
 
-	void begin(bool is_single_use, bool is_renderpass_continue, bool is_simultaneous_use);
+	[[nodiscard]] inline State get_state() const noexcept { return state_; };
+
+	// Secondary command buffers must pass the render pass state they will be executed within
+	void begin(bool is_single_use, bool is_renderpass_continue, bool is_simultaneous_use,
+	           const VkCommandBufferInheritanceInfo *inheritance_info = nullptr);
 	void end();
-	void submit(VkQueue queue, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore, VkFence fence, VkPipelineStageFlags *flags = nullptr);
+	// Every submission also signals the device timeline. A non-zero timeline_wait_value makes the submission wait
+	// for the timeline to reach it first, which is how work on other queues is ordered against it.
+	void submit(VkQueue queue, VkSemaphore wait_semaphore, VkSemaphore signal_semaphore, VkFence fence, VkPipelineStageFlags *flags = nullptr,
+	            uint64_t timeline_wait_value = 0);
+	// Timeline value signaled by the last submission
+	[[nodiscard]] inline uint64_t get_submitted_value() const noexcept { return submitted_value_; };
 	void reset();
+	// The pool this buffer was allocated from has been reset, which implicitly resets the buffer
+	inline void mark_pool_reset() noexcept { state_ = State::READY; };
 
 	// Static methods
 	static CommandBuffer begin_single_time_commands(Device *device, VkCommandPool pool);
@@ -76,6 +90,7 @@ private:
 	VkCommandPool pool_handle_{VK_NULL_HANDLE};
 
 	State state_{State::NOT_ALLOCATED};
+	uint64_t submitted_value_ = 0;
 
 	friend RenderPass;
 };
@@ -0,0 +1,49 @@
+#include "pch.hpp"
+
+#include "command_pool.hpp"
+
+#include "device.hpp"
+
+namespace flwfrg::vk
+{
+
+CommandPool::CommandPool(Device *device, uint32_t queue_family_index, VkCommandPoolCreateFlags flags)
+    : device_{device}
+{
+    assert(device_ != nullptr);
+
+    VkCommandPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    pool_info.queueFamilyIndex = queue_family_index;
+    pool_info.flags = flags;
+
+    if (vkCreateCommandPool(device_->get_logical_device(), &pool_info, nullptr, handle_.ptr()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create command pool");
+    }
+}
+
+CommandPool::~CommandPool()
+{
+    if (handle_.not_null())
+    {
+        // Deferred behind the command buffers allocated from it, which are deferred as well
+        device_->defer_destruction([device = device_->get_logical_device(), pool = static_cast<VkCommandPool>(handle_)]() {
+            vkDestroyCommandPool(device, pool, nullptr);
+        });
+        handle_ = make_handle<VkCommandPool>(VK_NULL_HANDLE);
+    }
+}
+
+void CommandPool::reset(bool release_resources)
+{
+    assert(handle_.not_null());
+
+    VkCommandPoolResetFlags flags = release_resources ? VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT : 0;
+    if (vkResetCommandPool(device_->get_logical_device(), handle_, flags) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to reset command pool");
+    }
+}
+
+}// namespace flwfrg::vk
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "util/handle.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+namespace flwfrg::vk
+{
+class Device;
+
+class CommandPool
+{
+public:
+    CommandPool() = default;
+    CommandPool(Device *device, uint32_t queue_family_index, VkCommandPoolCreateFlags flags = 0);
+    ~CommandPool();
+
+    // Copy
+    CommandPool(const CommandPool &) = delete;
+    CommandPool &operator=(const CommandPool &) = delete;
+    // Move
+    CommandPool(CommandPool &&other) noexcept = default;
+    CommandPool &operator=(CommandPool &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] constexpr VkCommandPool handle() const { return handle_; }
+
+    /// Resets every command buffer allocated from the pool in one call. Command buffer wrappers allocated from the
+    /// pool must be told with CommandBuffer::mark_pool_reset().
+    void reset(bool release_resources = false);
+
+private:
+    Device *device_ = nullptr;
+
+    Handle<VkCommandPool> handle_{};
+};
+
+}// namespace flwfrg::vk
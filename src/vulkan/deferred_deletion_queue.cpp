@@ -0,0 +1,45 @@
+#include "pch.hpp"
+
+#include "deferred_deletion_queue.hpp"
+
+namespace flwfrg::vk
+{
+
+void DeferredDeletionQueue::enqueue(uint64_t timeline_value, Deleter deleter)
+{
+    std::lock_guard lock{mutex_};
+    assert(entries_.empty() || entries_.back().timeline_value <= timeline_value);
+    entries_.push_back({timeline_value, std::move(deleter)});
+}
+
+void DeferredDeletionQueue::collect(uint64_t completed_value)
+{
+    // Deleters are run outside the lock, since destroying a resource may end up deferring another one
+    std::vector<Deleter> ready;
+    {
+        std::lock_guard lock{mutex_};
+        while (!entries_.empty() && entries_.front().timeline_value <= completed_value)
+        {
+            ready.emplace_back(std::move(entries_.front().deleter));
+            entries_.pop_front();
+        }
+    }
+
+    for (auto &deleter: ready)
+    {
+        deleter();
+    }
+}
+
+void DeferredDeletionQueue::flush()
+{
+    collect(std::numeric_limits<uint64_t>::max());
+}
+
+size_t DeferredDeletionQueue::size() const
+{
+    std::lock_guard lock{mutex_};
+    return entries_.size();
+}
+
+}// namespace flwfrg::vk
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+namespace flwfrg::vk
+{
+
+/// Holds destruction callbacks until the GPU has finished the submission they are keyed on. Keys are submission
+/// timeline values (see Device) and must be enqueued in non-decreasing order.
+class DeferredDeletionQueue
+{
+public:
+    using Deleter = std::function<void()>;
+
+public:
+    DeferredDeletionQueue() = default;
+    ~DeferredDeletionQueue() = default;
+
+    // Not copyable or movable
+    DeferredDeletionQueue(const DeferredDeletionQueue &) = delete;
+    DeferredDeletionQueue &operator=(const DeferredDeletionQueue &) = delete;
+    DeferredDeletionQueue(DeferredDeletionQueue &&) = delete;
+    DeferredDeletionQueue &operator=(DeferredDeletionQueue &&) = delete;
+
+    // Methods
+
+    void enqueue(uint64_t timeline_value, Deleter deleter);
+
+    /// Runs every deleter keyed on a value less than or equal to completed_value.
+    void collect(uint64_t completed_value);
+
+    /// Runs every deleter regardless of its value. Only valid once the device is idle.
+    void flush();
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Entry
+    {
+        uint64_t timeline_value;
+        Deleter deleter;
+    };
+
+    mutable std::mutex mutex_{};
+    std::deque<Entry> entries_{};
+};
+
+}// namespace flwfrg::vk
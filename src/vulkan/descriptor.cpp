@@ -17,16 +17,19 @@ DescriptorPool::DescriptorPool(Device *device, VkDescriptorPoolCreateInfo create
 		throw std::runtime_error("Failed to create descriptor pool");
 	}
 
-	FLOWFORGE_INFO("Descriptor pool created");
+	FLOWFORGE_TRACE("Descriptor pool created");
 }
 
 DescriptorPool::~DescriptorPool()
 {
 	if (handle_.not_null())
 	{
-		vkDestroyDescriptorPool(device_->get_logical_device(), handle_, nullptr);
+		// Sets allocated from the pool may still be bound by a frame in flight
+		device_->defer_destruction([device = device_->get_logical_device(), pool = static_cast<VkDescriptorPool>(handle_)]() {
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		});
 		handle_ = make_handle<VkDescriptorPool>(VK_NULL_HANDLE);
-		FLOWFORGE_INFO("Descriptor pool destroyed");
+		FLOWFORGE_TRACE("Descriptor pool destroyed");
 	}
 }
 
@@ -0,0 +1,154 @@
+#include "pch.hpp"
+
+#include "descriptor_allocator.hpp"
+
+#include "device.hpp"
+
+#include <algorithm>
+
+namespace flwfrg::vk
+{
+
+DescriptorAllocator::DescriptorAllocator(Device *device) : DescriptorAllocator(device, Config{}) {}
+
+DescriptorAllocator::DescriptorAllocator(Device *device, Config config)
+    : device_{device}, config_{std::move(config)}, next_sets_per_pool_{config_.initial_sets_per_pool}
+{
+    assert(device_ != nullptr);
+    assert(config_.initial_sets_per_pool > 0);
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+    assert(device_ != nullptr);
+
+    if (used_pools_.empty())
+        grab_pool();
+
+    VkDescriptorSetAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocate_info.descriptorPool = used_pools_.back().handle();
+    allocate_info.descriptorSetCount = 1;
+    allocate_info.pSetLayouts = &layout;
+
+    VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+    VkResult result = vkAllocateDescriptorSets(device_->get_logical_device(), &allocate_info, &descriptor_set);
+
+    // The current pool is exhausted, chain a new one and try again.
+    if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+    {
+        grab_pool();
+        allocate_info.descriptorPool = used_pools_.back().handle();
+        result = vkAllocateDescriptorSets(device_->get_logical_device(), &allocate_info, &descriptor_set);
+    }
+
+    if (result != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to allocate descriptor set");
+    }
+
+    return descriptor_set;
+}
+
+void DescriptorAllocator::reset()
+{
+    for (auto &pool: used_pools_)
+    {
+        vkResetDescriptorPool(device_->get_logical_device(), pool.handle(), 0);
+        free_pools_.emplace_back(std::move(pool));
+    }
+    used_pools_.clear();
+}
+
+void DescriptorAllocator::grab_pool()
+{
+    if (!free_pools_.empty())
+    {
+        used_pools_.emplace_back(std::move(free_pools_.back()));
+        free_pools_.pop_back();
+        return;
+    }
+
+    used_pools_.emplace_back(create_pool(next_sets_per_pool_));
+
+    // Grow the next pool, so a steadily increasing demand needs fewer and fewer pools.
+    next_sets_per_pool_ = std::min(next_sets_per_pool_ + next_sets_per_pool_ / 2, config_.max_sets_per_pool);
+}
+
+DescriptorPool DescriptorAllocator::create_pool(uint32_t set_count)
+{
+    std::vector<VkDescriptorPoolSize> pool_sizes;
+    pool_sizes.reserve(config_.ratios.size());
+    for (const auto &ratio: config_.ratios)
+    {
+        pool_sizes.push_back({ratio.type, std::max(1u, static_cast<uint32_t>(ratio.ratio * set_count))});
+    }
+
+    VkDescriptorPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    pool_info.flags = config_.flags;
+    pool_info.maxSets = set_count;
+    pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+    pool_info.pPoolSizes = pool_sizes.data();
+
+    return DescriptorPool(device_, pool_info);
+}
+
+DescriptorSetLayoutCache::DescriptorSetLayoutCache(Device *device) : device_{device}
+{
+    assert(device_ != nullptr);
+}
+
+VkDescriptorSetLayout DescriptorSetLayoutCache::get_layout(const VkDescriptorSetLayoutCreateInfo &create_info)
+{
+    assert(device_ != nullptr);
+
+    LayoutKey key{};
+    key.flags = create_info.flags;
+    key.bindings.assign(create_info.pBindings, create_info.pBindings + create_info.bindingCount);
+
+    // Binding order in the create info is irrelevant to the resulting layout
+    std::ranges::sort(key.bindings, [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) {
+        return a.binding < b.binding;
+    });
+
+    auto it = layouts_.find(key);
+    if (it != layouts_.end())
+        return it->second.handle();
+
+    auto [inserted, _] = layouts_.emplace(std::move(key), DescriptorSetLayout(device_, create_info));
+    return inserted->second.handle();
+}
+
+bool DescriptorSetLayoutCache::LayoutKey::operator==(const LayoutKey &other) const
+{
+    if (flags != other.flags || bindings.size() != other.bindings.size())
+        return false;
+
+    for (size_t i = 0; i < bindings.size(); i++)
+    {
+        const auto &a = bindings[i];
+        const auto &b = other.bindings[i];
+        if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+            a.stageFlags != b.stageFlags || a.pImmutableSamplers != b.pImmutableSamplers)
+            return false;
+    }
+
+    return true;
+}
+
+size_t DescriptorSetLayoutCache::LayoutKeyHash::operator()(const LayoutKey &key) const
+{
+    size_t result = std::hash<uint32_t>{}(key.flags);
+    for (const auto &binding: key.bindings)
+    {
+        // Pack the binding into a single 64 bit value and mix it in
+        uint64_t packed = static_cast<uint64_t>(binding.binding) | static_cast<uint64_t>(binding.descriptorType) << 16 |
+                          static_cast<uint64_t>(binding.descriptorCount) << 32 |
+                          static_cast<uint64_t>(binding.stageFlags) << 48;
+        result ^= std::hash<uint64_t>{}(packed) + 0x9e3779b9 + (result << 6) + (result >> 2);
+    }
+    return result;
+}
+
+}// namespace flwfrg::vk
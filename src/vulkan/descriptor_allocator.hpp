@@ -0,0 +1,117 @@
+#pragma once
+
+#include "descriptor.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <unordered_map>
+#include <vector>
+
+namespace flwfrg::vk
+{
+class Device;
+
+/// Hands out descriptor sets from a chain of descriptor pools. When the current pool runs out, a new
+/// (larger) pool is appended instead of failing. Resetting the allocator resets every pool in bulk with
+/// vkResetDescriptorPool and keeps them around for reuse.
+class DescriptorAllocator
+{
+public:
+    struct PoolSizeRatio
+    {
+        VkDescriptorType type;
+        float ratio;
+    };
+
+    struct Config
+    {
+        uint32_t initial_sets_per_pool = 64;
+        uint32_t max_sets_per_pool = 4096;
+        VkDescriptorPoolCreateFlags flags = 0;
+        std::vector<PoolSizeRatio> ratios{
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+                {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+        };
+    };
+
+public:
+    DescriptorAllocator() = default;
+    explicit DescriptorAllocator(Device *device);
+    DescriptorAllocator(Device *device, Config config);
+    ~DescriptorAllocator() = default;
+
+    // Copy
+    DescriptorAllocator(const DescriptorAllocator &) = delete;
+    DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+    // Move
+    DescriptorAllocator(DescriptorAllocator &&other) noexcept = default;
+    DescriptorAllocator &operator=(DescriptorAllocator &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+    /// Resets every pool owned by the allocator. All sets allocated from it become invalid, so this must only be
+    /// called once the GPU is done with them (for per-frame allocators: once the frame has completed on the device timeline).
+    void reset();
+
+    [[nodiscard]] inline size_t get_pool_count() const { return used_pools_.size() + free_pools_.size(); }
+
+private:
+    Device *device_ = nullptr;
+    Config config_{};
+
+    uint32_t next_sets_per_pool_ = 0;
+
+    // The back of used_pools_ is the pool currently allocated from.
+    std::vector<DescriptorPool> used_pools_{};
+    std::vector<DescriptorPool> free_pools_{};
+
+    void grab_pool();
+    DescriptorPool create_pool(uint32_t set_count);
+};
+
+/// Owns descriptor set layouts and deduplicates them by their binding signature, so shaders asking for
+/// identical layouts share one VkDescriptorSetLayout.
+class DescriptorSetLayoutCache
+{
+public:
+    DescriptorSetLayoutCache() = default;
+    explicit DescriptorSetLayoutCache(Device *device);
+    ~DescriptorSetLayoutCache() = default;
+
+    // Copy
+    DescriptorSetLayoutCache(const DescriptorSetLayoutCache &) = delete;
+    DescriptorSetLayoutCache &operator=(const DescriptorSetLayoutCache &) = delete;
+    // Move
+    DescriptorSetLayoutCache(DescriptorSetLayoutCache &&other) noexcept = default;
+    DescriptorSetLayoutCache &operator=(DescriptorSetLayoutCache &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] VkDescriptorSetLayout get_layout(const VkDescriptorSetLayoutCreateInfo &create_info);
+
+    [[nodiscard]] inline size_t size() const { return layouts_.size(); }
+
+private:
+    struct LayoutKey
+    {
+        VkDescriptorSetLayoutCreateFlags flags = 0;
+        std::vector<VkDescriptorSetLayoutBinding> bindings{};
+
+        bool operator==(const LayoutKey &other) const;
+    };
+
+    struct LayoutKeyHash
+    {
+        size_t operator()(const LayoutKey &key) const;
+    };
+
+    Device *device_ = nullptr;
+
+    std::unordered_map<LayoutKey, DescriptorSetLayout, LayoutKeyHash> layouts_{};
+};
+
+}// namespace flwfrg::vk
@@ -4,6 +4,7 @@
 #include "instance.hpp"
 #include "surface.hpp"
 
+#include <algorithm>
 #include <set>
 #include <unordered_set>
 #include <utility>
@@ -18,12 +19,31 @@ Device::Device(Instance *instance, Surface *surface, PhysicalDeviceRequirements
 
 	pick_physical_device();
 	create_logical_device();
+
+	timeline_.emplace(this, 0);
+
+	// The surface may be a temporary, windows check their own with can_present_to
+	surface_ = nullptr;
 }
 
 Device::~Device()
 {
 	if (logical_device_.not_null())
 	{
+		vkDeviceWaitIdle(logical_device_);
+
+		// Release everything still owned or deferred while the device and its pools exist
+		open_recordings_ = 0;
+		single_time_submissions_.clear();
+		recycled_single_time_command_buffers_.clear();
+		for (auto &destroy: recording_deletions_)
+		{
+			destroy();
+		}
+		recording_deletions_.clear();
+		deletion_queue_->flush();
+		timeline_.reset();
+
 		if (graphics_command_pool_.not_null())
 		{
 			vkDestroyCommandPool(logical_device_, graphics_command_pool_, nullptr);
@@ -34,10 +54,19 @@ Device::~Device()
 	}
 }
 
-const SwapchainSupportDetails &Device::update_swapchain_support_details()
+SwapchainSupportDetails Device::query_swapchain_support(VkSurfaceKHR surface) const
 {
-	swapchain_support_ = query_swapchain_support();
-	return swapchain_support_;
+	return query_swapchain_support(physical_device_, surface);
+}
+
+bool Device::can_present_to(VkSurfaceKHR surface) const
+{
+	if (!present_queue_index_.has_value())
+		return false;
+
+	VkBool32 supports_present = VK_FALSE;
+	vkGetPhysicalDeviceSurfaceSupportKHR(physical_device_, present_queue_index_.value(), surface, &supports_present);
+	return supports_present == VK_TRUE;
 }
 
 int32_t Device::find_memory_index(uint32_t type_filter, VkMemoryPropertyFlags memory_flags) const
@@ -57,6 +86,136 @@ int32_t Device::find_memory_index(uint32_t type_filter, VkMemoryPropertyFlags me
 	return -1;
 }
 
+CommandBuffer Device::acquire_single_time_command_buffer(VkCommandPool pool)
+{
+	poll_completed_value();
+
+	for (size_t i = 0; i < recycled_single_time_command_buffers_.size(); i++)
+	{
+		if (recycled_single_time_command_buffers_[i].get_pool_handle() == pool)
+		{
+			CommandBuffer command_buffer = std::move(recycled_single_time_command_buffers_[i]);
+			std::swap(recycled_single_time_command_buffers_[i], recycled_single_time_command_buffers_.back());
+			recycled_single_time_command_buffers_.pop_back();
+			return command_buffer;
+		}
+	}
+
+	return CommandBuffer{this, pool, true};
+}
+
+void Device::submit_single_time_command_buffer(CommandBuffer &&command_buffer, VkQueue queue)
+{
+	// Bound the number of one-shot submissions in flight by waiting on the oldest one, never on the whole queue
+	if (single_time_submissions_.size() >= max_single_time_submissions_in_flight)
+	{
+		wait_for(single_time_submissions_.front().timeline_value);
+	}
+
+	command_buffer.submit(queue, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+	single_time_submissions_.push_back({std::move(command_buffer), last_submitted_value_});
+}
+
+void Device::mark_submitted(uint64_t value)
+{
+	last_submitted_value_ = value;
+}
+
+bool Device::wait_for(uint64_t value, uint64_t timeout_ns)
+{
+	if (value <= completed_value_)
+		return true;
+
+	if (!timeline_->wait_for(value, timeout_ns))
+		return false;
+
+	mark_value_completed(value);
+	return true;
+}
+
+bool Device::is_complete(uint64_t value)
+{
+	if (value <= completed_value_)
+		return true;
+
+	return poll_completed_value() >= value;
+}
+
+uint64_t Device::poll_completed_value()
+{
+	mark_value_completed(timeline_->get_value());
+	return completed_value_;
+}
+
+void Device::mark_value_completed(uint64_t value)
+{
+	if (value <= completed_value_)
+		return;
+
+	completed_value_ = value;
+
+	// Recycle the one-shot command buffers the timeline has passed
+	while (!single_time_submissions_.empty() && single_time_submissions_.front().timeline_value <= completed_value_)
+	{
+		CommandBuffer &command_buffer = single_time_submissions_.front().command_buffer;
+		command_buffer.reset();
+		recycled_single_time_command_buffers_.emplace_back(std::move(command_buffer));
+		single_time_submissions_.pop_front();
+	}
+
+	deletion_queue_->collect(completed_value_);
+}
+
+VkResult Device::wait_for_present(VkSwapchainKHR swapchain, uint64_t present_id, uint64_t timeout_ns) const
+{
+	assert(supports_present_wait());
+	return wait_for_present_function_(logical_device_, swapchain, present_id, timeout_ns);
+}
+
+void Device::begin_recording()
+{
+	open_recordings_++;
+}
+
+void Device::end_recording()
+{
+	assert(open_recordings_ > 0);
+	if (--open_recordings_ > 0)
+		return;
+
+	// The recording has been submitted by now, so its submission is the last one that may use these
+	for (auto &destroy: recording_deletions_)
+	{
+		deletion_queue_->enqueue(last_submitted_value_, std::move(destroy));
+	}
+	recording_deletions_.clear();
+}
+
+void Device::wait_idle()
+{
+	vkDeviceWaitIdle(logical_device_);
+	mark_value_completed(last_submitted_value_);
+}
+
+void Device::defer_destruction(DeferredDeletionQueue::Deleter destroy)
+{
+	if (open_recordings_ > 0)
+	{
+		recording_deletions_.emplace_back(std::move(destroy));
+		return;
+	}
+
+	// Nothing in flight can still reference the resource
+	if (last_submitted_value_ <= completed_value_)
+	{
+		destroy();
+		return;
+	}
+
+	deletion_queue_->enqueue(last_submitted_value_, std::move(destroy));
+}
+
 void Device::pick_physical_device()
 {
 	assert(instance_->handle() != VK_NULL_HANDLE);
@@ -119,8 +278,6 @@ void Device::pick_physical_device()
 		compute_queue_index_ = queue_indices.compute_family_index;
 
 		physical_device_properties_ = make_handle(deviceProperties);
-		if (surface_ != nullptr)
-			swapchain_support_ = query_swapchain_support();
 	} else
 	{
 		throw std::runtime_error("failed to find a suitable GPU!");
@@ -213,16 +370,69 @@ void Device::create_logical_device()
 		queue_create_infos[i].pQueuePriorities = &queue_priority;
 	}
 
+	// Required extensions were checked when picking the device, optional ones are enabled where supported
+	uint32_t available_extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &available_extension_count, nullptr);
+	std::vector<VkExtensionProperties> available_extensions(available_extension_count);
+	vkEnumerateDeviceExtensionProperties(physical_device_, nullptr, &available_extension_count, available_extensions.data());
+
+	std::vector<const char *> extension_names;
+	for (const char *name: physical_device_requirements_.device_extension_names)
+	{
+		// Without a surface there is nothing to present to
+		if (surface_ == nullptr && std::string_view(name) == VK_KHR_SWAPCHAIN_EXTENSION_NAME)
+			continue;
+		extension_names.push_back(name);
+	}
+	for (const char *name: physical_device_requirements_.optional_device_extension_names)
+	{
+		bool supported = std::ranges::any_of(available_extensions, [name](const VkExtensionProperties &extension) {
+			return std::string_view(extension.extensionName) == name;
+		});
+		if (supported)
+			extension_names.push_back(name);
+		else
+			FLOWFORGE_INFO("Optional device extension {} is not supported", name);
+	}
+	enabled_extension_names_ = {extension_names.begin(), extension_names.end()};
+
+	VkPhysicalDeviceVulkan13Features vulkan_13_features{};
+	vulkan_13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	vulkan_13_features.synchronization2 = VK_TRUE;
+	vulkan_13_features.dynamicRendering = VK_TRUE;
+
+	VkPhysicalDeviceVulkan12Features vulkan_12_features{};
+	vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan_12_features.pNext = &vulkan_13_features;
+	vulkan_12_features.timelineSemaphore = VK_TRUE;
+
+	// Present wait is only usable when both extensions and their features are there
+	VkPhysicalDevicePresentIdFeaturesKHR present_id_features{};
+	present_id_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features{};
+	present_wait_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	bool enable_present_wait = false;
+	if (is_extension_enabled(VK_KHR_PRESENT_ID_EXTENSION_NAME) && is_extension_enabled(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+	{
+		present_id_features.pNext = &present_wait_features;
+		VkPhysicalDeviceFeatures2 features_2{};
+		features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features_2.pNext = &present_id_features;
+		vkGetPhysicalDeviceFeatures2(physical_device_, &features_2);
+
+		enable_present_wait = present_id_features.presentId && present_wait_features.presentWait;
+		if (enable_present_wait)
+			vulkan_13_features.pNext = &present_id_features;
+	}
+
 	// Request device features.
 	VkDeviceCreateInfo device_create_info = {VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+	device_create_info.pNext = &vulkan_12_features;
 	device_create_info.queueCreateInfoCount = index_count;
 	device_create_info.pQueueCreateInfos = queue_create_infos.data();
 	device_create_info.pEnabledFeatures = &physical_device_requirements_.required_features;
-	device_create_info.enabledExtensionCount = surface_ == nullptr ? 0 : 1;
-	const char *extension_names = nullptr;
-	if (surface_ != nullptr)
-		extension_names = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-	device_create_info.ppEnabledExtensionNames = &extension_names;
+	device_create_info.enabledExtensionCount = static_cast<uint32_t>(extension_names.size());
+	device_create_info.ppEnabledExtensionNames = extension_names.data();
 
 	// Deprecated and ignored
 	device_create_info.enabledLayerCount = 0;
@@ -244,6 +454,12 @@ void Device::create_logical_device()
 
 	FLOWFORGE_INFO("Logical device created");
 
+	if (enable_present_wait)
+	{
+		wait_for_present_function_ = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+				vkGetDeviceProcAddr(logical_device_, "vkWaitForPresentKHR"));
+	}
+
 	// Get queues.
 	if (graphics_queue_index_.has_value())
 	{
@@ -377,6 +593,26 @@ bool Device::is_device_suitable(VkPhysicalDevice device)
 	if (!supports_required_features(physical_device_requirements_.required_features, deviceFeatures))
 		return false;
 
+	// Submission tracking is built on timeline semaphores (core in Vulkan 1.2), and the render graph on
+	// synchronization2 and dynamic rendering (core in Vulkan 1.3)
+	if (deviceProperties.apiVersion < VK_API_VERSION_1_3)
+		return false;
+
+	VkPhysicalDeviceVulkan13Features vulkan_13_features{};
+	vulkan_13_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	VkPhysicalDeviceVulkan12Features vulkan_12_features{};
+	vulkan_12_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan_12_features.pNext = &vulkan_13_features;
+	VkPhysicalDeviceFeatures2 features_2{};
+	features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features_2.pNext = &vulkan_12_features;
+	vkGetPhysicalDeviceFeatures2(device, &features_2);
+
+	if (!vulkan_12_features.timelineSemaphore)
+		return false;
+	if (!vulkan_13_features.synchronization2 || !vulkan_13_features.dynamicRendering)
+		return false;
+
 	// Get the device queue families
 	QueueFamilyIndices indices = find_queue_families(device);
 
@@ -399,7 +635,7 @@ bool Device::is_device_suitable(VkPhysicalDevice device)
 		swapChainAdequate = true;
 	else if (extensionsSupported)
 	{
-		SwapchainSupportDetails swapChainSupport = query_swapchain_support(device);
+		SwapchainSupportDetails swapChainSupport = query_swapchain_support(device, surface_->handle());
 		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.present_modes.empty();
 	}
 
@@ -488,35 +724,35 @@ QueueFamilyIndices Device::find_queue_families(VkPhysicalDevice device)
 	return indices;
 }
 
-SwapchainSupportDetails Device::query_swapchain_support(VkPhysicalDevice device)
+SwapchainSupportDetails Device::query_swapchain_support(VkPhysicalDevice device, VkSurfaceKHR surface)
 {
-	assert(surface_ != nullptr && "Cannot query swapchain support for a non-existant surface");
+	assert(surface != VK_NULL_HANDLE && "Cannot query swapchain support for a non-existant surface");
 
 	SwapchainSupportDetails details;
 
 	// Get the surface capabilities of the physical device
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface_->handle(), &details.capabilities);
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
 	// Get the format count
 	uint32_t formatCount;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface_->handle(), &formatCount, nullptr);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, nullptr);
 
 	// if the format count isn't 0, resize the format list and insert the format details.
 	if (formatCount != 0)
 	{
 		details.formats.resize(formatCount);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface_->handle(), &formatCount, details.formats.data());
+		vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats.data());
 	}
 
 	// Get the present mode count
 	uint32_t presentModeCount;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface_->handle(), &presentModeCount, nullptr);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, nullptr);
 
 	// if the present mode count isn't 0, resize the mode list and populate it.
 	if (presentModeCount != 0)
 	{
 		details.present_modes.resize(presentModeCount);
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface_->handle(), &presentModeCount, details.present_modes.data());
+		vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.present_modes.data());
 	}
 
 	return details;
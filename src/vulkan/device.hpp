@@ -6,8 +6,17 @@
 #include <utility>
 #include <vector>
 
+#include "command_buffer.hpp"
+#include "deferred_deletion_queue.hpp"
+#include "timeline_semaphore.hpp"
 #include "util/handle.hpp"
 
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
 namespace flwfrg::vk
 {
 class Instance;
@@ -22,6 +31,8 @@ struct PhysicalDeviceRequirements
     bool transfer = true;
     bool discrete_gpu = false;
     std::vector<const char *> device_extension_names{VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+    // Enabled when the picked device supports them, see Device::is_extension_enabled
+    std::vector<const char *> optional_device_extension_names{};
     VkPhysicalDeviceFeatures required_features = {.samplerAnisotropy = VK_TRUE};
 };
 
@@ -97,23 +108,67 @@ public:
     };
     [[nodiscard]] inline VkFormat get_depth_format() const { return depth_format_; };
 
-    [[nodiscard]] inline const SwapchainSupportDetails &get_swapchain_support_details() const
+    // Surface queries. Each window has its own surface, all of them presenting through the same device.
+    [[nodiscard]] SwapchainSupportDetails query_swapchain_support(VkSurfaceKHR surface) const;
+    [[nodiscard]] bool can_present_to(VkSurfaceKHR surface) const;
+
+    [[nodiscard]] inline bool is_extension_enabled(std::string_view name) const
     {
-        return swapchain_support_;
+        return enabled_extension_names_.contains(std::string(name));
     };
-    const SwapchainSupportDetails &update_swapchain_support_details();
+
+    // VK_KHR_present_id and VK_KHR_present_wait, both extensions and features enabled
+    [[nodiscard]] inline bool supports_present_wait() const { return wait_for_present_function_ != nullptr; };
+    /// Blocks until the presentation with present_id on swapchain has been displayed. Requires supports_present_wait().
+    VkResult wait_for_present(VkSwapchainKHR swapchain, uint64_t present_id, uint64_t timeout_ns) const;
 
     [[nodiscard]] int32_t find_memory_index(uint32_t type_filter, VkMemoryPropertyFlags memory_flags) const;
 
+    // One-shot command buffers are recycled instead of being allocated and freed for every upload.
+    // The pool must have been created with VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT.
+    [[nodiscard]] CommandBuffer acquire_single_time_command_buffer(VkCommandPool pool);
+    // The command buffer is recycled once the timeline has passed its submission
+    void submit_single_time_command_buffer(CommandBuffer &&command_buffer, VkQueue queue);
+
+    // Timeline. Every queue submission signals the device timeline with the next value, so any subsystem can keep
+    // the value of the submission that last used a resource and later check or wait for it, instead of keeping a
+    // fence per object. Submissions signal in order, so a reached value implies all earlier values are reached.
+    [[nodiscard]] inline VkSemaphore get_timeline_semaphore() const { return timeline_->handle(); };
+    [[nodiscard]] inline uint64_t get_last_submitted_value() const { return last_submitted_value_; };
+    [[nodiscard]] inline uint64_t get_completed_value() const { return completed_value_; };
+    // The value the next queue submission has to signal. It only counts as submitted once the submission succeeded
+    // and called mark_submitted, so a failed one does not leave a value behind that waits would hang on.
+    [[nodiscard]] inline uint64_t get_next_submit_value() const { return last_submitted_value_ + 1; };
+    void mark_submitted(uint64_t value);
+    /// Blocks until the timeline has reached value. Returns false on timeout or error.
+    bool wait_for(uint64_t value, uint64_t timeout_ns = std::numeric_limits<uint64_t>::max());
+    /// Non-blocking check if the timeline has reached value.
+    [[nodiscard]] bool is_complete(uint64_t value);
+    /// Reads the timeline and releases whatever it has passed.
+    uint64_t poll_completed_value();
+
+    // Resources destroyed while a recording is open may be referenced by it, so their destruction is keyed on
+    // the submission that ends the recording instead of the last one.
+    void begin_recording();
+    void end_recording();
+
+    /// Runs destroy once the GPU is done with everything submitted or being recorded so far.
+    void defer_destruction(DeferredDeletionQueue::Deleter destroy);
+
+    /// Drains the GPU and releases everything deferred so far. Only meant for shutdown and swapchain recreation.
+    void wait_idle();
+
 private:
     Instance *instance_ = nullptr;
+    // Only used to pick a device that can present to it, cleared once the device is created
     Surface *surface_ = nullptr;
 
     PhysicalDeviceRequirements physical_device_requirements_{};
 
     VkPhysicalDevice physical_device_{};
     Handle<VkDevice> logical_device_{};
-    SwapchainSupportDetails swapchain_support_{};
+    std::unordered_set<std::string> enabled_extension_names_{};
+    PFN_vkWaitForPresentKHR wait_for_present_function_ = nullptr;
 
     std::optional<uint32_t> graphics_queue_index_;
     std::optional<uint32_t> present_queue_index_;
@@ -127,12 +182,33 @@ private:
 
     Handle<VkCommandPool> graphics_command_pool_{};
 
+    struct SingleTimeSubmission
+    {
+        CommandBuffer command_buffer{};
+        uint64_t timeline_value = 0;
+    };
+
+    // In submission order
+    std::deque<SingleTimeSubmission> single_time_submissions_{};
+    std::vector<CommandBuffer> recycled_single_time_command_buffers_{};
+
+    // Optional so it can be destroyed before the logical device
+    std::optional<TimelineSemaphore> timeline_{};
+    uint64_t last_submitted_value_ = 0;
+    uint64_t completed_value_ = 0;
+    uint32_t open_recordings_ = 0;
+    std::vector<DeferredDeletionQueue::Deleter> recording_deletions_{};
+    // unique_ptr keeps the device movable
+    std::unique_ptr<DeferredDeletionQueue> deletion_queue_ = std::make_unique<DeferredDeletionQueue>();
+
     VkPhysicalDeviceProperties physical_device_properties_{};
     VkPhysicalDeviceFeatures features_{};
     VkPhysicalDeviceMemoryProperties memory_{};
 
     VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
 
+    static constexpr size_t max_single_time_submissions_in_flight = 64;
+
 
     ///// Private methods
 
@@ -140,6 +216,8 @@ private:
 
     void create_logical_device();
 
+    void mark_value_completed(uint64_t value);
+
     ///// Helper methods
 
     [[nodiscard]] bool is_device_suitable(VkPhysicalDevice device);
@@ -148,9 +226,7 @@ private:
 
     QueueFamilyIndices find_queue_families(VkPhysicalDevice device);
 
-    SwapchainSupportDetails query_swapchain_support(VkPhysicalDevice device);
-
-    inline SwapchainSupportDetails query_swapchain_support() { return query_swapchain_support(physical_device_); };
+    static SwapchainSupportDetails query_swapchain_support(VkPhysicalDevice device, VkSurfaceKHR surface);
 
     [[nodiscard]] bool check_device_extension_support(VkPhysicalDevice device);
 
@@ -6,19 +6,92 @@
 
 namespace flwfrg::vk
 {
-DisplayContext::DisplayContext(Window *window, PhysicalDeviceRequirements requirements, bool enable_validation_layers)
+DisplayContext::DisplayContext(Window *window, PhysicalDeviceRequirements requirements, ValidationConfig validation_config,
+							   PresentConfig present_config, RenderPassConfig render_pass_config)
+	: DisplayContext(std::make_unique<GraphicsContext>(window, std::move(requirements), validation_config), nullptr,
+					 window, present_config, render_pass_config)
+{}
+
+DisplayContext::DisplayContext(GraphicsContext *graphics_context, Window *window, PresentConfig present_config,
+							   RenderPassConfig render_pass_config)
+	: DisplayContext(nullptr, graphics_context, window, present_config, render_pass_config)
+{}
+
+DisplayContext::DisplayContext(std::unique_ptr<GraphicsContext> owned_graphics_context, GraphicsContext *graphics_context,
+							   Window *window, PresentConfig present_config, RenderPassConfig render_pass_config)
 	: window_{window},
-	  instance_{enable_validation_layers},
-	  debug_messenger_(&instance_),
-	  surface_{&instance_, window_},
-	  device_{&instance_, &surface_, requirements},
-	  swapchain_{this}
+	  owned_graphics_context_{std::move(owned_graphics_context)},
+	  graphics_context_{owned_graphics_context_ ? owned_graphics_context_.get() : graphics_context},
+	  device_{graphics_context_->get_device()},
+	  surface_{&graphics_context_->get_instance(), window_},
+	  swapchain_{this, present_config},
+	  main_render_pass_{
+			  &device_,
+			  {0, 0, window_->get_width(), window_->get_height()},
+			  swapchain_.swapchain_image_format_.format,
+			  device_.get_depth_format(),
+			  {0, 0, 0.2f, 1.0f},
+			  1.0f,
+			  0,
+			  render_pass_config}
 {
 	FLOWFORGE_INFO("Creating frame buffers");
 	swapchain_.regenerate_frame_buffers(&main_render_pass_);
 	FLOWFORGE_INFO("Creating command buffers");
 	create_command_buffers();
+	create_frame_sync_objects();
+}
+DisplayContext::~DisplayContext()
+{
+	if (device_.get_logical_device() == VK_NULL_HANDLE)
+		return;
+
+	device_.wait_idle();
+
+	destroy_frame_sync_objects();
+}
+
+void DisplayContext::set_present_config(PresentConfig config)
+{
+	if (config.frames_in_flight == 0 || config.frames_in_flight > constant::max_frames_in_flight)
+	{
+		throw std::runtime_error("Failed to set present config, frames in flight must be between 1 and " +
+								 std::to_string(constant::max_frames_in_flight));
+	}
+
+	device_.wait_idle();
+
+	bool frame_count_changed = config.frames_in_flight != swapchain_.max_frames_in_flight_;
+	if (frame_count_changed)
+		destroy_frame_sync_objects();
+
+	swapchain_.present_config_ = config;
+	swapchain_.max_frames_in_flight_ = config.frames_in_flight;
+	recreate_swapchain();
 
+	if (frame_count_changed)
+	{
+		current_frame_ = 0;
+		create_command_buffers();
+		create_frame_sync_objects();
+	}
+}
+
+void DisplayContext::create_command_buffers()
+{
+	graphics_command_buffers_.clear();
+	frame_command_pools_.clear();
+
+	// Command buffers are indexed by the frame in flight, not the swapchain image
+	for (size_t i = 0; i < swapchain_.max_frames_in_flight_; i++)
+	{
+		frame_command_pools_.emplace_back(&device_, device_.get_graphics_queue_index(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		graphics_command_buffers_.emplace_back(&device_, frame_command_pools_.back().handle(), true);
+	}
+}
+
+void DisplayContext::create_frame_sync_objects()
+{
 	image_avaliable_semaphores_.resize(swapchain_.max_frames_in_flight_);
 	queue_complete_semaphores_.resize(swapchain_.max_frames_in_flight_);
 	for (size_t i = 0; i < swapchain_.max_frames_in_flight_; i++)
@@ -28,34 +101,30 @@ DisplayContext::DisplayContext(Window *window, PhysicalDeviceRequirements requir
 		vkCreateSemaphore(device_.get_logical_device(), &semaphore_info, nullptr, &image_avaliable_semaphores_[i]);
 		vkCreateSemaphore(device_.get_logical_device(), &semaphore_info, nullptr, &queue_complete_semaphores_[i]);
 
-		in_flight_fences_.emplace_back(&device_, true);
+		frame_descriptor_allocators_.emplace_back(&device_);
 	}
 
-	images_in_flight_.resize(swapchain_.get_image_count());
+	frame_timeline_values_.resize(swapchain_.max_frames_in_flight_, 0);
 }
-DisplayContext::~DisplayContext()
-{
-	if (device_.get_logical_device() == VK_NULL_HANDLE)
-		return;
-
-	vkDeviceWaitIdle(device_.get_logical_device());
 
-	// Destroy semaphores
-	for (size_t i = 0; i < swapchain_.max_frames_in_flight_; i++)
+void DisplayContext::destroy_frame_sync_objects()
+{
+	// Only called with the device idle
+	for (size_t i = 0; i < image_avaliable_semaphores_.size(); i++)
 	{
 		vkDestroySemaphore(device_.get_logical_device(), image_avaliable_semaphores_[i], nullptr);
 		vkDestroySemaphore(device_.get_logical_device(), queue_complete_semaphores_[i], nullptr);
 	}
+	image_avaliable_semaphores_.clear();
+	queue_complete_semaphores_.clear();
+	frame_descriptor_allocators_.clear();
+	frame_timeline_values_.clear();
 }
 
-void DisplayContext::create_command_buffers()
+void DisplayContext::recreate_swapchain()
 {
-	graphics_command_buffers_.clear();
-
-	for (size_t i = 0; i < swapchain_.get_image_count(); i++)
-	{
-		graphics_command_buffers_.emplace_back(&device_, device_.get_graphics_command_pool(), true);
-	}
+	swapchain_.recreate_swapchain();
+	regenerate_frame_buffers();
 }
 
 void DisplayContext::regenerate_frame_buffers()
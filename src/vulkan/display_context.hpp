@@ -1,23 +1,33 @@
 #pragma once
 
 #include "command_buffer.hpp"
-#include "debug_messenger.hpp"
+#include "command_pool.hpp"
+#include "descriptor_allocator.hpp"
 #include "device.hpp"
-#include "fence.hpp"
+#include "graphics_context.hpp"
 #include "instance.hpp"
 #include "render_pass.hpp"
 #include "surface.hpp"
 #include "swapchain.hpp"
 #include "window.hpp"
 
+#include <memory>
+
 namespace flwfrg::vk
 {
 class Renderer;
 
+/// Everything needed to render to one window: its surface, swapchain, render pass and per-frame resources.
+/// Either owns a GraphicsContext, or shares one with other display contexts to drive several windows from one device.
 class DisplayContext
 {
 public:
-	explicit DisplayContext(Window *window, PhysicalDeviceRequirements requirements = {}, bool enable_validation_layers = true);
+	explicit DisplayContext(Window *window, PhysicalDeviceRequirements requirements = {},
+							ValidationConfig validation_config = ValidationConfig::from_environment(),
+							PresentConfig present_config = {}, RenderPassConfig render_pass_config = {});
+	// The graphics context must outlive the display context
+	DisplayContext(GraphicsContext *graphics_context, Window *window, PresentConfig present_config = {},
+				   RenderPassConfig render_pass_config = {});
 	~DisplayContext();
 
 	// Copy
@@ -29,9 +39,14 @@ public:
 
 	// Methods
 
+	/// Recreates the swapchain with a new presentation policy. Drains the GPU, and rebuilds every per-frame resource
+	/// if the number of frames in flight changes.
+	void set_present_config(PresentConfig config);
+
 	// Getters
 	[[nodiscard]] inline Window *get_window() const { return window_; }
-	[[nodiscard]] inline Instance &get_instance() { return instance_; }
+	[[nodiscard]] inline GraphicsContext &get_graphics_context() { return *graphics_context_; }
+	[[nodiscard]] inline Instance &get_instance() { return graphics_context_->get_instance(); }
 	[[nodiscard]] inline Surface &get_surface() { return surface_; }
 	[[nodiscard]] inline Device &get_device() { return device_; }
 	[[nodiscard]] inline Swapchain &get_swapchain() { return swapchain_; }
@@ -41,35 +56,38 @@ public:
 	[[nodiscard]] inline uint32_t get_current_frame() const { return current_frame_; }
 
 	inline CommandBuffer &get_command_buffer() { return graphics_command_buffers_[current_frame_]; };
-	inline Fence &get_current_frame_fence_in_flight() { return in_flight_fences_[current_frame_]; };
-	inline Fence *get_image_index_frame_fence_in_flight() { return images_in_flight_[image_index_]; };
+	inline DescriptorSetLayoutCache &get_descriptor_layout_cache() { return graphics_context_->get_descriptor_layout_cache(); };
+	// Allocator for descriptor sets that are only valid for the current frame. Reset once the frame has completed.
+	inline DescriptorAllocator &get_frame_descriptor_allocator() { return frame_descriptor_allocators_[current_frame_]; };
+	// Device timeline value signaled by the last submission of the current frame slot
+	[[nodiscard]] inline uint64_t get_current_frame_timeline_value() const { return frame_timeline_values_[current_frame_]; };
 	inline VkFramebuffer get_frame_buffer_handle() { return swapchain_.frame_buffers_[image_index_].handle(); };
 
 private:
 	Window *window_ = nullptr;
-	Instance instance_;
-	DebugMessenger debug_messenger_;
-	Surface surface_;
+	// Only set when this display context created its graphics context itself
+	std::unique_ptr<GraphicsContext> owned_graphics_context_;
+	GraphicsContext *graphics_context_ = nullptr;
 
-	Device device_;
+	Device &device_;
+	Surface surface_;
 	Swapchain swapchain_;
 
-	RenderPass main_render_pass_{
-			&device_,
-			{0, 0, window_->get_width(), window_->get_height()},
-			swapchain_.swapchain_image_format_.format,
-			device_.get_depth_format(),
-			{0, 0, 0.2f, 1.0f},
-			1.0f,
-			0};
+	RenderPass main_render_pass_;
 
+	// One transient pool per frame in flight, reset in a single call once the frame has completed.
+	// Declared before the command buffers so they are freed before their pools are destroyed.
+	std::vector<CommandPool> frame_command_pools_{};
 	std::vector<CommandBuffer> graphics_command_buffers_{};
 
+	std::vector<DescriptorAllocator> frame_descriptor_allocators_{};
+
 	std::vector<VkSemaphore> image_avaliable_semaphores_;
 	std::vector<VkSemaphore> queue_complete_semaphores_;
 
-	std::vector<Fence> in_flight_fences_;
-	std::vector<Fence *> images_in_flight_;
+	// Binary semaphores remain for acquire and present, which do not accept timeline semaphores.
+	// Frame pacing waits on the device timeline value each frame in flight signaled last.
+	std::vector<uint64_t> frame_timeline_values_;
 
 	uint64_t frame_counter = 0;
 	// Current swapchain image index (next index may be unpredictable)
@@ -79,7 +97,14 @@ private:
 
 	// Methods
 
+	DisplayContext(std::unique_ptr<GraphicsContext> owned_graphics_context, GraphicsContext *graphics_context,
+				   Window *window, PresentConfig present_config, RenderPassConfig render_pass_config);
+
 	void create_command_buffers();
+	void create_frame_sync_objects();
+	void destroy_frame_sync_objects();
+	// Does not wait for the GPU, the old swapchain and its frame buffers are retired instead
+	void recreate_swapchain();
 	void regenerate_frame_buffers();
 
 	friend Swapchain;
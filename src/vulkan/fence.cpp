@@ -29,7 +29,11 @@ Fence::~Fence()
 {
 	if (handle_.not_null())
 	{
-		vkDestroyFence(device_->get_logical_device(), handle_, nullptr);
+		// The fence may still be part of a pending submission
+		device_->defer_destruction([device = device_->get_logical_device(), fence = static_cast<VkFence>(handle_)]() {
+			vkDestroyFence(device, fence, nullptr);
+		});
+		handle_ = make_handle<VkFence>(VK_NULL_HANDLE);
 		FLOWFORGE_TRACE("Fence destroyed");
 	}
 }
@@ -67,6 +71,17 @@ bool Fence::wait(uint64_t timeout_ns)
 	}
 }
 
+bool Fence::poll()
+{
+	if (signaled_)
+	{
+		return true;
+	}
+
+	signaled_ = vkGetFenceStatus(device_->get_logical_device(), handle_) == VK_SUCCESS;
+	return signaled_;
+}
+
 void Fence::reset()
 {
 	if (signaled_)
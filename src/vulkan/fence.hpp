@@ -26,6 +26,8 @@ public:
 	[[nodiscard]] inline VkFence get_handle() const { return handle_; }
 	[[nodiscard]] inline bool is_signaled() const { return signaled_; }
 	bool wait(uint64_t timeout_ns);
+	// Non-blocking status check
+	bool poll();
 	void reset();
 
 private:
@@ -36,7 +36,10 @@ FrameBuffer::~FrameBuffer()
 {
 	if (handle_.not_null())
 	{
-		vkDestroyFramebuffer(device_->get_logical_device(), handle_, nullptr);
+		// Frames still in flight may be rendering into it, e.g. right after a swapchain recreation
+		device_->defer_destruction([device = device_->get_logical_device(), frame_buffer = static_cast<VkFramebuffer>(handle_)]() {
+			vkDestroyFramebuffer(device, frame_buffer, nullptr);
+		});
 		FLOWFORGE_TRACE("Framebuffer destroyed");
 	}
 }
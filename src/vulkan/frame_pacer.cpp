@@ -0,0 +1,106 @@
+#include "pch.hpp"
+
+#include "frame_pacer.hpp"
+
+#include "display_context.hpp"
+
+#include <algorithm>
+
+namespace flwfrg::vk
+{
+
+FramePacer::FramePacer(DisplayContext *context) : context_{context}
+{
+    assert(context_ != nullptr);
+}
+
+void FramePacer::wait_before_input()
+{
+    const PresentConfig &config = context_->get_swapchain().get_present_config();
+    if (config.latency_limiter)
+        retire_frames(config.max_queued_frames, limiter_timeout_ns);
+    else
+        retire_frames(max_tracked_frames, 0);
+}
+
+void FramePacer::mark_input_sampled()
+{
+    input_time_ = clock::now();
+}
+
+void FramePacer::mark_presented(uint64_t timeline_value)
+{
+    Swapchain &swapchain = context_->get_swapchain();
+
+    QueuedFrame frame{};
+    frame.present_id = swapchain.get_last_present_id();
+    frame.timeline_value = timeline_value;
+    frame.swapchain_generation = swapchain.get_generation();
+    frame.input_time = input_time_;
+
+    // Without a present id, queueing the present is the last point that can be observed
+    if (!can_wait_for_present(frame))
+        add_sample(frame.input_time, clock::now(), false);
+
+    queued_frames_.push_back(frame);
+}
+
+bool FramePacer::can_wait_for_present(const QueuedFrame &frame) const
+{
+    // Present ids of a replaced swapchain can no longer be waited on
+    return frame.present_id != 0 && frame.swapchain_generation == context_->get_swapchain().get_generation();
+}
+
+bool FramePacer::wait_until_displayed(const QueuedFrame &frame, uint64_t timeout_ns)
+{
+    if (can_wait_for_present(frame))
+        return context_->get_swapchain().wait_for_present(frame.present_id, timeout_ns);
+
+    // The closest point available without present wait is the GPU finishing the frame
+    return context_->get_device().wait_for(frame.timeline_value, timeout_ns);
+}
+
+void FramePacer::retire_frames(size_t max_remaining, uint64_t timeout_ns)
+{
+    while (!queued_frames_.empty())
+    {
+        const QueuedFrame &frame = queued_frames_.front();
+        bool over_limit = queued_frames_.size() > max_remaining;
+
+        // Frames within the limit are only polled
+        if (wait_until_displayed(frame, over_limit ? timeout_ns : 0))
+        {
+            if (can_wait_for_present(frame))
+                add_sample(frame.input_time, clock::now(), true);
+        } else if (!over_limit)
+        {
+            break;
+        }
+
+        // Over the limit and timed out: drop it rather than stall every following frame on it
+        queued_frames_.pop_front();
+    }
+}
+
+void FramePacer::add_sample(clock::time_point input_time, clock::time_point present_time, bool measured_to_display)
+{
+    double latency_ms = std::chrono::duration<double, std::milli>(present_time - input_time).count();
+
+    if (stats_.sample_count == 0)
+    {
+        stats_.average_ms = latency_ms;
+        stats_.min_ms = latency_ms;
+        stats_.max_ms = latency_ms;
+    } else
+    {
+        stats_.average_ms += (latency_ms - stats_.average_ms) * average_weight;
+        stats_.min_ms = std::min(stats_.min_ms, latency_ms);
+        stats_.max_ms = std::max(stats_.max_ms, latency_ms);
+    }
+
+    stats_.last_ms = latency_ms;
+    stats_.measured_to_display = measured_to_display;
+    stats_.sample_count++;
+}
+
+}// namespace flwfrg::vk
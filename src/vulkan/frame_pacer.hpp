@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+namespace flwfrg::vk
+{
+class DisplayContext;
+
+/// Input-to-present latency in milliseconds.
+struct LatencyStats
+{
+    double last_ms = 0.0;
+    // Exponential moving average, so it follows changes to the present config
+    double average_ms = 0.0;
+    double min_ms = 0.0;
+    double max_ms = 0.0;
+    uint64_t sample_count = 0;
+    // True when the last sample ended at the present reaching the display (VK_KHR_present_wait). Otherwise it ended
+    // when the present was queued, which leaves out the time spent on the GPU and waiting for the display.
+    bool measured_to_display = false;
+};
+
+/// Follows each frame from input sampling to presentation. Measures the latency between the two, and holds back
+/// input sampling while too many presents are queued if the present config enables the latency limiter.
+class FramePacer
+{
+public:
+    explicit FramePacer(DisplayContext *context);
+    ~FramePacer() = default;
+
+    // Copy
+    FramePacer(const FramePacer &) = delete;
+    FramePacer &operator=(const FramePacer &) = delete;
+    // Move
+    FramePacer(FramePacer &&other) noexcept = default;
+    FramePacer &operator=(FramePacer &&other) noexcept = default;
+
+    // Methods
+
+    /// Call right before input is sampled. Blocks while the latency limiter is on and too many presents are queued.
+    void wait_before_input();
+    /// Call right after input has been sampled for the frame being started.
+    void mark_input_sampled();
+    /// Call once the frame has been submitted, with its timeline value, and presented successfully.
+    void mark_presented(uint64_t timeline_value);
+
+    [[nodiscard]] inline const LatencyStats &get_latency_stats() const { return stats_; }
+    inline void reset_latency_stats() { stats_ = {}; }
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    struct QueuedFrame
+    {
+        uint64_t present_id = 0;
+        uint64_t timeline_value = 0;
+        uint64_t swapchain_generation = 0;
+        clock::time_point input_time{};
+    };
+
+    DisplayContext *context_ = nullptr;
+
+    // Presented, but not known to be displayed yet. Oldest first.
+    std::deque<QueuedFrame> queued_frames_{};
+    clock::time_point input_time_{};
+    LatencyStats stats_{};
+
+    // A hidden or minimized window may never display anything, so the limiter gives up on a frame after this
+    static constexpr uint64_t limiter_timeout_ns = 100'000'000;
+    // Bounds the tracked frames when the limiter is off and nothing waits on them
+    static constexpr size_t max_tracked_frames = 16;
+    static constexpr double average_weight = 0.1;
+
+    [[nodiscard]] bool can_wait_for_present(const QueuedFrame &frame) const;
+    bool wait_until_displayed(const QueuedFrame &frame, uint64_t timeout_ns);
+    void retire_frames(size_t max_remaining, uint64_t timeout_ns);
+    void add_sample(clock::time_point input_time, clock::time_point present_time, bool measured_to_display);
+};
+
+}// namespace flwfrg::vk
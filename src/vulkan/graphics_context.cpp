@@ -0,0 +1,31 @@
+#include "pch.hpp"
+
+#include "graphics_context.hpp"
+
+#include "surface.hpp"
+
+#include <memory>
+
+namespace flwfrg::vk
+{
+namespace
+{
+// Present wait backs the latency limiter, but is not required to present at all
+PhysicalDeviceRequirements with_present_wait_extensions(PhysicalDeviceRequirements requirements)
+{
+    requirements.optional_device_extension_names.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    requirements.optional_device_extension_names.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+    return requirements;
+}
+}// namespace
+
+GraphicsContext::GraphicsContext(Window *window, PhysicalDeviceRequirements requirements,
+                                 ValidationConfig validation_config)
+    : instance_{validation_config},
+      debug_messenger_{validation_config.enable_validation_layers ? DebugMessenger(&instance_) : DebugMessenger()},
+      // The surface only has to live through device selection, each display context creates its own afterwards
+      device_{&instance_, std::make_unique<Surface>(&instance_, window).get(),
+              with_present_wait_extensions(std::move(requirements))}
+{}
+
+}// namespace flwfrg::vk
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "debug_messenger.hpp"
+#include "descriptor_allocator.hpp"
+#include "device.hpp"
+#include "instance.hpp"
+
+namespace flwfrg::vk
+{
+class Window;
+
+/// The part of rendering that is shared between windows: the instance, the device and the device wide caches.
+/// Any number of DisplayContexts can be created on top of one, so pipelines, textures and buffers are created once
+/// and used by every window.
+class GraphicsContext
+{
+public:
+    /// The window is only used to pick a device that can present to it, it does not have to outlive the context.
+    /// The debug messenger is only set up when validation is enabled.
+    explicit GraphicsContext(Window *window, PhysicalDeviceRequirements requirements = {},
+                             ValidationConfig validation_config = ValidationConfig::from_environment());
+    ~GraphicsContext() = default;
+
+    // Copy
+    GraphicsContext(const GraphicsContext &) = delete;
+    GraphicsContext &operator=(const GraphicsContext &) = delete;
+    // Move, not allowed since display contexts and resources point into it
+    GraphicsContext(GraphicsContext &&other) noexcept = delete;
+    GraphicsContext &operator=(GraphicsContext &&other) noexcept = delete;
+
+    // Getters
+    [[nodiscard]] inline Instance &get_instance() { return instance_; }
+    [[nodiscard]] inline Device &get_device() { return device_; }
+    inline DescriptorSetLayoutCache &get_descriptor_layout_cache() { return descriptor_layout_cache_; };
+
+private:
+    Instance instance_;
+    DebugMessenger debug_messenger_;
+
+    Device device_;
+
+    DescriptorSetLayoutCache descriptor_layout_cache_{&device_};
+};
+
+}// namespace flwfrg::vk
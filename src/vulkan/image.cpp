@@ -103,19 +103,23 @@ Image::Image(
 
 Image::~Image()
 {
-	if (view_)
+	if (view_.not_null() || image_handle_.not_null() || memory_.not_null())
 	{
-		vkDestroyImageView(device_->get_logical_device(), view_, nullptr);
-	}
-	if (image_handle_)
-	{
-		vkDestroyImage(device_->get_logical_device(), image_handle_, nullptr);
+		// The GPU may still be sampling from or rendering to the image
+		device_->defer_destruction([device = device_->get_logical_device(), view = static_cast<VkImageView>(view_),
+		                            image = static_cast<VkImage>(image_handle_), memory = static_cast<VkDeviceMemory>(memory_)]() {
+			if (view != VK_NULL_HANDLE)
+				vkDestroyImageView(device, view, nullptr);
+			if (image != VK_NULL_HANDLE)
+				vkDestroyImage(device, image, nullptr);
+			if (memory != VK_NULL_HANDLE)
+				vkFreeMemory(device, memory, nullptr);
+		});
+		view_ = {};
+		image_handle_ = {};
+		memory_ = {};
 		FLOWFORGE_TRACE("Vulkan Image destroyed");
 	}
-	if (memory_)
-	{
-		vkFreeMemory(device_->get_logical_device(), memory_, nullptr);
-	}
 }
 void Image::transition_layout(CommandBuffer &command_buffer, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout)
 {
@@ -4,15 +4,61 @@
 
 #include "debug_messenger.hpp"
 
+#include <algorithm>
+#include <cstdlib>
 #include <stdexcept>
+#include <string_view>
 #include <unordered_set>
 
 namespace flwfrg::vk
 {
-Instance::Instance(bool enable_validation_layers)
-	: enable_validation_layers_{enable_validation_layers}
+ValidationConfig ValidationConfig::from_environment()
 {
-	FLOWFORGE_INFO("Creating Vulkan instance");
+	ValidationConfig config{};
+
+	const char *value = std::getenv("FLOWFORGE_VALIDATION");
+	if (value == nullptr)
+		return config;
+
+	std::string_view options{value};
+	while (!options.empty())
+	{
+		size_t end = options.find(',');
+		std::string_view option = options.substr(0, end);
+		options = end == std::string_view::npos ? std::string_view{} : options.substr(end + 1);
+
+		if (option == "off" || option == "0")
+		{
+			config = ValidationConfig{.enable_validation_layers = false};
+		} else if (option == "on" || option == "1")
+		{
+			config.enable_validation_layers = true;
+		} else if (option == "gpu_assisted")
+		{
+			config.enable_validation_layers = true;
+			config.gpu_assisted = true;
+		} else if (option == "best_practices")
+		{
+			config.enable_validation_layers = true;
+			config.best_practices = true;
+		} else if (option == "synchronization")
+		{
+			config.enable_validation_layers = true;
+			config.synchronization = true;
+		} else if (!option.empty())
+		{
+			FLOWFORGE_WARN("Ignoring unknown FLOWFORGE_VALIDATION option '{}'", option);
+		}
+	}
+
+	return config;
+}
+
+Instance::Instance(ValidationConfig validation_config)
+	: validation_config_{validation_config},
+	  enable_validation_layers_{validation_config.enable_validation_layers}
+{
+	FLOWFORGE_INFO("Creating Vulkan instance, validation {}", enable_validation_layers_ ? "enabled" : "disabled");
 
 	// Check if the validation layers are enabled and supported.
 	if (enable_validation_layers_ && !validation_layers_supported(validationLayers))
@@ -34,7 +80,7 @@ Instance::Instance(bool enable_validation_layers)
 	// Specify the engine version
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
 	// Specify the vulkan API version.
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_3;
 
 	// Create the instance_ create info
 	VkInstanceCreateInfo createInfo{};
@@ -79,6 +125,42 @@ Instance::Instance(bool enable_validation_layers)
 		createInfo.pNext = nullptr;
 	}
 
+	// The validation layer's optional checks, which come in through an extension of the layer itself
+	std::vector<VkValidationFeatureEnableEXT> enabled_features{};
+	if (enable_validation_layers_)
+	{
+		if (validation_config_.gpu_assisted)
+		{
+			enabled_features.push_back(VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_EXT);
+			enabled_features.push_back(VK_VALIDATION_FEATURE_ENABLE_GPU_ASSISTED_RESERVE_BINDING_SLOT_EXT);
+		}
+		if (validation_config_.best_practices)
+			enabled_features.push_back(VK_VALIDATION_FEATURE_ENABLE_BEST_PRACTICES_EXT);
+		if (validation_config_.synchronization)
+			enabled_features.push_back(VK_VALIDATION_FEATURE_ENABLE_SYNCHRONIZATION_VALIDATION_EXT);
+	}
+
+	VkValidationFeaturesEXT validation_features{};
+	if (!enabled_features.empty())
+	{
+		if (layer_extension_supported(validationLayers[0], VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME))
+		{
+			extensions.push_back(VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+			createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+			createInfo.ppEnabledExtensionNames = extensions.data();
+
+			validation_features.sType = VK_STRUCTURE_TYPE_VALIDATION_FEATURES_EXT;
+			validation_features.pNext = createInfo.pNext;
+			validation_features.enabledValidationFeatureCount = static_cast<uint32_t>(enabled_features.size());
+			validation_features.pEnabledValidationFeatures = enabled_features.data();
+			createInfo.pNext = &validation_features;
+		} else
+		{
+			FLOWFORGE_WARN("The validation layer does not support {}, running without the requested validation features",
+						   VK_EXT_VALIDATION_FEATURES_EXTENSION_NAME);
+		}
+	}
+
 	// Finally, create the instance_
 	if (vkCreateInstance(&createInfo, nullptr, instance_.ptr()) != VK_SUCCESS)
 	{
@@ -146,6 +228,18 @@ bool Instance::validation_layers_supported(const std::vector<const char *> &laye
 	return true;
 }
 
+bool Instance::layer_extension_supported(const char *layer, const char *extension)
+{
+	uint32_t extension_count = 0;
+	vkEnumerateInstanceExtensionProperties(layer, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count);
+	vkEnumerateInstanceExtensionProperties(layer, &extension_count, extensions.data());
+
+	return std::any_of(extensions.begin(), extensions.end(), [extension](const VkExtensionProperties &properties) {
+		return strcmp(properties.extensionName, extension) == 0;
+	});
+}
+
 std::vector<const char *> Instance::get_required_extensions(bool enable_validation_layers)
 {
 	// Get the number of extensions required by glfw.
@@ -10,10 +10,35 @@
 namespace flwfrg::vk
 {
 
+/// Which Vulkan validation runs. Validation costs CPU time on every API call, so release builds (NDEBUG) run none by
+/// default, and debug builds run the validation layer on its own.
+struct ValidationConfig
+{
+#ifdef NDEBUG
+	static constexpr bool default_enabled = false;
+#else
+	static constexpr bool default_enabled = true;
+#endif
+
+	// VK_LAYER_KHRONOS_validation, with a debug messenger logging what it reports
+	bool enable_validation_layers = default_enabled;
+	// Instruments shaders to check descriptor indexing and buffer accesses on the GPU, at a large cost on both sides
+	bool gpu_assisted = false;
+	// Warns about API use that is valid but slow
+	bool best_practices = false;
+	// Checks for missing or wrong barriers between commands
+	bool synchronization = false;
+
+	/// The build's default, changed by the FLOWFORGE_VALIDATION environment variable when it is set. It takes a comma
+	/// separated list of "off", "on", "gpu_assisted", "best_practices" and "synchronization", where each of the last
+	/// three turns the validation layer on as well, e.g. FLOWFORGE_VALIDATION=best_practices,synchronization.
+	[[nodiscard]] static ValidationConfig from_environment();
+};
+
 class Instance
 {
 public:
-	explicit Instance(bool enable_validation_layers = true);
+	explicit Instance(ValidationConfig validation_config = ValidationConfig::from_environment());
 	~Instance();
 
 	// Copy
@@ -24,13 +49,16 @@ public:
 	Instance &operator=(Instance &&other) noexcept = default;
 
 	[[nodiscard]] VkInstance handle() const { return instance_; };
+	[[nodiscard]] inline const ValidationConfig &get_validation_config() const { return validation_config_; };
 
 private:
+	ValidationConfig validation_config_;
 	bool enable_validation_layers_;
 
 	Handle<VkInstance> instance_;
 
 	[[nodiscard]] static bool validation_layers_supported(const std::vector<const char *> &layers);
+	[[nodiscard]] static bool layer_extension_supported(const char *layer, const char *extension);
 	[[nodiscard]] static std::vector<const char *> get_required_extensions(bool enable_validation_layers);
 	static void check_glfw_required_instance_extensions(bool enable_validation_layers);
 
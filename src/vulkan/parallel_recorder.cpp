@@ -0,0 +1,128 @@
+#include "pch.hpp"
+
+#include "parallel_recorder.hpp"
+
+#include "display_context.hpp"
+#include "threading/thread_pool.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace flwfrg::vk
+{
+
+ParallelRecorder::ParallelRecorder(DisplayContext *context, ThreadPool *thread_pool, size_t min_draws_per_batch)
+    : context_{context}, thread_pool_{thread_pool}, min_draws_per_batch_{std::max<size_t>(min_draws_per_batch, 1)}
+{
+    assert(context_ != nullptr);
+    assert(thread_pool_ != nullptr);
+
+    slot_count_ = thread_pool_->get_thread_count() + 1;
+    create_slots();
+
+    recorded_handles_.resize(slot_count_);
+}
+
+void ParallelRecorder::record(size_t draw_count, const RecordFunction &record_function)
+{
+    assert(context_ != nullptr);
+
+    if (draw_count == 0)
+        return;
+
+    // Small workloads are cheaper to record on fewer threads than to hand out
+    size_t batch_count = std::min(slot_count_, (draw_count + min_draws_per_batch_ - 1) / min_draws_per_batch_);
+    size_t batch_size = (draw_count + batch_count - 1) / batch_count;
+
+    if (slots_.size() != context_->get_swapchain().get_max_frames_in_flight() * slot_count_)
+        create_slots();
+
+    RecordSlot *frame_slots = &slots_[context_->get_current_frame() * slot_count_];
+    reset_frame_slots(frame_slots);
+
+    thread_pool_->parallel_for(batch_count, [&](size_t batch) {
+        size_t first = batch * batch_size;
+        size_t count = std::min(batch_size, draw_count - first);
+        recorded_handles_[batch] = record_batch(frame_slots[batch], first, count, record_function);
+    });
+
+    vkCmdExecuteCommands(context_->get_command_buffer().get_handle(), static_cast<uint32_t>(batch_count),
+                         recorded_handles_.data());
+}
+
+void ParallelRecorder::create_slots()
+{
+    Device &device = context_->get_device();
+
+    // Old slots go through the device's deferred destruction, command buffers ahead of their pools
+    slots_.clear();
+
+    size_t frame_count = context_->get_swapchain().get_max_frames_in_flight();
+    slots_.resize(frame_count * slot_count_);
+    for (auto &slot: slots_)
+    {
+        slot.pool = CommandPool(&device, device.get_graphics_queue_index(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+    }
+    reset_frames_.assign(frame_count, std::numeric_limits<uint64_t>::max());
+}
+
+void ParallelRecorder::reset_frame_slots(RecordSlot *frame_slots)
+{
+    uint64_t &reset_frame = reset_frames_[context_->get_current_frame()];
+    if (reset_frame == context_->get_frame_counter())
+        return;
+
+    // The frame slot's timeline value has been waited on, so everything recorded from these pools last time is done.
+    // Later record calls of the frame leave them alone, the primary already executes what earlier calls recorded.
+    for (size_t slot = 0; slot < slot_count_; slot++)
+    {
+        frame_slots[slot].pool.reset();
+        for (auto &command_buffer: frame_slots[slot].command_buffers)
+        {
+            command_buffer.mark_pool_reset();
+        }
+        frame_slots[slot].used_count = 0;
+    }
+    reset_frame = context_->get_frame_counter();
+}
+
+VkCommandBuffer ParallelRecorder::record_batch(RecordSlot &slot, size_t first, size_t count,
+                                               const RecordFunction &record_function)
+{
+    if (slot.used_count == slot.command_buffers.size())
+        slot.command_buffers.emplace_back(&context_->get_device(), slot.pool.handle(), false);
+    CommandBuffer &command_buffer = slot.command_buffers[slot.used_count++];
+
+    VkCommandBufferInheritanceInfo inheritance_info{};
+    inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.renderPass = context_->get_main_render_pass().handle();
+    inheritance_info.subpass = context_->get_main_render_pass().get_current_subpass();
+    inheritance_info.framebuffer = context_->get_frame_buffer_handle();
+
+    command_buffer.begin(true, true, false, &inheritance_info);
+
+    // Dynamic state is not inherited from the primary command buffer
+    glm::vec2 frame_buffer_size = context_->get_swapchain().get_frame_buffer_size();
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = frame_buffer_size.x;
+    viewport.height = frame_buffer_size.y;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = {static_cast<uint32_t>(frame_buffer_size.x), static_cast<uint32_t>(frame_buffer_size.y)};
+
+    vkCmdSetViewport(command_buffer.get_handle(), 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer.get_handle(), 0, 1, &scissor);
+
+    record_function(command_buffer, first, count);
+
+    command_buffer.end();
+    return command_buffer.get_handle();
+}
+
+}// namespace flwfrg::vk
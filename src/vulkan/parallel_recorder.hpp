@@ -0,0 +1,87 @@
+#pragma once
+
+#include "command_buffer.hpp"
+#include "command_pool.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <functional>
+#include <vector>
+
+namespace flwfrg
+{
+class ThreadPool;
+}
+
+namespace flwfrg::vk
+{
+class DisplayContext;
+
+/// Records the draws of the main render pass into secondary command buffers on a thread pool, and executes them
+/// from the frame's primary command buffer. Every worker slot has its own transient command pool per frame in
+/// flight, so no pool is ever touched by two threads and a whole frame's buffers are recycled with one pool reset.
+/// The pools are reset on the first record of a frame only, so a frame may record several subpasses, each into
+/// command buffers of its own.
+///
+/// The frame has to be started with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+/// (see Renderer::begin_frame), after which no inline commands may be recorded into the main pass.
+class ParallelRecorder
+{
+public:
+    /// Records the draws [first, first + count) into the given secondary command buffer. Called concurrently from
+    /// several threads, each with its own command buffer.
+    using RecordFunction = std::function<void(CommandBuffer &command_buffer, size_t first, size_t count)>;
+
+public:
+    ParallelRecorder() = default;
+    ParallelRecorder(DisplayContext *context, ThreadPool *thread_pool, size_t min_draws_per_batch = 256);
+    ~ParallelRecorder() = default;
+
+    // Copy
+    ParallelRecorder(const ParallelRecorder &) = delete;
+    ParallelRecorder &operator=(const ParallelRecorder &) = delete;
+    // Move
+    ParallelRecorder(ParallelRecorder &&other) noexcept = default;
+    ParallelRecorder &operator=(ParallelRecorder &&other) noexcept = default;
+
+    // Methods
+
+    /// Splits draw_count draws into batches, records them in parallel and executes the resulting secondary command
+    /// buffers in the current frame's primary command buffer. Blocks until all batches are recorded.
+    /// May be called once per subpass of the main render pass, the draws are recorded for the current subpass.
+    void record(size_t draw_count, const RecordFunction &record_function);
+
+    [[nodiscard]] inline size_t get_slot_count() const { return slot_count_; }
+
+private:
+    struct RecordSlot
+    {
+        // The pool must outlive the command buffers allocated from it
+        CommandPool pool{};
+        // One per record call of a frame, kept for the next frames once allocated
+        std::vector<CommandBuffer> command_buffers{};
+        size_t used_count = 0;
+    };
+
+    DisplayContext *context_ = nullptr;
+    ThreadPool *thread_pool_ = nullptr;
+
+    size_t min_draws_per_batch_ = 0;
+    // Worker threads plus the calling thread
+    size_t slot_count_ = 0;
+
+    // Indexed as [frame * slot_count_ + slot]
+    std::vector<RecordSlot> slots_{};
+    // Per frame in flight, the frame counter its slots were last reset in
+    std::vector<uint64_t> reset_frames_{};
+    std::vector<VkCommandBuffer> recorded_handles_{};
+
+    // Sizes the slots to the current number of frames in flight, which may change with the present config
+    void create_slots();
+    // Resets the pools of the current frame's slots, unless already done this frame
+    void reset_frame_slots(RecordSlot *frame_slots);
+    [[nodiscard]] VkCommandBuffer record_batch(RecordSlot &slot, size_t first, size_t count,
+                                               const RecordFunction &record_function);
+};
+
+}// namespace flwfrg::vk
@@ -0,0 +1,961 @@
+#include "pch.hpp"
+
+#include "render_graph.hpp"
+
+#include "command_buffer.hpp"
+#include "device.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace flwfrg::vk
+{
+
+// Pass builder
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(ImageHandle image, Access access)
+{
+    assert(image.id < graph_->images_.size());
+    assert(!is_write_access(access));
+    assert(access != Access::COLOR_ATTACHMENT && access != Access::DEPTH_READ_ONLY);
+
+    add_access(graph_->passes_[pass_index_].image_accesses, image.id, access, true, false);
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::write(ImageHandle image, Access access)
+{
+    assert(image.id < graph_->images_.size());
+    assert(is_write_access(access));
+    assert(access != Access::COLOR_ATTACHMENT && access != Access::DEPTH_ATTACHMENT);
+
+    add_access(graph_->passes_[pass_index_].image_accesses, image.id, access, false, true);
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::read(BufferHandle buffer, Access access)
+{
+    assert(buffer.id < graph_->buffers_.size());
+    assert(!is_write_access(access));
+    assert(access != Access::SAMPLED && access != Access::DEPTH_READ_ONLY);
+
+    add_access(graph_->passes_[pass_index_].buffer_accesses, buffer.id, access, true, false);
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::write(BufferHandle buffer, Access access)
+{
+    assert(buffer.id < graph_->buffers_.size());
+    assert(access == Access::STORAGE_WRITE || access == Access::TRANSFER_DST);
+
+    add_access(graph_->passes_[pass_index_].buffer_accesses, buffer.id, access, false, true);
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::color_attachment(ImageHandle image,
+                                                                     std::optional<VkClearColorValue> clear)
+{
+    assert(image.id < graph_->images_.size());
+    Pass &pass = graph_->passes_[pass_index_];
+    assert(pass.type == PassType::GRAPHICS);
+
+    add_access(pass.image_accesses, image.id, Access::COLOR_ATTACHMENT, !clear.has_value(), true);
+
+    Attachment attachment{.image = image.id};
+    if (clear.has_value())
+        attachment.clear = VkClearValue{.color = clear.value()};
+    pass.color_attachments.push_back(attachment);
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::depth_attachment(ImageHandle image, std::optional<float> clear,
+                                                                     bool write)
+{
+    assert(image.id < graph_->images_.size());
+    Pass &pass = graph_->passes_[pass_index_];
+    assert(pass.type == PassType::GRAPHICS);
+    assert(!pass.depth_attachment.has_value());
+    // Clearing is a write
+    assert(write || !clear.has_value());
+
+    if (write)
+        add_access(pass.image_accesses, image.id, Access::DEPTH_ATTACHMENT, !clear.has_value(), true);
+    else
+        add_access(pass.image_accesses, image.id, Access::DEPTH_READ_ONLY, true, false);
+
+    Attachment attachment{.image = image.id};
+    if (clear.has_value())
+        attachment.clear = VkClearValue{.depthStencil = {clear.value(), 0}};
+    pass.depth_attachment = attachment;
+    pass.depth_write = write;
+    return *this;
+}
+
+RenderGraph::PassBuilder &RenderGraph::PassBuilder::side_effect()
+{
+    graph_->passes_[pass_index_].side_effect = true;
+    return *this;
+}
+
+// Render graph
+
+RenderGraph::RenderGraph(Device *device) : device_{device}
+{
+    assert(device_ != nullptr);
+}
+
+RenderGraph::~RenderGraph()
+{
+    release_compiled_resources();
+}
+
+RenderGraph::ImageHandle RenderGraph::create_image(std::string name, ImageDescription description)
+{
+    assert(description.format != VK_FORMAT_UNDEFINED);
+    assert(description.extent.width > 0 && description.extent.height > 0);
+
+    compiled_ = false;
+    images_.push_back(ImageResource{.name = std::move(name), .description = description, .imported = false});
+    return {static_cast<uint32_t>(images_.size() - 1)};
+}
+
+RenderGraph::ImageHandle RenderGraph::import_image(std::string name, ImageDescription description,
+                                                   ResourceState initial_state, ResourceState final_state)
+{
+    compiled_ = false;
+    images_.push_back(ImageResource{
+            .name = std::move(name),
+            .description = description,
+            .imported = true,
+            .initial_state = initial_state,
+            .final_state = final_state,
+    });
+    return {static_cast<uint32_t>(images_.size() - 1)};
+}
+
+RenderGraph::BufferHandle RenderGraph::import_buffer(std::string name, ResourceState initial_state,
+                                                     ResourceState final_state)
+{
+    compiled_ = false;
+    buffers_.push_back(BufferResource{
+            .name = std::move(name),
+            .initial_state = initial_state,
+            .final_state = final_state,
+    });
+    return {static_cast<uint32_t>(buffers_.size() - 1)};
+}
+
+RenderGraph::PassBuilder RenderGraph::add_pass(std::string name, PassType type, ExecuteFunction execute)
+{
+    compiled_ = false;
+    passes_.push_back(Pass{.name = std::move(name), .type = type, .execute = std::move(execute)});
+    return {this, static_cast<uint32_t>(passes_.size() - 1)};
+}
+
+void RenderGraph::reset()
+{
+    release_compiled_resources();
+
+    passes_.clear();
+    images_.clear();
+    buffers_.clear();
+    schedule_.clear();
+    final_image_barriers_.clear();
+    final_buffer_barriers_.clear();
+
+    compiled_ = false;
+    stats_ = {};
+}
+
+void RenderGraph::compile()
+{
+    // Recompiling starts from the declaration again
+    release_compiled_resources();
+    for (auto &pass: passes_)
+    {
+        pass.culled = false;
+        pass.image_barriers.clear();
+        pass.buffer_barriers.clear();
+    }
+    for (auto &image: images_)
+    {
+        image.usage = 0;
+        image.first_use = constant::invalid_id;
+        image.last_use = constant::invalid_id;
+        image.last_stage = VK_PIPELINE_STAGE_2_NONE;
+        image.last_access = VK_ACCESS_2_NONE;
+        image.memory_block = constant::invalid_id;
+    }
+    stats_ = {};
+
+    cull_passes();
+    compute_lifetimes();
+    allocate_transient_images();
+    compute_barriers();
+    choose_attachment_operations();
+
+    stats_.pass_count = static_cast<uint32_t>(schedule_.size());
+    stats_.culled_pass_count = static_cast<uint32_t>(passes_.size() - schedule_.size());
+    compiled_ = true;
+
+    FLOWFORGE_TRACE("Compiled render graph: {} passes ({} culled), {} barrier batches, {} KiB of transient memory "
+                    "({} KiB without aliasing)",
+                    stats_.pass_count, stats_.culled_pass_count, stats_.barrier_batch_count,
+                    stats_.transient_memory_size / 1024, stats_.unaliased_memory_size / 1024);
+}
+
+void RenderGraph::set_imported_image(ImageHandle image, VkImage handle, VkImageView view)
+{
+    assert(image.id < images_.size());
+    assert(images_[image.id].imported);
+
+    images_[image.id].image = handle;
+    images_[image.id].view = view;
+}
+
+void RenderGraph::set_imported_buffer(BufferHandle buffer, VkBuffer handle)
+{
+    assert(buffer.id < buffers_.size());
+
+    buffers_[buffer.id].buffer = handle;
+}
+
+void RenderGraph::execute(CommandBuffer &command_buffer)
+{
+    assert(compiled_);
+
+    for (uint32_t pass_index: schedule_)
+    {
+        const Pass &pass = passes_[pass_index];
+
+        record_barriers(command_buffer, pass.image_barriers, pass.buffer_barriers);
+
+        const bool is_rendering = !pass.color_attachments.empty() || pass.depth_attachment.has_value();
+        if (is_rendering)
+            begin_rendering(command_buffer, pass);
+
+        if (pass.execute)
+            pass.execute(command_buffer);
+
+        if (is_rendering)
+            vkCmdEndRendering(command_buffer.get_handle());
+    }
+
+    record_barriers(command_buffer, final_image_barriers_, final_buffer_barriers_);
+}
+
+VkImage RenderGraph::get_image(ImageHandle image) const
+{
+    assert(image.id < images_.size());
+    return images_[image.id].image;
+}
+
+VkImageView RenderGraph::get_image_view(ImageHandle image) const
+{
+    assert(image.id < images_.size());
+    return images_[image.id].view;
+}
+
+const RenderGraph::ImageDescription &RenderGraph::get_image_description(ImageHandle image) const
+{
+    assert(image.id < images_.size());
+    return images_[image.id].description;
+}
+
+bool RenderGraph::is_pass_culled(std::string_view name) const
+{
+    auto pass = std::ranges::find_if(passes_, [name](const Pass &other) { return other.name == name; });
+    assert(pass != passes_.end());
+    return pass->culled;
+}
+
+void RenderGraph::cull_passes()
+{
+    // Reference counting: a pass is needed while something needs a resource it writes. Imported resources are
+    // always needed, and a transient image nobody reads releases the passes writing it, which in turn may release
+    // what those passes read.
+    std::vector<uint32_t> pass_references(passes_.size(), 0);
+    std::vector<uint32_t> image_references(images_.size(), 0);
+    std::vector<std::vector<uint32_t>> image_writers(images_.size());
+
+    for (uint32_t pass_index = 0; pass_index < passes_.size(); pass_index++)
+    {
+        const Pass &pass = passes_[pass_index];
+        for (const auto &access: pass.image_accesses)
+        {
+            // A pass loading what it writes only needs the earlier contents if it survives itself
+            if (access.writes)
+            {
+                pass_references[pass_index]++;
+                image_writers[access.resource].push_back(pass_index);
+            }
+            else
+            {
+                image_references[access.resource]++;
+            }
+        }
+        for (const auto &access: pass.buffer_accesses)
+        {
+            if (access.writes)
+                pass_references[pass_index]++;
+        }
+    }
+
+    std::vector<uint32_t> unused_images{};
+    for (uint32_t image_index = 0; image_index < images_.size(); image_index++)
+    {
+        if (!images_[image_index].imported && image_references[image_index] == 0)
+            unused_images.push_back(image_index);
+    }
+
+    auto cull = [&](uint32_t pass_index) {
+        Pass &pass = passes_[pass_index];
+        pass.culled = true;
+        for (const auto &access: pass.image_accesses)
+        {
+            if (access.writes)
+                continue;
+            if (--image_references[access.resource] == 0 && !images_[access.resource].imported)
+                unused_images.push_back(access.resource);
+        }
+    };
+
+    for (uint32_t pass_index = 0; pass_index < passes_.size(); pass_index++)
+    {
+        if (pass_references[pass_index] == 0 && !passes_[pass_index].side_effect)
+            cull(pass_index);
+    }
+
+    while (!unused_images.empty())
+    {
+        uint32_t image_index = unused_images.back();
+        unused_images.pop_back();
+
+        for (uint32_t pass_index: image_writers[image_index])
+        {
+            if (passes_[pass_index].culled)
+                continue;
+            if (--pass_references[pass_index] == 0 && !passes_[pass_index].side_effect)
+                cull(pass_index);
+        }
+    }
+
+    schedule_.clear();
+    for (uint32_t pass_index = 0; pass_index < passes_.size(); pass_index++)
+    {
+        if (!passes_[pass_index].culled)
+            schedule_.push_back(pass_index);
+    }
+}
+
+void RenderGraph::compute_lifetimes()
+{
+    for (uint32_t position = 0; position < schedule_.size(); position++)
+    {
+        const Pass &pass = passes_[schedule_[position]];
+        for (const auto &access: pass.image_accesses)
+        {
+            ImageResource &image = images_[access.resource];
+            AccessInfo info = get_access_info(access.access, pass.type);
+
+            if (image.first_use == constant::invalid_id)
+                image.first_use = position;
+            image.last_use = position;
+            image.usage |= get_image_usage(access.access);
+            image.last_stage = info.stage;
+            image.last_access = access.writes ? info.access : VK_ACCESS_2_NONE;
+        }
+    }
+}
+
+void RenderGraph::allocate_transient_images()
+{
+    VkDevice device = device_->get_logical_device();
+
+    std::vector<uint32_t> transient_images{};
+    for (uint32_t image_index = 0; image_index < images_.size(); image_index++)
+    {
+        ImageResource &image = images_[image_index];
+        if (image.imported || image.first_use == constant::invalid_id)
+            continue;
+
+        VkImageCreateInfo image_info{};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.format = image.description.format;
+        image_info.extent = {image.description.extent.width, image.description.extent.height, 1};
+        image_info.mipLevels = 1;
+        image_info.arrayLayers = 1;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = image.usage;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+        if (vkCreateImage(device, &image_info, nullptr, &image.image) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create render graph image " + image.name);
+        }
+        vkGetImageMemoryRequirements(device, image.image, &image.memory_requirements);
+
+        stats_.unaliased_memory_size += image.memory_requirements.size;
+        transient_images.push_back(image_index);
+    }
+    stats_.transient_image_count = static_cast<uint32_t>(transient_images.size());
+
+    // Largest first, each image goes into the first block whose images are all dead before it is first used or
+    // born after it is last used
+    std::ranges::stable_sort(transient_images, [this](uint32_t a, uint32_t b) {
+        return images_[a].memory_requirements.size > images_[b].memory_requirements.size;
+    });
+
+    for (uint32_t image_index: transient_images)
+    {
+        ImageResource &image = images_[image_index];
+
+        auto fits = [this, &image](const MemoryBlock &block) {
+            if ((block.memory_type_bits & image.memory_requirements.memoryTypeBits) == 0)
+                return false;
+            return std::ranges::all_of(block.images, [this, &image](uint32_t other_index) {
+                const ImageResource &other = images_[other_index];
+                return other.last_use < image.first_use || image.last_use < other.first_use;
+            });
+        };
+
+        auto block = std::ranges::find_if(memory_blocks_, fits);
+        if (block == memory_blocks_.end())
+        {
+            memory_blocks_.emplace_back();
+            block = memory_blocks_.end() - 1;
+        }
+
+        block->size = std::max(block->size, image.memory_requirements.size);
+        block->alignment = std::max(block->alignment, image.memory_requirements.alignment);
+        block->memory_type_bits &= image.memory_requirements.memoryTypeBits;
+        block->images.push_back(image_index);
+        image.memory_block = static_cast<uint32_t>(block - memory_blocks_.begin());
+    }
+
+    for (auto &block: memory_blocks_)
+    {
+        std::ranges::sort(block.images, [this](uint32_t a, uint32_t b) {
+            return images_[a].first_use < images_[b].first_use;
+        });
+
+        int32_t memory_index = device_->find_memory_index(block.memory_type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        if (memory_index < 0)
+        {
+            throw std::runtime_error("Failed to find memory type for render graph images");
+        }
+
+        VkMemoryAllocateInfo allocate_info{};
+        allocate_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocate_info.allocationSize = block.size;
+        allocate_info.memoryTypeIndex = static_cast<uint32_t>(memory_index);
+
+        if (vkAllocateMemory(device, &allocate_info, nullptr, &block.memory) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate render graph memory");
+        }
+        stats_.transient_memory_size += block.size;
+
+        for (uint32_t image_index: block.images)
+        {
+            ImageResource &image = images_[image_index];
+            if (vkBindImageMemory(device, image.image, block.memory, 0) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to bind render graph image memory");
+            }
+
+            VkImageViewCreateInfo view_info{};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = image.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = image.description.format;
+            view_info.subresourceRange.aspectMask = get_aspect_flags(image.description.format);
+            view_info.subresourceRange.baseMipLevel = 0;
+            view_info.subresourceRange.levelCount = 1;
+            view_info.subresourceRange.baseArrayLayer = 0;
+            view_info.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(device, &view_info, nullptr, &image.view) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create render graph image view " + image.name);
+            }
+        }
+    }
+}
+
+void RenderGraph::compute_barriers()
+{
+    std::vector<TrackedState> image_states(images_.size());
+    for (uint32_t image_index = 0; image_index < images_.size(); image_index++)
+    {
+        const ImageResource &image = images_[image_index];
+        TrackedState &state = image_states[image_index];
+        if (image.imported)
+        {
+            state.layout = image.initial_state.layout;
+            state.write_stage = image.initial_state.stage;
+            state.write_access = image.initial_state.access;
+        }
+        else if (image.memory_block != constant::invalid_id)
+        {
+            // The contents are discarded, but the memory was last used by the image before it in the block. The
+            // first image waits for the last one, which used the memory during the previous execution.
+            const auto &block_images = memory_blocks_[image.memory_block].images;
+            auto position = std::ranges::find(block_images, image_index) - block_images.begin();
+            const ImageResource &previous = images_[block_images[(position + block_images.size() - 1) % block_images.size()]];
+            state.write_stage = previous.last_stage;
+            state.write_access = previous.last_access;
+        }
+    }
+
+    std::vector<TrackedState> buffer_states(buffers_.size());
+    for (uint32_t buffer_index = 0; buffer_index < buffers_.size(); buffer_index++)
+    {
+        buffer_states[buffer_index].write_stage = buffers_[buffer_index].initial_state.stage;
+        buffer_states[buffer_index].write_access = buffers_[buffer_index].initial_state.access;
+    }
+
+    // All barriers a pass needs are recorded together right before it
+    for (uint32_t pass_index: schedule_)
+    {
+        Pass &pass = passes_[pass_index];
+        for (const auto &access: pass.image_accesses)
+        {
+            AccessInfo info = get_access_info(access.access, pass.type);
+            info.is_write = access.writes;
+            synchronize(image_states[access.resource], access.resource, info, true, pass.image_barriers);
+        }
+        for (const auto &access: pass.buffer_accesses)
+        {
+            AccessInfo info = get_access_info(access.access, pass.type);
+            info.is_write = access.writes;
+            synchronize(buffer_states[access.resource], access.resource, info, false, pass.buffer_barriers);
+        }
+
+        if (!pass.image_barriers.empty() || !pass.buffer_barriers.empty())
+            stats_.barrier_batch_count++;
+        stats_.image_barrier_count += static_cast<uint32_t>(pass.image_barriers.size());
+        stats_.buffer_barrier_count += static_cast<uint32_t>(pass.buffer_barriers.size());
+    }
+
+    // Hand imported resources back in the state their owner expects
+    final_image_barriers_.clear();
+    final_buffer_barriers_.clear();
+    for (uint32_t image_index = 0; image_index < images_.size(); image_index++)
+    {
+        const ImageResource &image = images_[image_index];
+        if (!image.imported)
+            continue;
+        if (image.final_state.layout == VK_IMAGE_LAYOUT_UNDEFINED && image.final_state.stage == VK_PIPELINE_STAGE_2_NONE)
+            continue;
+
+        TrackedState &state = image_states[image_index];
+        AccessInfo info{
+                .stage = image.final_state.stage,
+                .access = image.final_state.access,
+                .layout = image.final_state.layout == VK_IMAGE_LAYOUT_UNDEFINED ? state.layout : image.final_state.layout,
+                .is_write = true,
+        };
+        synchronize(state, image_index, info, true, final_image_barriers_);
+    }
+    for (uint32_t buffer_index = 0; buffer_index < buffers_.size(); buffer_index++)
+    {
+        const BufferResource &buffer = buffers_[buffer_index];
+        if (buffer.final_state.stage == VK_PIPELINE_STAGE_2_NONE)
+            continue;
+
+        AccessInfo info{
+                .stage = buffer.final_state.stage,
+                .access = buffer.final_state.access,
+                .layout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .is_write = true,
+        };
+        synchronize(buffer_states[buffer_index], buffer_index, info, false, final_buffer_barriers_);
+    }
+
+    if (!final_image_barriers_.empty() || !final_buffer_barriers_.empty())
+        stats_.barrier_batch_count++;
+    stats_.image_barrier_count += static_cast<uint32_t>(final_image_barriers_.size());
+    stats_.buffer_barrier_count += static_cast<uint32_t>(final_buffer_barriers_.size());
+}
+
+void RenderGraph::choose_attachment_operations()
+{
+    for (uint32_t position = 0; position < schedule_.size(); position++)
+    {
+        Pass &pass = passes_[schedule_[position]];
+
+        auto choose = [this, position](Attachment &attachment, bool is_written) {
+            const ImageResource &image = images_[attachment.image];
+
+            // Nothing has been rendered to a transient image before its first use, or to an imported image that
+            // starts out undefined
+            const bool contents_undefined = image.first_use == position &&
+                                            (!image.imported || image.initial_state.layout == VK_IMAGE_LAYOUT_UNDEFINED);
+            if (attachment.clear.has_value())
+                attachment.load_op = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            else if (contents_undefined)
+                attachment.load_op = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            else
+                attachment.load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+            // Transient contents nobody reads later do not have to be written back to memory
+            if (!is_written)
+                attachment.store_op = VK_ATTACHMENT_STORE_OP_NONE;
+            else if (!image.imported && image.last_use == position)
+                attachment.store_op = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            else
+                attachment.store_op = VK_ATTACHMENT_STORE_OP_STORE;
+        };
+
+        for (auto &attachment: pass.color_attachments)
+            choose(attachment, true);
+        if (pass.depth_attachment.has_value())
+            choose(pass.depth_attachment.value(), pass.depth_write);
+    }
+}
+
+void RenderGraph::release_compiled_resources()
+{
+    std::vector<VkImageView> views{};
+    std::vector<VkImage> images{};
+    std::vector<VkDeviceMemory> memory{};
+
+    for (auto &image: images_)
+    {
+        if (image.imported)
+            continue;
+        if (image.view != VK_NULL_HANDLE)
+            views.push_back(image.view);
+        if (image.image != VK_NULL_HANDLE)
+            images.push_back(image.image);
+        image.view = VK_NULL_HANDLE;
+        image.image = VK_NULL_HANDLE;
+    }
+    for (auto &block: memory_blocks_)
+    {
+        if (block.memory != VK_NULL_HANDLE)
+            memory.push_back(block.memory);
+    }
+    memory_blocks_.clear();
+    compiled_ = false;
+
+    if (views.empty() && images.empty() && memory.empty())
+        return;
+
+    // Earlier executions may still be in flight
+    device_->defer_destruction([device = device_->get_logical_device(), views = std::move(views),
+                                images = std::move(images), memory = std::move(memory)]() {
+        for (VkImageView view: views)
+            vkDestroyImageView(device, view, nullptr);
+        for (VkImage image: images)
+            vkDestroyImage(device, image, nullptr);
+        for (VkDeviceMemory allocation: memory)
+            vkFreeMemory(device, allocation, nullptr);
+    });
+}
+
+void RenderGraph::record_barriers(CommandBuffer &command_buffer, const std::vector<Barrier> &image_barriers,
+                                  const std::vector<Barrier> &buffer_barriers) const
+{
+    if (image_barriers.empty() && buffer_barriers.empty())
+        return;
+
+    std::vector<VkImageMemoryBarrier2> vk_image_barriers{};
+    vk_image_barriers.reserve(image_barriers.size());
+    for (const auto &barrier: image_barriers)
+    {
+        const ImageResource &image = images_[barrier.resource];
+        assert(image.image != VK_NULL_HANDLE);
+
+        VkImageMemoryBarrier2 vk_barrier{};
+        vk_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        vk_barrier.srcStageMask = barrier.src_stage;
+        vk_barrier.srcAccessMask = barrier.src_access;
+        vk_barrier.dstStageMask = barrier.dst_stage;
+        vk_barrier.dstAccessMask = barrier.dst_access;
+        vk_barrier.oldLayout = barrier.old_layout;
+        vk_barrier.newLayout = barrier.new_layout;
+        vk_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.image = image.image;
+        vk_barrier.subresourceRange.aspectMask = get_aspect_flags(image.description.format);
+        vk_barrier.subresourceRange.baseMipLevel = 0;
+        vk_barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        vk_barrier.subresourceRange.baseArrayLayer = 0;
+        vk_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        vk_image_barriers.push_back(vk_barrier);
+    }
+
+    std::vector<VkBufferMemoryBarrier2> vk_buffer_barriers{};
+    vk_buffer_barriers.reserve(buffer_barriers.size());
+    for (const auto &barrier: buffer_barriers)
+    {
+        const BufferResource &buffer = buffers_[barrier.resource];
+        assert(buffer.buffer != VK_NULL_HANDLE);
+
+        VkBufferMemoryBarrier2 vk_barrier{};
+        vk_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        vk_barrier.srcStageMask = barrier.src_stage;
+        vk_barrier.srcAccessMask = barrier.src_access;
+        vk_barrier.dstStageMask = barrier.dst_stage;
+        vk_barrier.dstAccessMask = barrier.dst_access;
+        vk_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        vk_barrier.buffer = buffer.buffer;
+        vk_barrier.offset = 0;
+        vk_barrier.size = VK_WHOLE_SIZE;
+        vk_buffer_barriers.push_back(vk_barrier);
+    }
+
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(vk_image_barriers.size());
+    dependency_info.pImageMemoryBarriers = vk_image_barriers.data();
+    dependency_info.bufferMemoryBarrierCount = static_cast<uint32_t>(vk_buffer_barriers.size());
+    dependency_info.pBufferMemoryBarriers = vk_buffer_barriers.data();
+
+    vkCmdPipelineBarrier2(command_buffer.get_handle(), &dependency_info);
+}
+
+void RenderGraph::begin_rendering(CommandBuffer &command_buffer, const Pass &pass) const
+{
+    auto to_attachment_info = [this](const Attachment &attachment, VkImageLayout layout) {
+        const ImageResource &image = images_[attachment.image];
+        assert(image.view != VK_NULL_HANDLE);
+
+        VkRenderingAttachmentInfo info{};
+        info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+        info.imageView = image.view;
+        info.imageLayout = layout;
+        info.loadOp = attachment.load_op;
+        info.storeOp = attachment.store_op;
+        if (attachment.clear.has_value())
+            info.clearValue = attachment.clear.value();
+        return info;
+    };
+
+    std::vector<VkRenderingAttachmentInfo> color_infos{};
+    color_infos.reserve(pass.color_attachments.size());
+    for (const auto &attachment: pass.color_attachments)
+        color_infos.push_back(to_attachment_info(attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+
+    VkRenderingAttachmentInfo depth_info{};
+    if (pass.depth_attachment.has_value())
+    {
+        depth_info = to_attachment_info(pass.depth_attachment.value(),
+                                        pass.depth_write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+                                                         : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+    }
+
+    // Attachments of a pass share their size
+    uint32_t first_attachment = pass.color_attachments.empty() ? pass.depth_attachment->image
+                                                               : pass.color_attachments.front().image;
+    VkExtent2D extent = images_[first_attachment].description.extent;
+
+    VkRenderingInfo rendering_info{};
+    rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+    rendering_info.renderArea = {{0, 0}, extent};
+    rendering_info.layerCount = 1;
+    rendering_info.colorAttachmentCount = static_cast<uint32_t>(color_infos.size());
+    rendering_info.pColorAttachments = color_infos.data();
+    rendering_info.pDepthAttachment = pass.depth_attachment.has_value() ? &depth_info : nullptr;
+
+    vkCmdBeginRendering(command_buffer.get_handle(), &rendering_info);
+
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(extent.width);
+    viewport.height = static_cast<float>(extent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = extent;
+
+    vkCmdSetViewport(command_buffer.get_handle(), 0, 1, &viewport);
+    vkCmdSetScissor(command_buffer.get_handle(), 0, 1, &scissor);
+}
+
+void RenderGraph::add_access(std::vector<ResourceAccess> &accesses, uint32_t resource, Access access, bool reads,
+                             bool writes)
+{
+    auto existing = std::ranges::find_if(accesses, [resource](const ResourceAccess &other) {
+        return other.resource == resource;
+    });
+    if (existing == accesses.end())
+    {
+        accesses.push_back({resource, access, reads, writes});
+        return;
+    }
+
+    // A resource is in a single layout during a pass, so it can only be used one way
+    assert(existing->access == access);
+    existing->reads |= reads;
+    existing->writes |= writes;
+}
+
+bool RenderGraph::is_write_access(Access access)
+{
+    switch (access)
+    {
+        case Access::COLOR_ATTACHMENT:
+        case Access::DEPTH_ATTACHMENT:
+        case Access::STORAGE_WRITE:
+        case Access::TRANSFER_DST:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RenderGraph::AccessInfo RenderGraph::get_access_info(Access access, PassType type)
+{
+    const VkPipelineStageFlags2 shader_stages = type == PassType::COMPUTE
+                                                        ? VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+                                                        : VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                                                                  VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    const VkPipelineStageFlags2 fragment_tests =
+            VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+    switch (access)
+    {
+        case Access::COLOR_ATTACHMENT:
+            return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true};
+        case Access::DEPTH_ATTACHMENT:
+            return {fragment_tests,
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, true};
+        case Access::DEPTH_READ_ONLY:
+            return {fragment_tests, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, false};
+        case Access::SAMPLED:
+            return {shader_stages, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false};
+        case Access::STORAGE_READ:
+            return {shader_stages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL, false};
+        case Access::STORAGE_WRITE:
+            return {shader_stages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL, true};
+        case Access::TRANSFER_SRC:
+            return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false};
+        case Access::TRANSFER_DST:
+            return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, true};
+        case Access::UNIFORM_BUFFER:
+            return {shader_stages, VK_ACCESS_2_UNIFORM_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+        case Access::VERTEX_BUFFER:
+            return {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, false};
+        case Access::INDEX_BUFFER:
+            return {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED, false};
+        case Access::INDIRECT_BUFFER:
+            return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED, false};
+    }
+
+    assert(false);
+    return {};
+}
+
+VkImageUsageFlags RenderGraph::get_image_usage(Access access)
+{
+    switch (access)
+    {
+        case Access::COLOR_ATTACHMENT:
+            return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        case Access::DEPTH_ATTACHMENT:
+        case Access::DEPTH_READ_ONLY:
+            return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        case Access::SAMPLED:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        case Access::STORAGE_READ:
+        case Access::STORAGE_WRITE:
+            return VK_IMAGE_USAGE_STORAGE_BIT;
+        case Access::TRANSFER_SRC:
+            return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        case Access::TRANSFER_DST:
+            return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        default:
+            return 0;
+    }
+}
+
+VkImageAspectFlags RenderGraph::get_aspect_flags(VkFormat format)
+{
+    switch (format)
+    {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_X8_D24_UNORM_PACK32:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D16_UNORM_S8_UINT:
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        case VK_FORMAT_S8_UINT:
+            return VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+void RenderGraph::synchronize(TrackedState &state, uint32_t resource, const AccessInfo &info, bool is_image,
+                              std::vector<Barrier> &barriers)
+{
+    const bool layout_change = is_image && state.layout != info.layout;
+
+    // Writes and layout transitions wait for everything before them
+    if (info.is_write || layout_change)
+    {
+        VkPipelineStageFlags2 src_stage = state.write_stage | state.read_stages;
+        if (layout_change || src_stage != VK_PIPELINE_STAGE_2_NONE)
+        {
+            barriers.push_back({
+                    .resource = resource,
+                    .src_stage = src_stage,
+                    .src_access = state.write_access,
+                    .dst_stage = info.stage,
+                    .dst_access = info.access,
+                    .old_layout = state.layout,
+                    .new_layout = is_image ? info.layout : VK_IMAGE_LAYOUT_UNDEFINED,
+            });
+        }
+
+        if (is_image)
+            state.layout = info.layout;
+        state.write_stage = info.stage;
+        state.write_access = info.is_write ? info.access : VK_ACCESS_2_NONE;
+        state.read_stages = info.is_write ? VK_PIPELINE_STAGE_2_NONE : info.stage;
+        state.visible_stages = info.is_write ? VK_PIPELINE_STAGE_2_NONE : info.stage;
+        state.visible_access = info.is_write ? VK_ACCESS_2_NONE : info.access;
+        return;
+    }
+
+    // Reads only wait for the last write, once per stage and access. Reads after reads need nothing.
+    const bool already_visible = (info.stage & ~state.visible_stages) == 0 && (info.access & ~state.visible_access) == 0;
+    if (state.write_stage != VK_PIPELINE_STAGE_2_NONE && !already_visible)
+    {
+        barriers.push_back({
+                .resource = resource,
+                .src_stage = state.write_stage,
+                .src_access = state.write_access,
+                .dst_stage = info.stage,
+                .dst_access = info.access,
+                .old_layout = state.layout,
+                .new_layout = state.layout,
+        });
+        state.visible_stages |= info.stage;
+        state.visible_access |= info.access;
+    }
+    state.read_stages |= info.stage;
+}
+
+}// namespace flwfrg::vk
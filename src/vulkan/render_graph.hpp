@@ -0,0 +1,319 @@
+#pragma once
+
+#include "util/constants.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace flwfrg::vk
+{
+class CommandBuffer;
+class Device;
+
+/// Declares a frame as passes that read and write images and buffers, instead of recording barriers by hand.
+/// Compiling culls passes whose results are never used, places the transient images in shared memory where their
+/// lifetimes do not overlap and works out the barriers between passes, one vkCmdPipelineBarrier2 batch per pass at
+/// most. Compiling allocates the transient images, so a graph is declared once and only recompiled when it changes
+/// (e.g. on resize), while execute records it every frame.
+///
+/// Graphics passes with attachments are recorded inside dynamic rendering, so their pipelines are created with
+/// PipelineConfig::p_color_formats instead of a render pass.
+class RenderGraph
+{
+public:
+    enum class PassType
+    {
+        GRAPHICS,
+        COMPUTE,
+        TRANSFER
+    };
+
+    // How a pass uses a resource, which determines the stages, access and image layout the graph synchronizes on
+    enum class Access
+    {
+        // Images
+        COLOR_ATTACHMENT,
+        DEPTH_ATTACHMENT,
+        DEPTH_READ_ONLY,
+        SAMPLED,
+        // Images and buffers
+        STORAGE_READ,
+        STORAGE_WRITE,
+        TRANSFER_SRC,
+        TRANSFER_DST,
+        // Buffers
+        UNIFORM_BUFFER,
+        VERTEX_BUFFER,
+        INDEX_BUFFER,
+        INDIRECT_BUFFER
+    };
+
+    struct ImageHandle
+    {
+        uint32_t id = constant::invalid_id;
+        [[nodiscard]] inline bool is_valid() const { return id != constant::invalid_id; };
+    };
+    struct BufferHandle
+    {
+        uint32_t id = constant::invalid_id;
+        [[nodiscard]] inline bool is_valid() const { return id != constant::invalid_id; };
+    };
+
+    struct ImageDescription
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent{};
+    };
+
+    // State an imported resource is in when the graph starts, or has to be left in once it is done. The layout
+    // is ignored for buffers.
+    struct ResourceState
+    {
+        VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    struct CompileStats
+    {
+        uint32_t pass_count = 0;
+        uint32_t culled_pass_count = 0;
+        uint32_t barrier_batch_count = 0;
+        uint32_t image_barrier_count = 0;
+        uint32_t buffer_barrier_count = 0;
+        uint32_t transient_image_count = 0;
+        // Memory backing the transient images, and what it would have taken without aliasing
+        VkDeviceSize transient_memory_size = 0;
+        VkDeviceSize unaliased_memory_size = 0;
+    };
+
+    using ExecuteFunction = std::function<void(CommandBuffer &command_buffer)>;
+
+    class PassBuilder
+    {
+    public:
+        PassBuilder &read(ImageHandle image, Access access);
+        PassBuilder &write(ImageHandle image, Access access);
+        PassBuilder &read(BufferHandle buffer, Access access);
+        PassBuilder &write(BufferHandle buffer, Access access);
+
+        // Attachments of a graphics pass. Without a clear value the previous contents are loaded, which makes the
+        // attachment a read as well. A depth attachment that is not written is bound read-only.
+        PassBuilder &color_attachment(ImageHandle image, std::optional<VkClearColorValue> clear = std::nullopt);
+        PassBuilder &depth_attachment(ImageHandle image, std::optional<float> clear = std::nullopt, bool write = true);
+
+        // Never culled, for passes with effects the graph can not see
+        PassBuilder &side_effect();
+
+    private:
+        PassBuilder(RenderGraph *graph, uint32_t pass_index) : graph_{graph}, pass_index_{pass_index} {};
+
+        RenderGraph *graph_;
+        uint32_t pass_index_;
+
+        friend RenderGraph;
+    };
+
+public:
+    explicit RenderGraph(Device *device);
+    ~RenderGraph();
+
+    // Not copyable or movable, pass builders point back to the graph
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph &operator=(const RenderGraph &) = delete;
+    RenderGraph(RenderGraph &&) = delete;
+    RenderGraph &operator=(RenderGraph &&) = delete;
+
+    // Declaration
+
+    /// Image owned by the graph. Its contents do not survive the frame, and its memory may be shared with other
+    /// transient images that are not used at the same time.
+    ImageHandle create_image(std::string name, ImageDescription description);
+    /// Image owned by someone else, e.g. the swapchain image. Imported resources are the graph's outputs, passes
+    /// writing them are never culled.
+    ImageHandle import_image(std::string name, ImageDescription description, ResourceState initial_state,
+                             ResourceState final_state);
+    BufferHandle import_buffer(std::string name, ResourceState initial_state, ResourceState final_state);
+
+    /// Passes are recorded in the order they are added.
+    PassBuilder add_pass(std::string name, PassType type, ExecuteFunction execute);
+
+    /// Drops every pass and resource so the graph can be declared again. Compiled resources are released once the
+    /// GPU is done with them.
+    void reset();
+
+    void compile();
+    [[nodiscard]] inline bool is_compiled() const { return compiled_; };
+    [[nodiscard]] inline const CompileStats &get_compile_stats() const { return stats_; };
+
+    // Execution
+
+    // Imported resources can change between executions, e.g. the acquired swapchain image
+    void set_imported_image(ImageHandle image, VkImage handle, VkImageView view);
+    void set_imported_buffer(BufferHandle buffer, VkBuffer handle);
+
+    void execute(CommandBuffer &command_buffer);
+
+    // Valid once compiled, so passes can bind what earlier passes rendered
+    [[nodiscard]] VkImage get_image(ImageHandle image) const;
+    [[nodiscard]] VkImageView get_image_view(ImageHandle image) const;
+    [[nodiscard]] const ImageDescription &get_image_description(ImageHandle image) const;
+    [[nodiscard]] bool is_pass_culled(std::string_view name) const;
+
+private:
+    struct AccessInfo
+    {
+        VkPipelineStageFlags2 stage;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool is_write;
+    };
+
+    // Reading and writing the same resource in one pass is a single access, e.g. a loaded color attachment
+    struct ResourceAccess
+    {
+        uint32_t resource;
+        Access access;
+        bool reads;
+        bool writes;
+    };
+
+    struct Barrier
+    {
+        uint32_t resource;
+        VkPipelineStageFlags2 src_stage;
+        VkAccessFlags2 src_access;
+        VkPipelineStageFlags2 dst_stage;
+        VkAccessFlags2 dst_access;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+    };
+
+    struct Attachment
+    {
+        uint32_t image;
+        std::optional<VkClearValue> clear;
+        // Decided when compiling
+        VkAttachmentLoadOp load_op = VK_ATTACHMENT_LOAD_OP_LOAD;
+        VkAttachmentStoreOp store_op = VK_ATTACHMENT_STORE_OP_STORE;
+    };
+
+    struct Pass
+    {
+        std::string name;
+        PassType type;
+        ExecuteFunction execute;
+
+        std::vector<ResourceAccess> image_accesses{};
+        std::vector<ResourceAccess> buffer_accesses{};
+        std::vector<Attachment> color_attachments{};
+        std::optional<Attachment> depth_attachment{};
+        bool depth_write = false;
+        bool side_effect = false;
+
+        // Compiled
+        bool culled = false;
+        std::vector<Barrier> image_barriers{};
+        std::vector<Barrier> buffer_barriers{};
+    };
+
+    struct ImageResource
+    {
+        std::string name;
+        ImageDescription description;
+        bool imported;
+        ResourceState initial_state{};
+        ResourceState final_state{};
+
+        VkImage image = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+
+        // Compiled
+        VkImageUsageFlags usage = 0;
+        // Positions in the schedule of the first and last pass using the image
+        uint32_t first_use = constant::invalid_id;
+        uint32_t last_use = constant::invalid_id;
+        // What the last pass using it did, which the next image placed in the same memory has to wait for
+        VkPipelineStageFlags2 last_stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 last_access = VK_ACCESS_2_NONE;
+        VkMemoryRequirements memory_requirements{};
+        uint32_t memory_block = constant::invalid_id;
+    };
+
+    struct BufferResource
+    {
+        std::string name;
+        ResourceState initial_state{};
+        ResourceState final_state{};
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+    };
+
+    // Memory shared by transient images with disjoint lifetimes, kept in order of first use
+    struct MemoryBlock
+    {
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        uint32_t memory_type_bits = ~0u;
+        std::vector<uint32_t> images{};
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+    };
+
+    // Synchronization state of a resource while the schedule is walked
+    struct TrackedState
+    {
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // Last write, or layout transition
+        VkPipelineStageFlags2 write_stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+        // Reads since then, which a following write has to wait for
+        VkPipelineStageFlags2 read_stages = VK_PIPELINE_STAGE_2_NONE;
+        // What the last write has already been made visible to
+        VkPipelineStageFlags2 visible_stages = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 visible_access = VK_ACCESS_2_NONE;
+    };
+
+    Device *device_;
+
+    std::vector<Pass> passes_{};
+    std::vector<ImageResource> images_{};
+    std::vector<BufferResource> buffers_{};
+
+    // Indices of the passes that survived culling, in recording order
+    std::vector<uint32_t> schedule_{};
+    std::vector<Barrier> final_image_barriers_{};
+    std::vector<Barrier> final_buffer_barriers_{};
+    std::vector<MemoryBlock> memory_blocks_{};
+
+    bool compiled_ = false;
+    CompileStats stats_{};
+
+    // Compile steps
+    void cull_passes();
+    void compute_lifetimes();
+    void allocate_transient_images();
+    void compute_barriers();
+    void choose_attachment_operations();
+
+    void release_compiled_resources();
+    void record_barriers(CommandBuffer &command_buffer, const std::vector<Barrier> &image_barriers,
+                         const std::vector<Barrier> &buffer_barriers) const;
+    void begin_rendering(CommandBuffer &command_buffer, const Pass &pass) const;
+
+    static void add_access(std::vector<ResourceAccess> &accesses, uint32_t resource, Access access, bool reads,
+                           bool writes);
+    [[nodiscard]] static bool is_write_access(Access access);
+    [[nodiscard]] static AccessInfo get_access_info(Access access, PassType type);
+    [[nodiscard]] static VkImageUsageFlags get_image_usage(Access access);
+    [[nodiscard]] static VkImageAspectFlags get_aspect_flags(VkFormat format);
+    // Emits a barrier into barriers if the access has to wait for what happened to the resource so far
+    static void synchronize(TrackedState &state, uint32_t resource, const AccessInfo &info, bool is_image,
+                            std::vector<Barrier> &barriers);
+};
+
+}// namespace flwfrg::vk
@@ -9,12 +9,14 @@ namespace flwfrg::vk
 {
 
 
-RenderPass::RenderPass(Device *device, glm::vec4 draw_area, VkFormat color_format, VkFormat depth_format, glm::vec4 clear_color, float depth, uint32_t stencil)
+RenderPass::RenderPass(Device *device, glm::vec4 draw_area, VkFormat color_format, VkFormat depth_format, glm::vec4 clear_color, float depth, uint32_t stencil,
+					   RenderPassConfig config)
 	: device_{device},
 	  draw_area_{draw_area},
 	  clear_color_{clear_color},
 	  depth{depth},
 	  stencil{stencil},
+	  depth_prepass_{config.depth_prepass},
 	  state_{State::NOT_ALLOCATED}
 {
 	assert(device_ != nullptr);
@@ -78,25 +80,72 @@ RenderPass::RenderPass(Device *device, glm::vec4 draw_area, VkFormat color_forma
 	main_subpass.preserveAttachmentCount = 0;
 	main_subpass.pPreserveAttachments = nullptr;
 
+	std::vector<VkSubpassDescription> subpasses{};
+
+	// Depth prepass subpass, only writes depth
+	VkSubpassDescription prepass_subpass{};
+	prepass_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	prepass_subpass.colorAttachmentCount = 0;
+	prepass_subpass.pDepthStencilAttachment = &depth_attachment_ref;
+	if (depth_prepass_)
+		subpasses.push_back(prepass_subpass);
+
+	// The main subpass keeps depth writable, so pipelines that are not part of the prepass still depth test as usual
+	subpasses.push_back(main_subpass);
+	const uint32_t color_subpass = get_color_subpass();
+
 	// Render pass dependencies
+	std::vector<VkSubpassDependency> subpass_dependencies{};
+
 	VkSubpassDependency subpass_dependency{};
 	subpass_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	subpass_dependency.dstSubpass = 0;
+	subpass_dependency.dstSubpass = color_subpass;
 	subpass_dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	subpass_dependency.srcAccessMask = 0;
 	subpass_dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	subpass_dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	subpass_dependency.dependencyFlags = 0;
+	subpass_dependencies.push_back(subpass_dependency);
+
+	if (depth_prepass_)
+	{
+		constexpr VkPipelineStageFlags fragment_tests =
+				VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		constexpr VkAccessFlags depth_access =
+				VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		// The previous frame's depth tests are done before the prepass clears depth
+		VkSubpassDependency external_dependency{};
+		external_dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+		external_dependency.dstSubpass = depth_prepass_subpass;
+		external_dependency.srcStageMask = fragment_tests;
+		external_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		external_dependency.dstStageMask = fragment_tests;
+		external_dependency.dstAccessMask = depth_access;
+		external_dependency.dependencyFlags = 0;
+		subpass_dependencies.push_back(external_dependency);
+
+		// The color subpass tests against the depth the prepass wrote, pixel by pixel
+		VkSubpassDependency prepass_dependency{};
+		prepass_dependency.srcSubpass = depth_prepass_subpass;
+		prepass_dependency.dstSubpass = color_subpass;
+		prepass_dependency.srcStageMask = fragment_tests;
+		prepass_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		prepass_dependency.dstStageMask = fragment_tests;
+		prepass_dependency.dstAccessMask = depth_access;
+		prepass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		subpass_dependencies.push_back(prepass_dependency);
+	}
 
 	// Create info
 	VkRenderPassCreateInfo render_pass_info{};
 	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	render_pass_info.attachmentCount = static_cast<uint32_t>(attachment_descriptions.size());
 	render_pass_info.pAttachments = attachment_descriptions.data();
-	render_pass_info.subpassCount = 1;
-	render_pass_info.pSubpasses = &main_subpass;
-	render_pass_info.dependencyCount = 1;
-	render_pass_info.pDependencies = &subpass_dependency;
+	render_pass_info.subpassCount = static_cast<uint32_t>(subpasses.size());
+	render_pass_info.pSubpasses = subpasses.data();
+	render_pass_info.dependencyCount = static_cast<uint32_t>(subpass_dependencies.size());
+	render_pass_info.pDependencies = subpass_dependencies.data();
 	render_pass_info.pNext = nullptr;
 	render_pass_info.flags = 0;
 
@@ -124,7 +173,7 @@ void RenderPass::set_render_area(glm::vec4 draw_area)
 	draw_area_ = draw_area;
 }
 
-void RenderPass::begin(CommandBuffer &command_buffer, VkFramebuffer frame_buffer)
+void RenderPass::begin(CommandBuffer &command_buffer, VkFramebuffer frame_buffer, VkSubpassContents contents)
 {
 	// if (state_ != State::READY)
 	// {
@@ -145,10 +194,23 @@ void RenderPass::begin(CommandBuffer &command_buffer, VkFramebuffer frame_buffer
 	render_pass_begin_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
 	render_pass_begin_info.pClearValues = clear_values.data();
 
-	vkCmdBeginRenderPass(command_buffer.handle_, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(command_buffer.handle_, &render_pass_begin_info, contents);
 	command_buffer.state_ = CommandBuffer::State::IN_RENDER_PASS;
 
 	state_ = State::IN_RENDER_PASS;
+	current_subpass_ = 0;
+}
+
+void RenderPass::next_subpass(CommandBuffer &command_buffer, VkSubpassContents contents)
+{
+	if (state_ != State::IN_RENDER_PASS)
+	{
+		throw std::runtime_error("Render pass not in progress");
+	}
+	assert(current_subpass_ < get_color_subpass());
+
+	vkCmdNextSubpass(command_buffer.handle_, contents);
+	current_subpass_++;
 }
 
 void RenderPass::end(CommandBuffer &command_buffer)
@@ -158,6 +220,13 @@ void RenderPass::end(CommandBuffer &command_buffer)
 		throw std::runtime_error("Render pass not in progress");
 	}
 
+	// Every subpass has to be passed through, even if nothing was drawn in the prepass
+	while (current_subpass_ < get_color_subpass())
+	{
+		vkCmdNextSubpass(command_buffer.handle_, VK_SUBPASS_CONTENTS_INLINE);
+		current_subpass_++;
+	}
+
 	vkCmdEndRenderPass(command_buffer.handle_);
 
 	command_buffer.state_ = CommandBuffer::State::RECORDING;
@@ -14,6 +14,12 @@ namespace flwfrg::vk
 class Device;
 class CommandBuffer;
 
+struct RenderPassConfig
+{
+	// Adds a depth-only subpass ahead of the color subpass. With the geometry's depth laid down first, the color
+	// subpass can test with VK_COMPARE_OP_EQUAL and shade each pixel once, however many triangles overlap it.
+	bool depth_prepass = false;
+};
 
 class RenderPass
 {
@@ -29,7 +35,8 @@ public:
 	};
 
 public:
-	RenderPass(Device *device, glm::vec4 draw_area, VkFormat color_format, VkFormat depth_format, glm::vec4 clear_color, float depth, uint32_t stencil);
+	RenderPass(Device *device, glm::vec4 draw_area, VkFormat color_format, VkFormat depth_format, glm::vec4 clear_color, float depth, uint32_t stencil,
+			   RenderPassConfig config = {});
 	~RenderPass();
 
 	// Not copyable or movable
@@ -44,9 +51,18 @@ public:
 
 	void set_render_area(glm::vec4 draw_area);
 
-	void begin(CommandBuffer &command_buffer, VkFramebuffer frame_buffer);
+	[[nodiscard]] constexpr bool has_depth_prepass() const { return depth_prepass_; };
+	// Pipelines and secondary command buffers have to name the subpass they are used in
+	[[nodiscard]] constexpr uint32_t get_color_subpass() const { return depth_prepass_ ? 1 : 0; };
+	[[nodiscard]] constexpr uint32_t get_current_subpass() const { return current_subpass_; };
+
+	// Begins in the depth prepass subpass if there is one, otherwise in the color subpass
+	void begin(CommandBuffer &command_buffer, VkFramebuffer frame_buffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	void next_subpass(CommandBuffer &command_buffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
 	void end(CommandBuffer &command_buffer);
 
+	static constexpr uint32_t depth_prepass_subpass = 0;
+
 private:
 	Device *device_;
 
@@ -57,6 +73,9 @@ private:
 	float depth;
 	uint32_t stencil;
 
+	bool depth_prepass_;
+	uint32_t current_subpass_ = 0;
+
 	State state_;
 };
 
@@ -9,93 +9,173 @@ namespace flwfrg::vk
 {
 
 
-Renderer::Renderer(uint32_t initial_width, uint32_t initial_height, std::string window_name, PhysicalDeviceRequirements requirements) :
+Renderer::Renderer(uint32_t initial_width, uint32_t initial_height, std::string window_name, PhysicalDeviceRequirements requirements,
+                   PresentConfig present_config, RenderPassConfig render_pass_config, ValidationConfig validation_config) :
     window_name_{std::move(window_name)}, window_{initial_width, initial_height, window_name_},
-    display_context_{&window_, requirements, true}
+    display_context_{&window_, requirements, validation_config, present_config, render_pass_config}
 {}
 
-StatusOptional<CommandBuffer *, Renderer::RendererStatus, Renderer::RendererStatus::SUCCESS> Renderer::begin_frame()
+Renderer::Renderer(GraphicsContext &graphics_context, uint32_t initial_width, uint32_t initial_height, std::string window_name,
+                   PresentConfig present_config, RenderPassConfig render_pass_config) :
+    window_name_{std::move(window_name)}, window_{initial_width, initial_height, window_name_},
+    display_context_{&graphics_context, &window_, present_config, render_pass_config}
+{}
+
+StatusOptional<CommandBuffer *, Renderer::RendererStatus, Renderer::RendererStatus::SUCCESS> Renderer::begin_frame(VkSubpassContents contents)
+{
+    auto command_buffer = begin_frame_commands();
+    if (!command_buffer.has_value())
+        return command_buffer;
+
+    display_context_.main_render_pass_.set_render_area(
+            {0, 0, display_context_.get_swapchain().get_frame_buffer_size()});
+    // display_context_.main_render_pass_.set_render_area({0, 0, window_.get_width(), window_.get_height()});
+
+    // Begin the render pass.
+    display_context_.main_render_pass_.begin(*command_buffer.value(), display_context_.get_frame_buffer_handle(), contents);
+    main_render_pass_begun_ = true;
+
+    return command_buffer;
+}
+
+void Renderer::next_subpass(VkSubpassContents contents)
+{
+    assert(main_render_pass_begun_);
+
+    display_context_.main_render_pass_.next_subpass(
+            display_context_.graphics_command_buffers_[display_context_.current_frame_], contents);
+}
+
+StatusOptional<CommandBuffer *, Renderer::RendererStatus, Renderer::RendererStatus::SUCCESS> Renderer::begin_frame_commands()
 {
+    // Do all the waiting before input is sampled, so the input is as fresh as possible once the frame is displayed.
+    // Wait for the last submission of the frame slot we wish to write to. This also releases whatever the
+    // device deferred up to it.
+    Device &device = display_context_.device_;
+    if (!device.wait_for(display_context_.get_current_frame_timeline_value()))
+    {
+        FLOWFORGE_WARN_RATE_LIMITED("Failure to wait for frame in flight");
+        return RendererStatus::FAILED_TO_WAIT_ON_FENCE;
+    }
+    frame_pacer_.wait_before_input();
+    // Pick up any other submissions that finished in the meantime
+    device.poll_completed_value();
+    // The GPU is done with this frame, so its transient descriptor sets can be recycled.
+    display_context_.frame_descriptor_allocators_[display_context_.current_frame_].reset();
+
     glfwPollEvents();
+    frame_pacer_.mark_input_sampled();
     if (window_.should_close())
         return RendererStatus::WINDOW_SHOULD_CLOSE;
 
-    // Wait for the fence of the frame we wish to write to.
-    if (!display_context_.get_current_frame_fence_in_flight().wait(std::numeric_limits<uint64_t>::max()))
+    // A minimized window has nothing to present to
+    if (window_.get_width() == 0 || window_.get_height() == 0)
+        return RendererStatus::SWAPCHAIN_RESIZE;
+
+    // Resize before acquiring, so the frame is rendered at the new size. This does not wait for the GPU, frames
+    // in flight finish on the old swapchain.
+    Swapchain &swapchain = display_context_.swapchain_;
+    if (window_.was_window_resized() || swapchain.needs_recreation())
     {
-        FLOWFORGE_WARN("Failure to wait for fence in flight");
-        return RendererStatus::FAILED_TO_WAIT_ON_FENCE;
+        window_.reset_window_resized_flag();
+        display_context_.recreate_swapchain();
     }
+
     // Get the next image index
-    auto result = display_context_.swapchain_.acquire_next_image(
-            std::numeric_limits<uint64_t>::max(),
-            display_context_.image_avaliable_semaphores_[display_context_.current_frame_], VK_NULL_HANDLE,
-            &display_context_.image_index_);
+    auto acquire_image = [&]() {
+        return swapchain.acquire_next_image(
+                std::numeric_limits<uint64_t>::max(),
+                display_context_.image_avaliable_semaphores_[display_context_.current_frame_], VK_NULL_HANDLE,
+                &display_context_.image_index_);
+    };
+    auto result = acquire_image();
+    if (result == Status::OUT_OF_DATE_KHR)
+    {
+        // Went out of date since the check above. Try once more on a new swapchain instead of dropping the frame.
+        display_context_.recreate_swapchain();
+        result = acquire_image();
+    }
     if (result != Status::SUCCESS)
     {
         if (result == Status::OUT_OF_DATE_KHR)
             return RendererStatus::SWAPCHAIN_RESIZE;
         else
         {
-            FLOWFORGE_ERROR("Failed to acquire next image");
+            FLOWFORGE_ERROR_RATE_LIMITED("Failed to acquire next image");
             return RendererStatus::UNKNOWN_ERROR;
         }
     }
 
     CommandBuffer &command_buffer = display_context_.graphics_command_buffers_[display_context_.current_frame_];
 
-    command_buffer.reset();
-    command_buffer.begin(false, false, false);
+    // Recycle everything recorded for this frame last time around in one call
+    display_context_.frame_command_pools_[display_context_.current_frame_].reset();
+    command_buffer.mark_pool_reset();
+    command_buffer.begin(true, false, false);
+    device.begin_recording();
 
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
-    viewport.width = static_cast<float>(window_.get_width());
-    viewport.height = static_cast<float>(window_.get_height());
+    viewport.width = static_cast<float>(swapchain.get_extent().width);
+    viewport.height = static_cast<float>(swapchain.get_extent().height);
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
     VkRect2D scissor{};
     scissor.offset = {0, 0};
-    scissor.extent = {window_.get_width(), window_.get_height()};
+    scissor.extent = swapchain.get_extent();
 
     vkCmdSetViewport(command_buffer.get_handle(), 0, 1, &viewport);
     vkCmdSetScissor(command_buffer.get_handle(), 0, 1, &scissor);
 
-    display_context_.main_render_pass_.set_render_area(
-            {0, 0, display_context_.get_swapchain().get_frame_buffer_size()});
-    // display_context_.main_render_pass_.set_render_area({0, 0, window_.get_width(), window_.get_height()});
+    return &command_buffer;
+}
 
-    // Begin the render pass.
-    display_context_.main_render_pass_.begin(command_buffer, display_context_.get_frame_buffer_handle());
+RenderGraph::ImageHandle Renderer::import_swapchain_image(RenderGraph &graph)
+{
+    const Swapchain &swapchain = display_context_.swapchain_;
+
+    // The submission waits for the acquire at the color attachment output stage, so the first access has to
+    // wait for that stage too
+    return graph.import_image(
+            "swapchain",
+            {swapchain.get_image_format(), swapchain.get_extent()},
+            {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED},
+            {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+}
 
-    return &command_buffer;
+void Renderer::execute_graph(RenderGraph &graph, RenderGraph::ImageHandle swapchain_image)
+{
+    assert(!main_render_pass_begun_);
+
+    const Swapchain &swapchain = display_context_.swapchain_;
+    graph.set_imported_image(swapchain_image, swapchain.get_image(display_context_.image_index_),
+                             swapchain.get_image_view(display_context_.image_index_));
+    graph.execute(display_context_.graphics_command_buffers_[display_context_.current_frame_]);
 }
 
 Renderer::RendererStatus Renderer::end_frame()
 {
-    CommandBuffer &command_buffer = display_context_.graphics_command_buffers_[display_context_.current_frame_];
+    RendererStatus status = submit_frame();
+    if (status != RendererStatus::SUCCESS)
+        return status;
 
-    display_context_.main_render_pass_.end(command_buffer);
-
-    command_buffer.end();
+    Renderer *renderer = this;
+    return present_frames({&renderer, 1});
+}
 
-    // Wait for the previous frame to not use the image
-    // if (auto *fence = display_context_.get_image_index_frame_fence_in_flight())
-    // {
-    // 	if (!fence->wait(std::numeric_limits<uint64_t>::max()))
-    // 	{
-    // 		FLOWFORGE_WARN("Failed to wait for image index fence in flight");
-    // 		return RendererStatus::FAILED_TO_WAIT_ON_FENCE;
-    // 	}
-    // }
+Renderer::RendererStatus Renderer::submit_frame()
+{
+    CommandBuffer &command_buffer = display_context_.graphics_command_buffers_[display_context_.current_frame_];
 
-    // Set the fence as image in flight
-    display_context_.images_in_flight_[display_context_.image_index_] =
-            &display_context_.get_current_frame_fence_in_flight();
+    if (main_render_pass_begun_)
+    {
+        display_context_.main_render_pass_.end(command_buffer);
+        main_render_pass_begun_ = false;
+    }
 
-    // Reset the fence
-    display_context_.get_current_frame_fence_in_flight().reset();
+    command_buffer.end();
 
     // Submit the queue
     VkPipelineStageFlags flags[1] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
@@ -103,27 +183,46 @@ Renderer::RendererStatus Renderer::end_frame()
     command_buffer.submit(display_context_.device_.get_graphics_queue(),
                           display_context_.image_avaliable_semaphores_[display_context_.current_frame_],
                           display_context_.queue_complete_semaphores_[display_context_.current_frame_],
-                          display_context_.get_current_frame_fence_in_flight().get_handle(), flags);
+                          VK_NULL_HANDLE, flags);
+    display_context_.frame_timeline_values_[display_context_.current_frame_] = command_buffer.get_submitted_value();
+    display_context_.device_.end_recording();
 
-    // Give the image back to the swapchain
-    auto result = display_context_.swapchain_.present(
-            display_context_.device_.get_graphics_queue(), display_context_.device_.get_present_queue(),
-            display_context_.queue_complete_semaphores_[display_context_.current_frame_],
-            display_context_.image_index_);
+    return RendererStatus::SUCCESS;
+}
 
-    if (result != Status::SUCCESS)
+Renderer::RendererStatus Renderer::present_frames(std::span<Renderer *const> renderers)
+{
+    if (renderers.empty())
+        return RendererStatus::SUCCESS;
+
+    std::vector<Swapchain::PresentRequest> requests;
+    std::vector<uint64_t> submitted_values;
+    for (Renderer *renderer: renderers)
     {
-        if (result == Status::OUT_OF_DATE_KHR || result == Status::SUBOPTIMAL_KHR)
-        {
-            return RendererStatus::SWAPCHAIN_RESIZE;
-        } else
+        DisplayContext &context = renderer->display_context_;
+        requests.push_back({&context.swapchain_, context.queue_complete_semaphores_[context.current_frame_],
+                            context.image_index_});
+        // Read before presenting, which moves every context on to its next frame
+        submitted_values.push_back(context.frame_timeline_values_[context.current_frame_]);
+    }
+
+    // Give the images back to their swapchains, all through the queue of the shared device
+    auto results = Swapchain::present(renderers.front()->display_context_.device_.get_present_queue(), requests);
+
+    RendererStatus status = RendererStatus::SUCCESS;
+    for (size_t i = 0; i < renderers.size(); i++)
+    {
+        if (results[i] != Status::SUCCESS)
         {
-            FLOWFORGE_ERROR("Failed to present swap chain image");
-            return RendererStatus::UNKNOWN_ERROR;
+            FLOWFORGE_ERROR_RATE_LIMITED("Failed to present swap chain image");
+            status = RendererStatus::UNKNOWN_ERROR;
+            continue;
         }
+
+        renderers[i]->frame_pacer_.mark_presented(submitted_values[i]);
     }
 
-    return RendererStatus::SUCCESS;
+    return status;
 }
 
 } // namespace flwfrg::vk
@@ -1,10 +1,14 @@
 #pragma once
 
 #include "display_context.hpp"
+#include "frame_pacer.hpp"
 #include "glfw_context.hpp"
+#include "render_graph.hpp"
 #include "util/status_optional.hpp"
 #include "window.hpp"
 
+#include <span>
+
 namespace flwfrg::vk
 {
 
@@ -21,7 +25,15 @@ public:
 	};
 
 public:
-	Renderer(uint32_t initial_width, uint32_t initial_height, std::string window_name, PhysicalDeviceRequirements requirements = {});
+	/// Validation follows the build type unless overridden with validation_config, or at runtime with the
+	/// FLOWFORGE_VALIDATION environment variable (see ValidationConfig::from_environment).
+	Renderer(uint32_t initial_width, uint32_t initial_height, std::string window_name, PhysicalDeviceRequirements requirements = {},
+			 PresentConfig present_config = {}, RenderPassConfig render_pass_config = {},
+			 ValidationConfig validation_config = ValidationConfig::from_environment());
+	/// Opens another window on an existing graphics context, e.g. get_graphics_context() of the first renderer,
+	/// which then has to outlive this one. Resources created on the shared device can be used in every window.
+	Renderer(GraphicsContext &graphics_context, uint32_t initial_width, uint32_t initial_height, std::string window_name,
+			 PresentConfig present_config = {}, RenderPassConfig render_pass_config = {});
 	~Renderer() = default;
 
 	// Copy
@@ -36,10 +48,33 @@ public:
 	[[nodiscard]] inline uint64_t get_frame() const { return display_context_.get_current_frame(); };
 	[[nodiscard]] inline bool should_close() const { return window_.should_close(); };
 	[[nodiscard]] inline DisplayContext &get_display_context() { return display_context_; };
+	[[nodiscard]] inline GraphicsContext &get_graphics_context() { return display_context_.get_graphics_context(); };
 	[[nodiscard]] inline Window &get_window() { return window_; };
 
-	StatusOptional<CommandBuffer *, RendererStatus, RendererStatus::SUCCESS> begin_frame();
+	// Presentation policy. Changing it recreates the swapchain and drains the GPU, so it is not meant for every frame.
+	[[nodiscard]] inline const PresentConfig &get_present_config() const { return display_context_.swapchain_.get_present_config(); };
+	inline void set_present_config(PresentConfig config) { display_context_.set_present_config(config); };
+	// Measured from the input sampled in begin_frame to the frame being presented
+	[[nodiscard]] inline const LatencyStats &get_latency_stats() const { return frame_pacer_.get_latency_stats(); };
+	inline void reset_latency_stats() { frame_pacer_.reset_latency_stats(); };
+
+	// Pass VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS to record the main pass with a ParallelRecorder
+	StatusOptional<CommandBuffer *, RendererStatus, RendererStatus::SUCCESS> begin_frame(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	// With RenderPassConfig::depth_prepass the frame begins in the depth prepass, this moves on to the color subpass
+	void next_subpass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+	// Same as begin_frame, but leaves the main render pass out so the frame can be recorded by a render graph
+	StatusOptional<CommandBuffer *, RendererStatus, RendererStatus::SUCCESS> begin_frame_commands();
+	/// Imports the swapchain image into graph, handed back ready for presentation. Its extent is the swapchain's
+	/// at the time of the call, so graphs using it are declared again after a resize.
+	RenderGraph::ImageHandle import_swapchain_image(RenderGraph &graph);
+	/// Records graph into the frame started with begin_frame_commands, rendering to the acquired swapchain image.
+	void execute_graph(RenderGraph &graph, RenderGraph::ImageHandle swapchain_image);
+	// Submits and presents the frame. Same as submit_frame followed by present_frames with only this renderer.
 	RendererStatus end_frame();
+	// Submits the frame without presenting it, so several windows can be presented together with present_frames
+	RendererStatus submit_frame();
+	/// Presents the submitted frames of renderers sharing a graphics context in a single vkQueuePresentKHR.
+	static RendererStatus present_frames(std::span<Renderer *const> renderers);
 
 private:
 	std::string window_name_;
@@ -47,6 +82,9 @@ private:
 	GLFWContext glfw_context_{};
 	Window window_;
 	DisplayContext display_context_;
+	FramePacer frame_pacer_{&display_context_};
+
+	bool main_render_pass_begun_ = false;
 };
 
 }// namespace flwfrg::vk
\ No newline at end of file
@@ -0,0 +1,323 @@
+#include "pch.hpp"
+
+#include "asset_streamer.hpp"
+
+#include "import/file_contents.hpp"
+#include "io/file_reader.hpp"
+#include "vulkan/device.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+
+namespace flwfrg::vk
+{
+
+namespace
+{
+
+// Sorts every asset out of view after every asset in view
+constexpr double out_of_view_distance = 1e30;
+
+inline bool is_set(const std::vector<uint64_t> &bits, size_t index)
+{
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+} // namespace
+
+AssetStreamer::AssetStreamer(Device *device, ColorModelManager *model_manager, Config config)
+    : device_{device}, model_manager_{model_manager}, config_{config}, io_threads_{config.io_thread_count}
+{
+    assert(device_ != nullptr);
+    assert(config_.max_loads_in_flight > 0);
+
+    auto placeholder = StaticTexture::generate_default_texture(device_);
+    if (!placeholder.has_value())
+    {
+        throw std::runtime_error("Failed to create the placeholder texture for streaming");
+    }
+    placeholder_ = std::move(placeholder.value());
+}
+
+AssetStreamer::asset_id_t AssetStreamer::request_texture(std::filesystem::path path, const BoundingSphere &bounds)
+{
+    asset_id_t id = add_asset(Asset{.type = AssetType::TEXTURE, .path = std::move(path)}, bounds);
+    assets_[id].texture = std::make_unique<StreamedTexture>(device_, static_cast<uint32_t>(id), &placeholder_);
+    return id;
+}
+
+AssetStreamer::asset_id_t AssetStreamer::request_mesh(std::filesystem::path path, uint32_t mesh_index,
+                                                      const BoundingSphere &bounds)
+{
+    assert(model_manager_ != nullptr);
+
+    asset_id_t id =
+            add_asset(Asset{.type = AssetType::MESH, .path = std::move(path), .mesh_index = mesh_index}, bounds);
+    assets_[id].mesh = model_manager_->reserve_mesh();
+    return id;
+}
+
+AssetStreamer::asset_id_t AssetStreamer::add_asset(Asset asset, const BoundingSphere &bounds)
+{
+    asset.last_used_frame = frame_;
+    assets_.emplace_back(std::move(asset));
+    spheres_.emplace_back(bounds.center, bounds.radius);
+    return static_cast<asset_id_t>(assets_.size() - 1);
+}
+
+void AssetStreamer::set_bounds(asset_id_t asset, const BoundingSphere &bounds)
+{
+    assert(asset >= 0 && asset < static_cast<asset_id_t>(assets_.size()));
+    spheres_[asset] = glm::vec4{bounds.center, bounds.radius};
+}
+
+void AssetStreamer::mark_used(asset_id_t asset)
+{
+    assert(asset >= 0 && asset < static_cast<asset_id_t>(assets_.size()));
+    Asset &record = assets_[asset];
+    record.last_used_frame = frame_;
+    if (record.state == State::EVICTED)
+        record.state = State::QUEUED;
+}
+
+void AssetStreamer::update(const Camera &camera)
+{
+    // Everything in view counts as used this frame
+    camera.frustum().cull_spheres(spheres_, visible_);
+    for (size_t asset = 0; asset < assets_.size(); asset++)
+    {
+        if (is_set(visible_, asset))
+            mark_used(static_cast<asset_id_t>(asset));
+    }
+
+    finish_loads();
+    evict_over_budget();
+    start_loads(glm::vec3{camera.get_inverseView()[3]});
+
+    frame_++;
+}
+
+const Texture *AssetStreamer::get_texture(asset_id_t asset) const
+{
+    assert(asset >= 0 && asset < static_cast<asset_id_t>(assets_.size()));
+    assert(assets_[asset].type == AssetType::TEXTURE);
+    return assets_[asset].texture.get();
+}
+
+ColorModelManager::mesh_id_t AssetStreamer::get_mesh(asset_id_t asset) const
+{
+    assert(asset >= 0 && asset < static_cast<asset_id_t>(assets_.size()));
+    assert(assets_[asset].type == AssetType::MESH);
+    return assets_[asset].mesh;
+}
+
+bool AssetStreamer::is_resident(asset_id_t asset) const
+{
+    assert(asset >= 0 && asset < static_cast<asset_id_t>(assets_.size()));
+    return assets_[asset].state == State::RESIDENT;
+}
+
+void AssetStreamer::finish_loads()
+{
+    if (loads_in_flight_ == 0)
+        return;
+
+    uint64_t uploaded_size = 0;
+    bool uploaded = false;
+    for (size_t id = 0; id < assets_.size(); id++)
+    {
+        Asset &asset = assets_[id];
+        if (asset.state != State::LOADING ||
+            asset.load.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+        // The rest wait for the next update, but at least one load goes through however large it is
+        if (uploaded && uploaded_size >= config_.max_upload_size_per_update)
+            break;
+
+        loads_in_flight_--;
+        try
+        {
+            upload(asset, static_cast<asset_id_t>(id), asset.load.get());
+        }
+        catch (const std::exception &exception)
+        {
+            FLOWFORGE_WARN("Failed to stream {}, {}", asset.path.string(), exception.what());
+            asset.state = State::FAILED;
+            continue;
+        }
+
+        uploaded = true;
+        uploaded_size += asset.resident_size;
+    }
+
+    if (uploaded && model_manager_ != nullptr)
+        model_manager_->flush_uploads();
+}
+
+void AssetStreamer::upload(Asset &asset, asset_id_t id, LoadedData data)
+{
+    if (asset.type == AssetType::TEXTURE)
+    {
+        StaticTexture::DecodedImage &image = data.image.value();
+        auto texture = StaticTexture::create_texture(device_, static_cast<uint32_t>(id), image.width, image.height, 4,
+                                                     image.has_transparency, std::move(image.data));
+        if (!texture.has_value())
+        {
+            throw std::runtime_error("Failed to create texture");
+        }
+
+        asset.resident_size = static_cast<uint64_t>(image.width) * image.height * 4;
+        asset.texture->set_resident(std::move(texture.value()));
+    }
+    else
+    {
+        // Copied out of the mapping into the staging ring here, after which the file is unmapped
+        auto packed_mesh = data.mesh_file->get_packed_mesh(asset.mesh_index);
+        model_manager_->load_packed_mesh(asset.mesh, packed_mesh);
+        asset.resident_size = packed_mesh.vertex_data.size() + packed_mesh.index_data.size();
+    }
+
+    asset.state = State::RESIDENT;
+    resident_size_ += asset.resident_size;
+}
+
+void AssetStreamer::evict_over_budget()
+{
+    if (resident_size_ <= config_.memory_budget)
+        return;
+
+    // Least recently used first, never anything used this frame
+    candidates_.clear();
+    for (size_t id = 0; id < assets_.size(); id++)
+    {
+        const Asset &asset = assets_[id];
+        if (asset.state == State::RESIDENT && asset.last_used_frame < frame_)
+            candidates_.emplace_back(static_cast<double>(asset.last_used_frame), static_cast<asset_id_t>(id));
+    }
+    std::sort(candidates_.begin(), candidates_.end());
+
+    for (const auto &[last_used_frame, id]: candidates_)
+    {
+        if (resident_size_ <= config_.memory_budget)
+            break;
+        evict(assets_[id]);
+    }
+}
+
+void AssetStreamer::evict(Asset &asset)
+{
+    // The data is destroyed or reused once the frames drawing it are done
+    if (asset.type == AssetType::TEXTURE)
+        asset.texture->set_resident(std::nullopt);
+    else
+        model_manager_->unload_mesh(asset.mesh);
+
+    resident_size_ -= asset.resident_size;
+    asset.resident_size = 0;
+    asset.state = State::EVICTED;
+}
+
+void AssetStreamer::start_loads(const glm::vec3 &camera_position)
+{
+    // Nothing more fits until something can be evicted
+    if (loads_in_flight_ >= config_.max_loads_in_flight || resident_size_ >= config_.memory_budget)
+        return;
+
+    // Closest to the camera first, with everything in view before everything out of it
+    candidates_.clear();
+    for (size_t id = 0; id < assets_.size(); id++)
+    {
+        if (assets_[id].state != State::QUEUED)
+            continue;
+
+        const glm::vec4 &sphere = spheres_[id];
+        double distance = std::max(glm::length(glm::vec3{sphere} - camera_position) - sphere.w, 0.0f);
+        if (!is_set(visible_, id))
+            distance += out_of_view_distance;
+        candidates_.emplace_back(distance, static_cast<asset_id_t>(id));
+    }
+
+    size_t load_count = std::min<size_t>(config_.max_loads_in_flight - loads_in_flight_, candidates_.size());
+    std::partial_sort(candidates_.begin(), candidates_.begin() + static_cast<std::ptrdiff_t>(load_count),
+                      candidates_.end());
+
+    // The texture files started together are read in one batch, and decoded each on its own afterwards
+    std::vector<std::filesystem::path> texture_paths{};
+    std::vector<std::shared_ptr<std::promise<LoadedData>>> texture_loads{};
+    for (size_t candidate = 0; candidate < load_count; candidate++)
+    {
+        Asset &asset = assets_[candidates_[candidate].second];
+        asset.state = State::LOADING;
+        loads_in_flight_++;
+
+        if (asset.type == AssetType::TEXTURE)
+        {
+            texture_paths.push_back(asset.path);
+            texture_loads.push_back(std::make_shared<std::promise<LoadedData>>());
+            asset.load = texture_loads.back()->get_future();
+        }
+        else
+        {
+            asset.load = io_threads_.submit([path = asset.path, mesh_index = asset.mesh_index]() {
+                return load_mesh(path, mesh_index);
+            });
+        }
+    }
+
+    if (!texture_paths.empty())
+    {
+        io_threads_.enqueue([this, paths = std::move(texture_paths), loads = std::move(texture_loads)]() {
+            load_textures(paths, loads);
+        });
+    }
+}
+
+void AssetStreamer::load_textures(const std::vector<std::filesystem::path> &paths,
+                                  const std::vector<std::shared_ptr<std::promise<LoadedData>>> &loads)
+{
+    std::vector<io::ReadResult> files = io::read_files(paths);
+    for (size_t texture = 0; texture < files.size(); texture++)
+    {
+        if (!files[texture].succeeded())
+        {
+            loads[texture]->set_exception(std::make_exception_ptr(std::runtime_error(files[texture].error)));
+            continue;
+        }
+
+        auto file = std::make_shared<FileContents>(std::move(files[texture].contents));
+        io_threads_.enqueue([file, load = loads[texture]]() {
+            auto image = StaticTexture::decode_image(file->get_bytes());
+            if (!image.has_value())
+            {
+                load->set_exception(std::make_exception_ptr(std::runtime_error("Failed to decode image")));
+                return;
+            }
+            load->set_value(LoadedData{.image = std::move(image.value())});
+        });
+    }
+}
+
+AssetStreamer::LoadedData AssetStreamer::load_mesh(const std::filesystem::path &path, uint32_t mesh_index)
+{
+    LoadedData data{};
+    data.mesh_file.emplace(path);
+    if (mesh_index >= data.mesh_file->get_meshes().size())
+    {
+        throw std::runtime_error("Failed to find mesh " + std::to_string(mesh_index) + " in cooked mesh file");
+    }
+
+    // Reads every page of the mesh in here, so copying it out on the render thread does not wait on the disk
+    auto packed_mesh = data.mesh_file->get_packed_mesh(mesh_index);
+    for (auto blob: {packed_mesh.vertex_data, packed_mesh.index_data})
+    {
+        for (size_t offset = 0; offset < blob.size(); offset += cooked_mesh_blob_alignment)
+        {
+            static_cast<void>(*static_cast<const volatile std::byte *>(&blob[offset]));
+        }
+    }
+    return data;
+}
+
+}// namespace flwfrg::vk
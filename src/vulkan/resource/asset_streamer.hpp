@@ -0,0 +1,167 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include "import/cooked_mesh.hpp"
+#include "math/bounds.hpp"
+#include "math/camera.hpp"
+#include "threading/thread_pool.hpp"
+#include "vulkan/resource/model_manager.hpp"
+#include "vulkan/resource/static_texture.hpp"
+#include "vulkan/resource/streamed_texture.hpp"
+
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace flwfrg::vk
+{
+class Device;
+
+/// Loads textures and cooked meshes in the background, and keeps the ones in use resident within a memory budget.
+///
+/// Files are read and decoded on I/O threads of the streamer's own, the texture files started in one update with a
+/// single batch of reads. Every update, the queued assets are sorted by how close their bounds are to the camera,
+/// those in view first, and the closest ones are handed to the I/O threads.
+/// Finished loads are uploaded on the calling thread. Once the resident assets take more than the budget, the ones
+/// least recently in view are evicted, and loaded again when they come back into view.
+///
+/// Until an asset is resident its texture shows a placeholder, and its mesh has no data so its instances are not
+/// drawn. Texture and mesh ids stay the same throughout, so they can be used right after the request.
+class AssetStreamer
+{
+public:
+    typedef int32_t asset_id_t;
+
+    struct Config
+    {
+        uint32_t io_thread_count = 2;
+        // Device memory the streamed textures and meshes may take together. Assets in view are never evicted, and
+        // loads already in flight are uploaded regardless, so it can be exceeded until they leave the view.
+        uint64_t memory_budget = 512ull * 1024 * 1024;
+        // Loads given to the I/O threads at a time, the rest wait in priority order
+        uint32_t max_loads_in_flight = 8;
+        // Data uploaded per update at most, so a burst of finished loads is spread over several frames. At least one
+        // load is uploaded every update regardless of its size.
+        uint64_t max_upload_size_per_update = 32ull * 1024 * 1024;
+    };
+
+public:
+    /// @param model_manager Manager of the streamed meshes, may be nullptr when only textures are streamed
+    /// @throws std::runtime_error When the placeholder texture cannot be created
+    AssetStreamer(Device *device, ColorModelManager *model_manager, Config config);
+    AssetStreamer(Device *device, ColorModelManager *model_manager) : AssetStreamer(device, model_manager, Config{}) {}
+
+    // Not copyable or movable, the textures handed out point at the placeholder
+    AssetStreamer(const AssetStreamer &) = delete;
+    AssetStreamer &operator=(const AssetStreamer &) = delete;
+    AssetStreamer(AssetStreamer &&) = delete;
+    AssetStreamer &operator=(AssetStreamer &&) = delete;
+
+    // Methods
+
+    /// Queues an image file (PNG, JPEG, ...) for loading
+    /// @param bounds World space bounds of what the texture is drawn on, to prioritize it by
+    asset_id_t request_texture(std::filesystem::path path, const BoundingSphere &bounds);
+    /// Queues a mesh of a cooked mesh file (see cook_scene) for loading. Its mesh id is reserved right away.
+    /// @param bounds World space bounds of the mesh's instances, to prioritize it by
+    asset_id_t request_mesh(std::filesystem::path path, uint32_t mesh_index, const BoundingSphere &bounds);
+
+    /// For assets that move
+    void set_bounds(asset_id_t asset, const BoundingSphere &bounds);
+    /// Keeps the asset from being evicted this frame even when its bounds are not in view, or has it loaded again
+    /// if it was evicted
+    void mark_used(asset_id_t asset);
+
+    /// Uploads finished loads, evicts least recently used assets over the budget, and starts the next loads. Call
+    /// once per frame, before recording the frame's draws.
+    void update(const Camera &camera);
+
+    /// The texture to draw with, showing the placeholder until the data is resident
+    [[nodiscard]] const Texture *get_texture(asset_id_t asset) const;
+    /// The mesh to create instances of, drawn once it is resident
+    [[nodiscard]] ColorModelManager::mesh_id_t get_mesh(asset_id_t asset) const;
+    [[nodiscard]] bool is_resident(asset_id_t asset) const;
+    [[nodiscard]] inline uint64_t get_resident_size() const { return resident_size_; };
+
+private:
+    enum class AssetType
+    {
+        TEXTURE,
+        MESH
+    };
+
+    enum class State
+    {
+        QUEUED,
+        LOADING,
+        RESIDENT,
+        EVICTED,
+        FAILED
+    };
+
+    // What an I/O thread hands back, one of the two depending on the asset type
+    struct LoadedData
+    {
+        std::optional<StaticTexture::DecodedImage> image{};
+        std::optional<CookedMeshFile> mesh_file{};
+    };
+
+    struct Asset
+    {
+        AssetType type;
+        std::filesystem::path path;
+        // Into the cooked file, for meshes
+        uint32_t mesh_index = 0;
+        State state = State::QUEUED;
+        uint64_t last_used_frame = 0;
+        uint64_t resident_size = 0;
+        std::future<LoadedData> load{};
+
+        // Kept at a fixed address for the draws pointing at it, for textures
+        std::unique_ptr<StreamedTexture> texture{};
+        // For meshes
+        ColorModelManager::mesh_id_t mesh = -1;
+    };
+
+    Device *device_ = nullptr;
+    ColorModelManager *model_manager_ = nullptr;
+    Config config_{};
+
+    StaticTexture placeholder_{};
+
+    // Uses asset id as index
+    std::vector<Asset> assets_{};
+    // The bounds of every asset, center in xyz and radius in w, culled in one batch every update
+    std::vector<glm::vec4> spheres_{};
+    std::vector<uint64_t> visible_{};
+    uint64_t resident_size_ = 0;
+    uint32_t loads_in_flight_ = 0;
+    // Counts updates, assets marked used since the last one have this as their last_used_frame
+    uint64_t frame_ = 1;
+
+    // Scratch space for sorting assets by priority or age, smallest first
+    std::vector<std::pair<double, asset_id_t>> candidates_{};
+
+    // Last, so the I/O threads are joined before the assets they load for are destroyed
+    ThreadPool io_threads_;
+
+    asset_id_t add_asset(Asset asset, const BoundingSphere &bounds);
+    void finish_loads();
+    void upload(Asset &asset, asset_id_t id, LoadedData data);
+    void evict_over_budget();
+    void evict(Asset &asset);
+    void start_loads(const glm::vec3 &camera_position);
+
+    /// Reads texture files in one batch and queues their decodes, on an I/O thread
+    void load_textures(const std::vector<std::filesystem::path> &paths,
+                       const std::vector<std::shared_ptr<std::promise<LoadedData>>> &loads);
+    /// Maps a cooked mesh file and reads the mesh's pages in, on an I/O thread
+    static LoadedData load_mesh(const std::filesystem::path &path, uint32_t mesh_index);
+};
+
+}// namespace flwfrg::vk
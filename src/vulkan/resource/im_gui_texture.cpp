@@ -18,8 +18,7 @@ void ImGuiTexture::update_state()
 {
     if (current_texture_index_ != next_texture_index_)
     {
-        VkFence fence = updateFences_[next_texture_index_].get_handle();
-        if (vkGetFenceStatus(device_->get_logical_device(), fence) == VK_SUCCESS)
+        if (device_->is_complete(update_values_[next_texture_index_]))
         {
             current_texture_index_ = next_texture_index_;
         }
@@ -34,14 +33,13 @@ void ImGuiTexture::update_texture(std::span<uint8_t> data)
 {
     if (next_texture_index_ != current_texture_index_)
     {
-        updateFences_[next_texture_index_].wait(std::numeric_limits<uint64_t>::max());
+        device_->wait_for(update_values_[next_texture_index_]);
         current_texture_index_ = next_texture_index_;
     }
 
     next_texture_index_ = (current_texture_index_ + 1) % images_.size();
 
-    updateFences_[next_texture_index_].wait(std::numeric_limits<uint64_t>::max());
-    updateFences_[next_texture_index_].reset();
+    device_->wait_for(update_values_[next_texture_index_]);
 
     flush_data(data, next_texture_index_);
 }
@@ -95,9 +93,14 @@ void ImGuiTexture::free_descriptors()
 {
     if (descriptor_sets_[0] != VK_NULL_HANDLE)
     {
-        vkDeviceWaitIdle(device_->get_logical_device());
-        for (VkDescriptorSet descriptor : descriptor_sets_)
-            ImGui_ImplVulkan_RemoveTexture(descriptor);
+        // The sets may still be bound by frames in flight
+        for (auto &descriptor : descriptor_sets_)
+        {
+            device_->defer_destruction([descriptor_set = static_cast<VkDescriptorSet>(descriptor)]() {
+                ImGui_ImplVulkan_RemoveTexture(descriptor_set);
+            });
+            descriptor = make_handle<VkDescriptorSet>(VK_NULL_HANDLE);
+        }
     }
 }
 
@@ -116,6 +119,13 @@ Status ImGuiTexture::resize(uint32_t width, uint32_t height, uint8_t channel_cou
 
     free_descriptors();
 
+    // Previous uploads must have executed before their command buffers are re-recorded. This only waits on this
+    // texture's own submissions, not the whole device.
+    for (uint64_t value : update_values_)
+    {
+        device_->wait_for(value);
+    }
+
     // Create the images
     for (size_t i = 0; i < images_.size(); i++)
     {
@@ -126,13 +136,6 @@ Status ImGuiTexture::resize(uint32_t width, uint32_t height, uint8_t channel_cou
                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_IMAGE_ASPECT_COLOR_BIT, true);
     }
 
-    // Create the fences
-    for (size_t i = 0; i < updateFences_.size(); i++)
-    {
-        updateFences_[i].~Fence();
-        updateFences_[i] = Fence{device_, true};
-    }
-
     // Create staging buffer
     VkBufferUsageFlagBits usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
     VkMemoryPropertyFlags memory_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
@@ -140,7 +143,6 @@ Status ImGuiTexture::resize(uint32_t width, uint32_t height, uint8_t channel_cou
     {
         staging_buffers_[i].~Buffer();
         staging_buffers_[i] = Buffer{device_, image_size, usage, memory_flags, true};
-        updateFences_[i].reset();
         flush_data(data, i);
     }
 
@@ -150,7 +152,12 @@ Status ImGuiTexture::resize(uint32_t width, uint32_t height, uint8_t channel_cou
         if (sampler.status() != Status::SUCCESS)
             return sampler.status();
 
-        vkDestroySampler(device_->get_logical_device(), sampler_, nullptr);
+        if (sampler_.not_null())
+        {
+            device_->defer_destruction([device = device_->get_logical_device(), old_sampler = static_cast<VkSampler>(sampler_)]() {
+                vkDestroySampler(device, old_sampler, nullptr);
+            });
+        }
         sampler_ = std::move(sampler.value());
     }
 
@@ -189,8 +196,8 @@ void ImGuiTexture::flush_data(std::span<uint8_t> data, size_t image_index)
                                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
     command_buffers_[image_index].end();
-    command_buffers_[image_index].submit(queue, VK_NULL_HANDLE, VK_NULL_HANDLE,
-                                         updateFences_[image_index].get_handle());
+    command_buffers_[image_index].submit(queue, VK_NULL_HANDLE, VK_NULL_HANDLE, VK_NULL_HANDLE);
+    update_values_[image_index] = command_buffers_[image_index].get_submitted_value();
 
     generation_++;
 }
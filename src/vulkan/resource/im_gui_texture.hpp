@@ -3,7 +3,6 @@
 #include "texture.hpp"
 #include "vulkan/command_buffer.hpp"
 #include "vulkan/buffer.hpp"
-#include "vulkan/fence.hpp"
 
 #include <span>
 
@@ -40,7 +39,8 @@ public:
 private:
     std::array<CommandBuffer, 2> command_buffers_;
 
-    std::array<Fence, 2> updateFences_;
+    // Device timeline value of each image's last upload
+    std::array<uint64_t, 2> update_values_{};
     std::array<Buffer, 2> staging_buffers_;
     std::array<Image, 2> images_;
     std::array<Handle<VkDescriptorSet>, 2> descriptor_sets_{};
@@ -2,10 +2,32 @@
 
 #include "model_manager.hpp"
 
+#include "threading/thread_pool.hpp"
 #include "vulkan/device.hpp"
+#include "vulkan/resource/staging_ring.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 namespace flwfrg::vk
 {
+
+namespace
+{
+
+std::vector<glm::vec3> get_positions(const std::vector<ColorVertex> &vertices)
+{
+    std::vector<glm::vec3> positions(vertices.size());
+    for (size_t vertex = 0; vertex < vertices.size(); vertex++)
+    {
+        positions[vertex] = vertices[vertex].position;
+    }
+    return positions;
+}
+
+} // namespace
+
 ColorModelManager::ColorModelManager(Device *device) : device_(device) {}
 
 void ColorModelManager::reserve_vertex_buffer_space(uint64_t space_to_reserve)
@@ -60,45 +82,635 @@ ColorModelManager::object_id_t ColorModelManager::register_model(std::vector<Col
 }
 
 ColorModelManager::object_id_t ColorModelManager::register_model(std::vector<ColorVertex> vertices,
-                                                                 std::vector<uint32_t> indices)
+                                                                 std::vector<uint32_t> indices,
+                                                                 VertexFormat vertex_format, bool build_meshlets)
+{
+    mesh_id_t mesh = register_mesh(std::move(vertices), std::move(indices), vertex_format, build_meshlets);
+    object_meshes_.emplace_back(mesh);
+    object_transforms_.emplace_back(Transform{});
+    cached_mat4s_.emplace_back(object_transforms_.back().mat4() * mesh_data_list_[mesh].dequantization);
+
+    auto id = static_cast<object_id_t>(object_meshes_.size() - 1);
+    object_proxies_.emplace_back(object_bvh_.insert(mesh_data_list_[mesh].bounds, id));
+    return id;
+}
+
+// Currently a noop
+void ColorModelManager::unregister_model(object_id_t id) {}
+
+ColorModelManager::mesh_id_t ColorModelManager::register_mesh(std::vector<ColorVertex> vertices,
+                                                             std::vector<uint32_t> indices,
+                                                             VertexFormat vertex_format, bool build_meshlets)
+{
+    MeshletData meshlets{};
+    if (build_meshlets)
+        meshlets = flwfrg::build_meshlets(indices, get_positions(vertices));
+
+    mesh_id_t mesh = add_mesh();
+    upload_mesh(mesh, vertices, {LodLevel{.indices = std::move(indices)}}, vertex_format, VK_INDEX_TYPE_UINT32,
+                meshlets);
+    return mesh;
+}
+
+ColorModelManager::mesh_id_t ColorModelManager::register_packed_mesh(const PackedMesh &packed_mesh)
+{
+    mesh_id_t mesh = add_mesh();
+    upload_packed_mesh(mesh, packed_mesh);
+    return mesh;
+}
+
+ColorModelManager::mesh_id_t ColorModelManager::reserve_mesh()
+{
+    return add_mesh();
+}
+
+void ColorModelManager::load_packed_mesh(mesh_id_t mesh, const PackedMesh &packed_mesh)
+{
+    assert(mesh >= 0 && mesh < static_cast<mesh_id_t>(mesh_data_list_.size()));
+    unload_mesh(mesh);
+    upload_packed_mesh(mesh, packed_mesh);
+    // Drawable again, so the instance buffer is rebuilt with its instances back in
+    instance_generation_++;
+
+    // The dequantization of instances changes with the data
+    for (instance_id_t instance: mesh_instance_ids_[mesh])
+    {
+        set_instance_transform(instance, instances_[instance].transform);
+    }
+}
+
+void ColorModelManager::unload_mesh(mesh_id_t mesh)
 {
     assert(device_ != nullptr);
+    assert(mesh >= 0 && mesh < static_cast<mesh_id_t>(mesh_data_list_.size()));
+
+    MeshData &data = mesh_data_list_[mesh];
+    if (data.vertex_buffer_index < 0)
+        return;
+
+    const uint64_t timeline_value = device_->get_last_submitted_value();
+    release_range(free_vertex_ranges_, FreeRange{
+                                               .buffer_index = data.vertex_buffer_index,
+                                               .offset = data.vertex_offset,
+                                               .size = data.vertex_size,
+                                               .timeline_value = timeline_value,
+                                       });
+    release_range(free_index_ranges_, FreeRange{
+                                              .buffer_index = data.index_buffer_index,
+                                              .offset = data.index_offset,
+                                              .size = data.index_space,
+                                              .timeline_value = timeline_value,
+                                      });
 
-    uint64_t vertex_size = sizeof(ColorVertex) * vertices.size();
-    uint64_t index_size = sizeof(uint32_t) * indices.size();
-
-    reserve_vertex_buffer_space(vertex_size);
-    reserve_index_buffer_space(index_size);
-
-    uint64_t vertex_offset =
-            vertex_buffers_[current_vertex_buffer_index_].get_total_size() - remaining_vertex_buffer_space_;
-    uint64_t index_offset =
-            index_buffers_[current_index_buffer_index_].get_total_size() - remaining_index_buffer_space_;
-
-    vertex_buffers_[current_vertex_buffer_index_].upload_data(vertices.data(), vertex_offset, vertex_size,
-                                                              device_->get_graphics_command_pool(), nullptr,
-                                                              device_->get_graphics_queue());
-    index_buffers_[current_index_buffer_index_].upload_data(indices.data(), index_offset, index_size,
-                                                            device_->get_graphics_command_pool(), nullptr,
-                                                            device_->get_graphics_queue());
-
-    object_data_list_.emplace_back(ObjectData{
-            .vertex_buffer_index = static_cast<int32_t>(current_vertex_buffer_index_),
-            .index_buffer_index = static_cast<int32_t>(current_index_buffer_index_),
-            .vertex_offset = vertex_offset,
-            .index_offset = index_offset,
-            .index_count = static_cast<uint32_t>(vertices.size()),
+    // Meshlet buffers belong to a single mesh, so they are destroyed outright (once the GPU is done with them)
+    if (data.meshlet_buffer_index >= 0)
+        meshlet_buffers_[data.meshlet_buffer_index] = MeshletBuffers{};
+
+    // No indices keeps the instances from being drawn, as with meshes still being optimized. Skipping them moves the
+    // first instance of every later mesh, so the instance buffer has to be rebuilt.
+    data = MeshData{};
+    instance_generation_++;
+}
+
+ColorModelManager::mesh_id_t ColorModelManager::register_mesh_async(ThreadPool &thread_pool,
+                                                                   std::vector<ColorVertex> vertices,
+                                                                   std::vector<uint32_t> indices,
+                                                                   VertexFormat vertex_format,
+                                                                   MeshOptimizationConfig config,
+                                                                   LodConfig lod_config, bool build_meshlets)
+{
+    mesh_id_t mesh = add_mesh();
+    pending_meshes_.emplace_back(PendingMesh{
+            .mesh = mesh,
+            .vertex_format = vertex_format,
+            .result = thread_pool.submit(
+                    [vertices = std::move(vertices), indices = std::move(indices), config, lod_config,
+                     build_meshlets]() mutable {
+                        optimize_mesh(vertices, indices, config);
+
+                        auto positions = get_positions(vertices);
+                        auto lods = generate_lod_chain(indices, positions, lod_config);
+
+                        MeshletData meshlets{};
+                        if (build_meshlets)
+                            meshlets = flwfrg::build_meshlets(lods.front().indices, positions);
+
+                        return OptimizedMesh{std::move(vertices), std::move(lods), std::move(meshlets)};
+                    }),
     });
-    object_transforms_.emplace_back(Transform{});
-    cached_mat4s_.emplace_back(object_transforms_.back().mat4());
 
-    remaining_index_buffer_space_ -= index_size;
-    remaining_vertex_buffer_space_ -= vertex_size;
+    return mesh;
+}
+
+void ColorModelManager::finish_mesh_registrations(bool wait)
+{
+    auto still_pending = std::partition(pending_meshes_.begin(), pending_meshes_.end(), [wait](PendingMesh &pending) {
+        return !wait && pending.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    });
+
+    for (auto it = still_pending; it != pending_meshes_.end(); ++it)
+    {
+        OptimizedMesh optimized = it->result.get();
+
+        // Indices of meshes with few enough vertices fit in 16 bits, which halves the index buffer
+        VkIndexType index_type = optimized.vertices.size() <= std::numeric_limits<uint16_t>::max()
+                                         ? VK_INDEX_TYPE_UINT16
+                                         : VK_INDEX_TYPE_UINT32;
+        upload_mesh(it->mesh, optimized.vertices, optimized.lods, it->vertex_format, index_type, optimized.meshlets);
 
-    return static_cast<object_id_t>(object_data_list_.size() - 1);
+        // Instances created in the meantime did not know the dequantization yet
+        for (instance_id_t instance: mesh_instance_ids_[it->mesh])
+        {
+            set_instance_transform(instance, instances_[instance].transform);
+        }
+    }
+
+    pending_meshes_.erase(still_pending, pending_meshes_.end());
+    flush_uploads();
 }
 
-// Currently a noop
-void ColorModelManager::unregister_model(object_id_t id) {}
+void ColorModelManager::flush_uploads()
+{
+    if (staging_ring_ != nullptr && staging_ring_->has_pending_copies())
+        staging_ring_->flush();
+}
+
+ColorModelManager::mesh_id_t ColorModelManager::add_mesh()
+{
+    mesh_data_list_.emplace_back();
+    mesh_instance_data_.emplace_back();
+    mesh_instance_ids_.emplace_back();
+
+    return static_cast<mesh_id_t>(mesh_data_list_.size() - 1);
+}
+
+void ColorModelManager::upload_mesh(mesh_id_t mesh, const std::vector<ColorVertex> &vertices,
+                                    const std::vector<LodLevel> &lods, VertexFormat vertex_format,
+                                    VkIndexType index_type, const MeshletData &meshlets)
+{
+    assert(!lods.empty() && lods.size() <= max_lod_count);
+
+    auto quantization = QuantizationBounds::from_vertices(vertices);
+    auto bounds = AABB::from_vertices(vertices);
+    PackedMesh packed_mesh{
+            .vertex_data = std::as_bytes(std::span{vertices}),
+            .vertex_format = vertex_format,
+            .index_type = index_type,
+            .quantization = quantization,
+            .bounds = bounds,
+            .bounding_sphere = BoundingSphere::from_vertices(vertices, bounds),
+    };
+
+    std::vector<CompactColorVertex> compact_vertices{};
+    if (vertex_format == VertexFormat::COMPACT)
+    {
+        compact_vertices.reserve(vertices.size());
+        for (const auto &vertex: vertices)
+        {
+            compact_vertices.emplace_back(CompactColorVertex::from(vertex, quantization));
+        }
+        packed_mesh.vertex_data = std::as_bytes(std::span{compact_vertices});
+    }
+
+    // Every LOD goes into the same index range, one after the other
+    std::array<LodRange, max_lod_count> lod_ranges{};
+    std::vector<uint32_t> indices{};
+    for (size_t lod = 0; lod < lods.size(); lod++)
+    {
+        lod_ranges[lod] = LodRange{
+                .first_index = static_cast<uint32_t>(indices.size()),
+                .index_count = static_cast<uint32_t>(lods[lod].indices.size()),
+                .error = lods[lod].error,
+        };
+        indices.insert(indices.end(), lods[lod].indices.begin(), lods[lod].indices.end());
+    }
+    packed_mesh.lods = std::span{lod_ranges}.first(lods.size());
+    packed_mesh.index_data = std::as_bytes(std::span{indices});
+
+    std::vector<uint16_t> short_indices{};
+    if (index_type == VK_INDEX_TYPE_UINT16)
+    {
+        short_indices.assign(indices.begin(), indices.end());
+        packed_mesh.index_data = std::as_bytes(std::span{short_indices});
+    }
+
+    upload_packed_mesh(mesh, packed_mesh);
+
+    if (!meshlets.meshlets.empty())
+    {
+        mesh_data_list_[mesh].meshlet_buffer_index = static_cast<int32_t>(meshlet_buffers_.size());
+        meshlet_buffers_.emplace_back(upload_meshlets(meshlets));
+    }
+}
+
+void ColorModelManager::upload_packed_mesh(mesh_id_t mesh, const PackedMesh &packed_mesh)
+{
+    assert(device_ != nullptr);
+    assert(!packed_mesh.lods.empty() && packed_mesh.lods.size() <= max_lod_count);
+
+    MeshData data{};
+    data.lod_count = static_cast<uint32_t>(packed_mesh.lods.size());
+    std::copy(packed_mesh.lods.begin(), packed_mesh.lods.end(), data.lods.begin());
+
+    const uint64_t vertex_size = packed_mesh.vertex_data.size();
+    const uint64_t index_size = packed_mesh.index_data.size();
+    // Index buffer offsets have to be aligned to the index size, so every mesh takes a multiple of 4 bytes
+    uint64_t index_space = (index_size + 3) & ~static_cast<uint64_t>(3);
+
+    // Space of unloaded meshes first, the end of the current buffers otherwise
+    if (auto range = take_free_range(free_vertex_ranges_, vertex_size))
+    {
+        data.vertex_buffer_index = range->buffer_index;
+        data.vertex_offset = range->offset;
+    }
+    else
+    {
+        reserve_vertex_buffer_space(vertex_size);
+        data.vertex_buffer_index = static_cast<int32_t>(current_vertex_buffer_index_);
+        data.vertex_offset =
+                vertex_buffers_[current_vertex_buffer_index_].get_total_size() - remaining_vertex_buffer_space_;
+        remaining_vertex_buffer_space_ -= vertex_size;
+    }
+
+    if (auto range = take_free_range(free_index_ranges_, index_space))
+    {
+        data.index_buffer_index = range->buffer_index;
+        data.index_offset = range->offset;
+    }
+    else
+    {
+        reserve_index_buffer_space(index_space);
+        data.index_buffer_index = static_cast<int32_t>(current_index_buffer_index_);
+        data.index_offset =
+                index_buffers_[current_index_buffer_index_].get_total_size() - remaining_index_buffer_space_;
+        remaining_index_buffer_space_ -= index_space;
+    }
+
+    upload(vertex_buffers_[data.vertex_buffer_index], packed_mesh.vertex_data.data(), data.vertex_offset,
+           vertex_size);
+    upload(index_buffers_[data.index_buffer_index], packed_mesh.index_data.data(), data.index_offset, index_size);
+
+    const QuantizationBounds &quantization = packed_mesh.quantization;
+    data.vertex_size = vertex_size;
+    data.index_space = index_space;
+    data.index_count = data.lods[0].index_count;
+    data.index_type = packed_mesh.index_type;
+    data.vertex_format = packed_mesh.vertex_format;
+    if (packed_mesh.vertex_format == VertexFormat::COMPACT)
+    {
+        data.dequantization = quantization.dequantization_matrix();
+        data.lod_center = glm::vec3{0.5f};
+    }
+    else
+    {
+        data.lod_center = quantization.min + quantization.extent * 0.5f;
+    }
+    data.bounds = packed_mesh.bounds;
+    data.bounding_sphere = packed_mesh.bounding_sphere;
+    mesh_data_list_[mesh] = data;
+}
+
+std::optional<ColorModelManager::FreeRange> ColorModelManager::take_free_range(std::vector<FreeRange> &free_ranges,
+                                                                             uint64_t size)
+{
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); ++it)
+    {
+        if (it->size < size || !device_->is_complete(it->timeline_value))
+            continue;
+
+        FreeRange taken{.buffer_index = it->buffer_index, .offset = it->offset, .size = size};
+        it->offset += size;
+        it->size -= size;
+        if (it->size == 0)
+            free_ranges.erase(it);
+        return taken;
+    }
+    return std::nullopt;
+}
+
+void ColorModelManager::release_range(std::vector<FreeRange> &free_ranges, FreeRange range)
+{
+    if (range.size == 0)
+        return;
+
+    auto next = std::lower_bound(free_ranges.begin(), free_ranges.end(), range,
+                                 [](const FreeRange &a, const FreeRange &b) {
+                                     return a.buffer_index < b.buffer_index ||
+                                            (a.buffer_index == b.buffer_index && a.offset < b.offset);
+                                 });
+
+    // Neighbours merge into one range, reused once the GPU is done with both
+    if (next != free_ranges.begin())
+    {
+        auto previous = std::prev(next);
+        if (previous->buffer_index == range.buffer_index && previous->offset + previous->size == range.offset)
+        {
+            previous->size += range.size;
+            previous->timeline_value = std::max(previous->timeline_value, range.timeline_value);
+            if (next != free_ranges.end() && next->buffer_index == range.buffer_index &&
+                previous->offset + previous->size == next->offset)
+            {
+                previous->size += next->size;
+                previous->timeline_value = std::max(previous->timeline_value, next->timeline_value);
+                free_ranges.erase(next);
+            }
+            return;
+        }
+    }
+    if (next != free_ranges.end() && next->buffer_index == range.buffer_index &&
+        range.offset + range.size == next->offset)
+    {
+        next->offset = range.offset;
+        next->size += range.size;
+        next->timeline_value = std::max(next->timeline_value, range.timeline_value);
+        return;
+    }
+
+    free_ranges.insert(next, range);
+}
+
+ColorModelManager::MeshletBuffers ColorModelManager::upload_meshlets(const MeshletData &meshlets) const
+{
+    std::vector<GpuCluster> clusters(meshlets.meshlets.size());
+    for (size_t meshlet = 0; meshlet < clusters.size(); meshlet++)
+    {
+        const Meshlet &source = meshlets.meshlets[meshlet];
+        const MeshletBounds &bounds = meshlets.bounds[meshlet];
+        clusters[meshlet] = GpuCluster{
+                .sphere = glm::vec4{bounds.center, bounds.radius},
+                .cone_apex = glm::vec4{bounds.cone_apex, 0.0f},
+                .cone = glm::vec4{bounds.cone_axis, bounds.cone_cutoff},
+                .vertex_offset = source.vertex_offset,
+                .triangle_offset = source.triangle_offset,
+                .triangle_count = source.triangle_count,
+                .padding = 0,
+        };
+    }
+
+    auto create_storage_buffer = [this](const void *data, uint64_t size) {
+        Buffer buffer{device_, size,
+                      static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT),
+                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true};
+        upload(buffer, data, 0, size);
+        return buffer;
+    };
+
+    return MeshletBuffers{
+            .clusters = create_storage_buffer(clusters.data(), sizeof(GpuCluster) * clusters.size()),
+            .vertices = create_storage_buffer(meshlets.vertices.data(), sizeof(uint32_t) * meshlets.vertices.size()),
+            .triangles =
+                    create_storage_buffer(meshlets.triangles.data(), sizeof(uint32_t) * meshlets.triangles.size()),
+            .cluster_count = static_cast<uint32_t>(clusters.size()),
+    };
+}
+
+void ColorModelManager::upload(Buffer &buffer, const void *data, uint64_t offset, uint64_t size) const
+{
+    if (staging_ring_ != nullptr)
+    {
+        staging_ring_->upload(data, size, buffer, offset);
+        return;
+    }
+
+    buffer.upload_data(data, offset, size, device_->get_graphics_command_pool(), nullptr,
+                       device_->get_graphics_queue());
+}
+
+ColorModelManager::ClusterRenderInfo ColorModelManager::get_cluster_render_info(object_id_t id) const
+{
+    assert(has_meshlets(id));
+
+    const MeshData &data = mesh_data_list_[object_meshes_[id]];
+    const MeshletBuffers &meshlets = meshlet_buffers_[data.meshlet_buffer_index];
+    glm::vec3 scale = glm::abs(object_transforms_[id].scale);
+    float max_scale = std::max({scale.x, scale.y, scale.z});
+    float min_scale = std::min({scale.x, scale.y, scale.z});
+
+    return ClusterRenderInfo{
+            .cluster_buffer = meshlets.clusters.get_handle(),
+            .meshlet_vertex_buffer = meshlets.vertices.get_handle(),
+            .meshlet_triangle_buffer = meshlets.triangles.get_handle(),
+            .cluster_count = meshlets.cluster_count,
+            .index_count = data.lods[0].index_count,
+            .vertex_buffer = vertex_buffers_[data.vertex_buffer_index].get_handle(),
+            .vertex_offset = data.vertex_offset,
+            .vertex_format = data.vertex_format,
+            .transform = object_transforms_[id].mat4(),
+            .uniform_scale = max_scale - min_scale <= max_scale * 1e-3f,
+            .render_data = GeometryRenderData{.model = cached_mat4s_[id]},
+    };
+}
+
+void ColorModelManager::query_visible_models(const Camera &camera, std::vector<object_id_t> &visible_models) const
+{
+    object_bvh_.query(camera.frustum(), visible_models);
+}
+
+std::optional<ColorModelManager::object_id_t> ColorModelManager::pick_model(const Ray &ray) const
+{
+    auto hit = object_bvh_.raycast(ray);
+    if (!hit.has_value())
+        return std::nullopt;
+    return hit->user_data;
+}
+
+ColorModelManager::instance_id_t ColorModelManager::create_instance(mesh_id_t mesh, const Transform &transform)
+{
+    assert(mesh >= 0 && mesh < static_cast<mesh_id_t>(mesh_data_list_.size()));
+
+    instance_id_t id;
+    if (!free_instance_ids_.empty())
+    {
+        id = free_instance_ids_.back();
+        free_instance_ids_.pop_back();
+    }
+    else
+    {
+        id = static_cast<instance_id_t>(instances_.size());
+        instances_.emplace_back();
+    }
+
+    instances_[id] = InstanceRecord{
+            .mesh = mesh,
+            .slot = static_cast<uint32_t>(mesh_instance_data_[mesh].size()),
+            .transform = transform,
+    };
+    mesh_instance_data_[mesh].emplace_back(
+            InstanceData{.model = transform.mat4() * mesh_data_list_[mesh].dequantization});
+    mesh_instance_ids_[mesh].emplace_back(id);
+    instance_generation_++;
+
+    return id;
+}
+
+void ColorModelManager::destroy_instance(instance_id_t id)
+{
+    assert(id >= 0 && id < static_cast<instance_id_t>(instances_.size()) && instances_[id].mesh >= 0);
+    InstanceRecord &instance = instances_[id];
+
+    // Keep the mesh's instances packed by moving its last instance into the freed slot
+    auto &instance_data = mesh_instance_data_[instance.mesh];
+    auto &instance_ids = mesh_instance_ids_[instance.mesh];
+    instance_data[instance.slot] = instance_data.back();
+    instance_ids[instance.slot] = instance_ids.back();
+    instances_[instance_ids[instance.slot]].slot = instance.slot;
+    instance_data.pop_back();
+    instance_ids.pop_back();
+
+    instance.mesh = -1;
+    free_instance_ids_.push_back(id);
+    instance_generation_++;
+}
+
+uint32_t ColorModelManager::select_lod(const MeshData &data, const glm::mat4 &model, glm::vec3 scale,
+                                       const LodSelection &lod_selection)
+{
+    assert(lod_selection.camera != nullptr);
+
+    if (data.lod_count == 1)
+        return 0;
+
+    // w is the depth for perspective projections and 1 for orthographic ones, either way the size of a unit on
+    // screen is inversely proportional to it
+    const Camera &camera = *lod_selection.camera;
+    glm::vec4 clip_center = camera.get_projection() * camera.get_view() * model * glm::vec4(data.lod_center, 1.0f);
+    float depth = std::max(std::abs(clip_center.w), std::numeric_limits<float>::epsilon());
+    float pixels_per_unit = std::abs(camera.get_projection()[1][1]) * lod_selection.viewport_height * 0.5f / depth;
+
+    // The errors are in mesh units, which the transform scales
+    float max_scale = std::max({std::abs(scale.x), std::abs(scale.y), std::abs(scale.z)});
+    float pixels_per_error = pixels_per_unit * max_scale;
+
+    uint32_t lod = 0;
+    while (lod + 1 < data.lod_count && data.lods[lod + 1].error * pixels_per_error <= lod_selection.max_screen_error)
+    {
+        lod++;
+    }
+    return lod;
+}
+
+const std::vector<ColorModelManager::InstancedRenderInfo> &
+ColorModelManager::update_instances(uint32_t frame_index, const std::optional<LodSelection> &lod_selection)
+{
+    assert(device_ != nullptr);
+    assert(frame_index < constant::max_frames_in_flight);
+
+    uint32_t instance_count = 0;
+    for (const auto &instance_data: mesh_instance_data_)
+    {
+        instance_count += static_cast<uint32_t>(instance_data.size());
+    }
+
+    // Grow by doubling. The old buffer lives on until the frames drawing from it are done, and every frame writes
+    // its part of the new one before using it.
+    if (instance_count > instance_capacity_)
+    {
+        instance_capacity_ = std::max(instance_count, instance_capacity_ * 2);
+        instance_buffer_ = Buffer(device_, sizeof(InstanceData) * instance_capacity_ * constant::max_frames_in_flight,
+                                  VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  true);
+        frame_instance_generations_.fill(0);
+    }
+
+    uint64_t frame_offset = sizeof(InstanceData) * instance_capacity_ * frame_index;
+    // Instances are sorted by LOD, which changes with the camera, so selecting LODs uploads every frame
+    bool upload = instance_count > 0 &&
+                  (lod_selection.has_value() || frame_instance_generations_[frame_index] != instance_generation_);
+    InstanceData *mapped_instances = nullptr;
+    if (upload)
+    {
+        mapped_instances = static_cast<InstanceData *>(
+                instance_buffer_.lock_memory(frame_offset, sizeof(InstanceData) * instance_count, 0));
+    }
+
+    // Grouped by vertex format, so drawing them switches pipelines once per format
+    instanced_draws_.clear();
+    uint32_t first_instance = 0;
+    for (uint32_t format = 0; format < vertex_format_count; format++)
+    {
+        for (size_t mesh = 0; mesh < mesh_data_list_.size(); mesh++)
+        {
+            const auto &instance_data = mesh_instance_data_[mesh];
+            // Meshes still being optimized have no indices yet
+            const MeshData &data = mesh_data_list_[mesh];
+            if (instance_data.empty() || data.index_count == 0 ||
+                data.vertex_format != static_cast<VertexFormat>(format))
+            {
+                continue;
+            }
+
+            auto add_draw = [&](uint32_t lod, uint32_t lod_first_instance, uint32_t lod_instance_count) {
+                instanced_draws_.emplace_back(InstancedRenderInfo{
+                        .vertex_buffer = vertex_buffers_[data.vertex_buffer_index].get_handle(),
+                        .index_buffer = index_buffers_[data.index_buffer_index].get_handle(),
+                        .instance_buffer = instance_buffer_.get_handle(),
+                        .vertex_offset = data.vertex_offset,
+                        .index_offset = data.get_lod_index_offset(lod),
+                        .instance_offset = frame_offset,
+                        .index_count = data.lods[lod].index_count,
+                        .index_type = data.index_type,
+                        .first_instance = lod_first_instance,
+                        .instance_count = lod_instance_count,
+                        .vertex_format = data.vertex_format,
+                });
+            };
+
+            if (!lod_selection.has_value() || data.lod_count == 1)
+            {
+                if (upload)
+                {
+                    memcpy(mapped_instances + first_instance, instance_data.data(),
+                           sizeof(InstanceData) * instance_data.size());
+                }
+
+                add_draw(0, first_instance, static_cast<uint32_t>(instance_data.size()));
+                first_instance += static_cast<uint32_t>(instance_data.size());
+                continue;
+            }
+
+            // Counting sort of the instances by LOD, so each LOD is one draw
+            const auto &instance_ids = mesh_instance_ids_[mesh];
+            instance_lods_.resize(instance_data.size());
+            std::array<uint32_t, max_lod_count> lod_instance_counts{};
+            for (size_t slot = 0; slot < instance_data.size(); slot++)
+            {
+                instance_lods_[slot] = select_lod(data, instance_data[slot].model,
+                                                  instances_[instance_ids[slot]].transform.scale, *lod_selection);
+                lod_instance_counts[instance_lods_[slot]]++;
+            }
+
+            std::array<uint32_t, max_lod_count> lod_first_instances{};
+            for (uint32_t lod = 0; lod < data.lod_count; lod++)
+            {
+                lod_first_instances[lod] = first_instance;
+                first_instance += lod_instance_counts[lod];
+            }
+
+            std::array<uint32_t, max_lod_count> lod_cursors = lod_first_instances;
+            for (size_t slot = 0; slot < instance_data.size(); slot++)
+            {
+                mapped_instances[lod_cursors[instance_lods_[slot]]++] = instance_data[slot];
+            }
+
+            for (uint32_t lod = 0; lod < data.lod_count; lod++)
+            {
+                if (lod_instance_counts[lod] > 0)
+                    add_draw(lod, lod_first_instances[lod], lod_instance_counts[lod]);
+            }
+        }
+    }
+
+    if (upload)
+    {
+        instance_buffer_.unlock_memory();
+        // Sorted by LOD, the frame's part no longer matches the unsorted instance data
+        frame_instance_generations_[frame_index] = lod_selection.has_value() ? 0 : instance_generation_;
+    }
+
+    return instanced_draws_;
+}
 
 } // namespace flwfrg::vk
@@ -6,17 +6,36 @@
 #include <filesystem>
 #include <glm/glm.hpp>
 
+#include "math/bvh.hpp"
+#include "math/camera.hpp"
 #include "math/transform.hpp"
+#include "mesh/mesh_optimizer.hpp"
+#include "mesh/mesh_simplifier.hpp"
+#include "mesh/meshlet_builder.hpp"
 #include "vulkan/buffer.hpp"
 #include "vulkan/shader/vertex.hpp"
+#include "vulkan/util/constants.hpp"
+
+#include <array>
+#include <future>
+#include <optional>
+#include <span>
+
+namespace flwfrg
+{
+class ThreadPool;
+}
 
 namespace flwfrg::vk
 {
+class StagingRing;
 
 class ColorModelManager
 {
 public:
     typedef int32_t object_id_t;
+    typedef int32_t mesh_id_t;
+    typedef int32_t instance_id_t;
 
     struct GeometryRenderData
     {
@@ -30,9 +49,84 @@ public:
         uint64_t vertex_offset = 0;
         uint64_t index_offset = 0;
         uint32_t index_count = 0;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        VertexFormat vertex_format = VertexFormat::FULL;
+        // Includes the dequantization of compact meshes
         GeometryRenderData render_data{};
     };
 
+    // The meshlets of a model, culled by ClusterCullShader into a compacted index buffer. The three buffers are
+    // storage buffers laid out as cluster_cull.comp reads them.
+    struct ClusterRenderInfo
+    {
+        VkBuffer cluster_buffer;
+        VkBuffer meshlet_vertex_buffer;
+        VkBuffer meshlet_triangle_buffer;
+        uint32_t cluster_count = 0;
+        // Indices of the full detail mesh, the most a culled draw can have
+        uint32_t index_count = 0;
+        VkBuffer vertex_buffer;
+        uint64_t vertex_offset = 0;
+        VertexFormat vertex_format = VertexFormat::FULL;
+        // The transform the cluster bounds are culled with, which leaves out the dequantization of compact meshes
+        glm::mat4 transform{1.0f};
+        // Normal cones only survive transforms scaling every axis alike, the backface test is skipped otherwise
+        bool uniform_scale = true;
+        GeometryRenderData render_data{};
+    };
+
+    // Index range of a LOD, all LODs of a mesh being stored one after the other
+    struct LodRange
+    {
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+        float error = 0.0f;
+    };
+
+    // A mesh already laid out the way the vertex and index buffers take it, e.g. as read from a cooked mesh file,
+    // which is uploaded without converting or even looking at its vertices
+    struct PackedMesh
+    {
+        // ColorVertex or CompactColorVertex as vertex_format says
+        std::span<const std::byte> vertex_data;
+        // uint16_t or uint32_t as index_type says, with every LOD in it
+        std::span<const std::byte> index_data;
+        VertexFormat vertex_format = VertexFormat::FULL;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        std::span<const LodRange> lods;
+        // The bounds compact vertices were quantized into. Full vertices only take the LOD center from them.
+        QuantizationBounds quantization{};
+        AABB bounds{};
+        BoundingSphere bounding_sphere{};
+    };
+
+    // Picks the coarsest LOD whose error covers at most max_screen_error pixels on screen
+    struct LodSelection
+    {
+        const Camera *camera = nullptr;
+        float viewport_height = 0.0f;
+        float max_screen_error = 1.0f;
+    };
+
+    // One draw of every instance of a mesh, or of every instance at one LOD. The vertex buffer goes to binding 0 and
+    // the instance buffer to binding 1, after which the mesh is drawn with
+    // vkCmdDrawIndexed(index_count, instance_count, 0, 0, first_instance).
+    struct InstancedRenderInfo
+    {
+        VkBuffer vertex_buffer;
+        VkBuffer index_buffer;
+        VkBuffer instance_buffer;
+        uint64_t vertex_offset = 0;
+        uint64_t index_offset = 0;
+        // Start of the frame's instances in the instance buffer
+        uint64_t instance_offset = 0;
+        uint32_t index_count = 0;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        uint32_t first_instance = 0;
+        uint32_t instance_count = 0;
+        VertexFormat vertex_format = VertexFormat::FULL;
+    };
+
 public:
     ColorModelManager() = default;
     ColorModelManager(Device *device);
@@ -50,11 +144,77 @@ public:
     void reserve_vertex_buffer_space(uint64_t space_to_reserve);
     void reserve_index_buffer_space(uint64_t space_to_reserve);
 
+    /// Stages every upload in the ring from now on, instead of in a buffer and a submission of its own per upload.
+    /// The copies are only submitted by flush_uploads or finish_mesh_registrations, so importing many meshes takes one
+    /// submission. The ring has to outlive the manager, or be unset with nullptr first.
+    inline void set_staging_ring(StagingRing *staging_ring) { staging_ring_ = staging_ring; };
+    /// Submits the uploads staged in the ring, before drawing the meshes registered since the last flush
+    void flush_uploads();
+
+    // A model is a mesh of its own with a transform, drawn on its own with the transform as a push constant
     object_id_t register_model(std::vector<ColorVertex> vertices);
-    object_id_t register_model(std::vector<ColorVertex> vertices, std::vector<uint32_t> indices);
+    object_id_t register_model(std::vector<ColorVertex> vertices, std::vector<uint32_t> indices,
+                               VertexFormat vertex_format = VertexFormat::FULL, bool build_meshlets = false);
 
     void unregister_model(object_id_t id);
 
+    // Meshes are uploaded once and drawn as any number of instances, all of them in a single draw. Compact meshes
+    // are stored as CompactColorVertex and drawn with the shader's pipelines for VertexFormat::COMPACT.
+    /// @param build_meshlets Also splits the mesh into meshlets (see build_meshlets), so models of it can be drawn
+    /// with cluster culling
+    mesh_id_t register_mesh(std::vector<ColorVertex> vertices, std::vector<uint32_t> indices,
+                            VertexFormat vertex_format = VertexFormat::FULL, bool build_meshlets = false);
+
+    /// Uploads a mesh that needs no processing. The data is copied straight into the staging ring if there is one,
+    /// so it only has to stay alive until this returns.
+    mesh_id_t register_packed_mesh(const PackedMesh &packed_mesh);
+    /// A mesh id without any data yet, e.g. for a mesh streamed in later. Instances of it can be created right away,
+    /// and are drawn once load_packed_mesh gives it data.
+    mesh_id_t reserve_mesh();
+    /// Gives the mesh new data, replacing whatever it had before
+    void load_packed_mesh(mesh_id_t mesh, const PackedMesh &packed_mesh);
+    /// Frees the vertex and index data of the mesh, and stops drawing its instances until it is loaded again. The
+    /// space is reused once the GPU has finished the frames submitted so far, so call it before recording a frame's
+    /// draws rather than in between.
+    void unload_mesh(mesh_id_t mesh);
+
+    /// Optimizes the mesh on a worker thread (see optimize_mesh) and uploads it once finish_mesh_registrations
+    /// finds it done. Optimized meshes use 16 bit indices when their vertex count allows. The mesh id is valid right
+    /// away, and instances of it are drawn once it is uploaded.
+    /// @param lod_config LODs to generate on the worker as well, stored after the full detail indices
+    /// @param build_meshlets Splits the full detail mesh into meshlets on the worker as well
+    mesh_id_t register_mesh_async(ThreadPool &thread_pool, std::vector<ColorVertex> vertices,
+                                  std::vector<uint32_t> indices, VertexFormat vertex_format = VertexFormat::FULL,
+                                  MeshOptimizationConfig config = {}, LodConfig lod_config = {},
+                                  bool build_meshlets = false);
+    /// Uploads the meshes whose optimization has finished, e.g. once per frame. Uploads are done here rather than on
+    /// the workers, since they use the graphics queue. Flushes the staging ring as well, if there is one.
+    /// @param wait Blocks until every pending mesh is uploaded
+    void finish_mesh_registrations(bool wait = false);
+    [[nodiscard]] inline bool is_mesh_ready(mesh_id_t mesh) const
+    {
+        assert(mesh >= 0 && mesh < static_cast<mesh_id_t>(mesh_data_list_.size()));
+        return mesh_data_list_[mesh].index_count > 0;
+    }
+
+    instance_id_t create_instance(mesh_id_t mesh, const Transform &transform = {});
+    void destroy_instance(instance_id_t id);
+
+    /// Writes the transforms of every instance into the frame's part of the instance buffer, and returns one draw
+    /// per mesh with instances. Each frame in flight has its own part, so the transforms of frames still being drawn
+    /// are left alone. Call once per frame, before recording the draws.
+    /// @param frame_index The frame in flight, see DisplayContext::get_current_frame
+    /// @param lod_selection Selects a LOD for every instance of meshes with LODs, with one draw per LOD in use.
+    /// Without it every instance is drawn at full detail.
+    const std::vector<InstancedRenderInfo> &update_instances(uint32_t frame_index,
+                                                            const std::optional<LodSelection> &lod_selection = {});
+
+    [[nodiscard]] inline uint32_t get_lod_count(mesh_id_t mesh) const
+    {
+        assert(mesh >= 0 && mesh < static_cast<mesh_id_t>(mesh_data_list_.size()));
+        return mesh_data_list_[mesh].lod_count;
+    }
+
     // Model access
 
     inline const Transform &get_transform(object_id_t id) const
@@ -66,46 +226,218 @@ public:
     inline void set_transform(object_id_t id, const Transform &transform)
     {
         assert(id >= 0 && id < static_cast<object_id_t>(object_transforms_.size()));
+        const MeshData &data = mesh_data_list_[object_meshes_[id]];
+        glm::mat4 matrix = transform.mat4();
         object_transforms_[id] = transform;
-        cached_mat4s_[id] = transform.mat4();
+        cached_mat4s_[id] = matrix * data.dequantization;
+        object_bvh_.update(object_proxies_[id], data.bounds.transformed(matrix));
+    }
+
+    /// World space bounds of the model, as of its last transform
+    [[nodiscard]] inline const AABB &get_bounds(object_id_t id) const
+    {
+        assert(id >= 0 && id < static_cast<object_id_t>(object_proxies_.size()));
+        return object_bvh_.get_bounds(object_proxies_[id]);
+    }
+
+    [[nodiscard]] inline BoundingSphere get_bounding_sphere(object_id_t id) const
+    {
+        assert(id >= 0 && id < static_cast<object_id_t>(object_meshes_.size()));
+        return mesh_data_list_[object_meshes_[id]].bounding_sphere.transformed(object_transforms_[id].mat4());
+    }
+
+    /// Hierarchy over the world space bounds of every model, with the object ids as user data. Kept up to date by
+    /// register_model and set_transform.
+    [[nodiscard]] inline const Bvh &get_model_bvh() const { return object_bvh_; };
+
+    /// Appends every model whose bounds are in the camera's view
+    void query_visible_models(const Camera &camera, std::vector<object_id_t> &visible_models) const;
+    /// The closest model whose bounds the ray hits. No triangles are kept on the CPU, so it stops at the bounds.
+    [[nodiscard]] std::optional<object_id_t> pick_model(const Ray &ray) const;
+
+    [[nodiscard]] inline uint32_t select_lod(object_id_t id, const LodSelection &lod_selection) const
+    {
+        assert(id >= 0 && id < static_cast<object_id_t>(object_meshes_.size()));
+        return select_lod(mesh_data_list_[object_meshes_[id]], cached_mat4s_[id], object_transforms_[id].scale,
+                          lod_selection);
     }
 
-    inline ModelRenderInfo get_model_render_info(object_id_t id) const
+    [[nodiscard]] inline bool has_meshlets(object_id_t id) const
     {
-        assert(id >= 0 && id < static_cast<object_id_t>(object_data_list_.size()));
-        const ObjectData &data = object_data_list_[id];
+        assert(id >= 0 && id < static_cast<object_id_t>(object_meshes_.size()));
+        return mesh_data_list_[object_meshes_[id]].meshlet_buffer_index >= 0;
+    }
+
+    [[nodiscard]] ClusterRenderInfo get_cluster_render_info(object_id_t id) const;
+
+    inline ModelRenderInfo get_model_render_info(object_id_t id, uint32_t lod = 0) const
+    {
+        assert(id >= 0 && id < static_cast<object_id_t>(object_meshes_.size()));
+        const MeshData &data = mesh_data_list_[object_meshes_[id]];
+        assert(lod < data.lod_count);
         return ModelRenderInfo{
             .vertex_buffer = vertex_buffers_[data.vertex_buffer_index].get_handle(),
             .index_buffer = index_buffers_[data.index_buffer_index].get_handle(),
             .vertex_offset = data.vertex_offset,
-            .index_offset = data.index_offset,
-            .index_count = data.index_count,
+            .index_offset = data.get_lod_index_offset(lod),
+            .index_count = data.lods[lod].index_count,
+            .index_type = data.index_type,
+            .vertex_format = data.vertex_format,
             .render_data = GeometryRenderData{.model = cached_mat4s_[id]},
         };
     }
 
+    inline const Transform &get_instance_transform(instance_id_t id) const
+    {
+        assert(id >= 0 && id < static_cast<instance_id_t>(instances_.size()) && instances_[id].mesh >= 0);
+        return instances_[id].transform;
+    }
+
+    inline void set_instance_transform(instance_id_t id, const Transform &transform)
+    {
+        assert(id >= 0 && id < static_cast<instance_id_t>(instances_.size()) && instances_[id].mesh >= 0);
+        InstanceRecord &instance = instances_[id];
+        instance.transform = transform;
+        mesh_instance_data_[instance.mesh][instance.slot].model =
+                transform.mat4() * mesh_data_list_[instance.mesh].dequantization;
+        instance_generation_++;
+    }
+
+    [[nodiscard]] inline uint32_t get_instance_count(mesh_id_t mesh) const
+    {
+        assert(mesh >= 0 && mesh < static_cast<mesh_id_t>(mesh_data_list_.size()));
+        return static_cast<uint32_t>(mesh_instance_data_[mesh].size());
+    }
+
 private:
-    struct ObjectData
+    struct MeshData
     {
         int32_t vertex_buffer_index = -1;
         int32_t index_buffer_index = -1;
         uint64_t vertex_offset = 0;
         uint64_t index_offset = 0;
+        // Space taken in the buffers, given back when the mesh is unloaded
+        uint64_t vertex_size = 0;
+        uint64_t index_space = 0;
         uint32_t index_count = 0;
+        VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+        VertexFormat vertex_format = VertexFormat::FULL;
+        // Maps compact positions back into the mesh's bounds, identity for full vertices
+        glm::mat4 dequantization{1.0f};
+
+        // Index ranges of the LODs, stored one after the other starting at index_offset
+        std::array<LodRange, max_lod_count> lods{};
+        uint32_t lod_count = 1;
+        // Center of the mesh in the space the model matrix takes, where LODs are selected by distance from
+        glm::vec3 lod_center{0.0f};
+        // Into meshlet_buffers_, -1 for meshes without meshlets
+        int32_t meshlet_buffer_index = -1;
+        // In the space the transform of models takes, which is before the dequantization of compact meshes
+        AABB bounds{};
+        BoundingSphere bounding_sphere{};
+
+        [[nodiscard]] inline uint64_t get_lod_index_offset(uint32_t lod) const
+        {
+            uint64_t index_size = index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+            return index_offset + index_size * lods[lod].first_index;
+        }
+    };
+
+    // An instance's place in its mesh's instance data. Destroyed instances have no mesh and are reused.
+    struct InstanceRecord
+    {
+        mesh_id_t mesh = -1;
+        uint32_t slot = 0;
+        Transform transform{};
     };
 
     Device *device_ = nullptr;
+    StagingRing *staging_ring_ = nullptr;
+
+    // A cluster as cluster_cull.comp reads it (std430)
+    struct GpuCluster
+    {
+        // Center and radius
+        glm::vec4 sphere;
+        // Apex, w unused
+        glm::vec4 cone_apex;
+        // Axis and cutoff
+        glm::vec4 cone;
+        uint32_t vertex_offset;
+        uint32_t triangle_offset;
+        uint32_t triangle_count;
+        uint32_t padding;
+    };
+
+    struct MeshletBuffers
+    {
+        Buffer clusters{};
+        Buffer vertices{};
+        Buffer triangles{};
+        uint32_t cluster_count = 0;
+    };
+
+    struct OptimizedMesh
+    {
+        std::vector<ColorVertex> vertices;
+        std::vector<LodLevel> lods;
+        // No meshlets unless asked for
+        MeshletData meshlets;
+    };
+
+    struct PendingMesh
+    {
+        mesh_id_t mesh;
+        VertexFormat vertex_format;
+        std::future<OptimizedMesh> result;
+    };
+
+    // Uses mesh id as index
+    std::vector<MeshData> mesh_data_list_{};
+    std::vector<PendingMesh> pending_meshes_{};
+    // Kept packed per mesh, so a mesh's instances are contiguous in the instance buffer
+    std::vector<std::vector<InstanceData>> mesh_instance_data_{};
+    std::vector<std::vector<instance_id_t>> mesh_instance_ids_{};
 
     // Uses object id as index
-    std::vector<ObjectData> object_data_list_{};
+    std::vector<mesh_id_t> object_meshes_{};
     std::vector<Transform> object_transforms_{};
     std::vector<glm::mat4> cached_mat4s_{};
+    std::vector<Bvh::proxy_id_t> object_proxies_{};
+    Bvh object_bvh_{};
+
+    // Uses instance id as index
+    std::vector<InstanceRecord> instances_{};
+    std::vector<instance_id_t> free_instance_ids_{};
+
+    // Host visible, with room for instance_capacity_ instances for each frame in flight
+    Buffer instance_buffer_{};
+    uint32_t instance_capacity_ = 0;
+    // Bumped on every change, so frames whose instance data is already current skip the upload
+    uint64_t instance_generation_ = 1;
+    std::array<uint64_t, constant::max_frames_in_flight> frame_instance_generations_{};
+    std::vector<InstancedRenderInfo> instanced_draws_{};
+    // Scratch space for the LOD of every instance of a mesh
+    std::vector<uint32_t> instance_lods_{};
 
-    // Index stored in ObjectData
+    // Index stored in MeshData
     std::vector<Buffer> vertex_buffers_{};
     std::vector<Buffer> index_buffers_{};
+    std::vector<MeshletBuffers> meshlet_buffers_{};
 
-    // TODO: Make free lists for buffers and make unregister not be a noop
+    // TODO: Make unregister not be a noop
+
+    // Space given back by unloaded meshes, sorted by buffer and offset. It is only reused once the timeline has
+    // passed timeline_value, as frames drawing the mesh may still be in flight until then.
+    struct FreeRange
+    {
+        int32_t buffer_index = -1;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+        uint64_t timeline_value = 0;
+    };
+    std::vector<FreeRange> free_vertex_ranges_{};
+    std::vector<FreeRange> free_index_ranges_{};
 
     // Simple growing only buffers
 
@@ -113,6 +445,21 @@ private:
     uint64_t current_index_buffer_index_ = std::numeric_limits<uint64_t>::max();
     uint64_t remaining_vertex_buffer_space_ = 0;
     uint64_t remaining_index_buffer_space_ = 0;
+
+    mesh_id_t add_mesh();
+    void upload_mesh(mesh_id_t mesh, const std::vector<ColorVertex> &vertices, const std::vector<LodLevel> &lods,
+                     VertexFormat vertex_format, VkIndexType index_type, const MeshletData &meshlets);
+    void upload_packed_mesh(mesh_id_t mesh, const PackedMesh &packed_mesh);
+    /// Takes size bytes from the first free range the GPU is done with that fits, if any
+    [[nodiscard]] std::optional<FreeRange> take_free_range(std::vector<FreeRange> &free_ranges, uint64_t size);
+    static void release_range(std::vector<FreeRange> &free_ranges, FreeRange range);
+    [[nodiscard]] MeshletBuffers upload_meshlets(const MeshletData &meshlets) const;
+    void upload(Buffer &buffer, const void *data, uint64_t offset, uint64_t size) const;
+
+    /// @param model The model matrix, including the dequantization
+    /// @param scale The scale of the transform, which scales the error of the LODs as well
+    [[nodiscard]] static uint32_t select_lod(const MeshData &data, const glm::mat4 &model, glm::vec3 scale,
+                                             const LodSelection &lod_selection);
 };
 
 } // namespace flwfrg::vk
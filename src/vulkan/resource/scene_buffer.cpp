@@ -0,0 +1,77 @@
+#include "pch.hpp"
+
+#include "scene_buffer.hpp"
+
+#include "vulkan/device.hpp"
+
+#include <algorithm>
+
+namespace flwfrg::vk
+{
+
+SceneBuffer::SceneBuffer(Device *device) : device_{device} {}
+
+void SceneBuffer::update(uint32_t frame_index, const Scene &scene)
+{
+    assert(device_ != nullptr);
+    assert(frame_index < constant::max_frames_in_flight);
+
+    // Grow by doubling. The old buffer lives on until the frames drawing from it are done.
+    auto id_capacity = static_cast<uint32_t>(scene.get_id_capacity());
+    if (id_capacity > capacity_)
+    {
+        capacity_ = std::max(id_capacity, capacity_ * 2);
+        buffer_ = Buffer(device_, sizeof(glm::mat4) * capacity_ * constant::max_frames_in_flight,
+                         static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT),
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                         true);
+        full_update_.fill(true);
+        for (auto &pending: pending_nodes_)
+        {
+            pending.clear();
+        }
+    }
+
+    // Every frame has to catch up on the changes, each when its turn comes
+    const auto &changed_nodes = scene.get_changed_nodes();
+    for (uint32_t frame = 0; frame < constant::max_frames_in_flight; frame++)
+    {
+        if (!full_update_[frame])
+            pending_nodes_[frame].insert(pending_nodes_[frame].end(), changed_nodes.begin(), changed_nodes.end());
+    }
+
+    auto &pending = pending_nodes_[frame_index];
+    if (!full_update_[frame_index] && pending.empty())
+        return;
+
+    auto *mapped_matrices =
+            static_cast<glm::mat4 *>(buffer_.lock_memory(get_frame_offset(frame_index), get_frame_size(), 0));
+    if (full_update_[frame_index])
+    {
+        for (Scene::node_id_t id = 0; id < scene.get_id_capacity(); id++)
+        {
+            if (scene.is_valid(id))
+                mapped_matrices[id] = scene.get_world_matrix(id);
+        }
+        full_update_[frame_index] = false;
+    }
+    else
+    {
+        // Nodes changing every frame are pending once per update since the frame last wrote, and in id order the
+        // writes walk the mapping forwards
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+        for (Scene::node_id_t id: pending)
+        {
+            // Destroyed since
+            if (scene.is_valid(id))
+                mapped_matrices[id] = scene.get_world_matrix(id);
+        }
+    }
+    buffer_.unlock_memory();
+    pending.clear();
+}
+
+} // namespace flwfrg::vk
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "scene/scene.hpp"
+#include "vulkan/buffer.hpp"
+#include "vulkan/util/constants.hpp"
+
+#include <array>
+#include <vector>
+
+namespace flwfrg::vk
+{
+class Device;
+
+/// The world matrices of a Scene on the GPU, indexed by node id. Each frame in flight has its own part, and update
+/// only writes the matrices that changed since the frame last wrote its part. Usable as a storage buffer, or as the
+/// instance buffer of ColorModelManager::InstancedRenderInfo for nodes with consecutive ids.
+class SceneBuffer
+{
+public:
+    SceneBuffer() = default;
+    explicit SceneBuffer(Device *device);
+    ~SceneBuffer() = default;
+
+    // Copy
+    SceneBuffer(const SceneBuffer &) = delete;
+    SceneBuffer &operator=(const SceneBuffer &) = delete;
+    // Move
+    SceneBuffer(SceneBuffer &&other) noexcept = default;
+    SceneBuffer &operator=(SceneBuffer &&other) noexcept = default;
+
+    // Methods
+
+    /// Writes what Scene::update changed into the frame's part of the buffer, in one pass over the mapped memory.
+    /// Call once per frame, after Scene::update.
+    /// @param frame_index The frame in flight, see DisplayContext::get_current_frame
+    void update(uint32_t frame_index, const Scene &scene);
+
+    [[nodiscard]] inline VkBuffer get_handle() const { return buffer_.get_handle(); };
+    [[nodiscard]] inline uint64_t get_frame_offset(uint32_t frame_index) const
+    {
+        return sizeof(glm::mat4) * capacity_ * frame_index;
+    }
+    [[nodiscard]] inline uint64_t get_frame_size() const { return sizeof(glm::mat4) * capacity_; };
+
+private:
+    Device *device_ = nullptr;
+
+    Buffer buffer_{};
+    // Matrices per frame
+    uint32_t capacity_ = 0;
+
+    // Changed by earlier updates, but not written to the frame's part yet
+    std::array<std::vector<Scene::node_id_t>, constant::max_frames_in_flight> pending_nodes_{};
+    // Set for every frame when the buffer is recreated, the frame then writes every node
+    std::array<bool, constant::max_frames_in_flight> full_update_{};
+};
+
+} // namespace flwfrg::vk
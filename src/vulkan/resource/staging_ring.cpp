@@ -0,0 +1,164 @@
+#include "pch.hpp"
+
+#include "staging_ring.hpp"
+
+#include "vulkan/device.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace flwfrg::vk
+{
+
+namespace
+{
+
+constexpr uint64_t max_alignment = 256;
+
+constexpr uint64_t align_up(uint64_t value, uint64_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+StagingRing::StagingRing(Device *device, uint64_t capacity)
+    : device_{device},
+      // A multiple of every alignment, so wrapping around keeps allocations aligned
+      capacity_{align_up(capacity, max_alignment)}
+{
+    assert(device_ != nullptr);
+    assert(capacity_ > 0);
+
+    buffer_ = Buffer(device_, capacity_, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+    mapped_ = static_cast<std::byte *>(buffer_.lock_memory(0, capacity_, 0));
+}
+
+StagingRing::~StagingRing()
+{
+    if (has_pending_copies())
+        flush();
+}
+
+StagingRing::Allocation StagingRing::allocate(uint64_t size, uint64_t alignment)
+{
+    assert(device_ != nullptr);
+    assert(size > 0 && size <= capacity_);
+    assert(alignment > 0 && alignment <= max_alignment && (alignment & (alignment - 1)) == 0);
+
+    release_completed_submissions();
+
+    while (true)
+    {
+        // Allocations do not wrap around the end, they start over at the beginning of the ring instead
+        uint64_t position = align_up(head_, alignment);
+        if (position % capacity_ + size > capacity_)
+            position = align_up(position, capacity_);
+
+        if (position + size - tail_ <= capacity_)
+        {
+            head_ = position + size;
+            return Allocation{.data = mapped_ + position % capacity_, .offset = position % capacity_, .size = size};
+        }
+
+        if (submissions_.empty())
+        {
+            // The ring is full of copies that were never submitted
+            if (head_ != flushed_head_)
+            {
+                flush();
+                continue;
+            }
+
+            // Nothing is in use, so start over at the beginning where the whole ring is free
+            head_ = align_up(head_, capacity_);
+            tail_ = head_;
+            flushed_head_ = head_;
+            continue;
+        }
+
+        const Submission &oldest = submissions_.front();
+        if (!device_->wait_for(oldest.timeline_value))
+        {
+            throw std::runtime_error("Failed to wait for staging ring submission");
+        }
+        tail_ = oldest.end;
+        submissions_.pop_front();
+    }
+}
+
+void StagingRing::copy(const Allocation &allocation, Buffer &destination, uint64_t destination_offset)
+{
+    assert(allocation.offset + allocation.size <= capacity_);
+    assert(destination_offset + allocation.size <= destination.get_total_size());
+
+    if (!has_pending_copies())
+        command_buffer_ = CommandBuffer::begin_single_time_commands(device_, device_->get_graphics_command_pool());
+
+    VkBufferCopy copy_region{};
+    copy_region.srcOffset = allocation.offset;
+    copy_region.dstOffset = destination_offset;
+    copy_region.size = allocation.size;
+
+    vkCmdCopyBuffer(command_buffer_.get_handle(), buffer_.get_handle(), destination.get_handle(), 1, &copy_region);
+}
+
+void StagingRing::upload(const void *data, uint64_t size, Buffer &destination, uint64_t destination_offset)
+{
+    // Pieces of a quarter of the ring, so the first ones are copied while the later ones are staged
+    const uint64_t max_piece_size = std::max<uint64_t>(capacity_ / 4, max_alignment);
+    const auto *bytes = static_cast<const std::byte *>(data);
+
+    for (uint64_t done = 0; done < size;)
+    {
+        uint64_t piece_size = std::min(size - done, max_piece_size);
+        Allocation allocation = allocate(piece_size);
+        std::memcpy(allocation.data, bytes + done, piece_size);
+        copy(allocation, destination, destination_offset + done);
+        done += piece_size;
+    }
+}
+
+uint64_t StagingRing::flush()
+{
+    assert(device_ != nullptr);
+
+    if (!has_pending_copies())
+    {
+        // Allocated but never copied, the space is free again as soon as nothing before it is read anymore
+        if (head_ != flushed_head_)
+        {
+            submissions_.push_back({head_, device_->get_last_submitted_value()});
+            flushed_head_ = head_;
+        }
+        return device_->get_last_submitted_value();
+    }
+
+    // One barrier for every copy, making them visible to any later work on the queue
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    vkCmdPipelineBarrier(command_buffer_.get_handle(), VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    CommandBuffer::end_single_time_commands(device_, command_buffer_, device_->get_graphics_queue());
+
+    uint64_t timeline_value = device_->get_last_submitted_value();
+    submissions_.push_back({head_, timeline_value});
+    flushed_head_ = head_;
+    return timeline_value;
+}
+
+void StagingRing::release_completed_submissions()
+{
+    while (!submissions_.empty() && device_->is_complete(submissions_.front().timeline_value))
+    {
+        tail_ = submissions_.front().end;
+        submissions_.pop_front();
+    }
+}
+
+} // namespace flwfrg::vk
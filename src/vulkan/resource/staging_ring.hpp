@@ -0,0 +1,95 @@
+#pragma once
+
+#include "vulkan/buffer.hpp"
+#include "vulkan/command_buffer.hpp"
+
+#include <cstddef>
+#include <deque>
+
+namespace flwfrg::vk
+{
+class Device;
+
+/// Host visible memory that uploads are staged in, used as a ring so any number of uploads share one mapped buffer
+/// and one submission, where Buffer::upload_data creates a buffer and submits once per upload.
+///
+/// Copies into their destinations are recorded as uploads come in, and flush submits them all at once with a barrier
+/// making them visible to any later work on the graphics queue. Space is reused once the device timeline has passed
+/// the submission that read it, and uploads only wait for the GPU when the whole ring is still being read.
+class StagingRing
+{
+public:
+    static constexpr uint64_t default_capacity = 64ull * 1024 * 1024;
+
+    /// Room in the ring, mapped at data. Written by the caller and then copied with copy.
+    struct Allocation
+    {
+        std::byte *data = nullptr;
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+
+    StagingRing() = default;
+    explicit StagingRing(Device *device, uint64_t capacity = default_capacity);
+    /// Submits the copies that were not flushed yet
+    ~StagingRing();
+
+    // Copy
+    StagingRing(const StagingRing &) = delete;
+    StagingRing &operator=(const StagingRing &) = delete;
+    // Move
+    StagingRing(StagingRing &&other) noexcept = default;
+    StagingRing &operator=(StagingRing &&other) noexcept = default;
+
+    // Methods
+
+    /// Room for size bytes, e.g. to convert or read data straight into staging memory without a copy of it first.
+    /// Waits for the oldest submissions when the ring is full, and flushes first when it is full of unflushed copies.
+    /// @param size At most get_capacity()
+    /// @param alignment A power of two, at most 256
+    [[nodiscard]] Allocation allocate(uint64_t size, uint64_t alignment = 16);
+    /// Records the copy of an allocation into destination, which needs VK_BUFFER_USAGE_TRANSFER_DST_BIT
+    void copy(const Allocation &allocation, Buffer &destination, uint64_t destination_offset);
+    /// Stages data and records its copy into destination, in pieces when it does not fit the ring at once
+    void upload(const void *data, uint64_t size, Buffer &destination, uint64_t destination_offset);
+
+    /// Submits the copies recorded since the last flush. Anything submitted to the graphics queue afterwards sees the
+    /// uploaded data.
+    /// @return The timeline value of the submission, or the last submitted value when there was nothing to submit
+    uint64_t flush();
+
+    [[nodiscard]] inline uint64_t get_capacity() const { return capacity_; };
+    [[nodiscard]] inline bool has_pending_copies() const
+    {
+        return command_buffer_.get_state() == CommandBuffer::State::RECORDING;
+    };
+
+private:
+    Device *device_ = nullptr;
+
+    Buffer buffer_{};
+    // Mapped for as long as the ring lives
+    std::byte *mapped_ = nullptr;
+    uint64_t capacity_ = 0;
+
+    // Positions only ever grow and are taken modulo the capacity, so a full ring and an empty one are told apart.
+    // Everything from tail_ up to head_ is in use, and everything from flushed_head_ on is not submitted yet.
+    uint64_t head_ = 0;
+    uint64_t tail_ = 0;
+    uint64_t flushed_head_ = 0;
+
+    // The end of what each flush submitted, freed once the timeline reaches its value
+    struct Submission
+    {
+        uint64_t end;
+        uint64_t timeline_value;
+    };
+    std::deque<Submission> submissions_{};
+
+    // Recording from the first copy after a flush on
+    CommandBuffer command_buffer_{};
+
+    void release_completed_submissions();
+};
+
+} // namespace flwfrg::vk
@@ -2,12 +2,15 @@
 
 #include "static_texture.hpp"
 
+#include "io/file_reader.hpp"
 #include "vulkan/buffer.hpp"
 #include "vulkan/command_buffer.hpp"
 #include "vulkan/device.hpp"
 
 #include <stb_image.h>
 
+#include <stdexcept>
+
 
 namespace flwfrg::vk
 {
@@ -19,57 +22,30 @@ const Image &StaticTexture::get_image() const
 Status StaticTexture::load_texture_from_file(std::string texture_name)
 {
 	std::string path = "assets/textures/" + texture_name + ".png";
-	const int32_t required_channel_count = 4;
-	stbi_set_flip_vertically_on_load(true);
-
-	int32_t width, height, channel_count;
-
-	uint8_t *data = stbi_load(path.c_str(),
-							  &width,
-							  &height,
-							  &channel_count,
-							  required_channel_count);
 
-
-	if (stbi_failure_reason())
+	FileContents file{};
+	try
+	{
+		file = io::read_file(path);
+	} catch (const std::runtime_error &e)
 	{
-		FLOWFORGE_WARN("Failed to load texture '{}', {}", path, stbi_failure_reason());
+		FLOWFORGE_WARN("Failed to load texture '{}', {}", path, e.what());
+		return Status::FLOWFORGE_FAILED_TO_OPEN_FILE;
 	}
 
-	if (data == nullptr)
+	auto image = decode_image(file.get_bytes());
+	if (!image.has_value())
 	{
-		return Status::FLOWFORGE_FAILED_TO_LOAD_TEXTURE_DATA;
+		FLOWFORGE_WARN("Failed to load texture '{}'", path);
+		return image.status();
 	}
 
 	uint32_t generation = generation_;
 	generation_ = constant::invalid_generation;
-	uint64_t total_size = width * height * required_channel_count;
 
-	bool has_transparency = false;
-	for (size_t i = 0; i < total_size; i += 4)
 	{
-		uint8_t a = data[i + 3];
-		if (a < 255)
-		{
-			has_transparency = true;
-			break;
-		}
-	}
-
-	std::vector<uint8_t> data_vec;
-	data_vec.resize(total_size);
-	std::copy_n(data, total_size, data_vec.begin());
-	// for (size_t i = 0; i < total_size; i += 4)
-	// {
-	// 	data_vec[i / 4 + 0] = data[i] / 255.0f;
-	// 	data_vec[i / 4 + 1] = data[i + 1] / 255.0f;
-	// 	data_vec[i / 4 + 2] = data[i + 2] / 255.0f;
-	// 	data_vec[i / 4 + 3] = data[i + 3] / 255.0f;
-	// }
-	stbi_image_free(data);
-
-	{
-		auto opt_status = create_texture(device_, id_, static_cast<uint32_t>(width), static_cast<uint32_t>(height), static_cast<uint8_t>(generation), has_transparency, data_vec);
+		DecodedImage &decoded = image.value();
+		auto opt_status = create_texture(device_, id_, decoded.width, decoded.height, 4, decoded.has_transparency, std::move(decoded.data));
 		if (!opt_status.has_value())
 			return opt_status.status();
 
@@ -84,6 +60,44 @@ Status StaticTexture::load_texture_from_file(std::string texture_name)
 	return Status::SUCCESS;
 }
 
+StatusOptional<StaticTexture::DecodedImage, Status, Status::SUCCESS> StaticTexture::decode_image(std::span<const std::byte> file)
+{
+	const int32_t required_channel_count = 4;
+	stbi_set_flip_vertically_on_load_thread(true);
+
+	int32_t width, height, channel_count;
+	uint8_t *data = stbi_load_from_memory(reinterpret_cast<const stbi_uc *>(file.data()),
+										  static_cast<int>(file.size()),
+										  &width,
+										  &height,
+										  &channel_count,
+										  required_channel_count);
+	if (data == nullptr)
+	{
+		FLOWFORGE_WARN("Failed to decode texture, {}", stbi_failure_reason());
+		return Status::FLOWFORGE_FAILED_TO_LOAD_TEXTURE_DATA;
+	}
+
+	uint64_t total_size = static_cast<uint64_t>(width) * height * required_channel_count;
+	DecodedImage image{
+			.width = static_cast<uint32_t>(width),
+			.height = static_cast<uint32_t>(height),
+			.data = std::vector<uint8_t>(data, data + total_size),
+	};
+	stbi_image_free(data);
+
+	for (size_t i = 3; i < total_size; i += 4)
+	{
+		if (image.data[i] < 255)
+		{
+			image.has_transparency = true;
+			break;
+		}
+	}
+
+	return image;
+}
+
 StatusOptional<StaticTexture, Status, Status::SUCCESS> StaticTexture::create_texture(Device *device, uint32_t id, uint32_t width, uint32_t height, uint8_t channel_count, bool has_transparency, std::vector<uint8_t> data)
 {
 	assert(device != nullptr);
@@ -2,6 +2,8 @@
 
 #include "texture.hpp"
 
+#include <span>
+
 namespace flwfrg::vk
 {
 
@@ -10,8 +12,21 @@ class StaticTexture : public Texture
 public:
 	[[nodiscard]] const Image &get_image() const override;
 
+	// Pixels decoded from an image file, ready for create_texture
+	struct DecodedImage
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool has_transparency = false;
+		std::vector<uint8_t> data{};
+	};
+
 	Status load_texture_from_file(std::string texture_name);
 
+	/// Decodes an image file in memory (PNG, JPEG, ...) into four channels, flipped vertically as
+	/// load_texture_from_file does. Uses no Vulkan and no global state, so loader threads can decode in parallel.
+	static StatusOptional<DecodedImage, Status, Status::SUCCESS> decode_image(std::span<const std::byte> file);
+
 	static StatusOptional<StaticTexture, Status, Status::SUCCESS> create_texture(
 			Device *device,
 			uint32_t id,
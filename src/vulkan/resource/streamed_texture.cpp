@@ -0,0 +1,48 @@
+#include "pch.hpp"
+
+#include "streamed_texture.hpp"
+
+#include <stdexcept>
+
+namespace flwfrg::vk
+{
+
+StreamedTexture::StreamedTexture(Device *device, uint32_t id, const StaticTexture *placeholder)
+    : placeholder_{placeholder}
+{
+    assert(device != nullptr && placeholder != nullptr);
+
+    device_ = device;
+    id_ = id;
+    width_ = placeholder->get_width();
+    height_ = placeholder->get_height();
+    channel_count_ = placeholder->get_channel_count();
+    has_transparency_ = placeholder->has_transparency();
+    generation_ = 0;
+
+    auto sampler = create_sampler(device);
+    if (sampler.status() != Status::SUCCESS)
+    {
+        throw std::runtime_error("Failed to create sampler for streamed texture");
+    }
+    sampler_ = std::move(sampler.value());
+}
+
+const Image &StreamedTexture::get_image() const
+{
+    return resident_.has_value() ? resident_->get_image() : placeholder_->get_image();
+}
+
+void StreamedTexture::set_resident(std::optional<StaticTexture> texture)
+{
+    resident_ = std::move(texture);
+
+    const Texture &shown = resident_.has_value() ? static_cast<const Texture &>(*resident_) : *placeholder_;
+    width_ = shown.get_width();
+    height_ = shown.get_height();
+    channel_count_ = shown.get_channel_count();
+    has_transparency_ = shown.has_transparency();
+    generation_++;
+}
+
+}// namespace flwfrg::vk
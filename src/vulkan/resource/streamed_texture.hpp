@@ -0,0 +1,39 @@
+#pragma once
+
+#include "static_texture.hpp"
+#include "texture.hpp"
+
+#include <optional>
+
+namespace flwfrg::vk
+{
+
+/// A texture that shows a placeholder until its data is resident, and again once it is evicted. It stays at the same
+/// address throughout, and its generation changes on every swap, so descriptors pointing at it are rewritten.
+class StreamedTexture : public Texture
+{
+public:
+    StreamedTexture() = default;
+    /// @param placeholder Shown while nothing is resident, has to outlive the texture
+    /// @throws std::runtime_error When the sampler cannot be created
+    StreamedTexture(Device *device, uint32_t id, const StaticTexture *placeholder);
+
+    // Move
+    StreamedTexture(StreamedTexture &&other) noexcept = default;
+    StreamedTexture &operator=(StreamedTexture &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] const Image &get_image() const override;
+
+    /// Shows the texture from now on, or the placeholder again when given nothing. The texture replaced is destroyed
+    /// once the frames sampling it are done.
+    void set_resident(std::optional<StaticTexture> texture);
+    [[nodiscard]] inline bool is_resident() const { return resident_.has_value(); };
+
+private:
+    const StaticTexture *placeholder_ = nullptr;
+    std::optional<StaticTexture> resident_{};
+};
+
+}// namespace flwfrg::vk
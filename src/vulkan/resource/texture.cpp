@@ -15,8 +15,11 @@ Texture::~Texture()
 {
     if (sampler_.not_null())
     {
-        vkDeviceWaitIdle(device_->get_logical_device());
-        vkDestroySampler(device_->get_logical_device(), sampler_, nullptr);
+        // Frames in flight may still sample through it
+        device_->defer_destruction([device = device_->get_logical_device(), sampler = static_cast<VkSampler>(sampler_)]() {
+            vkDestroySampler(device, sampler, nullptr);
+        });
+        sampler_ = make_handle<VkSampler>(VK_NULL_HANDLE);
         FLOWFORGE_TRACE("Texture destroyed");
     }
 }
@@ -0,0 +1,204 @@
+#include "pch.hpp"
+
+#include "cluster_cull_shader.hpp"
+
+#include "vulkan/command_buffer.hpp"
+#include "vulkan/display_context.hpp"
+#include "vulkan/util/constants.hpp"
+
+#include <array>
+
+namespace flwfrg::vk::shader
+{
+
+ClusterCullShader::ClusterCullShader(DisplayContext *context) : context_{context}
+{
+    assert(context_ != nullptr);
+
+    auto stage = ShaderStage::create_shader_module(&context_->get_device(), shader_file_name,
+                                                   VK_SHADER_STAGE_COMPUTE_BIT);
+    if (!stage.has_value())
+    {
+        throw std::runtime_error("Failed to create shader stage");
+    }
+    stage_ = std::move(stage.value());
+
+    // Clusters, meshlet vertices, meshlet triangles, culled indices and draws
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t binding = 0; binding < bindings.size(); binding++)
+    {
+        bindings[binding].binding = binding;
+        bindings[binding].descriptorCount = 1;
+        bindings[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[binding].pImmutableSamplers = nullptr;
+        bindings[binding].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layout_info{};
+    layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    layout_info.pBindings = bindings.data();
+    descriptor_set_layout_ = context_->get_descriptor_layout_cache().get_layout(layout_info);
+
+    static_assert(sizeof(PushConstants) <= 128, "Vulkan only guarantees 128 bytes of push constants");
+    auto created_pipeline = Pipeline::create_compute_pipeline(&context_->get_device(),
+                                                              stage_.get_shader_stage_create_info(),
+                                                              {descriptor_set_layout_}, sizeof(PushConstants));
+    if (!created_pipeline.has_value())
+    {
+        throw std::runtime_error("Failed to create cluster culling pipeline");
+    }
+    pipeline_ = std::move(created_pipeline.value());
+}
+
+void ClusterCullShader::reserve(uint32_t index_count, uint32_t draw_count)
+{
+    assert(context_ != nullptr);
+
+    if (index_count > index_capacity_)
+    {
+        index_capacity_ = index_count;
+        index_buffer_ = Buffer(&context_->get_device(),
+                               sizeof(uint32_t) * index_capacity_ * constant::max_frames_in_flight,
+                               static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                  VK_BUFFER_USAGE_INDEX_BUFFER_BIT),
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+    }
+
+    // Host visible, the draws are reset from the CPU before every frame culls into them
+    if (draw_count > draw_capacity_)
+    {
+        draw_capacity_ = draw_count;
+        indirect_buffer_ = Buffer(&context_->get_device(),
+                                  sizeof(VkDrawIndexedIndirectCommand) * draw_capacity_ *
+                                          constant::max_frames_in_flight,
+                                  static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                                                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT),
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                  true);
+    }
+}
+
+void ClusterCullShader::begin_frame()
+{
+    frame_index_count_ = 0;
+    frame_draw_count_ = 0;
+}
+
+ClusterCullShader::CulledDraw ClusterCullShader::cull(const ColorModelManager::ClusterRenderInfo &info,
+                                                      const glm::mat4 &projection, const glm::mat4 &view)
+{
+    return cull(context_->get_command_buffer(), info, projection, view);
+}
+
+ClusterCullShader::CulledDraw ClusterCullShader::cull(CommandBuffer &command_buffer,
+                                                      const ColorModelManager::ClusterRenderInfo &info,
+                                                      const glm::mat4 &projection, const glm::mat4 &view)
+{
+    assert(frame_index_count_ + info.index_count <= index_capacity_ && "Reserve room for the culled indices first");
+    assert(frame_draw_count_ < draw_capacity_ && "Reserve room for the culled draws first");
+
+    uint32_t current_frame = context_->get_current_frame();
+    uint32_t draw_index = draw_capacity_ * current_frame + frame_draw_count_;
+    uint32_t first_index = index_capacity_ * current_frame + frame_index_count_;
+    frame_draw_count_++;
+    frame_index_count_ += info.index_count;
+
+    // The clusters add their indices to the count
+    VkDrawIndexedIndirectCommand draw_command{
+            .indexCount = 0,
+            .instanceCount = 1,
+            .firstIndex = first_index,
+            .vertexOffset = 0,
+            .firstInstance = 0,
+    };
+    uint64_t indirect_offset = sizeof(VkDrawIndexedIndirectCommand) * draw_index;
+    indirect_buffer_.load_data(&draw_command, indirect_offset, sizeof(draw_command), 0);
+
+    PushConstants constants{};
+    // Planes of the clip space frustum (Gribb and Hartmann) taken back into the mesh's space, with depth from 0 to 1
+    glm::mat4 mesh_to_clip = projection * view * info.transform;
+    auto row = [&mesh_to_clip](int i) {
+        return glm::vec4{mesh_to_clip[0][i], mesh_to_clip[1][i], mesh_to_clip[2][i], mesh_to_clip[3][i]};
+    };
+    constants.frustum_planes[0] = row(3) + row(0);
+    constants.frustum_planes[1] = row(3) - row(0);
+    constants.frustum_planes[2] = row(3) + row(1);
+    constants.frustum_planes[3] = row(3) - row(1);
+    constants.frustum_planes[4] = row(2);
+    constants.frustum_planes[5] = row(3) - row(2);
+
+    glm::vec4 camera_position = glm::inverse(view)[3];
+    constants.camera_position = glm::inverse(info.transform) * camera_position;
+    constants.camera_position.w = info.uniform_scale ? 1.0f : 0.0f;
+    constants.cluster_count = info.cluster_count;
+    constants.draw_index = draw_index;
+    constants.first_index = first_index;
+
+    VkDescriptorSet descriptor_set = context_->get_frame_descriptor_allocator().allocate(descriptor_set_layout_);
+
+    std::array<VkDescriptorBufferInfo, 5> buffer_infos{
+            VkDescriptorBufferInfo{info.cluster_buffer, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{info.meshlet_vertex_buffer, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{info.meshlet_triangle_buffer, 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{index_buffer_.get_handle(), 0, VK_WHOLE_SIZE},
+            VkDescriptorBufferInfo{indirect_buffer_.get_handle(), 0, VK_WHOLE_SIZE},
+    };
+    std::array<VkWriteDescriptorSet, 5> descriptor_writes{};
+    for (uint32_t binding = 0; binding < descriptor_writes.size(); binding++)
+    {
+        descriptor_writes[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[binding].dstSet = descriptor_set;
+        descriptor_writes[binding].dstBinding = binding;
+        descriptor_writes[binding].dstArrayElement = 0;
+        descriptor_writes[binding].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptor_writes[binding].descriptorCount = 1;
+        descriptor_writes[binding].pBufferInfo = &buffer_infos[binding];
+    }
+    vkUpdateDescriptorSets(context_->get_device().get_logical_device(),
+                           static_cast<uint32_t>(descriptor_writes.size()), descriptor_writes.data(), 0, nullptr);
+
+    pipeline_.bind(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE);
+    vkCmdBindDescriptorSets(command_buffer.get_handle(), VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_.layout(), 0, 1,
+                            &descriptor_set, 0, nullptr);
+    vkCmdPushConstants(command_buffer.get_handle(), pipeline_.layout(), VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(PushConstants), &constants);
+    vkCmdDispatch(command_buffer.get_handle(), info.cluster_count, 1, 1);
+
+    return CulledDraw{
+            .vertex_buffer = info.vertex_buffer,
+            .vertex_offset = info.vertex_offset,
+            .index_buffer = index_buffer_.get_handle(),
+            .indirect_buffer = indirect_buffer_.get_handle(),
+            .indirect_offset = indirect_offset,
+            .vertex_format = info.vertex_format,
+            .render_data = info.render_data,
+    };
+}
+
+void ClusterCullShader::record_barrier(CommandBuffer &command_buffer) const
+{
+    VkMemoryBarrier2 barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    barrier.dstStageMask = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+    barrier.dstAccessMask = VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+
+    VkDependencyInfo dependency_info{};
+    dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+    dependency_info.memoryBarrierCount = 1;
+    dependency_info.pMemoryBarriers = &barrier;
+    vkCmdPipelineBarrier2(command_buffer.get_handle(), &dependency_info);
+}
+
+void ClusterCullShader::draw(CommandBuffer &command_buffer, const CulledDraw &culled_draw)
+{
+    vkCmdBindVertexBuffers(command_buffer.get_handle(), 0, 1, &culled_draw.vertex_buffer, &culled_draw.vertex_offset);
+    vkCmdBindIndexBuffer(command_buffer.get_handle(), culled_draw.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdDrawIndexedIndirect(command_buffer.get_handle(), culled_draw.indirect_buffer, culled_draw.indirect_offset, 1,
+                             sizeof(VkDrawIndexedIndirectCommand));
+}
+
+} // namespace flwfrg::vk::shader
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "vulkan/buffer.hpp"
+#include "vulkan/device.hpp"
+#include "vulkan/resource/model_manager.hpp"
+#include "vulkan/shader/pipeline.hpp"
+#include "vulkan/shader/shader_stage.hpp"
+
+namespace flwfrg::vk
+{
+class DisplayContext;
+}
+
+namespace flwfrg::vk::shader
+{
+
+/// Culls the meshlets of models against the view frustum and their normal cones in a compute pass, and writes the
+/// triangles of the visible ones into a compacted index buffer drawn with vkCmdDrawIndexedIndirect. Works on plain
+/// compute and indirect draws, so it needs no mesh shader support.
+///
+/// The culling is recorded outside of rendering, before the draws. Both wait for it either through record_barrier
+/// or through a render graph pass writing get_index_buffer and get_indirect_buffer as storage buffers.
+class ClusterCullShader
+{
+public:
+    // A culled model. Drawn with the vertex buffer at binding 0, the 32 bit index buffer and
+    // vkCmdDrawIndexedIndirect(indirect_buffer, indirect_offset, 1, 0), see draw.
+    struct CulledDraw
+    {
+        VkBuffer vertex_buffer;
+        uint64_t vertex_offset = 0;
+        VkBuffer index_buffer;
+        VkBuffer indirect_buffer;
+        uint64_t indirect_offset = 0;
+        VertexFormat vertex_format = VertexFormat::FULL;
+        ColorModelManager::GeometryRenderData render_data{};
+    };
+
+public:
+    ClusterCullShader() = default;
+    explicit ClusterCullShader(DisplayContext *context);
+    ~ClusterCullShader() = default;
+
+    // Copy
+    ClusterCullShader(const ClusterCullShader &) = delete;
+    ClusterCullShader &operator=(const ClusterCullShader &) = delete;
+    // Move
+    ClusterCullShader(ClusterCullShader &&other) noexcept = default;
+    ClusterCullShader &operator=(ClusterCullShader &&other) noexcept = default;
+
+    // Methods
+
+    /// Makes room for culling models with up to index_count indices and draw_count draws in total every frame. The
+    /// buffers are recreated, so call it before recording a frame rather than in the middle of one.
+    void reserve(uint32_t index_count, uint32_t draw_count);
+
+    /// Starts culling the current frame, reusing the frame's part of the output buffers
+    void begin_frame();
+    /// Records the culling of a model's clusters into the current frame's command buffer.
+    [[nodiscard]] CulledDraw cull(const ColorModelManager::ClusterRenderInfo &info, const glm::mat4 &projection,
+                                  const glm::mat4 &view);
+    [[nodiscard]] CulledDraw cull(CommandBuffer &command_buffer, const ColorModelManager::ClusterRenderInfo &info,
+                                  const glm::mat4 &projection, const glm::mat4 &view);
+    /// Makes the culled indices and draws visible to the index fetch and indirect draws recorded after it
+    void record_barrier(CommandBuffer &command_buffer) const;
+
+    /// Binds the buffers of a culled draw and records it. The pipeline and object state are bound by the caller,
+    /// e.g. with DebugShader::use and update_object.
+    static void draw(CommandBuffer &command_buffer, const CulledDraw &culled_draw);
+
+    [[nodiscard]] inline VkBuffer get_index_buffer() const { return index_buffer_.get_handle(); };
+    [[nodiscard]] inline VkBuffer get_indirect_buffer() const { return indirect_buffer_.get_handle(); };
+
+    static inline PhysicalDeviceRequirements get_minimum_requirements()
+    {
+        return PhysicalDeviceRequirements{
+            .graphics = true,
+            .present = true,
+            .compute = true,
+            .transfer = true,
+            .device_extension_names = {VK_KHR_SWAPCHAIN_EXTENSION_NAME},
+        };
+    }
+
+private:
+    DisplayContext *context_ = nullptr;
+
+    ShaderStage stage_{};
+    Pipeline pipeline_{};
+    // Owned by the display context's layout cache
+    VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
+
+    // Every frame in flight has its own part of both buffers
+    uint32_t index_capacity_ = 0;
+    uint32_t draw_capacity_ = 0;
+    Buffer index_buffer_{};
+    Buffer indirect_buffer_{};
+
+    // Used so far by the current frame
+    uint32_t frame_index_count_ = 0;
+    uint32_t frame_draw_count_ = 0;
+
+    struct PushConstants
+    {
+        glm::vec4 frustum_planes[6];
+        glm::vec4 camera_position;
+        uint32_t cluster_count;
+        uint32_t draw_index;
+        uint32_t first_index;
+        uint32_t padding;
+    };
+
+    // Static members
+
+    static constexpr const char *shader_file_name = "default_cluster_cull";
+    // Threads per workgroup in default_cluster_cull.comp, one per triangle of a cluster
+    static constexpr uint32_t workgroup_size = 128;
+    static_assert(meshlet_max_triangles <= workgroup_size);
+};
+
+} // namespace flwfrg::vk::shader
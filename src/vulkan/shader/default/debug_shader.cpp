@@ -4,11 +4,12 @@
 
 #include "vulkan/display_context.hpp"
 #include "vulkan/shader/vertex.hpp"
+#include "vulkan/util/constants.hpp"
 
 namespace flwfrg::vk::shader
 {
 
-DebugShader::DebugShader(DisplayContext *context) : context_{context}
+DebugShader::DebugShader(DisplayContext *context, std::optional<RenderTarget> render_target) : context_{context}
 {
     assert(context_ != nullptr);
 
@@ -41,20 +42,7 @@ DebugShader::DebugShader(DisplayContext *context) : context_{context}
     global_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     global_layout_info.bindingCount = 1;
     global_layout_info.pBindings = &global_ubo_layout_binding;
-    global_descriptor_set_layout_ = DescriptorSetLayout(&context_->get_device(), global_layout_info);
-
-    // Global descriptor pool
-    VkDescriptorPoolSize global_pool_size{};
-    global_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    global_pool_size.descriptorCount = context_->get_swapchain().get_image_count();
-
-    VkDescriptorPoolCreateInfo global_pool_info{};
-    global_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    global_pool_info.poolSizeCount = 1;
-    global_pool_info.pPoolSizes = &global_pool_size;
-    global_pool_info.maxSets = context_->get_swapchain().get_image_count();
-
-    global_descriptor_pool_ = DescriptorPool(&context_->get_device(), global_pool_info);
+    global_descriptor_set_layout_ = context_->get_descriptor_layout_cache().get_layout(global_layout_info);
 
     // Pipeline creation
     VkViewport viewport{};
@@ -69,34 +57,96 @@ DebugShader::DebugShader(DisplayContext *context) : context_{context}
     scissor.offset = {0, 0};
     scissor.extent = {context_->get_window()->get_width(), context_->get_window()->get_height()};
 
-    // Attributes
-    auto binding_description = ColorVertex::get_binding_description();
-
     // Descriptor set layouts
     // TODO: Change this to not be vector
     std::vector<VkDescriptorSetLayout> descriptor_set_layouts{
-            global_descriptor_set_layout_.handle(),
+            global_descriptor_set_layout_,
     };
 
+    // Instanced variants read the model matrix from the instance buffer instead of a push constant
+    instanced_stage_ = create_stage(instanced_shader_file_name, VK_SHADER_STAGE_VERTEX_BIT);
 
-    // Stages
-    std::vector<VkPipelineShaderStageCreateInfo> stage_create_infos{};
-    stage_create_infos.resize(shader_stage_count);
-    for (uint16_t i = 0; i < shader_stage_count; i++)
+    Pipeline::PipelineConfig pipeline_config{};
+    if (render_target.has_value())
     {
-        stage_create_infos[i] = stages_[i].get_shader_stage_create_info();
+        pipeline_config.p_color_formats = &render_target->color_formats;
+        pipeline_config.depth_format = render_target->depth_format;
+        depth_prepass_ = render_target->depth_prepass;
+    }
+    else
+    {
+        pipeline_config.p_renderpass = &context_->get_main_render_pass();
+        depth_prepass_ = context_->get_main_render_pass().has_depth_prepass();
     }
-
-    Pipeline::PipelineConfig pipeline_config{};
-    pipeline_config.p_renderpass = &context_->get_main_render_pass();
-    pipeline_config.p_attributes = &binding_description;
     pipeline_config.p_descriptor_set_layouts = &descriptor_set_layouts; // TODO: also needs changing here
-    pipeline_config.p_stages = &stage_create_infos;
     pipeline_config.viewport = viewport;
     pipeline_config.scissor = scissor;
-    pipeline_config.vertex_stride = sizeof(ColorVertex);
 
-    // Create the pipelines
+    // Depth prepass, positions only and no fragment stage
+    if (depth_prepass_)
+    {
+        depth_prepass_stage_ = create_stage(depth_prepass_shader_file_name, VK_SHADER_STAGE_VERTEX_BIT);
+        depth_prepass_instanced_stage_ =
+                create_stage(depth_prepass_instanced_shader_file_name, VK_SHADER_STAGE_VERTEX_BIT);
+    }
+
+    // Create the pipelines, for every vertex format with and without instancing
+    for (uint32_t format = 0; format < vertex_format_count; format++)
+    {
+        pipelines_[format] = create_pipeline_set(pipeline_config, static_cast<VertexFormat>(format), false);
+        instanced_pipelines_[format] = create_pipeline_set(pipeline_config, static_cast<VertexFormat>(format), true);
+    }
+
+    // Create global uniform buffer
+    global_uniform_buffer_ = Buffer(
+            &context_->get_device(), sizeof(GlobalUniformObject) * constant::max_frames_in_flight,
+            static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            true);
+}
+
+ShaderStage DebugShader::create_stage(const char *file_name, VkShaderStageFlagBits stage_type) const
+{
+    auto stage = ShaderStage::create_shader_module(&context_->get_device(), file_name, stage_type);
+    if (!stage.has_value())
+    {
+        throw std::runtime_error("Failed to create shader stage");
+    }
+
+    return std::move(stage.value());
+}
+
+DebugShader::PipelineSet DebugShader::create_pipeline_set(Pipeline::PipelineConfig pipeline_config,
+                                                          VertexFormat vertex_format, bool instanced) const
+{
+    // Attributes
+    auto binding_description = vertex_format == VertexFormat::COMPACT ? CompactColorVertex::get_binding_description()
+                                                                      : ColorVertex::get_binding_description();
+    pipeline_config.vertex_stride =
+            vertex_format == VertexFormat::COMPACT ? sizeof(CompactColorVertex) : sizeof(ColorVertex);
+
+    // Positions come first, and are all the depth prepass reads
+    std::vector<VkVertexInputAttributeDescription> position_attributes{binding_description.front()};
+    if (instanced)
+    {
+        auto instance_attributes =
+                InstanceData::get_binding_description(static_cast<uint32_t>(binding_description.size()));
+        binding_description.insert(binding_description.end(), instance_attributes.begin(), instance_attributes.end());
+        position_attributes.insert(position_attributes.end(), instance_attributes.begin(), instance_attributes.end());
+        pipeline_config.instance_stride = sizeof(InstanceData);
+    }
+
+    // Stages
+    std::vector<VkPipelineShaderStageCreateInfo> stage_create_infos{
+            (instanced ? instanced_stage_ : stages_[0]).get_shader_stage_create_info(),
+            stages_[1].get_shader_stage_create_info(),
+    };
+
+    pipeline_config.p_attributes = &binding_description;
+    pipeline_config.p_stages = &stage_create_infos;
+
+    PipelineSet pipeline_set{};
 
     // Wireframe
     auto created_pipeline = Pipeline::create_pipeline(&context_->get_device(), pipeline_config, true);
@@ -107,9 +157,15 @@ DebugShader::DebugShader(DisplayContext *context) : context_{context}
         throw std::runtime_error("Failed to create pipeline");
     }
 
-    pipeline_wire_frame_ = std::move(created_pipeline.value());
+    pipeline_set.wire_frame = std::move(created_pipeline.value());
 
-    // Solid
+    // Solid. After a depth prepass only the front most fragment of each pixel passes, and depth is already final.
+    // Wireframe lines do not rasterize to the same depth as the triangles, so the wireframe pipeline tests normally.
+    if (depth_prepass_)
+    {
+        pipeline_config.depth_compare_op = VK_COMPARE_OP_EQUAL;
+        pipeline_config.depth_write = false;
+    }
     created_pipeline = Pipeline::create_pipeline(&context_->get_device(), pipeline_config, false);
 
     // Check that it was created
@@ -118,42 +174,57 @@ DebugShader::DebugShader(DisplayContext *context) : context_{context}
         throw std::runtime_error("Failed to create solid pipeline");
     }
 
-    pipeline_solid_ = std::move(created_pipeline.value());
+    pipeline_set.solid = std::move(created_pipeline.value());
 
-    // Create global uniform buffer
-    global_uniform_buffer_ = Buffer(
-            &context_->get_device(), sizeof(GlobalUniformObject) * 3,
-            static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT),
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            true);
-
-    // Allocate global descriptor sets
-    std::vector<VkDescriptorSetLayout> global_layouts = {global_descriptor_set_layout_.handle(),
-                                                         global_descriptor_set_layout_.handle(),
-                                                         global_descriptor_set_layout_.handle()};
-
-    VkDescriptorSetAllocateInfo allocate_info{};
-    allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocate_info.descriptorPool = global_descriptor_pool_.handle();
-    allocate_info.descriptorSetCount = global_layouts.size();
-    allocate_info.pSetLayouts = global_layouts.data();
-    // Allocate it
-    if (vkAllocateDescriptorSets(context_->get_device().get_logical_device(), &allocate_info,
-                                 global_descriptor_sets_.data()) != VK_SUCCESS)
+    if (depth_prepass_)
     {
-        throw std::runtime_error("Failed to allocate descriptor sets");
+        std::vector<VkPipelineShaderStageCreateInfo> prepass_stage_create_infos{
+                (instanced ? depth_prepass_instanced_stage_ : depth_prepass_stage_).get_shader_stage_create_info()};
+
+        Pipeline::PipelineConfig prepass_config = pipeline_config;
+        prepass_config.p_attributes = &position_attributes;
+        prepass_config.p_stages = &prepass_stage_create_infos;
+        prepass_config.depth_compare_op = VK_COMPARE_OP_LESS;
+        prepass_config.depth_write = true;
+        prepass_config.depth_only = true;
+        if (prepass_config.p_renderpass != nullptr)
+            prepass_config.subpass = RenderPass::depth_prepass_subpass;
+
+        created_pipeline = Pipeline::create_pipeline(&context_->get_device(), prepass_config, false);
+        if (!created_pipeline.has_value())
+        {
+            throw std::runtime_error("Failed to create depth prepass pipeline");
+        }
+
+        pipeline_set.depth_prepass = std::move(created_pipeline.value());
     }
+
+    return pipeline_set;
 }
 
 void DebugShader::update_global_state(glm::mat4 projection, glm::mat4 view)
 {
-    CommandBuffer &command_buffer = context_->get_command_buffer();
-    auto current_frame = context_->get_current_frame();
-    //auto image_index = context_->get_image_index();
-    VkDescriptorSet global_descriptor = global_descriptor_sets_[current_frame];
+    prepare_global_state(projection, view);
 
     use();
+    bind_global_state(context_->get_command_buffer());
+}
+
+void DebugShader::update_object(ColorModelManager::GeometryRenderData data)
+{
+    update_object(context_->get_command_buffer(), data);
+}
+
+void DebugShader::use(VertexFormat vertex_format)
+{
+    use(context_->get_command_buffer(), vertex_format);
+}
+
+void DebugShader::prepare_global_state(glm::mat4 projection, glm::mat4 view)
+{
+    auto current_frame = context_->get_current_frame();
+    // Transient set, recycled in bulk once the frame has finished on the GPU
+    global_descriptor_set_ = context_->get_frame_descriptor_allocator().allocate(global_descriptor_set_layout_);
 
     global_ubo.projection = projection;
     global_ubo.view = view;
@@ -175,7 +246,7 @@ void DebugShader::update_global_state(glm::mat4 projection, glm::mat4 view)
     // Global ubo
     VkWriteDescriptorSet ubo_descriptor_write{};
     ubo_descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    ubo_descriptor_write.dstSet = global_descriptor;
+    ubo_descriptor_write.dstSet = global_descriptor_set_;
     ubo_descriptor_write.dstBinding = 0;
     ubo_descriptor_write.dstArrayElement = 0;
     ubo_descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -183,43 +254,87 @@ void DebugShader::update_global_state(glm::mat4 projection, glm::mat4 view)
     ubo_descriptor_write.pBufferInfo = &buffer_info;
 
     vkUpdateDescriptorSets(context_->get_device().get_logical_device(), 1, &ubo_descriptor_write, 0, nullptr);
-    global_descriptor_updated_[current_frame] = true;
+}
 
-    // Bind descriptor set
-    if (using_wire_frame_)
-    {
-        vkCmdBindDescriptorSets(command_buffer.get_handle(), VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                pipeline_wire_frame_.layout(), 0, 1, &global_descriptor, 0, nullptr);
-    } else
-    {
-        vkCmdBindDescriptorSets(command_buffer.get_handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_solid_.layout(),
-                                0, 1, &global_descriptor, 0, nullptr);
-    }
+void DebugShader::bind_global_state(CommandBuffer &command_buffer) const
+{
+    assert(global_descriptor_set_ != VK_NULL_HANDLE);
+
+    vkCmdBindDescriptorSets(command_buffer.get_handle(), VK_PIPELINE_BIND_POINT_GRAPHICS, current_pipeline().layout(),
+                            0, 1, &global_descriptor_set_, 0, nullptr);
 }
 
-void DebugShader::update_object(ColorModelManager::GeometryRenderData data)
+void DebugShader::update_object(CommandBuffer &command_buffer, ColorModelManager::GeometryRenderData data) const
 {
-    CommandBuffer &command_buffer = context_->get_command_buffer();
-    if (using_wire_frame_)
-    {
-        vkCmdPushConstants(command_buffer.get_handle(), pipeline_wire_frame_.layout(), VK_SHADER_STAGE_VERTEX_BIT, 0,
-                           sizeof(glm::mat4), &data.model);
-    } else
-    {
-        vkCmdPushConstants(command_buffer.get_handle(), pipeline_solid_.layout(), VK_SHADER_STAGE_VERTEX_BIT, 0,
-                           sizeof(glm::mat4), &data.model);
-    }
+    vkCmdPushConstants(command_buffer.get_handle(), current_pipeline().layout(), VK_SHADER_STAGE_VERTEX_BIT, 0,
+                       sizeof(glm::mat4), &data.model);
 }
 
-void DebugShader::use()
+void DebugShader::use(CommandBuffer &command_buffer, VertexFormat vertex_format) const
 {
-    if (using_wire_frame_)
-    {
-        pipeline_wire_frame_.bind(context_->get_command_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS);
-    }
-    else
+    select_pipeline(vertex_format, false).bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+}
+
+void DebugShader::use_instanced(VertexFormat vertex_format)
+{
+    use_instanced(context_->get_command_buffer(), vertex_format);
+}
+
+void DebugShader::use_instanced(CommandBuffer &command_buffer, VertexFormat vertex_format) const
+{
+    select_pipeline(vertex_format, true).bind(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS);
+}
+
+void DebugShader::use_depth_prepass(VertexFormat vertex_format)
+{
+    use_depth_prepass(context_->get_command_buffer(), vertex_format);
+}
+
+void DebugShader::use_depth_prepass(CommandBuffer &command_buffer, VertexFormat vertex_format) const
+{
+    assert(depth_prepass_);
+
+    // Same layout as the color pipelines, so the global state and objects are bound the same way
+    pipelines_[static_cast<uint32_t>(vertex_format)].depth_prepass.bind(command_buffer,
+                                                                         VK_PIPELINE_BIND_POINT_GRAPHICS);
+}
+
+void DebugShader::use_depth_prepass_instanced(VertexFormat vertex_format)
+{
+    use_depth_prepass_instanced(context_->get_command_buffer(), vertex_format);
+}
+
+void DebugShader::use_depth_prepass_instanced(CommandBuffer &command_buffer, VertexFormat vertex_format) const
+{
+    assert(depth_prepass_);
+
+    instanced_pipelines_[static_cast<uint32_t>(vertex_format)].depth_prepass.bind(command_buffer,
+                                                                                   VK_PIPELINE_BIND_POINT_GRAPHICS);
+}
+
+void DebugShader::draw_instances(CommandBuffer &command_buffer,
+                                 const std::vector<ColorModelManager::InstancedRenderInfo> &draws,
+                                 bool depth_prepass) const
+{
+    std::optional<VertexFormat> bound_format{};
+    for (const auto &draw: draws)
     {
-        pipeline_solid_.bind(context_->get_command_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS);
+        // Draws come grouped by format, so this binds each format's pipeline once
+        if (bound_format != draw.vertex_format)
+        {
+            if (depth_prepass)
+                use_depth_prepass_instanced(command_buffer, draw.vertex_format);
+            else
+                use_instanced(command_buffer, draw.vertex_format);
+            bound_format = draw.vertex_format;
+        }
+
+        VkBuffer buffers[2] = {draw.vertex_buffer, draw.instance_buffer};
+        VkDeviceSize offsets[2] = {draw.vertex_offset, draw.instance_offset};
+        vkCmdBindVertexBuffers(command_buffer.get_handle(), 0, 2, buffers, offsets);
+        vkCmdBindIndexBuffer(command_buffer.get_handle(), draw.index_buffer, draw.index_offset, draw.index_type);
+        vkCmdDrawIndexed(command_buffer.get_handle(), draw.index_count, draw.instance_count, 0, 0,
+                         draw.first_instance);
     }
 }
 
@@ -7,6 +7,9 @@
 #include "vulkan/shader/pipeline.hpp"
 #include "vulkan/shader/shader_stage.hpp"
 
+#include <array>
+#include <optional>
+
 namespace flwfrg::vk
 {
 class DisplayContext;
@@ -17,9 +20,19 @@ namespace flwfrg::vk::shader
 
 class DebugShader
 {
+public:
+    // Attachments of a render graph pass the shader draws in, instead of the main render pass
+    struct RenderTarget
+    {
+        std::vector<VkFormat> color_formats{};
+        VkFormat depth_format = VK_FORMAT_UNDEFINED;
+        // The pass is preceded by a depth prepass drawn with use_depth_prepass, see RenderPassConfig::depth_prepass
+        bool depth_prepass = false;
+    };
+
 public:
     DebugShader() = default;
-    explicit DebugShader(DisplayContext *context);
+    explicit DebugShader(DisplayContext *context, std::optional<RenderTarget> render_target = std::nullopt);
     ~DebugShader() = default;
 
     // Copy
@@ -33,11 +46,40 @@ public:
     void update_global_state(glm::mat4 projection, glm::mat4 view);
     void update_object(ColorModelManager::GeometryRenderData data);
 
-    void use();
+    // Meshes registered with a compact vertex format are drawn with that format's pipelines
+    void use(VertexFormat vertex_format = VertexFormat::FULL);
+
+    // For recording into secondary command buffers. prepare_global_state writes the frame's global state without
+    // recording anything, after which any number of threads may bind it with bind_global_state.
+    void prepare_global_state(glm::mat4 projection, glm::mat4 view);
+    void bind_global_state(CommandBuffer &command_buffer) const;
+    void update_object(CommandBuffer &command_buffer, ColorModelManager::GeometryRenderData data) const;
+    void use(CommandBuffer &command_buffer, VertexFormat vertex_format = VertexFormat::FULL) const;
 
     inline void use_wire_frame(bool value) { using_wire_frame_ = value; };
     inline bool using_wire_frame() const { return using_wire_frame_; }
 
+    // Set up for the main render pass's depth prepass, or a render target preceded by one. Geometry is then drawn
+    // twice, first with use_depth_prepass in the prepass and then as usual in the color pass.
+    [[nodiscard]] inline bool has_depth_prepass() const { return depth_prepass_; };
+    // Only the solid pipeline tests against the prepass, wireframe draws can skip it
+    [[nodiscard]] inline bool uses_depth_prepass() const { return depth_prepass_ && !using_wire_frame_; };
+    void use_depth_prepass(VertexFormat vertex_format = VertexFormat::FULL);
+    void use_depth_prepass(CommandBuffer &command_buffer, VertexFormat vertex_format = VertexFormat::FULL) const;
+
+    // Instanced drawing, with the model matrices in ColorModelManager's instance buffer. Binds the same global state
+    // as the other pipelines, but takes no object push constant.
+    void use_instanced(VertexFormat vertex_format = VertexFormat::FULL);
+    void use_instanced(CommandBuffer &command_buffer, VertexFormat vertex_format = VertexFormat::FULL) const;
+    void use_depth_prepass_instanced(VertexFormat vertex_format = VertexFormat::FULL);
+    void use_depth_prepass_instanced(CommandBuffer &command_buffer,
+                                     VertexFormat vertex_format = VertexFormat::FULL) const;
+    // Records one draw per mesh, as returned by ColorModelManager::update_instances, binding the instanced pipeline
+    // of each vertex format it draws. With depth_prepass set it binds the depth prepass pipelines instead.
+    void draw_instances(CommandBuffer &command_buffer,
+                        const std::vector<ColorModelManager::InstancedRenderInfo> &draws,
+                        bool depth_prepass = false) const;
+
     static inline PhysicalDeviceRequirements get_minimum_requirements()
     {
         VkPhysicalDeviceFeatures features{};
@@ -56,25 +98,55 @@ private:
 
     std::vector<ShaderStage> stages_{};
 
-    DescriptorPool global_descriptor_pool_{};
-    DescriptorSetLayout global_descriptor_set_layout_{};
-
-    // One set per frame (max 3)
-    std::array<VkDescriptorSet, 3> global_descriptor_sets_{};
-    std::array<bool, 3> global_descriptor_updated_{};
+    // Owned by the display context's layout cache. Global sets are allocated per frame.
+    VkDescriptorSetLayout global_descriptor_set_layout_ = VK_NULL_HANDLE;
+    VkDescriptorSet global_descriptor_set_ = VK_NULL_HANDLE;
 
     // Global uniform buffer
     GlobalUniformObject global_ubo{};
     Buffer global_uniform_buffer_{};
 
+    // The pipelines drawing one vertex format
+    struct PipelineSet
+    {
+        Pipeline wire_frame{};
+        Pipeline solid{};
+        // Only created with a depth prepass
+        Pipeline depth_prepass{};
+    };
+
     bool using_wire_frame_ = true;
-    Pipeline pipeline_wire_frame_{};
-    Pipeline pipeline_solid_{};
+    bool depth_prepass_ = false;
+    ShaderStage instanced_stage_{};
+    ShaderStage depth_prepass_stage_{};
+    ShaderStage depth_prepass_instanced_stage_{};
+
+    // Indexed by vertex format. Every pipeline shares one layout.
+    std::array<PipelineSet, vertex_format_count> pipelines_{};
+    std::array<PipelineSet, vertex_format_count> instanced_pipelines_{};
+
+    [[nodiscard]] inline const Pipeline &select_pipeline(VertexFormat vertex_format, bool instanced) const
+    {
+        const PipelineSet &pipeline_set =
+                (instanced ? instanced_pipelines_ : pipelines_)[static_cast<uint32_t>(vertex_format)];
+        return using_wire_frame_ ? pipeline_set.wire_frame : pipeline_set.solid;
+    }
+    [[nodiscard]] inline const Pipeline &current_pipeline() const
+    {
+        return select_pipeline(VertexFormat::FULL, false);
+    }
+
+    [[nodiscard]] ShaderStage create_stage(const char *file_name, VkShaderStageFlagBits stage_type) const;
+    [[nodiscard]] PipelineSet create_pipeline_set(Pipeline::PipelineConfig pipeline_config, VertexFormat vertex_format,
+                                                  bool instanced) const;
 
     // Static members
 
     static constexpr uint16_t shader_stage_count = 2;
     static constexpr const char *shader_file_name = "default_debug_shader";
+    static constexpr const char *depth_prepass_shader_file_name = "default_depth_prepass";
+    static constexpr const char *instanced_shader_file_name = "default_debug_shader_instanced";
+    static constexpr const char *depth_prepass_instanced_shader_file_name = "default_depth_prepass_instanced";
 };
 
 } // namespace flwfrg::vk::shader
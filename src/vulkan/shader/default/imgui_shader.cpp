@@ -82,7 +82,7 @@ IMGuiShader::IMGuiShader(DisplayContext *context, Config config) : display_conte
     init_info.Queue = context->get_device().get_graphics_queue();
     init_info.PipelineCache = VK_NULL_HANDLE;
     init_info.DescriptorPool = descriptor_pool_.handle();
-    init_info.Subpass = 0;
+    init_info.Subpass = context->get_main_render_pass().get_color_subpass();
     init_info.MinImageCount = context->get_swapchain().get_image_count();
     init_info.ImageCount = context->get_swapchain().get_image_count();
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
@@ -95,7 +95,8 @@ IMGuiShader::IMGuiShader(DisplayContext *context, Config config) : display_conte
     if (config.enable_docking)
         ImGui::GetIO().ConfigFlags |= ImGuiConfigFlags_DockingEnable;
 }
-IMGuiShader::~IMGuiShader() { vkDeviceWaitIdle(display_context_->get_device().get_logical_device()); }
+// Also releases deferred ImGui texture descriptors while the backend is still alive
+IMGuiShader::~IMGuiShader() { display_context_->get_device().wait_idle(); }
 
 ImGuiContext *IMGuiShader::get_context() const
 {
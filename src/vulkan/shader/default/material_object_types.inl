@@ -4,6 +4,8 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 #include <glm/glm.hpp>
+#include "vulkan/util/constants.hpp"
+
 #include <glm/gtc/constants.hpp>
 #include <vulkan/vulkan.h>
 
@@ -20,7 +22,8 @@ namespace flwfrg::vk::shader
 
 struct DescriptorState
 {
-	std::array<uint32_t, 3> generations{};
+	// One per frame in flight
+	std::array<uint32_t, constant::max_frames_in_flight> generations{};
 };
 
 #define VULKAN_MATERIAL_SHADER_DESCRIPTOR_COUNT 2
@@ -28,7 +31,8 @@ struct DescriptorState
 
 struct MaterialShaderObjectState
 {
-	std::array<VkDescriptorSet, 3> descriptor_sets{};
+	// One per frame in flight
+	std::array<VkDescriptorSet, constant::max_frames_in_flight> descriptor_sets{};
 
 	std::array<DescriptorState, VULKAN_MATERIAL_SHADER_DESCRIPTOR_COUNT> descriptor_states{};
 };
@@ -232,21 +232,7 @@ MaterialShader::MaterialShader(DisplayContext *context)
 	global_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	global_layout_info.bindingCount = 1;
 	global_layout_info.pBindings = &global_ubo_layout_binding;
-	global_descriptor_set_layout_ = DescriptorSetLayout(&context_->get_device(), global_layout_info);
-
-	// Global descriptor pool
-	VkDescriptorPoolSize global_pool_size{};
-	global_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	global_pool_size.descriptorCount = context_->get_swapchain().get_image_count();
-
-	VkDescriptorPoolCreateInfo global_pool_info{};
-	global_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	global_pool_info.poolSizeCount = 1;
-	global_pool_info.pPoolSizes = &global_pool_size;
-	global_pool_info.maxSets = context_->get_swapchain().get_image_count();
-	// global_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
-
-	global_descriptor_pool_ = DescriptorPool(&context_->get_device(), global_pool_info);
+	global_descriptor_set_layout_ = context_->get_descriptor_layout_cache().get_layout(global_layout_info);
 
 	// Local/object descriptors
 	const uint32_t local_sampler_count = 1;
@@ -269,21 +255,24 @@ MaterialShader::MaterialShader(DisplayContext *context)
 	layout_create_info.bindingCount = bindings.size();
 	layout_create_info.pBindings = bindings.data();
 
-	local_descriptor_set_layout_ = DescriptorSetLayout(&context_->get_device(), layout_create_info);
+	local_descriptor_set_layout_ = context_->get_descriptor_layout_cache().get_layout(layout_create_info);
 
-	// Local layout pool
+	// Local layout pool, every object has a set per frame in flight. The sets stay on this fixed pool instead of the
+	// growing DescriptorAllocator pools, since it is sized for all VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT objects
+	// of object_states_ and released objects free their sets back to it, so it cannot run out.
+	constexpr uint32_t local_set_count = VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT * constant::max_frames_in_flight;
 	std::array<VkDescriptorPoolSize, VULKAN_MATERIAL_SHADER_DESCRIPTOR_COUNT> local_pool_sizes{};
 	local_pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	local_pool_sizes[0].descriptorCount = VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT;
+	local_pool_sizes[0].descriptorCount = local_set_count;
 
 	local_pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	local_pool_sizes[1].descriptorCount = local_sampler_count * VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT;
+	local_pool_sizes[1].descriptorCount = local_sampler_count * local_set_count;
 
 	VkDescriptorPoolCreateInfo local_pool_info{};
 	local_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	local_pool_info.poolSizeCount = local_pool_sizes.size();
 	local_pool_info.pPoolSizes = local_pool_sizes.data();
-	local_pool_info.maxSets = VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT;
+	local_pool_info.maxSets = local_set_count;
 	local_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
 	// Create local/object descriptor pool
@@ -308,8 +297,8 @@ MaterialShader::MaterialShader(DisplayContext *context)
 	// Descriptor set layouts
 	// TODO: Change this to not be vector
 	std::vector<VkDescriptorSetLayout> descriptor_set_layouts {
-			global_descriptor_set_layout_.handle(),
-			local_descriptor_set_layout_.handle()
+			global_descriptor_set_layout_,
+			local_descriptor_set_layout_
 	};
 
 
@@ -345,29 +334,25 @@ MaterialShader::MaterialShader(DisplayContext *context)
 
 	pipeline_ = std::move(created_pipeline.value());
 
+	// Compact vertices, read by the same shaders
+	auto compact_binding_description = MaterialShader::CompactVertex::get_binding_description();
+	pipeline_config.p_attributes = &compact_binding_description;
+	pipeline_config.vertex_stride = sizeof(MaterialShader::CompactVertex);
+
+	created_pipeline = Pipeline::create_pipeline(&context_->get_device(), pipeline_config, false);
+	if (!created_pipeline.has_value())
+	{
+		throw std::runtime_error("Failed to create compact pipeline");
+	}
+
+	pipeline_compact_ = std::move(created_pipeline.value());
+
 	// Create global uniform buffer
-	global_uniform_buffer_ = Buffer(&context_->get_device(), sizeof(GlobalUniformObject) * 3,
+	global_uniform_buffer_ = Buffer(&context_->get_device(), sizeof(GlobalUniformObject) * constant::max_frames_in_flight,
 									static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT),
 									VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 									true);
 
-	// Allocate global descriptor sets
-	std::vector<VkDescriptorSetLayout> global_layouts = {
-			global_descriptor_set_layout_.handle(),
-			global_descriptor_set_layout_.handle(),
-			global_descriptor_set_layout_.handle()};
-
-	VkDescriptorSetAllocateInfo allocate_info{};
-	allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocate_info.descriptorPool = global_descriptor_pool_.handle();
-	allocate_info.descriptorSetCount = global_layouts.size();
-	allocate_info.pSetLayouts = global_layouts.data();
-	// Allocate it
-	if (vkAllocateDescriptorSets(context_->get_device().get_logical_device(), &allocate_info, global_descriptor_sets_.data()) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to allocate descriptor sets");
-	}
-
 	local_uniform_buffer_ = Buffer(&context_->get_device(),
 								   sizeof(LocalUniformObject) * VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT,
 								   static_cast<VkBufferUsageFlagBits>(VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT),
@@ -386,7 +371,8 @@ void MaterialShader::update_global_state(glm::mat4 projection, glm::mat4 view)
 	CommandBuffer &command_buffer = context_->get_command_buffer();
     auto current_frame = context_->get_current_frame();
 	//auto image_index = context_->get_image_index();
-    VkDescriptorSet global_descriptor = global_descriptor_sets_[current_frame];
+	// Transient set, recycled in bulk once the frame has finished on the GPU
+	VkDescriptorSet global_descriptor = context_->get_frame_descriptor_allocator().allocate(global_descriptor_set_layout_);
 
 	use();
 
@@ -420,7 +406,6 @@ void MaterialShader::update_global_state(glm::mat4 projection, glm::mat4 view)
 	vkUpdateDescriptorSets(context_->get_device().get_logical_device(),
 						   1, &ubo_descriptor_write,
 						   0, nullptr);
-    global_descriptor_updated_[current_frame] = true;
 
 	// Bind descriptor set
 	vkCmdBindDescriptorSets(command_buffer.get_handle(),
@@ -536,9 +521,11 @@ void MaterialShader::update_object(GeometryRenderData data)
 							nullptr);
 }
 
-void MaterialShader::use()
+void MaterialShader::use(VertexFormat vertex_format)
 {
-	pipeline_.bind(context_->get_command_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS);
+	// Both pipelines share a layout, so descriptors and push constants stay bound when switching
+	const Pipeline &pipeline = vertex_format == VertexFormat::COMPACT ? pipeline_compact_ : pipeline_;
+	pipeline.bind(context_->get_command_buffer(), VK_PIPELINE_BIND_POINT_GRAPHICS);
 }
 
 uint32_t MaterialShader::acquire_resources()
@@ -557,10 +544,8 @@ uint32_t MaterialShader::acquire_resources()
 	}
 
 	// Allocate descriptor sets
-	std::array<VkDescriptorSetLayout, 3> layouts = {
-		local_descriptor_set_layout_.handle(),
-		local_descriptor_set_layout_.handle(),
-		local_descriptor_set_layout_.handle()};
+	std::array<VkDescriptorSetLayout, constant::max_frames_in_flight> layouts{};
+	layouts.fill(local_descriptor_set_layout_);
 
 	VkDescriptorSetAllocateInfo alloc_info{};
 	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -581,16 +566,15 @@ void MaterialShader::release_resources(uint32_t object_id)
 {
 	MaterialShaderObjectState &object_state = object_states_[object_id];
 
-	vkDeviceWaitIdle(context_->get_device().get_logical_device());
-
-	// Free the descriptor sets of the object state and check the result
-	if (vkFreeDescriptorSets(context_->get_device().get_logical_device(),
-							 local_descriptor_pool_.handle(),
-							 object_state.descriptor_sets.size(),
-							 object_state.descriptor_sets.data()) != VK_SUCCESS)
-	{
-		throw std::runtime_error("Failed to free descriptor sets");
-	}
+	// Free the descriptor sets of the object state once no frame in flight can have them bound
+	context_->get_device().defer_destruction([device = context_->get_device().get_logical_device(),
+											  pool = local_descriptor_pool_.handle(),
+											  descriptor_sets = object_state.descriptor_sets]() {
+		if (vkFreeDescriptorSets(device, pool, static_cast<uint32_t>(descriptor_sets.size()), descriptor_sets.data()) != VK_SUCCESS)
+		{
+			FLOWFORGE_ERROR("Failed to free descriptor sets");
+		}
+	});
 
 	// set generations to an invalid state
 	for (DescriptorState &descriptor_state: object_state.descriptor_states)
@@ -7,6 +7,7 @@
 #include "vulkan/resource/texture.hpp"
 #include "vulkan/shader/pipeline.hpp"
 #include "vulkan/shader/shader_stage.hpp"
+#include "vulkan/shader/vertex.hpp"
 
 namespace flwfrg::vk
 {
@@ -36,6 +37,32 @@ public:
 		}
 	};
 
+	// Vertex in 12 instead of 32 bytes, drawn with use(VertexFormat::COMPACT). Positions are quantized over bounds
+	// whose QuantizationBounds::dequantization_matrix has to be part of the object's model matrix.
+	struct CompactVertex {
+		glm::u16vec4 position{0};
+		glm::u16vec2 texture_coordinate{0};
+
+		static inline CompactVertex from(const Vertex &vertex, const QuantizationBounds &bounds)
+		{
+			return CompactVertex{
+					.position = bounds.quantize(vertex.position),
+					.texture_coordinate = {glm::packHalf1x16(vertex.texture_coordinate.x),
+										   glm::packHalf1x16(vertex.texture_coordinate.y)},
+			};
+		}
+
+		static inline std::vector<VkVertexInputAttributeDescription> get_binding_description()
+		{
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+			attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactVertex, position)});
+			attributeDescriptions.push_back({1, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, texture_coordinate)});
+
+			return attributeDescriptions;
+		}
+	};
+
 public:
 	MaterialShader() = default;
 	explicit MaterialShader(DisplayContext* context);
@@ -58,7 +85,7 @@ public:
 
     [[nodiscoard]] VkDescriptorSet get_object_descriptor_set(uint32_t object_id, uint32_t image_index) const { return object_states_[object_id].descriptor_sets[image_index]; }
 
-	void use();
+	void use(VertexFormat vertex_format = VertexFormat::FULL);
 
 	[[nodiscard]] uint32_t acquire_resources();
 	void release_resources(uint32_t object_id);
@@ -68,14 +95,10 @@ private:
 
 	std::vector<ShaderStage> stages_{};
 
-	DescriptorPool global_descriptor_pool_{};
-	DescriptorSetLayout global_descriptor_set_layout_{};
+	// Layouts are owned by the display context's layout cache. Global sets are allocated per frame.
+	VkDescriptorSetLayout global_descriptor_set_layout_ = VK_NULL_HANDLE;
 	DescriptorPool local_descriptor_pool_{};
-	DescriptorSetLayout local_descriptor_set_layout_{};
-
-	// One set per frame (max 3)
-	std::array<VkDescriptorSet, 3> global_descriptor_sets_{};
-	std::array<bool, 3> global_descriptor_updated_{};
+	VkDescriptorSetLayout local_descriptor_set_layout_ = VK_NULL_HANDLE;
 
 	// Global uniform buffer
 	GlobalUniformObject global_ubo{};
@@ -88,6 +111,7 @@ private:
 	std::array<MaterialShaderObjectState, VULKAN_MATERIAL_SHADER_MAX_OBJECT_COUNT> object_states_{}; // Todo: Make dynamic later
 
 	Pipeline pipeline_{};
+	Pipeline pipeline_compact_{};
 
 	StaticTexture default_texture_;
 
@@ -6,6 +6,8 @@
 #include "vulkan/command_buffer.hpp"
 #include "vulkan/device.hpp"
 
+#include <array>
+
 namespace flwfrg::vk
 {
 
@@ -35,7 +37,7 @@ StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_pipeline(
 
 	assert(pipeline_config.p_attributes != nullptr);
 	assert(pipeline_config.p_stages != nullptr);
-	assert(pipeline_config.p_renderpass != nullptr);
+	assert((pipeline_config.p_renderpass != nullptr) != (pipeline_config.p_color_formats != nullptr));
 
 	Pipeline return_pipeline{};
 	return_pipeline.device_ = device;
@@ -76,8 +78,8 @@ StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_pipeline(
 	VkPipelineDepthStencilStateCreateInfo depth_stencil{};
 	depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depth_stencil.depthTestEnable = VK_TRUE;
-	depth_stencil.depthWriteEnable = VK_TRUE;
-	depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depth_stencil.depthWriteEnable = pipeline_config.depth_write ? VK_TRUE : VK_FALSE;
+	depth_stencil.depthCompareOp = pipeline_config.depth_compare_op;
 	depth_stencil.depthBoundsTestEnable = VK_FALSE;
 	depth_stencil.stencilTestEnable = VK_FALSE;
 
@@ -98,8 +100,15 @@ StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_pipeline(
 	color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	color_blending.logicOpEnable = VK_FALSE;
 	color_blending.logicOp = VK_LOGIC_OP_COPY;
-	color_blending.attachmentCount = 1;
-	color_blending.pAttachments = &color_blend_attachment;
+	// Depth only passes have no color attachments to blend into
+	size_t color_attachment_count = 1;
+	if (pipeline_config.depth_only)
+		color_attachment_count = 0;
+	else if (pipeline_config.p_color_formats)
+		color_attachment_count = pipeline_config.p_color_formats->size();
+	std::vector<VkPipelineColorBlendAttachmentState> color_blend_attachments(color_attachment_count, color_blend_attachment);
+	color_blending.attachmentCount = static_cast<uint32_t>(color_blend_attachments.size());
+	color_blending.pAttachments = color_blend_attachments.data();
 
 	// Dynamic state
 	std::array<VkDynamicState, 3> dynamic_states = {
@@ -114,16 +123,19 @@ StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_pipeline(
 	dynamic_state.pDynamicStates = dynamic_states.data();
 
 	// Vertex input
-	VkVertexInputBindingDescription vertex_binding_description{};
-	vertex_binding_description.binding = 0;
-	vertex_binding_description.stride = pipeline_config.vertex_stride;
-	vertex_binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	std::array<VkVertexInputBindingDescription, 2> vertex_binding_descriptions{};
+	vertex_binding_descriptions[0].binding = 0;
+	vertex_binding_descriptions[0].stride = pipeline_config.vertex_stride;
+	vertex_binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	vertex_binding_descriptions[1].binding = 1;
+	vertex_binding_descriptions[1].stride = pipeline_config.instance_stride;
+	vertex_binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
 	// Attributes
 	VkPipelineVertexInputStateCreateInfo vertex_input_info{};
 	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_info.vertexBindingDescriptionCount = 1;
-	vertex_input_info.pVertexBindingDescriptions = &vertex_binding_description;
+	vertex_input_info.vertexBindingDescriptionCount = pipeline_config.instance_stride > 0 ? 2 : 1;
+	vertex_input_info.pVertexBindingDescriptions = vertex_binding_descriptions.data();
 	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(pipeline_config.p_attributes->size());
 	vertex_input_info.pVertexAttributeDescriptions = pipeline_config.p_attributes->data();
 
@@ -192,8 +204,21 @@ StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_pipeline(
 
 	pipeline_info.layout = return_pipeline.pipeline_layout_;
 
-	pipeline_info.renderPass = pipeline_config.p_renderpass->handle();
-	pipeline_info.subpass = 0;
+	VkPipelineRenderingCreateInfo rendering_info{};
+	rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	if (pipeline_config.p_renderpass != nullptr)
+	{
+		pipeline_info.renderPass = pipeline_config.p_renderpass->handle();
+		pipeline_info.subpass = pipeline_config.subpass.value_or(pipeline_config.p_renderpass->get_color_subpass());
+	}
+	else
+	{
+		rendering_info.colorAttachmentCount = static_cast<uint32_t>(color_attachment_count);
+		rendering_info.pColorAttachmentFormats = pipeline_config.p_color_formats->data();
+		rendering_info.depthAttachmentFormat = pipeline_config.depth_format;
+		pipeline_info.pNext = &rendering_info;
+		pipeline_info.renderPass = VK_NULL_HANDLE;
+	}
 	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 	pipeline_info.basePipelineIndex = -1;
 
@@ -224,4 +249,86 @@ StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_pipeline(
 	return return_pipeline;
 }
 
+StatusOptional<Pipeline, Status, Status::SUCCESS> Pipeline::create_compute_pipeline(
+		Device *device,
+		const VkPipelineShaderStageCreateInfo &stage,
+		const std::vector<VkDescriptorSetLayout> &descriptor_set_layouts,
+		uint32_t push_constant_size)
+{
+	assert(device != nullptr);
+	assert(stage.stage == VK_SHADER_STAGE_COMPUTE_BIT);
+
+	Pipeline return_pipeline{};
+	return_pipeline.device_ = device;
+
+	// Pipeline layout
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
+	pipeline_layout_info.pSetLayouts = descriptor_set_layouts.data();
+
+	// Push constants
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = push_constant_size;
+	if (push_constant_size > 0)
+	{
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+	}
+
+	auto result = vkCreatePipelineLayout(
+			return_pipeline.device_->get_logical_device(),
+			&pipeline_layout_info,
+			nullptr,
+			return_pipeline.pipeline_layout_.ptr());
+	if (result != VK_SUCCESS)
+	{
+		FLOWFORGE_ERROR("Failed to create compute pipeline layout");
+		switch (result)
+		{
+			case VK_ERROR_OUT_OF_HOST_MEMORY:
+				return {Status::OUT_OF_HOST_MEMORY};
+			case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+				return {Status::OUT_OF_DEVICE_MEMORY};
+			default:
+				return {Status::UNKNOWN_ERROR};
+		}
+	}
+
+	// Create the pipeline
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage = stage;
+	pipeline_info.layout = return_pipeline.pipeline_layout_;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+	pipeline_info.basePipelineIndex = -1;
+
+	result = vkCreateComputePipelines(
+			return_pipeline.device_->get_logical_device(),
+			VK_NULL_HANDLE,
+			1,
+			&pipeline_info,
+			nullptr,
+			return_pipeline.handle_.ptr());
+	if (result != VK_SUCCESS)
+	{
+		FLOWFORGE_ERROR("Failed to create compute pipeline");
+		switch (result)
+		{
+			case VK_ERROR_OUT_OF_HOST_MEMORY:
+				return {Status::OUT_OF_HOST_MEMORY};
+			case VK_ERROR_OUT_OF_DEVICE_MEMORY:
+				return {Status::OUT_OF_DEVICE_MEMORY};
+			case VK_ERROR_INVALID_SHADER_NV:
+				return {Status::INVALID_SHADER};
+			default:
+				return {Status::UNKNOWN_ERROR};
+		}
+	}
+
+	return return_pipeline;
+}
+
 }// namespace flwfrg::vk
\ No newline at end of file
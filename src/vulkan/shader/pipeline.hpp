@@ -6,6 +6,8 @@
 #include "vulkan/render_pass.hpp"
 #include "vulkan/util/status_optional.hpp"
 
+#include <optional>
+
 namespace flwfrg::vk
 {
 class CommandBuffer;
@@ -22,6 +24,19 @@ public:
 		VkViewport viewport;
 		VkRect2D scissor;
 		uint32_t vertex_stride;
+		// Pipelines drawn inside dynamic rendering (render graph passes) leave p_renderpass null and
+		// describe their attachments here instead
+		const std::vector<VkFormat> *p_color_formats = nullptr;
+		VkFormat depth_format = VK_FORMAT_UNDEFINED;
+		// Subpass of p_renderpass, its color subpass when not set
+		std::optional<uint32_t> subpass{};
+		// A color pass after a depth prepass tests with VK_COMPARE_OP_EQUAL and leaves depth as the prepass wrote it
+		VkCompareOp depth_compare_op = VK_COMPARE_OP_LESS;
+		bool depth_write = true;
+		// Depth prepass pipelines write no color, and usually only have a vertex stage reading positions
+		bool depth_only = false;
+		// Instanced pipelines read per instance attributes from binding 1, which advances once per instance
+		uint32_t instance_stride = 0;
 	};
 
 public:
@@ -50,6 +65,13 @@ public:
 			PipelineConfig pipeline_config,
 			bool is_wireframe);
 
+	/// @param push_constant_size Bytes of push constants the stage reads, 0 for none
+	static StatusOptional<Pipeline, Status, Status::SUCCESS> create_compute_pipeline(
+			Device *device,
+			const VkPipelineShaderStageCreateInfo &stage,
+			const std::vector<VkDescriptorSetLayout> &descriptor_set_layouts,
+			uint32_t push_constant_size);
+
 private:
 	Device *device_ = nullptr;
 
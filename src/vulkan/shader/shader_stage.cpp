@@ -2,9 +2,10 @@
 
 #include "shader_stage.hpp"
 
+#include "io/file_reader.hpp"
 #include "vulkan/device.hpp"
 
-#include <fstream>
+#include <stdexcept>
 
 namespace flwfrg::vk
 {
@@ -28,7 +29,7 @@ StatusOptional<ShaderStage, Status, Status::SUCCESS> ShaderStage::create_shader_
 		file_name = "assets/shaders/" + name + get_shader_stage_file_extension(shader_stage_flag);
 	} catch (const std::runtime_error &e)
 	{
-		FLOWFORGE_ERROR(e.what());
+		FLOWFORGE_ERROR("Failed to find the shader file of {}: {}", name, e.what());
 		// FLOWFORGE_ERROR("Shader stage flag was {}", shader_stage_flag);
 		return Status::UNKNOWN_OR_INVALID_SHADER_STAGE;
 	}
@@ -37,27 +38,20 @@ StatusOptional<ShaderStage, Status, Status::SUCCESS> ShaderStage::create_shader_
 	return_stage.device_ = device;
 
 	// Read in the file
-	std::ifstream file(file_name, std::ios::ate | std::ios::binary);
-	if (!file.is_open())
+	FileContents file{};
+	try
+	{
+		file = io::read_file(file_name);
+	} catch (const std::runtime_error &e)
 	{
-		FLOWFORGE_ERROR("Failed to open file: {}", file_name);
+		// The message already names the file and why it could not be read
+		FLOWFORGE_ERROR("{}", e.what());
 		return Status::FLOWFORGE_FAILED_TO_OPEN_FILE;
 	}
 
-	std::vector<uint8_t> file_buffer;
-	// Read the entire file as binary
-	file.seekg(0, std::ios::end);
-	file_buffer.resize(file.tellg());
-	file.seekg(0);
-	file.read(reinterpret_cast<char *>(file_buffer.data()),
-			  static_cast<long>(file_buffer.size()));
-
 	// Set shader stage info
-	return_stage.create_info.codeSize = file_buffer.size();
-	return_stage.create_info.pCode = reinterpret_cast<const uint32_t *>(file_buffer.data());
-
-	// Close the file
-	file.close();
+	return_stage.create_info.codeSize = file.size;
+	return_stage.create_info.pCode = reinterpret_cast<const uint32_t *>(file.data.get());
 
 	// Create the shader module and check the result
 	auto result = vkCreateShaderModule(return_stage.device_->get_logical_device(), &return_stage.create_info, nullptr, return_stage.handle_.ptr());
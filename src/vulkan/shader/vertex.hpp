@@ -4,18 +4,81 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
 
 #include <vulkan/vulkan_core.h>
 
 namespace flwfrg::vk
 {
 
+// Vertex layout of a mesh. Compact vertices quantize positions to 16 bits over the bounds of their mesh and pack
+// colors and texture coordinates into 8 and 16 bits per channel, roughly a third of the size of the full layout.
+enum class VertexFormat
+{
+    FULL,
+    COMPACT
+};
+constexpr uint32_t vertex_format_count = 2;
+
+// Bounds compact positions are quantized over. Quantized positions are read as unsigned normalized values in
+// [0, 1], and the dequantization (min + position * extent) is folded into the mesh's model matrix, so the shaders
+// read both layouts the same way.
+struct QuantizationBounds
+{
+    glm::vec3 min{0};
+    glm::vec3 extent{1};
+
+    template<typename VertexType>
+    static inline QuantizationBounds from_vertices(const std::vector<VertexType> &vertices)
+    {
+        if (vertices.empty())
+            return {};
+
+        glm::vec3 min = vertices.front().position;
+        glm::vec3 max = vertices.front().position;
+        for (const auto &vertex: vertices)
+        {
+            min = glm::min(min, vertex.position);
+            max = glm::max(max, vertex.position);
+        }
+
+        // Flat meshes would divide by zero along their flat axis
+        glm::vec3 extent = max - min;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (extent[axis] <= 0.0f)
+                extent[axis] = 1.0f;
+        }
+
+        return QuantizationBounds{.min = min, .extent = extent};
+    }
+
+    [[nodiscard]] inline glm::u16vec4 quantize(glm::vec3 position) const
+    {
+        glm::vec3 normalized = glm::clamp((position - min) / extent, 0.0f, 1.0f);
+        return glm::u16vec4{glm::round(normalized * 65535.0f), 0};
+    }
+
+    [[nodiscard]] inline glm::mat4 dequantization_matrix() const
+    {
+        glm::mat4 matrix{1.0f};
+        matrix[0][0] = extent.x;
+        matrix[1][1] = extent.y;
+        matrix[2][2] = extent.z;
+        matrix[3] = glm::vec4{min, 1.0f};
+        return matrix;
+    }
+};
+
 struct ColorVertex
 {
 
     glm::vec3 position{0};
     alignas(sizeof(glm::vec4)) glm::vec4 color{1};
 
+    bool operator==(const ColorVertex &other) const = default;
+
     static inline std::vector<VkVertexInputAttributeDescription> get_binding_description()
     {
         std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
@@ -27,6 +90,53 @@ struct ColorVertex
     }
 };
 
+// ColorVertex in 12 instead of 32 bytes, for meshes registered with VertexFormat::COMPACT
+struct CompactColorVertex
+{
+    // The fourth component pads the position, three component 16 bit formats are rarely supported for vertices
+    glm::u16vec4 position{0};
+    uint32_t color = 0xffffffff;
+
+    static inline CompactColorVertex from(const ColorVertex &vertex, const QuantizationBounds &bounds)
+    {
+        return CompactColorVertex{
+                .position = bounds.quantize(vertex.position),
+                .color = glm::packUnorm4x8(vertex.color),
+        };
+    }
+
+    static inline std::vector<VkVertexInputAttributeDescription> get_binding_description()
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        attributeDescriptions.push_back({0, 0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(CompactColorVertex, position)});
+        attributeDescriptions.push_back({1, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactColorVertex, color)});
+
+        return attributeDescriptions;
+    }
+};
+
+// Per instance attributes of instanced draws, read from binding 1 which advances once per instance
+struct InstanceData
+{
+    glm::mat4 model{1.0f};
+
+    // A mat4 attribute takes four locations, one per column, starting after the vertex attributes
+    static inline std::vector<VkVertexInputAttributeDescription> get_binding_description(uint32_t first_location)
+    {
+        std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+
+        for (uint32_t column = 0; column < 4; column++)
+        {
+            attributeDescriptions.push_back({first_location + column, 1, VK_FORMAT_R32G32B32A32_SFLOAT,
+                                             static_cast<uint32_t>(offsetof(InstanceData, model) +
+                                                                   sizeof(glm::vec4) * column)});
+        }
+
+        return attributeDescriptions;
+    }
+};
+
 struct Vertex3d
 {
 	glm::vec3 position{0};
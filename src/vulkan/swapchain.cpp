@@ -5,14 +5,28 @@
 #include "command_buffer.hpp"
 #include "display_context.hpp"
 
+#include <algorithm>
+#include <limits>
+
 namespace flwfrg::vk
 {
 
 
-Swapchain::Swapchain(DisplayContext *context)
-	: context_{context}
+Swapchain::Swapchain(DisplayContext *context, PresentConfig config)
+	: context_{context}, present_config_{config}, max_frames_in_flight_{config.frames_in_flight}
 {
 	assert(context != nullptr);
+	if (config.frames_in_flight == 0 || config.frames_in_flight > constant::max_frames_in_flight)
+	{
+		throw std::runtime_error("Failed to create swapchain, frames in flight must be between 1 and " +
+								 std::to_string(constant::max_frames_in_flight));
+	}
+
+	// The device may have been picked for another window
+	if (!context_->device_.can_present_to(context_->surface_.handle()))
+	{
+		throw std::runtime_error("Failed to create swapchain, the device cannot present to the window surface");
+	}
 
 	FLOWFORGE_INFO("Creating new swapchain");
 	recreate_swapchain();
@@ -20,6 +34,13 @@ Swapchain::Swapchain(DisplayContext *context)
 
 Swapchain::~Swapchain()
 {
+	// The display context has drained the GPU by now, so nothing has to be deferred
+	for (auto &retired: retired_swapchains_)
+	{
+		vkDestroySwapchainKHR(context_->device_.get_logical_device(), retired.handle, nullptr);
+	}
+	retired_swapchains_.clear();
+
 	// Destroy the views
 	for (auto view: swapchain_image_views_)
 	{
@@ -45,11 +66,14 @@ Status Swapchain::acquire_next_image(uint64_t timeout_ns, VkSemaphore image_avai
 
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
-		// Trigger swapchain recreation, then boot out of the render loop.
-		recreate_swapchain();
-		context_->regenerate_frame_buffers();
+		// No image was acquired, the caller has to recreate the swapchain before trying again
+		needs_recreation_ = true;
 		return Status::OUT_OF_DATE_KHR;
-	} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+	} else if (result == VK_SUBOPTIMAL_KHR)
+	{
+		// The image is still usable, so finish this frame with it and recreate before the next one
+		needs_recreation_ = true;
+	} else if (result != VK_SUCCESS)
 	{
 		switch (result)
 		{
@@ -72,20 +96,74 @@ Status Swapchain::acquire_next_image(uint64_t timeout_ns, VkSemaphore image_avai
 }
 Status Swapchain::present(VkQueue graphics_queue, VkQueue present_queue, VkSemaphore render_complete_semaphore, uint32_t present_image_index)
 {
+	PresentRequest request{this, render_complete_semaphore, present_image_index};
+	return present(present_queue, {&request, 1}).front();
+}
+
+std::vector<Status> Swapchain::present(VkQueue present_queue, std::span<const PresentRequest> requests)
+{
+	if (requests.empty())
+		return {};
+
+	// Requests are expected to come from display contexts sharing one device
+	Device &device = requests.front().swapchain->context_->device_;
+
+	std::vector<VkSemaphore> wait_semaphores;
+	std::vector<VkSwapchainKHR> swapchains;
+	std::vector<uint32_t> image_indices;
+	std::vector<uint64_t> present_ids;
+	for (const auto &request: requests)
+	{
+		assert(&request.swapchain->context_->device_ == &device);
+		wait_semaphores.push_back(request.render_complete_semaphore);
+		swapchains.push_back(request.swapchain->swapchain_);
+		image_indices.push_back(request.image_index);
+		present_ids.push_back(request.swapchain->last_present_id_ + 1);
+	}
+	std::vector<VkResult> results(requests.size(), VK_SUCCESS);
+
 	VkPresentInfoKHR present_info{};
 	present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	present_info.waitSemaphoreCount = 1;
-	present_info.pWaitSemaphores = &render_complete_semaphore;
-	present_info.swapchainCount = 1;
-	present_info.pSwapchains = swapchain_.ptr();
-	present_info.pImageIndices = &present_image_index;
-	present_info.pResults = nullptr;
-
-	VkResult result = vkQueuePresentKHR(present_queue, &present_info);
+	present_info.waitSemaphoreCount = static_cast<uint32_t>(wait_semaphores.size());
+	present_info.pWaitSemaphores = wait_semaphores.data();
+	present_info.swapchainCount = static_cast<uint32_t>(swapchains.size());
+	present_info.pSwapchains = swapchains.data();
+	present_info.pImageIndices = image_indices.data();
+	present_info.pResults = results.data();
+
+	// Tag the presents so the time they reach the display can be waited on
+	VkPresentIdKHR present_id_info{};
+	bool use_present_ids = device.supports_present_wait();
+	if (use_present_ids)
+	{
+		present_id_info.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		present_id_info.swapchainCount = static_cast<uint32_t>(present_ids.size());
+		present_id_info.pPresentIds = present_ids.data();
+		present_info.pNext = &present_id_info;
+	}
+
+	// One call for every window, the individual outcomes are reported through pResults
+	vkQueuePresentKHR(present_queue, &present_info);
+
+	std::vector<Status> statuses;
+	statuses.reserve(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		statuses.push_back(requests[i].swapchain->finish_present(results[i], use_present_ids ? present_ids[i] : 0));
+	}
+	return statuses;
+}
+
+Status Swapchain::finish_present(VkResult result, uint64_t present_id)
+{
+	if (present_id != 0 && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR))
+		last_present_id_ = present_id;
+
 	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
 	{
-		recreate_swapchain();
-		context_->regenerate_frame_buffers();
+		// The semaphore wait still executes, so the frame counts as presented. Recreation happens before the next
+		// acquire, without waiting for the GPU.
+		needs_recreation_ = true;
 	} else if (result != VK_SUCCESS)
 	{
 		switch (result)
@@ -108,17 +186,30 @@ Status Swapchain::present(VkQueue graphics_queue, VkQueue present_queue, VkSemap
 	context_->current_frame_ = (context_->current_frame_ + 1) % max_frames_in_flight_;
 	context_->frame_counter++;
 
+	release_retired_swapchains();
+
 	return Status::SUCCESS;
 }
 
+bool Swapchain::wait_for_present(uint64_t present_id, uint64_t timeout_ns) const
+{
+	if (!context_->device_.supports_present_wait() || present_id == 0 || present_id > last_present_id_)
+		return false;
+
+	return context_->device_.wait_for_present(swapchain_, present_id, timeout_ns) == VK_SUCCESS;
+}
+
 void Swapchain::recreate_swapchain()
 {
 	FLOWFORGE_TRACE("Recreating swapchain");
 
-	vkDeviceWaitIdle(context_->device_.get_logical_device());
-
+	// No device idle here. Work still in flight keeps rendering to and presenting the old images, which are retired
+	// below and released once the GPU is done with them.
 	Handle<VkSwapchainKHR> old_swapchain = std::move(swapchain_);
 	swapchain_ = make_handle<VkSwapchainKHR>(VK_NULL_HANDLE);
+	needs_recreation_ = false;
+
+	support_ = context_->device_.query_swapchain_support(context_->surface_.handle());
 
 	// Choose swapchain surface format and throw an error if this wasn't possible
 	if (!choose_swapchain_surface_format())
@@ -126,37 +217,29 @@ void Swapchain::recreate_swapchain()
 		throw std::runtime_error("Failed to choose swapchain surface format!");
 	}
 
-	// Choose present mode
-	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;// fifo support is guaranteed by the Vulkan standard.
-	for (auto supported_mode: context_->device_.get_swapchain_support_details().present_modes)
-	{
-		if (supported_mode == VK_PRESENT_MODE_MAILBOX_KHR)
-		{
-			present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
-			break;
-		}
-	}
+	present_mode_ = choose_present_mode();
 
-	context_->device_.update_swapchain_support_details();
-
-	VkExtent2D extent = context_->device_.get_swapchain_support_details().capabilities.currentExtent;
+	VkExtent2D extent = support_.capabilities.currentExtent;
+	// The surface size is determined by the swapchain, use the window's frame buffer size
+	if (extent.width == std::numeric_limits<uint32_t>::max())
+		extent = context_->window_->get_extent();
 
 	// Clamp size
 	extent.width = std::clamp(
 			extent.width,
-			context_->device_.get_swapchain_support_details().capabilities.minImageExtent.width,
-			context_->device_.get_swapchain_support_details().capabilities.maxImageExtent.width);
+			support_.capabilities.minImageExtent.width,
+			support_.capabilities.maxImageExtent.width);
 	extent.height = std::clamp(
 			extent.height,
-			context_->device_.get_swapchain_support_details().capabilities.minImageExtent.height,
-			context_->device_.get_swapchain_support_details().capabilities.maxImageExtent.height);
+			support_.capabilities.minImageExtent.height,
+			support_.capabilities.maxImageExtent.height);
 
-	// Get image count
-	uint32_t image_count = std::clamp(
-		3u,
-		context_->device_.get_swapchain_support_details().capabilities.minImageCount,
-		context_->device_.get_swapchain_support_details().capabilities.maxImageCount);
-	assert(image_count < 4u);
+	// Get image count. One image more than the frames in flight, so a frame can be recorded while another is
+	// being displayed. A maxImageCount of 0 means there is no upper limit.
+	const auto &capabilities = support_.capabilities;
+	uint32_t image_count = std::max<uint32_t>(max_frames_in_flight_ + 1u, capabilities.minImageCount);
+	if (capabilities.maxImageCount > 0)
+		image_count = std::min(image_count, capabilities.maxImageCount);
 
 	// Swapchain create info
 	VkSwapchainCreateInfoKHR create_info{};
@@ -185,9 +268,9 @@ void Swapchain::recreate_swapchain()
 		create_info.pQueueFamilyIndices = nullptr;// Optional
 	}
 
-	create_info.preTransform = context_->device_.get_swapchain_support_details().capabilities.currentTransform;
+	create_info.preTransform = support_.capabilities.currentTransform;
 	create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	create_info.presentMode = present_mode;
+	create_info.presentMode = present_mode_;
 	create_info.clipped = VK_TRUE;
 	create_info.oldSwapchain = old_swapchain;
 
@@ -201,18 +284,31 @@ void Swapchain::recreate_swapchain()
 		throw std::runtime_error("Failed to create swapchain!");
 	}
 
+	extent_ = extent;
+
+	// Presents to the old swapchain may still be queued, which no fence or semaphore can tell us about. Keep it
+	// until the GPU has finished what was submitted so far and a full round of frames went to the new swapchain.
 	if (old_swapchain.not_null())
 	{
-		vkDestroySwapchainKHR(context_->device_.get_logical_device(), old_swapchain, nullptr);
+		retired_swapchains_.push_back(
+				{old_swapchain, context_->device_.get_last_submitted_value(), context_->frame_counter});
 	}
 
-	// Destroy the old images (if they exist)
-	for (auto view: swapchain_image_views_)
+	// The old views may still be referenced by submitted frames
+	if (!swapchain_image_views_.empty())
 	{
-		vkDestroyImageView(context_->device_.get_logical_device(), view, nullptr);
+		context_->device_.defer_destruction([device = context_->device_.get_logical_device(),
+											 views = std::move(swapchain_image_views_)]() {
+			for (auto view: views)
+			{
+				vkDestroyImageView(device, view, nullptr);
+			}
+		});
+		swapchain_image_views_ = {};
 	}
 
-	context_->current_frame_ = 0;
+	last_present_id_ = 0;
+	generation_++;
 	// Get the image count and check result
 	if (vkGetSwapchainImagesKHR(
 				context_->device_.get_logical_device(),
@@ -283,7 +379,7 @@ void Swapchain::regenerate_frame_buffers(RenderPass *renderpass)
 {
 	frame_buffers_.clear();
 
-	frame_buffer_size_ = {context_->device_.swapchain_support_.capabilities.currentExtent.width, context_->device_.swapchain_support_.capabilities.currentExtent.height};
+	frame_buffer_size_ = {extent_.width, extent_.height};
 	for (size_t i = 0; i < get_image_count(); i++)
 	{
 		std::vector<VkImageView> attachments{swapchain_image_views_[i], depth_attachment_->get_image_view()};
@@ -296,9 +392,50 @@ void Swapchain::regenerate_frame_buffers(RenderPass *renderpass)
 	}
 }
 
+void Swapchain::release_retired_swapchains()
+{
+	std::erase_if(retired_swapchains_, [this](const RetiredSwapchain &retired) {
+		bool released = context_->frame_counter >= retired.frame + max_frames_in_flight_ &&
+						context_->device_.is_complete(retired.timeline_value);
+		if (released)
+		{
+			vkDestroySwapchainKHR(context_->device_.get_logical_device(), retired.handle, nullptr);
+			FLOWFORGE_TRACE("Retired vulkan swapchain destroyed");
+		}
+		return released;
+	});
+}
+
+VkPresentModeKHR Swapchain::choose_present_mode() const
+{
+	VkPresentModeKHR requested = VK_PRESENT_MODE_FIFO_KHR;
+	switch (present_config_.present_mode)
+	{
+		case PresentMode::IMMEDIATE:
+			requested = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			break;
+		case PresentMode::MAILBOX:
+			requested = VK_PRESENT_MODE_MAILBOX_KHR;
+			break;
+		case PresentMode::FIFO:
+			requested = VK_PRESENT_MODE_FIFO_KHR;
+			break;
+		case PresentMode::FIFO_RELAXED:
+			requested = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			break;
+	}
+
+	const auto &supported_modes = support_.present_modes;
+	if (std::ranges::find(supported_modes, requested) != supported_modes.end())
+		return requested;
+
+	FLOWFORGE_WARN("Requested present mode is not supported, falling back to FIFO");
+	return VK_PRESENT_MODE_FIFO_KHR;// fifo support is guaranteed by the Vulkan standard.
+}
+
 bool Swapchain::choose_swapchain_surface_format()
 {
-	for (auto format: context_->device_.get_swapchain_support_details().formats)
+	for (auto format: support_.formats)
 	{
 		if (format.format == VK_FORMAT_B8G8R8A8_SRGB &&
 			format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
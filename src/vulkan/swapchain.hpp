@@ -1,7 +1,9 @@
 #pragma once
 
+#include "device.hpp"
 #include "frame_buffer.hpp"
 #include "image.hpp"
+#include "util/constants.hpp"
 #include "util/status_optional.hpp"
 
 #include <vulkan/vulkan_core.h>
@@ -11,15 +13,43 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/constants.hpp>
 
+#include <span>
+
 
 namespace flwfrg::vk
 {
 class DisplayContext;
 
+enum class PresentMode
+{
+    // Presents right away, may tear. Lowest latency.
+    IMMEDIATE,
+    // Replaces the queued image with the newest one, never tears. Low latency at the cost of throwing frames away.
+    MAILBOX,
+    // Vsync. Always supported, highest latency once the queue is full.
+    FIFO,
+    // Vsync, but tears instead of waiting another refresh when a frame is late.
+    FIFO_RELAXED
+};
+
+struct PresentConfig
+{
+    // Falls back to FIFO when the surface does not support the requested mode
+    PresentMode present_mode = PresentMode::MAILBOX;
+    // Frames the CPU may record ahead of the GPU. More frames favor throughput, fewer favor latency.
+    // At most constant::max_frames_in_flight.
+    uint8_t frames_in_flight = 3;
+    // Block before sampling input until at most max_queued_frames earlier presents are still waiting to be
+    // displayed. 0 gives the lowest latency, 1 keeps the CPU working while the GPU finishes the previous frame.
+    // Uses VK_KHR_present_wait when available, otherwise waits for the GPU to finish the frame instead.
+    bool latency_limiter = false;
+    uint8_t max_queued_frames = 1;
+};
+
 class Swapchain
 {
 public:
-    explicit Swapchain(DisplayContext *context);
+    explicit Swapchain(DisplayContext *context, PresentConfig config = {});
     ~Swapchain();
 
     // Copy
@@ -34,14 +64,57 @@ public:
                               uint32_t *out_image_index);
     Status present(VkQueue graphics_queue, VkQueue present_queue, VkSemaphore render_complete_semaphore,
                    uint32_t present_image_index);
+
+    struct PresentRequest
+    {
+        Swapchain *swapchain = nullptr;
+        VkSemaphore render_complete_semaphore = VK_NULL_HANDLE;
+        uint32_t image_index = 0;
+    };
+    /// Presents to several swapchains of the same device in a single vkQueuePresentKHR. Returns a status per request.
+    static std::vector<Status> present(VkQueue present_queue, std::span<const PresentRequest> requests);
     [[nodiscard]] inline uint8_t get_image_count() const { return swapchain_images_.size(); };
     [[nodiscard]] inline glm::vec2 get_frame_buffer_size() const { return frame_buffer_size_; };
+    [[nodiscard]] inline VkExtent2D get_extent() const { return extent_; };
+    [[nodiscard]] inline VkFormat get_image_format() const { return swapchain_image_format_.format; };
+    [[nodiscard]] inline VkImage get_image(uint32_t index) const { return swapchain_images_[index]; };
+    [[nodiscard]] inline VkImageView get_image_view(uint32_t index) const { return swapchain_image_views_[index]; };
+    // Set when acquire or present reported the swapchain as out of date or suboptimal
+    [[nodiscard]] inline bool needs_recreation() const { return needs_recreation_; };
+    [[nodiscard]] inline uint8_t get_max_frames_in_flight() const { return max_frames_in_flight_; };
+    [[nodiscard]] inline const PresentConfig &get_present_config() const { return present_config_; };
+    // The mode actually in use, which differs from the requested one if the surface lacks support for it
+    [[nodiscard]] inline VkPresentModeKHR get_present_mode() const { return present_mode_; };
+    // Id attached to the last successful present, 0 if present ids are not supported
+    [[nodiscard]] inline uint64_t get_last_present_id() const { return last_present_id_; };
+    // Incremented every time the swapchain is recreated. Present ids of an older swapchain can not be waited on.
+    [[nodiscard]] inline uint64_t get_generation() const { return generation_; };
+    /// Blocks until the present with present_id has been displayed. Returns false on timeout, or if the id belongs
+    /// to an older swapchain the wait is no longer possible for.
+    bool wait_for_present(uint64_t present_id, uint64_t timeout_ns) const;
 
 private:
     DisplayContext *context_;
 
+    SwapchainSupportDetails support_{};
     VkSurfaceFormatKHR swapchain_image_format_;
+    PresentConfig present_config_;
+    VkPresentModeKHR present_mode_ = VK_PRESENT_MODE_FIFO_KHR;
     uint8_t max_frames_in_flight_ = 3;
+    uint64_t last_present_id_ = 0;
+    uint64_t generation_ = 0;
+    VkExtent2D extent_{};
+    bool needs_recreation_ = false;
+
+    struct RetiredSwapchain
+    {
+        VkSwapchainKHR handle = VK_NULL_HANDLE;
+        // Last submission made before the swapchain was retired
+        uint64_t timeline_value = 0;
+        // Display context frame counter at retirement
+        uint64_t frame = 0;
+    };
+    std::vector<RetiredSwapchain> retired_swapchains_{};
     Handle<VkSwapchainKHR> swapchain_{};
 
     // Not stored in flwfrg::vk::Image since swapchain images are retrieved, not created.
@@ -55,8 +128,11 @@ private:
 
     void recreate_swapchain();
     void regenerate_frame_buffers(RenderPass *renderpass);
+    void release_retired_swapchains();
+    Status finish_present(VkResult result, uint64_t present_id);
 
     bool choose_swapchain_surface_format();
+    VkPresentModeKHR choose_present_mode() const;
 
     friend DisplayContext;
 };
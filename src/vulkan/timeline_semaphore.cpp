@@ -0,0 +1,88 @@
+#include "pch.hpp"
+
+#include "timeline_semaphore.hpp"
+
+#include "device.hpp"
+
+namespace flwfrg::vk
+{
+
+TimelineSemaphore::TimelineSemaphore(Device *device, uint64_t initial_value) : device_{device}
+{
+    assert(device_ != nullptr);
+
+    VkSemaphoreTypeCreateInfo type_info{};
+    type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    type_info.initialValue = initial_value;
+
+    VkSemaphoreCreateInfo semaphore_info{};
+    semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphore_info.pNext = &type_info;
+
+    if (vkCreateSemaphore(device_->get_logical_device(), &semaphore_info, nullptr, handle_.ptr()) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to create timeline semaphore");
+    }
+}
+
+TimelineSemaphore::~TimelineSemaphore()
+{
+    if (handle_.not_null())
+    {
+        vkDestroySemaphore(device_->get_logical_device(), handle_, nullptr);
+        handle_ = make_handle<VkSemaphore>(VK_NULL_HANDLE);
+    }
+}
+
+uint64_t TimelineSemaphore::get_value() const
+{
+    uint64_t value = 0;
+    if (vkGetSemaphoreCounterValue(device_->get_logical_device(), handle_, &value) != VK_SUCCESS)
+    {
+        FLOWFORGE_ERROR("Failed to get timeline semaphore value");
+    }
+    return value;
+}
+
+bool TimelineSemaphore::wait_for(uint64_t value, uint64_t timeout_ns) const
+{
+    VkSemaphore semaphore = handle_;
+
+    VkSemaphoreWaitInfo wait_info{};
+    wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &semaphore;
+    wait_info.pValues = &value;
+
+    VkResult result = vkWaitSemaphores(device_->get_logical_device(), &wait_info, timeout_ns);
+    switch (result)
+    {
+        case VK_SUCCESS:
+            return true;
+        case VK_TIMEOUT:
+            FLOWFORGE_WARN("Timeline semaphore wait timed out");
+            return false;
+        case VK_ERROR_DEVICE_LOST:
+            FLOWFORGE_ERROR("Device lost while waiting for timeline semaphore");
+            return false;
+        default:
+            FLOWFORGE_ERROR("Failed to wait for timeline semaphore");
+            return false;
+    }
+}
+
+void TimelineSemaphore::signal(uint64_t value)
+{
+    VkSemaphoreSignalInfo signal_info{};
+    signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO;
+    signal_info.semaphore = handle_;
+    signal_info.value = value;
+
+    if (vkSignalSemaphore(device_->get_logical_device(), &signal_info) != VK_SUCCESS)
+    {
+        throw std::runtime_error("Failed to signal timeline semaphore");
+    }
+}
+
+}// namespace flwfrg::vk
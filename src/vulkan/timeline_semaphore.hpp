@@ -0,0 +1,46 @@
+#pragma once
+
+#include "util/handle.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+namespace flwfrg::vk
+{
+class Device;
+
+/// A VK_SEMAPHORE_TYPE_TIMELINE semaphore. Its counter only ever increases, so a single semaphore can stand in for
+/// any number of fences: work is done once the counter has reached the value it signals.
+class TimelineSemaphore
+{
+public:
+    TimelineSemaphore() = default;
+    explicit TimelineSemaphore(Device *device, uint64_t initial_value = 0);
+    ~TimelineSemaphore();
+
+    // Copy
+    TimelineSemaphore(const TimelineSemaphore &) = delete;
+    TimelineSemaphore &operator=(const TimelineSemaphore &) = delete;
+    // Move
+    TimelineSemaphore(TimelineSemaphore &&other) noexcept = default;
+    TimelineSemaphore &operator=(TimelineSemaphore &&other) noexcept = default;
+
+    // Methods
+
+    [[nodiscard]] constexpr VkSemaphore handle() const { return handle_; }
+
+    /// Current counter value, without blocking.
+    [[nodiscard]] uint64_t get_value() const;
+
+    /// Blocks until the counter has reached value. Returns false on timeout or error.
+    bool wait_for(uint64_t value, uint64_t timeout_ns) const;
+
+    /// Signals value from the host.
+    void signal(uint64_t value);
+
+private:
+    Device *device_ = nullptr;
+
+    Handle<VkSemaphore> handle_{};
+};
+
+}// namespace flwfrg::vk
@@ -4,5 +4,7 @@ namespace flwfrg::vk::constant
 {
 constexpr uint32_t invalid_id = std::numeric_limits<uint32_t>::max();
 constexpr uint32_t invalid_generation = std::numeric_limits<uint32_t>::max();
+// Upper bound for PresentConfig::frames_in_flight, per-frame buffers are sized for it
+constexpr uint8_t max_frames_in_flight = 4;
 
 }
\ No newline at end of file
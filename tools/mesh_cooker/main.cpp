@@ -0,0 +1,96 @@
+#include "import/cooked_mesh.hpp"
+#include "import/imported_scene.hpp"
+#include "threading/thread_pool.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string_view>
+
+namespace
+{
+
+void print_usage()
+{
+    std::cerr << "Usage: mesh_cooker <input .gltf/.glb/.obj> <output .ffmesh> [options]\n"
+                 "Options:\n"
+                 "  --full           Store full precision vertices instead of quantized ones\n"
+                 "  --lods <count>   Levels of detail to generate, including the full mesh (default 4, at most "
+              << flwfrg::max_lod_count
+              << ")\n"
+                 "  --no-optimize    Keep the vertex and triangle order of the input\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        print_usage();
+        return EXIT_FAILURE;
+    }
+
+    flwfrg::CookConfig config{};
+    for (int argument = 3; argument < argc; argument++)
+    {
+        std::string_view option = argv[argument];
+        if (option == "--full")
+        {
+            config.vertex_format = flwfrg::vk::VertexFormat::FULL;
+        }
+        else if (option == "--lods" && argument + 1 < argc)
+        {
+            int level_count = std::atoi(argv[++argument]);
+            if (level_count < 1 || level_count > static_cast<int>(flwfrg::max_lod_count))
+            {
+                print_usage();
+                return EXIT_FAILURE;
+            }
+            config.lod.level_count = static_cast<uint32_t>(level_count);
+        }
+        else if (option == "--no-optimize")
+        {
+            config.optimization = flwfrg::MeshOptimizationConfig{
+                    .deduplicate_vertices = false,
+                    .optimize_vertex_cache = false,
+                    .optimize_overdraw = false,
+                    .optimize_vertex_fetch = false,
+            };
+        }
+        else
+        {
+            print_usage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    try
+    {
+        flwfrg::ThreadPool thread_pool{};
+
+        auto start = std::chrono::steady_clock::now();
+        flwfrg::ImportedScene scene = flwfrg::import_scene(argv[1], thread_pool);
+        auto imported = std::chrono::steady_clock::now();
+        flwfrg::cook_scene(scene, argv[2], thread_pool, config);
+        auto cooked = std::chrono::steady_clock::now();
+
+        size_t primitive_count = 0;
+        for (const auto &mesh: scene.meshes)
+        {
+            primitive_count += mesh.primitives.size();
+        }
+        std::cout << "Cooked " << primitive_count << " primitives and " << scene.nodes.size() << " nodes into "
+                  << argv[2] << " (import "
+                  << std::chrono::duration<double, std::milli>(imported - start).count() << " ms, cook "
+                  << std::chrono::duration<double, std::milli>(cooked - imported).count() << " ms)\n";
+    }
+    catch (const std::exception &exception)
+    {
+        std::cerr << exception.what() << '\n';
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}